@@ -3,6 +3,10 @@
 //
 // Demonstrates drawing hills using a grid and 2D function to set the height of each vertex.
 //
+// The monkey face is read straight from models/monkeyface.blend.  Run with -assimp
+// to stream models/monkeyface.fbx through ModelImporter instead.  Either loader
+// falls back to the other if its file can't be read.
+//
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
 //      Hold the right mouse button down to zoom in and out.
@@ -13,9 +17,9 @@
 #include "d3dx11Effect.h"
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include "BlendFile.h"
+#include "ModelImporter.h"
 
-#include <assimp/Importer.hpp>      // C++ importer interface
-#include <assimp/scene.h>           // Output data structure
 #include <assimp/postprocess.h>     // Post processing fla
 
 struct MyVertex
@@ -24,10 +28,10 @@ struct MyVertex
 	XMFLOAT4 Color;
 };
 
-class HillsApp : public D3DApp
+class HillsApp : public D3DApp, private ModelImporter::Consumer
 {
 public:
-	HillsApp(HINSTANCE hInstance);
+	HillsApp(HINSTANCE hInstance, bool useImporter);
 	~HillsApp();
 
 	bool Init();
@@ -41,7 +45,12 @@ public:
 
 private:
 	float GetHeight(float x, float z)const;
-	void BuildGeometryBuffers();
+	bool BuildGeometryBuffers();
+	bool BuildBlendBuffers(const std::string& filename);
+	bool LoadBlendMesh(const std::string& filename, std::vector<MyVertex>& vertices, std::vector<UINT>& indices);
+	bool LoadAssimpMesh(const std::string& filename);
+	void BeginModel(uint32_t numMeshes, uint32_t numVertices, uint32_t numIndices);
+	void ConsumeMesh(const ModelImporter::Mesh& mesh);
 	void BuildFX();
 	void BuildVertexLayout();
 
@@ -60,6 +69,12 @@ private:
 
 	UINT mMeshIndexCount;
 
+	// Load the model through ModelImporter rather than BlendFile.
+	bool mUseImporter;
+
+	// Reused for each mesh LoadAssimpMesh() uploads.
+	std::vector<MyVertex> mMeshVertices;
+
 	XMFLOAT4X4 mView;
 	XMFLOAT4X4 mProj;
 
@@ -78,7 +93,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
-	HillsApp theApp(hInstance);
+	HillsApp theApp(hInstance, strstr(cmdLine, "-assimp") != 0);
 	
 	if( !theApp.Init() )
 		return 0;
@@ -87,9 +102,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 }
  
 
-HillsApp::HillsApp(HINSTANCE hInstance)
+HillsApp::HillsApp(HINSTANCE hInstance, bool useImporter)
 : D3DApp(hInstance), mVB(0), mIB(0), mFX(0), mTech(0),
-  mfxWorldViewProj(0), mInputLayout(0), mMeshIndexCount(0),
+  mfxWorldViewProj(0), mInputLayout(0), mMeshIndexCount(0), mUseImporter(useImporter),
   mTheta(1.5f*MathHelper::Pi), mPhi(0.1f*MathHelper::Pi), mRadius(200.0f)
 {
 	mMainWndCaption = L"Hills Demo";
@@ -116,7 +131,12 @@ bool HillsApp::Init()
 	if(!D3DApp::Init())
 		return false;
 
-	BuildGeometryBuffers();
+	if( !BuildGeometryBuffers() )
+	{
+		MessageBox(0, L"Failed to load models/monkeyface.blend or models/monkeyface.fbx.", 0, 0);
+		return false;
+	}
+
 	BuildFX();
 	BuildVertexLayout();
 
@@ -231,46 +251,26 @@ float HillsApp::GetHeight(float x, float z)const
 	return 0.3f*( z*sinf(0.1f*x) + x*cosf(0.1f*z) );
 }
 
-void HillsApp::BuildGeometryBuffers()
+bool HillsApp::BuildGeometryBuffers()
 {
-	//create a new assimp importer object
-	Assimp::Importer importer;
-	//generate a mesh from the given file using assimp
-	const aiScene *assScene = importer.ReadFile("models/monkeyface.fbx", aiPostProcessSteps::aiProcess_CalcTangentSpace |
-																			aiPostProcessSteps::aiProcess_Triangulate |
-																			aiPostProcessSteps::aiProcess_JoinIdenticalVertices |
-																			aiPostProcessSteps::aiProcess_SortByPType);
+	const std::string blendFile = "models/monkeyface.blend";
+	const std::string fbxFile   = "models/monkeyface.fbx";
+
+	if( mUseImporter )
+		return LoadAssimpMesh(fbxFile) || BuildBlendBuffers(blendFile);
+
+	return BuildBlendBuffers(blendFile) || LoadAssimpMesh(fbxFile);
+}
 
+bool HillsApp::BuildBlendBuffers(const std::string& filename)
+{
 	std::vector<UINT> indices;
 	std::vector<MyVertex> vertices;
-	for (size_t i = 0; i < assScene->mNumMeshes; i++)
-	{
-		aiMesh *assMesh = assScene->mMeshes[i];
-		for (size_t j = 0; j < assMesh->mNumVertices; j++)
-		{
-			MyVertex vertex;
-			vertex.Pos = XMFLOAT3(assMesh->mVertices[j].x, assMesh->mVertices[j].y, assMesh->mVertices[j].z);
-			if (assMesh->HasVertexColors(i))
-			{
-				vertex.Color = XMFLOAT4(assMesh->mColors[i][j].r, assMesh->mColors[i][j].g, assMesh->mColors[i][j].b, assMesh->mColors[i][j].a);
-			}
-			else
-			{
-				vertex.Color = XMFLOAT4(255, 255, 255, 255);
-			}
-			vertices.push_back(vertex);
-		}
-		for (size_t j = 0; j < assMesh->mNumFaces; j++)
-		{
-			aiFace assFace = assMesh->mFaces[j];
-			for (size_t f = 0; f < assFace.mNumIndices; f++)
-			{
-				indices.push_back(assFace.mIndices[f]);
-				mMeshIndexCount ++;
-			}
-		}
 
-	}
+	if( !LoadBlendMesh(filename, vertices, indices) )
+		return false;
+
+	mMeshIndexCount = indices.size();
 
     D3D11_BUFFER_DESC vbd;
     vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -295,8 +295,122 @@ void HillsApp::BuildGeometryBuffers()
     D3D11_SUBRESOURCE_DATA iinitData;
 	iinitData.pSysMem = &indices[0];
     HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mIB));
+
+	return true;
 }
  
+bool HillsApp::LoadBlendMesh(const std::string& filename, std::vector<MyVertex>& vertices, std::vector<UINT>& indices)
+{
+	BlendFile file;
+	if( !file.Open(filename) )
+		return false;
+
+	BlendFile::Mesh mesh;
+	for(UINT m = 0; m < file.GetMeshCount(); ++m)
+	{
+		if( !file.ReadMesh(m, mesh) )
+		{
+			vertices.clear();
+			indices.clear();
+			return false;
+		}
+
+		UINT baseVertex = vertices.size();
+
+		vertices.resize(baseVertex + mesh.Vertices.size());
+		for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+		{
+			const float* p = mesh.Vertices[i].Position;
+
+			vertices[baseVertex + i].Pos   = XMFLOAT3(p[0], p[1], p[2]);
+			vertices[baseVertex + i].Color = XMFLOAT4(255, 255, 255, 255);
+		}
+
+		for(size_t i = 0; i < mesh.Indices.size(); ++i)
+			indices.push_back(baseVertex + mesh.Indices[i]);
+	}
+
+	return !indices.empty();
+}
+
+bool HillsApp::LoadAssimpMesh(const std::string& filename)
+{
+	// The meshes are converted on the job system and uploaded one at a time by
+	// BeginModel() and ConsumeMesh(); the scene is freed as they arrive.
+	ModelImporter importer;
+	bool loaded = importer.Import(filename, aiProcess_JoinIdenticalVertices | aiProcess_SortByPType, *this);
+
+	mMeshVertices.clear();
+	mMeshVertices.shrink_to_fit();
+
+	// A model without triangles leaves nothing to draw.
+	if( !loaded || mMeshIndexCount == 0 )
+	{
+		ReleaseCOM(mVB);
+		ReleaseCOM(mIB);
+		mMeshIndexCount = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void HillsApp::BeginModel(uint32_t numMeshes, uint32_t numVertices, uint32_t numIndices)
+{
+	mMeshIndexCount = numIndices;
+
+	if( numVertices == 0 || numIndices == 0 )
+		return;
+
+	// Default usage, since the meshes are written into the buffers as they are
+	// converted instead of all at creation.
+    D3D11_BUFFER_DESC vbd;
+    vbd.Usage = D3D11_USAGE_DEFAULT;
+	vbd.ByteWidth = sizeof(MyVertex) * numVertices;
+    vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    vbd.CPUAccessFlags = 0;
+    vbd.MiscFlags = 0;
+    HR(md3dDevice->CreateBuffer(&vbd, 0, &mVB));
+
+	D3D11_BUFFER_DESC ibd;
+    ibd.Usage = D3D11_USAGE_DEFAULT;
+	ibd.ByteWidth = sizeof(UINT) * numIndices;
+    ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    ibd.CPUAccessFlags = 0;
+    ibd.MiscFlags = 0;
+    HR(md3dDevice->CreateBuffer(&ibd, 0, &mIB));
+}
+
+void HillsApp::ConsumeMesh(const ModelImporter::Mesh& mesh)
+{
+	if( mesh.Vertices.empty() || mesh.Indices.empty() )
+		return;
+
+	mMeshVertices.resize(mesh.Vertices.size());
+	for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+	{
+		const float* p = mesh.Vertices[i].Position;
+		const float* c = mesh.Vertices[i].Color;
+
+		mMeshVertices[i].Pos   = XMFLOAT3(p[0], p[1], p[2]);
+		mMeshVertices[i].Color = XMFLOAT4(c[0], c[1], c[2], c[3]);
+	}
+
+	// Buffer boxes are in bytes along x.
+	D3D11_BOX box;
+	box.left   = sizeof(MyVertex) * mesh.BaseVertex;
+	box.right  = sizeof(MyVertex) * (mesh.BaseVertex + mesh.Vertices.size());
+	box.top    = 0;
+	box.bottom = 1;
+	box.front  = 0;
+	box.back   = 1;
+	md3dImmediateContext->UpdateSubresource(mVB, 0, &box, &mMeshVertices[0], 0, 0);
+
+	box.left  = sizeof(UINT) * mesh.StartIndex;
+	box.right = sizeof(UINT) * (mesh.StartIndex + mesh.Indices.size());
+	md3dImmediateContext->UpdateSubresource(mIB, 0, &box, &mesh.Indices[0], 0, 0);
+}
+
 void HillsApp::BuildFX()
 {
 	std::ifstream fin("fx/color.fxo", std::ios::binary);
@@ -13,6 +13,14 @@ cbuffer cbPerObject
 	float globalTime;
 };
 
+cbuffer cbPerFrame
+{
+	float4x4 gViewProj;
+
+	// Indexed by the per instance material id.
+	float4 gMaterialColors[8];
+};
+
 struct VertexIn
 {
 	float3 Pos   : POSITION;
@@ -38,6 +46,33 @@ VertexOut VS(VertexIn vin)
 	return vout;
 }
 
+struct InstancedVertexIn
+{
+	float3 Pos   : POSITION;
+	float4 Color : COLOR;
+	row_major float4x4 World : WORLD;
+	uint MaterialId : MATERIAL;
+};
+
+VertexOut InstancedVS(InstancedVertexIn vin)
+{
+	VertexOut vout;
+
+	// Transform to world space with the instance's matrix, then to homogeneous clip space.
+	float4 posW = mul(float4(vin.Pos, 1.0f), vin.World);
+	vout.PosH = mul(posW, gViewProj);
+
+	// The vertex color holds the shading, the material the tint.
+	vout.Color = vin.Color * gMaterialColors[vin.MaterialId % 8];
+
+	return vout;
+}
+
+float4 InstancedPS(VertexOut pin) : SV_Target
+{
+	return pin.Color;
+}
+
 
 //-----------------SETTINGS-----------------
 //#define TIMES_DETAILED (sin(time*32.0)+1.0)
@@ -199,3 +234,23 @@ technique11 ColorTech
 	}
 }
 
+technique11 InstancedColorTech
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_5_0, InstancedVS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, InstancedPS()));
+	}
+}
+
+// Plain vertex colors with gWorldViewProj, for the merged static shapes.
+technique11 VertexColorTech
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, InstancedPS()));
+	}
+}
@@ -3,6 +3,12 @@
 //
 // Demonstrates drawing simple geometric primitives in wireframe mode.
 //
+// The shapes never move, so they are merged into one static batch with their world
+// matrices and colors baked in, and drawn with a DrawIndexed call per run of visible
+// shapes (see StaticBatcher).  The field of SphereFieldSize^2 small spheres around
+// them is drawn with hardware instancing: one DrawIndexedInstanced call for all of
+// the spheres inside the view frustum (see InstanceRenderer).
+//
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
 //      Hold the right mouse button down to zoom in and out.
@@ -13,6 +19,8 @@
 #include "d3dx11Effect.h"
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include "InstanceRenderer.h"
+#include "StaticBatcher.h"
 
 struct Vertex
 {
@@ -20,6 +28,22 @@ struct Vertex
 	XMFLOAT4 Color;
 };
 
+// The field is SphereFieldSize x SphereFieldSize spheres, about 100k.
+const UINT SphereFieldSize = 316;
+const float SphereFieldSpacing = 1.5f;
+
+const XMFLOAT4 MaterialColors[8] =
+{
+	XMFLOAT4(0.9f, 0.9f, 0.9f, 1.0f),
+	XMFLOAT4(0.9f, 0.3f, 0.2f, 1.0f),
+	XMFLOAT4(0.3f, 0.7f, 0.3f, 1.0f),
+	XMFLOAT4(0.2f, 0.4f, 0.9f, 1.0f),
+	XMFLOAT4(0.9f, 0.8f, 0.2f, 1.0f),
+	XMFLOAT4(0.8f, 0.3f, 0.8f, 1.0f),
+	XMFLOAT4(0.2f, 0.8f, 0.8f, 1.0f),
+	XMFLOAT4(0.9f, 0.5f, 0.1f, 1.0f)
+};
+
 class ShapesApp : public D3DApp
 {
 public:
@@ -39,6 +63,13 @@ private:
 	void BuildGeometryBuffers();
 	void BuildFX();
 	void BuildVertexLayout();
+	void BuildInstances();
+
+	// Appends the mesh to the vertex and index lists and registers it with mInstances.
+	UINT AddMesh(const GeometryGenerator::MeshData& mesh, std::vector<Vertex>& vertices, std::vector<UINT>& indices);
+
+	// Adds a copy of the mesh, colored with the material, to mScenery.
+	void AddScenery(const GeometryGenerator::MeshData& mesh, const XMFLOAT4X4& world, UINT materialId);
 
 private:
 	ID3D11Buffer* mVB;
@@ -46,10 +77,20 @@ private:
 
 	ID3DX11Effect* mFX;
 	ID3DX11EffectTechnique* mTech;
+	ID3DX11EffectTechnique* mInstancedTech;
+	ID3DX11EffectTechnique* mVertexColorTech;
 	ID3DX11EffectMatrixVariable* mfxWorldViewProj;
+	ID3DX11EffectMatrixVariable* mfxViewProj;
+	ID3DX11EffectVectorVariable* mfxMaterialColors;
 	ID3DX11EffectScalarVariable* globalTime;
 
 	ID3D11InputLayout* mInputLayout;
+	ID3D11InputLayout* mInstancedInputLayout;
+
+	InstanceRenderer mInstances;
+	StaticBatcher mScenery;
+
+	UINT mSmallSphereMesh;
 
 	//ID3D11RasterizerState* mWireframeRS;
 
@@ -63,21 +104,6 @@ private:
 	XMFLOAT4X4 mView;
 	XMFLOAT4X4 mProj;
 
-	int mBoxVertexOffset;
-	int mGridVertexOffset;
-	int mSphereVertexOffset;
-	int mCylinderVertexOffset;
-
-	UINT mBoxIndexOffset;
-	UINT mGridIndexOffset;
-	UINT mSphereIndexOffset;
-	UINT mCylinderIndexOffset;
-
-	UINT mBoxIndexCount;
-	UINT mGridIndexCount;
-	UINT mSphereIndexCount;
-	UINT mCylinderIndexCount;
-
 	float mTheta;
 	float mPhi;
 	float mRadius;
@@ -103,8 +129,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
  
 
 ShapesApp::ShapesApp(HINSTANCE hInstance)
-: D3DApp(hInstance), mVB(0), mIB(0), mFX(0), mTech(0),
-  mfxWorldViewProj(0), mInputLayout(0), /*mWireframeRS(0),*/
+: D3DApp(hInstance), mVB(0), mIB(0), mFX(0), mTech(0), mInstancedTech(0), mVertexColorTech(0),
+  mfxWorldViewProj(0), mfxViewProj(0), mfxMaterialColors(0), mInputLayout(0), mInstancedInputLayout(0),
+  /*mWireframeRS(0),*/ mSmallSphereMesh(0),
   mTheta(1.5f*MathHelper::Pi), mPhi(0.1f*MathHelper::Pi), mRadius(15.0f)
 {
 	mMainWndCaption = L"Shapes Demo";
@@ -141,6 +168,7 @@ ShapesApp::~ShapesApp()
 	ReleaseCOM(mIB);
 	ReleaseCOM(mFX);
 	ReleaseCOM(mInputLayout);
+	ReleaseCOM(mInstancedInputLayout);
 	//ReleaseCOM(mWireframeRS);
 }
 
@@ -149,9 +177,12 @@ bool ShapesApp::Init()
 	if(!D3DApp::Init())
 		return false;
 
+	mInstances.Init(md3dDevice);
+
 	BuildGeometryBuffers();
 	BuildFX();
 	BuildVertexLayout();
+	BuildInstances();
 
 	/*D3D11_RASTERIZER_DESC wireframeDesc;
 	ZeroMemory(&wireframeDesc, sizeof(D3D11_RASTERIZER_DESC));
@@ -222,6 +253,42 @@ void ShapesApp::DrawScene()
 		md3dImmediateContext->Draw(6, 0);
 	}
 
+	//
+	// Draw the sphere field, one draw call for all of the visible spheres.
+	//
+
+	mInstances.Cull(viewProj);
+
+	mfxViewProj->SetMatrix(reinterpret_cast<float*>(&viewProj));
+	mfxMaterialColors->SetFloatVectorArray(reinterpret_cast<const float*>(MaterialColors), 0, 8);
+
+	md3dImmediateContext->IASetInputLayout(mInstancedInputLayout);
+
+	mInstancedTech->GetDesc( &techDesc );
+	for (UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		mInstancedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+		mInstances.Draw(md3dImmediateContext);
+	}
+
+	//
+	// Draw the shapes from their merged buffers.  Their vertices are already in
+	// world space.
+	//
+
+	mScenery.Cull(viewProj);
+	mScenery.Bind(md3dImmediateContext);
+
+	md3dImmediateContext->IASetInputLayout(mInputLayout);
+
+	mVertexColorTech->GetDesc( &techDesc );
+	for (UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		mfxWorldViewProj->SetMatrix(reinterpret_cast<float*>(&viewProj));
+		mVertexColorTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+		mScenery.Draw(md3dImmediateContext, 0);
+	}
+
 	HR(mSwapChain->Present(0, 0));
 }
 
@@ -283,17 +350,56 @@ void ShapesApp::BuildGeometryBuffers()
 	verts[4] = GeometryGenerator::Vertex(+10.0f, -10.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.5f);
 	verts[5] = GeometryGenerator::Vertex(-10.0f, +10.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f);
 
-	UINT totalVertexCount = sizeof(verts) / sizeof(GeometryGenerator::Vertex);
+	UINT quadVertexCount = sizeof(verts) / sizeof(GeometryGenerator::Vertex);
 
-	std::vector<Vertex> vertices(totalVertexCount);
+	std::vector<Vertex> vertices(quadVertexCount);
 
 	UINT k = 0;
-	for (size_t i = 0; i < totalVertexCount; ++i, ++k)
+	for (size_t i = 0; i < quadVertexCount; ++i, ++k)
 	{
 		vertices[k].Pos = verts[i].Position;
 		vertices[k].Color = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
 	}
 
+	//
+	// The instanced sphere follows the quad in the same vertex buffer.  The shapes
+	// are merged into mScenery.
+	//
+
+	GeometryGenerator::MeshData box;
+	GeometryGenerator::MeshData sphere;
+	GeometryGenerator::MeshData cylinder;
+	GeometryGenerator::MeshData smallSphere;
+
+	GeometryGenerator geoGen;
+	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
+	geoGen.CreateSphere(0.5f, 20, 20, sphere);
+	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
+	geoGen.CreateSphere(0.5f, 8, 6, smallSphere);
+
+	std::vector<UINT> indices;
+
+	mSmallSphereMesh = AddMesh(smallSphere, vertices, indices);
+
+	StaticBatcher::VertexFormat format;
+	format.Stride         = sizeof(Vertex);
+	format.PositionOffset = 0;
+	format.NormalOffset   = StaticBatcher::NoElement;
+	mScenery.Init(format);
+
+	AddScenery(box, mBoxWorld, 0);
+	AddScenery(sphere, mCenterSphere, 1);
+
+	for(int i = 0; i < 10; ++i)
+	{
+		AddScenery(cylinder, mCylWorld[i], 2);
+		AddScenery(sphere, mSphereWorld[i], 3);
+	}
+
+	mScenery.Build(md3dDevice);
+
+	UINT totalVertexCount = (UINT)vertices.size();
+
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
 	vbd.ByteWidth = sizeof(Vertex) * totalVertexCount;
@@ -303,6 +409,79 @@ void ShapesApp::BuildGeometryBuffers()
 	D3D11_SUBRESOURCE_DATA vinitData;
 	vinitData.pSysMem = &vertices[0];
     HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mVB));
+
+	D3D11_BUFFER_DESC ibd;
+	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.ByteWidth = sizeof(UINT) * (UINT)indices.size();
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibd.CPUAccessFlags = 0;
+	ibd.MiscFlags = 0;
+	D3D11_SUBRESOURCE_DATA iinitData;
+	iinitData.pSysMem = &indices[0];
+	HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mIB));
+}
+
+UINT ShapesApp::AddMesh(const GeometryGenerator::MeshData& mesh, std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+	INT baseVertex = (INT)vertices.size();
+	UINT startIndex = (UINT)indices.size();
+
+	// There is no lighting, so bake a little shading from the normal into the vertex color.
+	float radius = 0.0f;
+	for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+	{
+		float shade = 0.6f + 0.4f*mesh.Vertices[i].Normal.y;
+
+		Vertex v;
+		v.Pos   = mesh.Vertices[i].Position;
+		v.Color = XMFLOAT4(shade, shade, shade, 1.0f);
+		vertices.push_back(v);
+
+		radius = MathHelper::Max(radius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&v.Pos))));
+	}
+
+	indices.insert(indices.end(), mesh.Indices.begin(), mesh.Indices.end());
+
+	return mInstances.AddMesh((UINT)mesh.Indices.size(), startIndex, baseVertex, XMFLOAT3(0.0f, 0.0f, 0.0f), radius);
+}
+
+void ShapesApp::AddScenery(const GeometryGenerator::MeshData& mesh, const XMFLOAT4X4& world, UINT materialId)
+{
+	// The same shading the instanced technique gives, with the material color
+	// baked in, so every shape draws with the one color technique.
+	const XMFLOAT4& color = MaterialColors[materialId];
+
+	std::vector<Vertex> vertices(mesh.Vertices.size());
+	for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+	{
+		float shade = 0.6f + 0.4f*mesh.Vertices[i].Normal.y;
+
+		vertices[i].Pos   = mesh.Vertices[i].Position;
+		vertices[i].Color = XMFLOAT4(shade*color.x, shade*color.y, shade*color.z, color.w);
+	}
+
+	mScenery.AddMesh(&vertices[0], (UINT)vertices.size(), &mesh.Indices[0], (UINT)mesh.Indices.size(), world, 0);
+}
+
+void ShapesApp::BuildInstances()
+{
+	// A field of small spheres on a gently rolling surface below the shapes.
+	float halfWidth = 0.5f*SphereFieldSpacing*(SphereFieldSize-1);
+
+	for(UINT i = 0; i < SphereFieldSize; ++i)
+	{
+		for(UINT j = 0; j < SphereFieldSize; ++j)
+		{
+			float x = -halfWidth + j*SphereFieldSpacing;
+			float z = -halfWidth + i*SphereFieldSpacing;
+			float y = -2.0f + 1.5f*sinf(0.05f*x)*cosf(0.05f*z);
+
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixTranslation(x, y, z));
+
+			mInstances.AddInstance(mSmallSphereMesh, world, 4 + (i + j) % 4);
+		}
+	}
 }
  
 void ShapesApp::BuildFX()
@@ -321,7 +500,11 @@ void ShapesApp::BuildFX()
 		0, md3dDevice, &mFX));
 
 	mTech    = mFX->GetTechniqueByName("ColorTech");
+	mInstancedTech = mFX->GetTechniqueByName("InstancedColorTech");
+	mVertexColorTech = mFX->GetTechniqueByName("VertexColorTech");
 	mfxWorldViewProj = mFX->GetVariableByName("gWorldViewProj")->AsMatrix();
+	mfxViewProj = mFX->GetVariableByName("gViewProj")->AsMatrix();
+	mfxMaterialColors = mFX->GetVariableByName("gMaterialColors")->AsVector();
 	globalTime = mFX->GetVariableByName("globalTime")->AsScalar();
 }
 
@@ -339,4 +522,13 @@ void ShapesApp::BuildVertexLayout()
     mTech->GetPassByIndex(0)->GetDesc(&passDesc);
 	HR(md3dDevice->CreateInputLayout(vertexDesc, 2, passDesc.pIAInputSignature, 
 		passDesc.IAInputSignatureSize, &mInputLayout));
+
+	// The instanced layout adds the per instance data from slot 1.
+	std::vector<D3D11_INPUT_ELEMENT_DESC> instancedDesc(vertexDesc, vertexDesc + 2);
+	instancedDesc.insert(instancedDesc.end(), InstanceRenderer::InstanceInputDesc,
+		InstanceRenderer::InstanceInputDesc + InstanceRenderer::InstanceInputCount);
+
+	mInstancedTech->GetPassByIndex(0)->GetDesc(&passDesc);
+	HR(md3dDevice->CreateInputLayout(&instancedDesc[0], (UINT)instancedDesc.size(), passDesc.pIAInputSignature,
+		passDesc.IAInputSignatureSize, &mInstancedInputLayout));
 }
\ No newline at end of file
@@ -6,6 +6,11 @@
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
 //      Hold the right mouse button down to zoom in and out.
+//		Press 'J' to update and draw each frame in turn, 'K' or 'L' to let
+//		the update run one or two frames ahead of the render thread.
+//
+// Run with -latencybench to time 5 seconds at each frame latency; the frames per
+// second of each are written to FrameLatency.txt.
 //
 //***************************************************************************************
 
@@ -14,6 +19,7 @@
 #include "MathHelper.h"
 #include "LightHelper.h"
 #include "Waves.h"
+#include "Heightfield.h"
 
 struct Vertex
 {
@@ -31,6 +37,8 @@ public:
 	void OnResize();
 	void UpdateScene(float dt);
 	void DrawScene(); 
+	void WriteSnapshot(UINT slot);
+	void DrawSnapshot(UINT slot);
 
 	void OnMouseDown(WPARAM btnState, int x, int y);
 	void OnMouseUp(WPARAM btnState, int x, int y);
@@ -44,7 +52,26 @@ private:
 	void BuildFX();
 	void BuildVertexLayout();
 
+	struct FrameSnapshot;
+	void WriteFrameState(FrameSnapshot& frame)const;
+	void WriteWaveVertices(Vertex* vertices)const;
+	void DrawFrame(const FrameSnapshot& frame);
+
 private:
+	// What DrawSnapshot() needs of a frame, copied after UpdateScene().
+	struct FrameSnapshot
+	{
+		XMFLOAT4X4 View;
+		XMFLOAT4X4 Proj;
+		XMFLOAT3 EyePosW;
+
+		DirectionalLight Directional;
+		PointLight Point;
+		SpotLight Spot;
+
+		std::vector<Vertex> WaveVertices;
+	};
+
 	ID3D11Buffer* mLandVB;
 	ID3D11Buffer* mLandIB;
 
@@ -52,6 +79,10 @@ private:
 	ID3D11Buffer* mWavesIB;
 
 	Waves mWaves;
+
+	// Heights of the land grid as drawn, for placing things on it.
+	Heightfield mLandHeights;
+
 	DirectionalLight mDirLight;
 	PointLight mPointLight;
 	SpotLight mSpotLight;
@@ -88,6 +119,8 @@ private:
 
 	POINT mLastMousePos;
 
+	FrameSnapshot mSnapshots[MaxFrameLatency + 1];
+
 	XMFLOAT4 spotDiffuse;
 	XMFLOAT4 spotSpecular;
 	XMFLOAT4 pointDiffuse;
@@ -106,6 +139,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	
 	if( !theApp.Init() )
 		return 0;
+
+	if( strstr(cmdLine, "-latencybench") )
+		theApp.BenchmarkFrameLatency(5.0f);
 	
 	return theApp.Run();
 }
@@ -347,6 +383,16 @@ void LightingApp::UpdateScene(float dt)
 		toon = false;
 	}
 
+	if (GetAsyncKeyState('J')) {
+		SetFrameLatency(0);
+	}
+	if (GetAsyncKeyState('K')) {
+		SetFrameLatency(1);
+	}
+	if (GetAsyncKeyState('L')) {
+		SetFrameLatency(2);
+	}
+
 	if (toon) {
 		SetToonShading(pointDiffuse, mPointLight.Diffuse, pointSpecular, mPointLight.Specular);
 		SetToonShading(spotDiffuse, mSpotLight.Diffuse, spotSpecular, mSpotLight.Specular);
@@ -399,22 +445,6 @@ void LightingApp::UpdateScene(float dt)
 
 	mWaves.Update(dt);
 
-	//
-	// Update the wave vertex buffer with the new solution.
-	//
-	
-	D3D11_MAPPED_SUBRESOURCE mappedData;
-	HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
-
-	Vertex* v = reinterpret_cast<Vertex*>(mappedData.pData);
-	for(UINT i = 0; i < mWaves.VertexCount(); ++i)
-	{
-		v[i].Pos    = mWaves[i];
-		v[i].Normal = mWaves.Normal(i);
-	}
-
-	md3dImmediateContext->Unmap(mWavesVB, 0);
-
 	//
 	// Animate the lights.
 	//
@@ -422,7 +452,7 @@ void LightingApp::UpdateScene(float dt)
 	// Circle light over the land surface.
 	mPointLight.Position.x = 70.0f*cosf( 0.2f*mTimer.TotalTime() );
 	mPointLight.Position.z = 70.0f*sinf( 0.2f*mTimer.TotalTime() );
-	mPointLight.Position.y = MathHelper::Max(GetHillHeight(mPointLight.Position.x, 
+	mPointLight.Position.y = MathHelper::Max(mLandHeights.GetHeight(mPointLight.Position.x, 
 		mPointLight.Position.z), -3.0f) + 10.0f;
 
 
@@ -434,6 +464,67 @@ void LightingApp::UpdateScene(float dt)
 }
 
 void LightingApp::DrawScene()
+{
+	// Drawn right after UpdateScene(), so nothing has to outlive the frame: the
+	// waves go straight into the vertex buffer instead of through a snapshot.
+	FrameSnapshot& frame = mSnapshots[0];
+	WriteFrameState(frame);
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	WriteWaveVertices(reinterpret_cast<Vertex*>(mappedData.pData));
+	md3dImmediateContext->Unmap(mWavesVB, 0);
+
+	DrawFrame(frame);
+}
+
+void LightingApp::WriteSnapshot(UINT slot)
+{
+	FrameSnapshot& frame = mSnapshots[slot];
+	WriteFrameState(frame);
+
+	// The simulation moves on while this frame waits to be drawn, so its
+	// solution is copied too.
+	frame.WaveVertices.resize(mWaves.VertexCount());
+	WriteWaveVertices(&frame.WaveVertices[0]);
+}
+
+void LightingApp::DrawSnapshot(UINT slot)
+{
+	const FrameSnapshot& frame = mSnapshots[slot];
+
+	//
+	// Update the wave vertex buffer with the frame's solution.
+	//
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	memcpy(mappedData.pData, &frame.WaveVertices[0], sizeof(Vertex)*frame.WaveVertices.size());
+	md3dImmediateContext->Unmap(mWavesVB, 0);
+
+	DrawFrame(frame);
+}
+
+void LightingApp::WriteFrameState(FrameSnapshot& frame)const
+{
+	frame.View        = mView;
+	frame.Proj        = mProj;
+	frame.EyePosW     = mEyePosW;
+	frame.Directional = mDirLight;
+	frame.Point       = mPointLight;
+	frame.Spot        = mSpotLight;
+}
+
+void LightingApp::WriteWaveVertices(Vertex* vertices)const
+{
+	for(UINT i = 0; i < mWaves.VertexCount(); ++i)
+	{
+		vertices[i].Pos    = mWaves[i];
+		vertices[i].Normal = mWaves.Normal(i);
+	}
+}
+
+void LightingApp::DrawFrame(const FrameSnapshot& frame)
 {
 	md3dImmediateContext->ClearRenderTargetView(mRenderTargetView, reinterpret_cast<const float*>(&Colors::LightSteelBlue));
 	md3dImmediateContext->ClearDepthStencilView(mDepthStencilView, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
@@ -444,15 +535,15 @@ void LightingApp::DrawScene()
 	UINT stride = sizeof(Vertex);
     UINT offset = 0;
 
-	XMMATRIX view  = XMLoadFloat4x4(&mView);
-	XMMATRIX proj  = XMLoadFloat4x4(&mProj);
+	XMMATRIX view  = XMLoadFloat4x4(&frame.View);
+	XMMATRIX proj  = XMLoadFloat4x4(&frame.Proj);
 	XMMATRIX viewProj = view*proj;
 
 	// Set per frame constants.
-	mfxDirLight->SetRawValue(&mDirLight, 0, sizeof(mDirLight));
-	mfxPointLight->SetRawValue(&mPointLight, 0, sizeof(mPointLight));
-	mfxSpotLight->SetRawValue(&mSpotLight, 0, sizeof(mSpotLight));
-	mfxEyePosW->SetRawValue(&mEyePosW, 0, sizeof(mEyePosW));
+	mfxDirLight->SetRawValue(&frame.Directional, 0, sizeof(frame.Directional));
+	mfxPointLight->SetRawValue(&frame.Point, 0, sizeof(frame.Point));
+	mfxSpotLight->SetRawValue(&frame.Spot, 0, sizeof(frame.Spot));
+	mfxEyePosW->SetRawValue(&frame.EyePosW, 0, sizeof(frame.EyePosW));
  
     D3DX11_TECHNIQUE_DESC techDesc;
     mTech->GetDesc( &techDesc );
@@ -590,6 +681,8 @@ void LightingApp::BuildLandGeometryBuffers()
 		vertices[i].Normal = GetHillNormal(p.x, p.z);
 	}
 
+	mLandHeights.Init(50, 50, 160.0f/49.0f, &vertices[0].Pos.y, sizeof(Vertex));
+
     D3D11_BUFFER_DESC vbd;
     vbd.Usage = D3D11_USAGE_IMMUTABLE;
 	vbd.ByteWidth = sizeof(Vertex) * grid.Vertices.size();
@@ -1,7 +1,14 @@
 //***************************************************************************************
 // CrateDemo.cpp by Frank Luna (C) 2011 All Rights Reserved.
 //
-// Demonstrates texturing a box.
+// Demonstrates texturing a box.  The phone screen plays the fire animation from a
+// flipbook atlas, cooked from the FireAnim frames on first run.
+//
+// Draws go through a RenderQueue, which sorts them by state and skips the state
+// changes that are already bound; the caption shows how many it skipped and how
+// many bytes of constants were uploaded.
+//
+// The box texture is streamed through TextureMgr.
 //
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
@@ -16,8 +23,12 @@
 #include "LightHelper.h"
 #include "Effects.h"
 #include "Vertex.h"
+#include "Flipbook.h"
+#include "RenderQueue.h"
+#include "TextureMgr.h"
+#include <iomanip>
 
-class CrateApp : public D3DApp
+class CrateApp : public D3DApp, private RenderQueue::Binder
 {
 public:
 	CrateApp(HINSTANCE hInstance);
@@ -34,19 +45,42 @@ public:
 
 private:
 	void BuildGeometryBuffers();
+	bool LoadFireAnim();
+	void BuildRenderQueue();
+
+	// RenderQueue::Binder
+	void ApplyMaterial(UINT material);
+	void ApplyObject(UINT object);
+	void ApplyPass(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc);
+
+private:
+	enum SceneMaterial
+	{
+		BoxMaterial,
+		ScreenMaterial
+	};
+
+	enum SceneObject
+	{
+		BoxObject,
+		ScreenObject
+	};
 
 private:
 	ID3D11Buffer* mBoxVB;
 	ID3D11Buffer* mBoxIB;
 
-	ID3D11ShaderResourceView* mDiffuseMapSRV;
-	ID3D11ShaderResourceView* mPhotoDiffuseMapSRV;
+	TextureMgr mTexMgr;
+	TextureMgr::Handle mDiffuseMap;
+
+	Flipbook mFireAnim;
 
 	DirectionalLight mDirLights[3];
 	Material mBoxMat;
 
 	XMFLOAT4X4 mTexTransform;
 	XMFLOAT4X4 mBoxWorld;
+	XMFLOAT4X4 mScreenWorld;
 
 	XMFLOAT4X4 mView;
 	XMFLOAT4X4 mProj;
@@ -59,6 +93,13 @@ private:
 	UINT mScreenIndexOffset;
 	UINT mScreenIndexCount;
 
+	RenderQueue mQueue;
+	UINT mBasicShader;
+	UINT mBoxGeometry;
+
+	// Set before the queue is executed, for ApplyObject().
+	XMFLOAT4X4 mViewProj;
+
 	XMFLOAT3 mEyePosW;
 
 	float mTheta;
@@ -86,7 +127,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
  
 
 CrateApp::CrateApp(HINSTANCE hInstance)
-: D3DApp(hInstance), mBoxVB(0), mBoxIB(0), mDiffuseMapSRV(0), mPhotoDiffuseMapSRV(0), mEyePosW(0.0f, 0.0f, 0.0f),
+: D3DApp(hInstance), mBoxVB(0), mBoxIB(0), mDiffuseMap(TextureMgr::InvalidHandle), mBasicShader(0), mBoxGeometry(0),
+  mEyePosW(0.0f, 0.0f, 0.0f),
   mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(2.5f)
 {
 	mMainWndCaption = L"Crate Demo";
@@ -96,6 +138,8 @@ CrateApp::CrateApp(HINSTANCE hInstance)
 
 	XMMATRIX I = XMMatrixIdentity();
 	XMStoreFloat4x4(&mBoxWorld, I);
+	XMStoreFloat4x4(&mScreenWorld, I);
+	XMStoreFloat4x4(&mViewProj, I);
 	XMStoreFloat4x4(&mTexTransform, I);
 	XMStoreFloat4x4(&mView, I);
 	XMStoreFloat4x4(&mProj, I);
@@ -119,8 +163,6 @@ CrateApp::~CrateApp()
 {
 	ReleaseCOM(mBoxVB);
 	ReleaseCOM(mBoxIB);
-	ReleaseCOM(mDiffuseMapSRV);
-	ReleaseCOM(mPhotoDiffuseMapSRV);
 
 	Effects::DestroyAll();
 	InputLayouts::DestroyAll();
@@ -135,13 +177,18 @@ bool CrateApp::Init()
 	Effects::InitAll(md3dDevice);
 	InputLayouts::InitAll(md3dDevice);
 
-	HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice, 
-		L"Textures/phone.dds", 0, 0, &mDiffuseMapSRV, 0 ));
+	// The box shows the placeholder until the worker has mapped the file.
+	mTexMgr.Init(md3dDevice, 64*1024*1024, 1);
+	mDiffuseMap = mTexMgr.RequestTexture(L"Textures/phone.dds");
 
-	HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice,
-		L"Textures/photo.dds", 0, 0, &mPhotoDiffuseMapSRV, 0));
+	if( !LoadFireAnim() )
+	{
+		MessageBox(0, L"Failed to load the FireAnim frames.", 0, 0);
+		return false;
+	}
  
 	BuildGeometryBuffers();
+	BuildRenderQueue();
 
 	return true;
 }
@@ -152,6 +199,8 @@ void CrateApp::OnResize()
 
 	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	XMStoreFloat4x4(&mProj, P);
+
+	mQueue.SetDepthRange(1.0f, 1000.0f);
 }
 
 void CrateApp::UpdateScene(float dt)
@@ -177,50 +226,98 @@ void CrateApp::DrawScene()
 	md3dImmediateContext->ClearRenderTargetView(mRenderTargetView, reinterpret_cast<const float*>(&Colors::LightSteelBlue));
 	md3dImmediateContext->ClearDepthStencilView(mDepthStencilView, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
 
-	md3dImmediateContext->IASetInputLayout(InputLayouts::Basic32);
-    md3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
- 
-	UINT stride = sizeof(Vertex::Basic32);
-    UINT offset = 0;
- 
 	XMMATRIX view  = XMLoadFloat4x4(&mView);
 	XMMATRIX proj  = XMLoadFloat4x4(&mProj);
 	XMMATRIX viewProj = view*proj;
+	XMStoreFloat4x4(&mViewProj, viewProj);
 
 	// Set per frame constants.
 	Effects::BasicFX->SetDirLights(mDirLights);
 	Effects::BasicFX->SetEyePosW(mEyePosW);
- 
-	ID3DX11EffectTechnique* activeTech = Effects::BasicFX->Light2TexTech;
-
-    D3DX11_TECHNIQUE_DESC techDesc;
-	activeTech->GetDesc( &techDesc );
-    for(UINT p = 0; p < techDesc.Passes; ++p)
-    {
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mBoxVB, &stride, &offset);
-		md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R32_UINT, 0);
-
-		// Draw the box.
-		XMMATRIX world = XMLoadFloat4x4(&mBoxWorld);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMMATRIX worldViewProj = world*view*proj;
-
-		Effects::BasicFX->SetWorld(world);
-		Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BasicFX->SetWorldViewProj(worldViewProj);
-		Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mTexTransform));
-		Effects::BasicFX->SetMaterial(mBoxMat);
 
-		Effects::BasicFX->SetDiffuseMap(mDiffuseMapSRV);
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->Draw(36, mBoxVertexOffset);
+	//
+	// Submit the box and the screen; the queue sets their states and draws them.
+	//
+
+	mQueue.Clear();
+
+	RenderQueue::Packet packet;
+	packet.Shader   = mBasicShader;
+	packet.Geometry = mBoxGeometry;
 
-		Effects::BasicFX->SetDiffuseMap(mPhotoDiffuseMapSRV);
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->Draw(6, mScreenVertexOffset);
-    }
+	XMMATRIX world = XMLoadFloat4x4(&mBoxWorld);
+	packet.Material = BoxMaterial;
+	packet.Object   = BoxObject;
+	packet.Count    = 36;
+	packet.Start    = mBoxVertexOffset;
+	packet.Depth    = XMVectorGetZ(XMVector3TransformCoord(world.r[3], view));
+	mQueue.Submit(packet);
+
+	world = XMLoadFloat4x4(&mScreenWorld);
+	packet.Material = ScreenMaterial;
+	packet.Object   = ScreenObject;
+	packet.Count    = 6;
+	packet.Start    = mScreenVertexOffset;
+	packet.Depth    = XMVectorGetZ(XMVector3TransformCoord(world.r[3], view));
+	mQueue.Submit(packet);
+
+	Effects::BasicFX->ResetStats();
+	mQueue.Execute(md3dImmediateContext, *this);
+
+	const RenderQueue::Stats& stats = mQueue.GetStats();
+
+	// A fixed buffer, so the caption costs no heap allocation once the string has
+	// grown to fit.
+	wchar_t caption[256];
+	_snwprintf_s(caption, _TRUNCATE, L"Crate Demo    State changes: %u (%u skipped)    Constants uploaded: %u bytes",
+		stats.StateChanges, stats.StateChangesRemoved, Effects::BasicFX->GetBytesUploaded());
+	mMainWndCaption = caption;
 
 	HR(mSwapChain->Present(0, 0));
+
+	mTexMgr.Update();
+}
+
+void CrateApp::ApplyMaterial(UINT material)
+{
+	Effects::BasicFX->SetMaterial(mBoxMat);
+
+	if( material == ScreenMaterial )
+	{
+		// Pick the animation frame with the texture transform.
+		UINT frame = mFireAnim.GetFrame(mTimer.TotalTime());
+		Effects::BasicFX->SetTexTransform(mFireAnim.GetFrameTransform(frame));
+		Effects::BasicFX->SetDiffuseMap(mFireAnim.GetSRV());
+	}
+	else
+	{
+		Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mTexTransform));
+		Effects::BasicFX->SetDiffuseMap(mTexMgr.GetSRV(mDiffuseMap));
+	}
+}
+
+void CrateApp::ApplyObject(UINT object)
+{
+	XMMATRIX world = XMLoadFloat4x4(object == ScreenObject ? &mScreenWorld : &mBoxWorld);
+	XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
+	XMMATRIX worldViewProj = world*XMLoadFloat4x4(&mViewProj);
+
+	Effects::BasicFX->SetWorld(world);
+	Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
+	Effects::BasicFX->SetWorldViewProj(worldViewProj);
+}
+
+void CrateApp::ApplyPass(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc)
+{
+	Effects::BasicFX->Apply(pass, dc);
+}
+
+void CrateApp::BuildRenderQueue()
+{
+	mBasicShader = mQueue.AddShader(Effects::BasicFX->GetTech(BasicEffect::Lights2 | BasicEffect::Texture), 0, InputLayouts::Basic32);
+
+	// The box and the screen are drawn without indices.
+	mBoxGeometry = mQueue.AddGeometry(mBoxVB, sizeof(Vertex::Basic32), 0);
 }
 
 void CrateApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -268,6 +365,30 @@ void CrateApp::OnMouseMove(WPARAM btnState, int x, int y)
 	mLastMousePos.y = y;
 }
 
+bool CrateApp::LoadFireAnim()
+{
+	const std::wstring flipbookFile = L"Textures/FireAnim.flip";
+
+	if( mFireAnim.Load(md3dDevice, flipbookFile) )
+		return true;
+
+	std::vector<std::wstring> frameFiles;
+	for(int i = 1; i <= 120; ++i)
+	{
+		std::wostringstream name;
+		name << L"../FireAnim/Fire" << std::setw(3) << std::setfill(L'0') << i << L".bmp";
+		frameFiles.push_back(name.str());
+	}
+
+	Flipbook::CookOptions options;
+	options.FramesPerSecond = 30.0f;
+
+	if( !Flipbook::Cook(frameFiles, flipbookFile, options) )
+		return false;
+
+	return mFireAnim.Load(md3dDevice, flipbookFile);
+}
+
 void CrateApp::BuildGeometryBuffers()
 {
 	GeometryGenerator::Vertex verts[42];
@@ -30,16 +30,15 @@ Effect::~Effect()
 
 #pragma region BasicEffect
 BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
-	: Effect(device, filename)
+	: Effect(device, filename), mDiffuseMapSRV(0), mBytesUploaded(0)
 {
-	Light1Tech    = mFX->GetTechniqueByName("Light1");
-	Light2Tech    = mFX->GetTechniqueByName("Light2");
-	Light3Tech    = mFX->GetTechniqueByName("Light3");
+	// Options in the bit order of BasicEffect::Feature.
+	static const char* lights[] = { "Light0", "Light1", "Light2", "Light3" };
+	static const char* texture[] = { "", "Tex" };
 
-	Light0TexTech = mFX->GetTechniqueByName("Light0Tex");
-	Light1TexTech = mFX->GetTechniqueByName("Light1Tex");
-	Light2TexTech = mFX->GetTechniqueByName("Light2Tex");
-	Light3TexTech = mFX->GetTechniqueByName("Light3Tex");
+	Techniques.Init(mFX);
+	Techniques.AddOption(lights, 4);
+	Techniques.AddOption(texture, 2);
 
 	WorldViewProj     = mFX->GetVariableByName("gWorldViewProj")->AsMatrix();
 	World             = mFX->GetVariableByName("gWorld")->AsMatrix();
@@ -49,11 +48,33 @@ BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
 	DirLights         = mFX->GetVariableByName("gDirLights");
 	Mat               = mFX->GetVariableByName("gMaterial");
 	DiffuseMap        = mFX->GetVariableByName("gDiffuseMap")->AsShaderResource();
+
+	PerFrameCB.Init(mFX, "cbPerFrame");
+	PerFrameCB.Track(DirLights);
+	PerFrameCB.Track(EyePosW);
+
+	PerMaterialCB.Init(mFX, "cbPerMaterial");
+	PerMaterialCB.Track(TexTransform);
+	PerMaterialCB.Track(Mat);
+
+	PerObjectCB.Init(mFX, "cbPerObject");
+	PerObjectCB.Track(World);
+	PerObjectCB.Track(WorldInvTranspose);
+	PerObjectCB.Track(WorldViewProj);
 }
 
 BasicEffect::~BasicEffect()
 {
 }
+
+void BasicEffect::Apply(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc)
+{
+	mBytesUploaded += PerFrameCB.Commit();
+	mBytesUploaded += PerMaterialCB.Commit();
+	mBytesUploaded += PerObjectCB.Commit();
+
+	pass->Apply(0, dc);
+}
 #pragma endregion
 
 #pragma region Effects
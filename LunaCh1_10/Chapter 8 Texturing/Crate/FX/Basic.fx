@@ -16,13 +16,17 @@ cbuffer cbPerFrame
 	float4 gFogColor;
 };
 
+cbuffer cbPerMaterial
+{
+	float4x4 gTexTransform;
+	Material gMaterial;
+};
+
 cbuffer cbPerObject
 {
 	float4x4 gWorld;
 	float4x4 gWorldInvTranspose;
 	float4x4 gWorldViewProj;
-	float4x4 gTexTransform;
-	Material gMaterial;
 }; 
 
 // Nonnumeric values cannot be added to a cbuffer.
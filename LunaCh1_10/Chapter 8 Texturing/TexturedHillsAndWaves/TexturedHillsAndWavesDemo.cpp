@@ -3,6 +3,13 @@
 //
 // Demonstrates texture tiling and texture animation.
 //
+// The hills are streamed from a cooked tile file, Hills.tiles, which is written
+// from the height function the first time the demo runs.
+//
+// The scene sits 1000 km from the world origin, where a float can only place a
+// vertex to within 6 cm.  Positions are kept in double and rebased to the camera
+// each frame (see LargeWorld.h), so the hills draw without jitter.
+//
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
 //      Hold the right mouse button down to zoom in and out.
@@ -17,6 +24,10 @@
 #include "Effects.h"
 #include "Vertex.h"
 #include "Waves.h"
+#include "Camera.h"
+#include "Terrain.h"
+#include "TextureStreamer.h"
+#include "LargeWorld.h"
 
 class TexturedHillsAndWavesApp : public D3DApp
 {
@@ -34,20 +45,28 @@ public:
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
 private:
-	float GetHillHeight(float x, float z)const;
-	XMFLOAT3 GetHillNormal(float x, float z)const;
-	void BuildLandGeometryBuffers();
+	static float GetHillHeight(float x, float z);
+	bool BuildLandGeometryBuffers();
 	void BuildWaveGeometryBuffers();
 
 private:
-	ID3D11Buffer* mLandVB;
-	ID3D11Buffer* mLandIB;
+	enum SceneObject
+	{
+		LandObject,
+		WavesObject,
+		NumObjects
+	};
+
+private:
+	Terrain mLand;
 
 	ID3D11Buffer* mWavesVB;
 	ID3D11Buffer* mWavesIB;
 
-	ID3D11ShaderResourceView* mGrassMapSRV;
-	ID3D11ShaderResourceView* mWavesMapSRV;
+	// Mip levels of the land and water textures stream in as the camera gets close.
+	TextureStreamer mTexStreamer;
+	TextureStreamer::Handle mGrassMap;
+	TextureStreamer::Handle mWavesMap;
 
 	Waves mWaves;
 
@@ -57,13 +76,21 @@ private:
 
 	XMFLOAT4X4 mGrassTexTransform;
 	XMFLOAT4X4 mWaterTexTransform;
-	XMFLOAT4X4 mLandWorld;
-	XMFLOAT4X4 mWavesWorld;
+	// Where the hills and waves are in the world, and the camera-relative world
+	// matrices they are drawn with this frame.
+	WorldPosition mSceneAnchor;
+	WorldTransform mTransforms[NumObjects];
+	XMFLOAT4X4 mRenderWorld[NumObjects];
+
+	RenderOrigin mOrigin;
 
-	XMFLOAT4X4 mView;
-	XMFLOAT4X4 mProj;
+	// Draws in render space, where the eye is always at the origin.
+	Camera mCam;
+
+	// The same view in the scene's own space, which the terrain and texture
+	// streamer select patches and mips in.
+	Camera mSceneCam;
 
-	UINT mLandIndexCount;
 	XMFLOAT2 mWaterTexOffset;
 
 	XMFLOAT3 mEyePosW;
@@ -92,8 +119,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 }
 
 TexturedHillsAndWavesApp::TexturedHillsAndWavesApp(HINSTANCE hInstance)
-: D3DApp(hInstance), mLandVB(0), mLandIB(0), mWavesVB(0), mWavesIB(0), mGrassMapSRV(0), mWavesMapSRV(0), mWaterTexOffset(0.0f, 0.0f),
-  mEyePosW(0.0f, 0.0f, 0.0f), mLandIndexCount(0), mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(80.0f)
+: D3DApp(hInstance), mWavesVB(0), mWavesIB(0), mGrassMap(0), mWavesMap(0), mWaterTexOffset(0.0f, 0.0f),
+  mSceneAnchor(1000000.0, 0.0, 1000000.0), mEyePosW(0.0f, 0.0f, 0.0f), mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(80.0f)
 {
 	mMainWndCaption = L"TexturedHillsAndWaves Demo";
 	
@@ -101,10 +128,11 @@ TexturedHillsAndWavesApp::TexturedHillsAndWavesApp(HINSTANCE hInstance)
 	mLastMousePos.y = 0;
 
 	XMMATRIX I = XMMatrixIdentity();
-	XMStoreFloat4x4(&mLandWorld, I);
-	XMStoreFloat4x4(&mWavesWorld, I);
-	XMStoreFloat4x4(&mView, I);
-	XMStoreFloat4x4(&mProj, I);
+	for(UINT i = 0; i < NumObjects; ++i)
+	{
+		mTransforms[i] = WorldTransform(I, mSceneAnchor);
+		XMStoreFloat4x4(&mRenderWorld[i], I);
+	}
 
 	XMMATRIX grassTexScale = XMMatrixScaling(5.0f, 5.0f, 0.0f);
 	XMStoreFloat4x4(&mGrassTexTransform, grassTexScale);
@@ -135,12 +163,8 @@ TexturedHillsAndWavesApp::TexturedHillsAndWavesApp(HINSTANCE hInstance)
 
 TexturedHillsAndWavesApp::~TexturedHillsAndWavesApp()
 {
-	ReleaseCOM(mLandVB);
-	ReleaseCOM(mLandIB);
 	ReleaseCOM(mWavesVB);
 	ReleaseCOM(mWavesIB);
-	ReleaseCOM(mGrassMapSRV);
-	ReleaseCOM(mWavesMapSRV);
 
 	Effects::DestroyAll();
 	InputLayouts::DestroyAll();
@@ -157,13 +181,13 @@ bool TexturedHillsAndWavesApp::Init()
 	Effects::InitAll(md3dDevice);
 	InputLayouts::InitAll(md3dDevice);
 
-	HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice, 
-		L"Textures/grass.dds", 0, 0, &mGrassMapSRV, 0 ));
+	mTexStreamer.Init(md3dDevice, md3dImmediateContext, 8*1024*1024);
+	mGrassMap = mTexStreamer.Register(L"Textures/grass.dds");
+	mWavesMap = mTexStreamer.Register(L"Textures/water2.dds");
 
-	HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice, 
-		L"Textures/water2.dds", 0, 0, &mWavesMapSRV, 0 ));
+	if( !BuildLandGeometryBuffers() )
+		return false;
 
-	BuildLandGeometryBuffers();
 	BuildWaveGeometryBuffers();
 
 	return true;
@@ -173,8 +197,8 @@ void TexturedHillsAndWavesApp::OnResize()
 {
 	D3DApp::OnResize();
 
-	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
-	XMStoreFloat4x4(&mProj, P);
+	mCam.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	mSceneCam.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 }
 
 void TexturedHillsAndWavesApp::UpdateScene(float dt)
@@ -184,15 +208,30 @@ void TexturedHillsAndWavesApp::UpdateScene(float dt)
 	float z = mRadius*sinf(mPhi)*sinf(mTheta);
 	float y = mRadius*cosf(mPhi);
 
-	mEyePosW = XMFLOAT3(x, y, z);
-
 	// Build the view matrix.
 	XMVECTOR pos    = XMVectorSet(x, y, z, 1.0f);
 	XMVECTOR target = XMVectorZero();
 	XMVECTOR up     = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
 
-	XMMATRIX V = XMMatrixLookAtLH(pos, target, up);
-	XMStoreFloat4x4(&mView, V);
+	mSceneCam.LookAt(pos, target, up);
+
+	// The eye is formed in double and becomes the render origin, so the view
+	// matrix holds only the rotation and the scene is a small offset away.
+	WorldPosition eyeW(mSceneAnchor.x + x, mSceneAnchor.y + y, mSceneAnchor.z + z);
+	mOrigin.SetCameraPosition(mCam, eyeW);
+	mCam.LookAt(XMFLOAT3(0.0f, 0.0f, 0.0f), mOrigin.ToRender(mSceneAnchor), XMFLOAT3(0.0f, 1.0f, 0.0f));
+
+	mEyePosW = mCam.GetPosition();
+
+	mOrigin.RebaseTransforms(mTransforms, NumObjects, mRenderWorld);
+
+	// Pick the land patches to draw from the new camera.
+	mLand.Update(mSceneCam);
+
+	// Both textures are tiled 5 times across their grid.
+	mTexStreamer.BeginFrame(mSceneCam, mClientHeight);
+	mTexStreamer.RequestCoverage(mGrassMap, XMFLOAT3(0.0f, 0.0f, 0.0f), 0.5f*sqrtf(2.0f)*mLand.GetWidth(), 5.0f);
+	mTexStreamer.RequestCoverage(mWavesMap, XMFLOAT3(0.0f, 0.0f, 0.0f), 0.5f*sqrtf(2.0f)*mWaves.Width(), 5.0f);
 
 	//
 	// Every quarter second, generate a random wave.
@@ -259,40 +298,37 @@ void TexturedHillsAndWavesApp::DrawScene()
 	UINT stride = sizeof(Vertex::Basic32);
     UINT offset = 0;
  
-	XMMATRIX view  = XMLoadFloat4x4(&mView);
-	XMMATRIX proj  = XMLoadFloat4x4(&mProj);
-	XMMATRIX viewProj = view*proj;
+	// Cached by the camera; only rebuilt when the camera moved.
+	XMMATRIX viewProj = mCam.ViewProj();
 
 	// Set per frame constants.
 	Effects::BasicFX->SetDirLights(mDirLights);
 	Effects::BasicFX->SetEyePosW(mEyePosW);
  
-	ID3DX11EffectTechnique* activeTech = Effects::BasicFX->Light3TexTech;
+	ID3DX11EffectTechnique* activeTech = Effects::BasicFX->GetTech(BasicEffect::Lights3 | BasicEffect::Texture);
 
     D3DX11_TECHNIQUE_DESC techDesc;
 	activeTech->GetDesc( &techDesc );
     for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		//
-		// Draw the hills.
+		// Draw the hills.  The terrain binds its own patch buffers.
 		//
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mLandVB, &stride, &offset);
-		md3dImmediateContext->IASetIndexBuffer(mLandIB, DXGI_FORMAT_R32_UINT, 0);
 
 		// Set per object constants.
-		XMMATRIX world = XMLoadFloat4x4(&mLandWorld);
+		XMMATRIX world = XMLoadFloat4x4(&mRenderWorld[LandObject]);
 		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMMATRIX worldViewProj = world*view*proj;
+		XMMATRIX worldViewProj = world*viewProj;
 		
 		Effects::BasicFX->SetWorld(world);
 		Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
 		Effects::BasicFX->SetWorldViewProj(worldViewProj);
 		Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mGrassTexTransform));
 		Effects::BasicFX->SetMaterial(mLandMat);
-		Effects::BasicFX->SetDiffuseMap(mGrassMapSRV);
+		Effects::BasicFX->SetDiffuseMap(mTexStreamer.GetSRV(mGrassMap));
 
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mLandIndexCount, 0, 0);
+		Effects::BasicFX->Apply(activeTech->GetPassByIndex(p), md3dImmediateContext);
+		mLand.Draw(md3dImmediateContext);
 
 		//
 		// Draw the waves.
@@ -301,22 +337,25 @@ void TexturedHillsAndWavesApp::DrawScene()
 		md3dImmediateContext->IASetIndexBuffer(mWavesIB, DXGI_FORMAT_R32_UINT, 0);
 
 		// Set per object constants.
-		world = XMLoadFloat4x4(&mWavesWorld);
+		world = XMLoadFloat4x4(&mRenderWorld[WavesObject]);
 		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+		worldViewProj = world*viewProj;
 		
 		Effects::BasicFX->SetWorld(world);
 		Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
 		Effects::BasicFX->SetWorldViewProj(worldViewProj);
 		Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mWaterTexTransform));
 		Effects::BasicFX->SetMaterial(mWavesMat);
-		Effects::BasicFX->SetDiffuseMap(mWavesMapSRV);
+		Effects::BasicFX->SetDiffuseMap(mTexStreamer.GetSRV(mWavesMap));
 
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+		Effects::BasicFX->Apply(activeTech->GetPassByIndex(p), md3dImmediateContext);
 		md3dImmediateContext->DrawIndexed(3*mWaves.TriangleCount(), 0, 0);
     }
 
 	HR(mSwapChain->Present(0, 0));
+
+	// Resize textures for what the camera needed this frame.
+	mTexStreamer.EndFrame();
 }
 
 void TexturedHillsAndWavesApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -364,75 +403,56 @@ void TexturedHillsAndWavesApp::OnMouseMove(WPARAM btnState, int x, int y)
 	mLastMousePos.y = y;
 }
 
-float TexturedHillsAndWavesApp::GetHillHeight(float x, float z)const
+float TexturedHillsAndWavesApp::GetHillHeight(float x, float z)
 {
 	return 0.3f*( z*sinf(0.1f*x) + x*cosf(0.1f*z) );
 }
 
-XMFLOAT3 TexturedHillsAndWavesApp::GetHillNormal(float x, float z)const
+bool TexturedHillsAndWavesApp::BuildLandGeometryBuffers()
 {
-	// n = (-df/dx, 1, -df/dz)
-	XMFLOAT3 n(
-		-0.03f*z*cosf(0.1f*x) - 0.3f*cosf(0.1f*z),
-		1.0f,
-		-0.3f*sinf(0.1f*x) + 0.03f*x*sinf(0.1f*z));
-	
-	XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-	XMStoreFloat3(&n, unitNormal);
-
-	return n;
-}
-
-void TexturedHillsAndWavesApp::BuildLandGeometryBuffers()
-{
-	GeometryGenerator::MeshData grid;
- 
-	GeometryGenerator geoGen;
-
-	geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+	//
+	// The hills are a quadtree terrain instead of one dense grid.  Patches far
+	// from the camera are drawn at coarser levels, so the sample count can grow
+	// without growing the number of vertices drawn.
+	//
 
-	mLandIndexCount = grid.Indices.size();
+	Terrain::InitInfo info;
+	info.HeightFunc       = &TexturedHillsAndWavesApp::GetHillHeight;
+	info.NumSamples       = 257;
+	info.PatchCells       = 16;
+	info.CellSpacing      = 160.0f / 256.0f;
+	info.LodDistance      = 30.0f;
+	info.MaxCachedPatches = 256;
 
 	//
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  
+	// Cook the tile file once from the height function, then stream the land
+	// from it the way a terrain too large for memory would be.
 	//
 
-	std::vector<Vertex::Basic32> vertices(grid.Vertices.size());
-	for(size_t i = 0; i < grid.Vertices.size(); ++i)
-	{
-		XMFLOAT3 p = grid.Vertices[i].Position;
+	const std::wstring tileFilename = L"Hills.tiles";
 
-		p.y = GetHillHeight(p.x, p.z);
-		
-		vertices[i].Pos    = p;
-		vertices[i].Normal = GetHillNormal(p.x, p.z);
-		vertices[i].Tex    = grid.Vertices[i].TexC;
+	if( GetFileAttributesW(tileFilename.c_str()) == INVALID_FILE_ATTRIBUTES )
+	{
+		Terrain source;
+		// Do not leave a partly written file behind for the next run.
+		if( source.Init(md3dDevice, info) && !source.WriteTileFile(tileFilename) )
+			DeleteFileW(tileFilename.c_str());
 	}
 
-    D3D11_BUFFER_DESC vbd;
-    vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex::Basic32) * grid.Vertices.size();
-    vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vbd.CPUAccessFlags = 0;
-    vbd.MiscFlags = 0;
-    D3D11_SUBRESOURCE_DATA vinitData;
-    vinitData.pSysMem = &vertices[0];
-    HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mLandVB));
+	Terrain::InitInfo streamedInfo = info;
+	streamedInfo.TileFilename     = tileFilename;
+	streamedInfo.TileMemoryBudget = 4*1024*1024;
 
-	//
-	// Pack the indices of all the meshes into one index buffer.
-	//
+	if( mLand.Init(md3dDevice, streamedInfo) )
+		return true;
 
-	D3D11_BUFFER_DESC ibd;
-    ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * mLandIndexCount;
-    ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    ibd.CPUAccessFlags = 0;
-    ibd.MiscFlags = 0;
-    D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &grid.Indices[0];
-    HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mLandIB));
+	// The tile file could not be written or read; keep the whole heightfield in
+	// memory instead.
+	if( mLand.Init(md3dDevice, info) )
+		return true;
+
+	MessageBox(0, L"Failed to build the terrain.", 0, 0);
+	return false;
 }
 
 void TexturedHillsAndWavesApp::BuildWaveGeometryBuffers()
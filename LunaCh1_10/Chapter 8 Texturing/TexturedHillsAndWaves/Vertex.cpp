@@ -24,7 +24,7 @@ void InputLayouts::InitAll(ID3D11Device* device)
 	// Basic32
 	//
 
-	Effects::BasicFX->Light1Tech->GetPassByIndex(0)->GetDesc(&passDesc);
+	Effects::BasicFX->GetTech(BasicEffect::Lights1)->GetPassByIndex(0)->GetDesc(&passDesc);
 	HR(device->CreateInputLayout(InputLayoutDesc::Basic32, 3, passDesc.pIAInputSignature, 
 		passDesc.IAInputSignatureSize, &Basic32));
 }
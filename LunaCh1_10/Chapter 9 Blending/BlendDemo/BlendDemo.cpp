@@ -3,6 +3,9 @@
 //
 // Demonstrates blending, HLSL clip(), and fogging.
 //
+// The transparent triangles are sorted back to front every frame (see
+// TransparencySorter), so they blend correctly from any camera angle.
+//
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
 //      Hold the right mouse button down to zoom in and out.
@@ -20,6 +23,7 @@
 #include "MathHelper.h"
 #include "RenderStates.h"
 #include "Effects.h"
+#include "TransparencySorter.h"
 
 using namespace std;
 
@@ -52,7 +56,9 @@ private:
 
 private:
 	ID3D11Buffer* mBoxVB;
-	ID3D11Buffer* mBoxIB;
+
+	// Owns the index buffer of the transparent triangles.
+	TransparencySorter mTransparentTris;
 
 	ID3D11Buffer* mBoxVB2;
 	ID3D11Buffer* mBoxIB2;
@@ -113,7 +119,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 }
 
 BlendDemo::BlendDemo(HINSTANCE hInstance)
-	: D3DApp(hInstance), mBoxVB(0), mBoxIB(0), mBoxVB2(0), mBoxIB2(0), mBoxVB3(0), mBoxIB3(0), mFX(0), mTech(0), sTech(0), aTech(0),
+	: D3DApp(hInstance), mBoxVB(0), mBoxVB2(0), mBoxIB2(0), mBoxVB3(0), mBoxIB3(0), mFX(0), mTech(0), sTech(0), aTech(0),
 	mfxWorldViewProj(0), mInputLayout(0), mWireframeRS(0),
 	mTheta(1.5f*MathHelper::Pi), mPhi(0.25f*MathHelper::Pi), mRadius(5.0f)
 {
@@ -138,7 +144,6 @@ BlendDemo::BlendDemo(HINSTANCE hInstance)
 BlendDemo::~BlendDemo()
 {
 	ReleaseCOM(mBoxVB);
-	ReleaseCOM(mBoxIB);
 	ReleaseCOM(mBoxVB2);
 	ReleaseCOM(mBoxIB2);
 	ReleaseCOM(mFX);
@@ -218,8 +223,13 @@ void BlendDemo::DrawScene()
 
 	D3DX11_TECHNIQUE_DESC techDesc;
 
+	// Order the triangles furthest to closest for this frame's camera.
+	mTransparentTris.Sort(md3dImmediateContext, world*view);
+
+	ID3D11Buffer* indexBuffer = mTransparentTris.GetIndexBuffer();
+
 	md3dImmediateContext->IASetVertexBuffers(0, 1, &mBoxVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R32_UINT, 0);
+	md3dImmediateContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 	mTech->GetDesc(&techDesc);
 	for (UINT p = 0; p < techDesc.Passes; ++p)
@@ -231,10 +241,7 @@ void BlendDemo::DrawScene()
 		md3dImmediateContext->OMSetBlendState(RenderStates::TransparentBS, blendFactor, 0xffffffff);
 		pass->Apply(0, md3dImmediateContext);
 
-		// draw triangles in the right order (furthest to closest)
-		md3dImmediateContext->DrawIndexed(3, 0, 0);
-		md3dImmediateContext->DrawIndexed(3, 3, 0);
-		md3dImmediateContext->DrawIndexed(3, 6, 0);
+		md3dImmediateContext->DrawIndexed(mTransparentTris.GetIndexCount(), 0, 0);
 	}
 	HR(mSwapChain->Present(0, 0));
 }
@@ -308,7 +315,7 @@ void BlendDemo::BuildGeometryBuffers()
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * 12;
+	vbd.ByteWidth = sizeof(vertices);
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -317,23 +324,15 @@ void BlendDemo::BuildGeometryBuffers()
 	vinitData.pSysMem = vertices;
 	HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mBoxVB));
 
-	// Create the index buffer
+	// The index buffer is rewritten in back to front order every frame.
 	UINT indices[] = {
 		0, 1, 2,
 		3, 4, 5,
 		6, 7, 8
 	};
 
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * 12;
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
-	D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = indices;
-	HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mBoxIB));
+	mTransparentTris.Init(md3dDevice, &vertices[0].Pos, sizeof(Vertex), sizeof(vertices)/sizeof(Vertex),
+		indices, sizeof(indices)/sizeof(UINT));
 }
 
 void BlendDemo::BuildFX()
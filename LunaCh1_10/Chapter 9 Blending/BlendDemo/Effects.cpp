@@ -30,35 +30,19 @@ Effect::~Effect()
 
 #pragma region BasicEffect
 BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
-	: Effect(device, filename)
+	: Effect(device, filename), mDiffuseMapSRV(0), mBytesUploaded(0)
 {
-	Light1Tech    = mFX->GetTechniqueByName("Light1");
-	Light2Tech    = mFX->GetTechniqueByName("Light2");
-	Light3Tech    = mFX->GetTechniqueByName("Light3");
-
-	Light0TexTech = mFX->GetTechniqueByName("Light0Tex");
-	Light1TexTech = mFX->GetTechniqueByName("Light1Tex");
-	Light2TexTech = mFX->GetTechniqueByName("Light2Tex");
-	Light3TexTech = mFX->GetTechniqueByName("Light3Tex");
-
-	Light0TexAlphaClipTech = mFX->GetTechniqueByName("Light0TexAlphaClip");
-	Light1TexAlphaClipTech = mFX->GetTechniqueByName("Light1TexAlphaClip");
-	Light2TexAlphaClipTech = mFX->GetTechniqueByName("Light2TexAlphaClip");
-	Light3TexAlphaClipTech = mFX->GetTechniqueByName("Light3TexAlphaClip");
-
-	Light1FogTech    = mFX->GetTechniqueByName("Light1Fog");
-	Light2FogTech    = mFX->GetTechniqueByName("Light2Fog");
-	Light3FogTech    = mFX->GetTechniqueByName("Light3Fog");
-
-	Light0TexFogTech = mFX->GetTechniqueByName("Light0TexFog");
-	Light1TexFogTech = mFX->GetTechniqueByName("Light1TexFog");
-	Light2TexFogTech = mFX->GetTechniqueByName("Light2TexFog");
-	Light3TexFogTech = mFX->GetTechniqueByName("Light3TexFog");
-
-	Light0TexAlphaClipFogTech = mFX->GetTechniqueByName("Light0TexAlphaClipFog");
-	Light1TexAlphaClipFogTech = mFX->GetTechniqueByName("Light1TexAlphaClipFog");
-	Light2TexAlphaClipFogTech = mFX->GetTechniqueByName("Light2TexAlphaClipFog");
-	Light3TexAlphaClipFogTech = mFX->GetTechniqueByName("Light3TexAlphaClipFog");
+	// Options in the bit order of BasicEffect::Feature.
+	static const char* lights[] = { "Light0", "Light1", "Light2", "Light3" };
+	static const char* texture[] = { "", "Tex" };
+	static const char* alphaClip[] = { "", "AlphaClip" };
+	static const char* fog[] = { "", "Fog" };
+
+	Techniques.Init(mFX);
+	Techniques.AddOption(lights, 4);
+	Techniques.AddOption(texture, 2);
+	Techniques.AddOption(alphaClip, 2);
+	Techniques.AddOption(fog, 2);
 
 	WorldViewProj     = mFX->GetVariableByName("gWorldViewProj")->AsMatrix();
 	World             = mFX->GetVariableByName("gWorld")->AsMatrix();
@@ -71,11 +55,36 @@ BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
 	DirLights         = mFX->GetVariableByName("gDirLights");
 	Mat               = mFX->GetVariableByName("gMaterial");
 	DiffuseMap        = mFX->GetVariableByName("gDiffuseMap")->AsShaderResource();
+
+	PerFrameCB.Init(mFX, "cbPerFrame");
+	PerFrameCB.Track(DirLights);
+	PerFrameCB.Track(EyePosW);
+	PerFrameCB.Track(FogStart);
+	PerFrameCB.Track(FogRange);
+	PerFrameCB.Track(FogColor);
+
+	PerMaterialCB.Init(mFX, "cbPerMaterial");
+	PerMaterialCB.Track(TexTransform);
+	PerMaterialCB.Track(Mat);
+
+	PerObjectCB.Init(mFX, "cbPerObject");
+	PerObjectCB.Track(World);
+	PerObjectCB.Track(WorldInvTranspose);
+	PerObjectCB.Track(WorldViewProj);
 }
 
 BasicEffect::~BasicEffect()
 {
 }
+
+void BasicEffect::Apply(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc)
+{
+	mBytesUploaded += PerFrameCB.Commit();
+	mBytesUploaded += PerMaterialCB.Commit();
+	mBytesUploaded += PerObjectCB.Commit();
+
+	pass->Apply(0, dc);
+}
 #pragma endregion
 
 #pragma region Effects
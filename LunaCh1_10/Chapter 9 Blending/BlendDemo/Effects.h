@@ -9,6 +9,8 @@
 #define EFFECTS_H
 
 #include "d3dUtil.h"
+#include "ConstantBufferShadow.h"
+#include "TechniqueRegistry.h"
 
 #pragma region Effect
 class Effect
@@ -30,48 +32,46 @@ protected:
 class BasicEffect : public Effect
 {
 public:
+	// Technique features.  The light count takes the low two bits.
+	enum Feature
+	{
+		Lights0   = 0,
+		Lights1   = 1,
+		Lights2   = 2,
+		Lights3   = 3,
+		Texture   = 1 << 2,
+		AlphaClip = 1 << 3,
+		Fog       = 1 << 4
+	};
+
 	BasicEffect(ID3D11Device* device, const std::wstring& filename);
 	~BasicEffect();
 
-	void SetWorldViewProj(CXMMATRIX M)                  { WorldViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorld(CXMMATRIX M)                          { World->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorldInvTranspose(CXMMATRIX M)              { WorldInvTranspose->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetTexTransform(CXMMATRIX M)                   { TexTransform->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetEyePosW(const XMFLOAT3& v)                  { EyePosW->SetRawValue(&v, 0, sizeof(XMFLOAT3)); }
-	void SetFogColor(const FXMVECTOR v)                 { FogColor->SetFloatVector(reinterpret_cast<const float*>(&v)); }
-	void SetFogStart(float f)                           { FogStart->SetFloat(f); }
-	void SetFogRange(float f)                           { FogRange->SetFloat(f); }
-	void SetDirLights(const DirectionalLight* lights)   { DirLights->SetRawValue(lights, 0, 3*sizeof(DirectionalLight)); }
-	void SetMaterial(const Material& mat)               { Mat->SetRawValue(&mat, 0, sizeof(Material)); }
-	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { DiffuseMap->SetResource(tex); }
-
-	ID3DX11EffectTechnique* Light1Tech;
-	ID3DX11EffectTechnique* Light2Tech;
-	ID3DX11EffectTechnique* Light3Tech;
-
-	ID3DX11EffectTechnique* Light0TexTech;
-	ID3DX11EffectTechnique* Light1TexTech;
-	ID3DX11EffectTechnique* Light2TexTech;
-	ID3DX11EffectTechnique* Light3TexTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipTech;
-
-	ID3DX11EffectTechnique* Light1FogTech;
-	ID3DX11EffectTechnique* Light2FogTech;
-	ID3DX11EffectTechnique* Light3FogTech;
-
-	ID3DX11EffectTechnique* Light0TexFogTech;
-	ID3DX11EffectTechnique* Light1TexFogTech;
-	ID3DX11EffectTechnique* Light2TexFogTech;
-	ID3DX11EffectTechnique* Light3TexFogTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipFogTech;
+	void SetWorldViewProj(CXMMATRIX M)                  { if( PerObjectCB.Update(WorldViewProj, &M, sizeof(M)) ) WorldViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetWorld(CXMMATRIX M)                          { if( PerObjectCB.Update(World, &M, sizeof(M)) ) World->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetWorldInvTranspose(CXMMATRIX M)              { if( PerObjectCB.Update(WorldInvTranspose, &M, sizeof(M)) ) WorldInvTranspose->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetTexTransform(CXMMATRIX M)                   { if( PerMaterialCB.Update(TexTransform, &M, sizeof(M)) ) TexTransform->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetEyePosW(const XMFLOAT3& v)                  { if( PerFrameCB.Update(EyePosW, &v, sizeof(XMFLOAT3)) ) EyePosW->SetRawValue(&v, 0, sizeof(XMFLOAT3)); }
+	void SetFogColor(const FXMVECTOR v)                 { if( PerFrameCB.Update(FogColor, &v, sizeof(XMFLOAT4)) ) FogColor->SetFloatVector(reinterpret_cast<const float*>(&v)); }
+	void SetFogStart(float f)                           { if( PerFrameCB.Update(FogStart, &f, sizeof(float)) ) FogStart->SetFloat(f); }
+	void SetFogRange(float f)                           { if( PerFrameCB.Update(FogRange, &f, sizeof(float)) ) FogRange->SetFloat(f); }
+	void SetDirLights(const DirectionalLight* lights)   { if( PerFrameCB.Update(DirLights, lights, 3*sizeof(DirectionalLight)) ) DirLights->SetRawValue(lights, 0, 3*sizeof(DirectionalLight)); }
+	void SetMaterial(const Material& mat)               { if( PerMaterialCB.Update(Mat, &mat, sizeof(Material)) ) Mat->SetRawValue(&mat, 0, sizeof(Material)); }
+	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { if( tex != mDiffuseMapSRV ) { mDiffuseMapSRV = tex; DiffuseMap->SetResource(tex); } }
+
+	///<summary>
+	/// Applies the pass.  Only buffers with a changed variable are uploaded; their
+	/// size is added to the bytes uploaded.
+	///</summary>
+	void Apply(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc);
+
+	UINT GetBytesUploaded()const                        { return mBytesUploaded; }
+	void ResetStats()                                   { mBytesUploaded = 0; }
+
+	// Technique for a combination of features, e.g. Lights3|Texture.
+	ID3DX11EffectTechnique* GetTech(UINT features)      { return Techniques.Get(features); }
+
+	TechniqueRegistry Techniques;
 
 	ID3DX11EffectMatrixVariable* WorldViewProj;
 	ID3DX11EffectMatrixVariable* World;
@@ -85,6 +85,15 @@ public:
 	ID3DX11EffectVariable* Mat;
 
 	ID3DX11EffectShaderResourceVariable* DiffuseMap;
+
+	// Copies of the constant buffers, by update frequency.
+	ConstantBufferShadow PerFrameCB;
+	ConstantBufferShadow PerMaterialCB;
+	ConstantBufferShadow PerObjectCB;
+
+private:
+	ID3D11ShaderResourceView* mDiffuseMapSRV;
+	UINT mBytesUploaded;
 };
 #pragma endregion
 
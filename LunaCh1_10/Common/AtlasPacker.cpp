@@ -0,0 +1,360 @@
+//***************************************************************************************
+// AtlasPacker.cpp
+//***************************************************************************************
+
+#include "AtlasPacker.h"
+#include <algorithm>
+
+namespace
+{
+	uint32_t NextPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while( result < value )
+			result <<= 1;
+		return result;
+	}
+
+	bool Contains(const AtlasPacker::Rect& outer, const AtlasPacker::Rect& inner)
+	{
+		return inner.X >= outer.X && inner.Y >= outer.Y &&
+			inner.X + inner.Width <= outer.X + outer.Width &&
+			inner.Y + inner.Height <= outer.Y + outer.Height;
+	}
+
+	// Sorts indices so that large rectangles are inserted first: by longer side,
+	// then by area.
+	struct LargerFirst
+	{
+		const std::vector<AtlasPacker::Rect>* Sizes;
+
+		bool operator()(size_t a, size_t b)const
+		{
+			const AtlasPacker::Rect& ra = (*Sizes)[a];
+			const AtlasPacker::Rect& rb = (*Sizes)[b];
+
+			uint32_t sideA = std::max(ra.Width, ra.Height);
+			uint32_t sideB = std::max(rb.Width, rb.Height);
+			if( sideA != sideB )
+				return sideA > sideB;
+
+			return (uint64_t)ra.Width*ra.Height > (uint64_t)rb.Width*rb.Height;
+		}
+	};
+}
+
+AtlasPacker::Rect::Rect()
+	: X(0), Y(0), Width(0), Height(0)
+{
+}
+
+AtlasPacker::Rect::Rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+	: X(x), Y(y), Width(width), Height(height)
+{
+}
+
+AtlasPacker::AtlasPacker()
+	: mWidth(0), mHeight(0), mMethod(MethodMaxRects), mUsedArea(0)
+{
+}
+
+void AtlasPacker::Reset(uint32_t width, uint32_t height, Method method)
+{
+	mWidth    = width;
+	mHeight   = height;
+	mMethod   = method;
+	mUsedArea = 0;
+
+	mSkyline.clear();
+	mFreeRects.clear();
+
+	if( method == MethodSkyline )
+	{
+		SkylineNode ground = { 0, 0, width };
+		mSkyline.push_back(ground);
+	}
+	else
+	{
+		mFreeRects.push_back(Rect(0, 0, width, height));
+	}
+}
+
+bool AtlasPacker::Insert(uint32_t width, uint32_t height, Rect& rect)
+{
+	if( width == 0 || height == 0 || width > mWidth || height > mHeight )
+		return false;
+
+	bool inserted = mMethod == MethodSkyline ?
+		InsertSkyline(width, height, rect) :
+		InsertMaxRects(width, height, rect);
+
+	if( inserted )
+		mUsedArea += (uint64_t)width*height;
+
+	return inserted;
+}
+
+float AtlasPacker::GetOccupancy()const
+{
+	uint64_t area = (uint64_t)mWidth*mHeight;
+
+	return area > 0 ? (float)((double)mUsedArea / area) : 0.0f;
+}
+
+bool AtlasPacker::FitSkyline(size_t index, uint32_t width, uint32_t height, uint32_t& y)const
+{
+	if( mSkyline[index].X + width > mWidth )
+		return false;
+
+	// The rectangle rests on the highest node it spans.
+	y = 0;
+	uint32_t widthLeft = width;
+
+	for(size_t i = index; widthLeft > 0; ++i)
+	{
+		y = std::max(y, mSkyline[i].Y);
+		if( y + height > mHeight )
+			return false;
+
+		if( mSkyline[i].Width >= widthLeft )
+			break;
+
+		widthLeft -= mSkyline[i].Width;
+	}
+
+	return true;
+}
+
+bool AtlasPacker::InsertSkyline(uint32_t width, uint32_t height, Rect& rect)
+{
+	size_t bestIndex = mSkyline.size();
+	uint32_t bestTop = UINT32_MAX;
+	uint32_t bestY   = 0;
+
+	for(size_t i = 0; i < mSkyline.size(); ++i)
+	{
+		uint32_t y = 0;
+		if( FitSkyline(i, width, height, y) && y + height < bestTop )
+		{
+			bestIndex = i;
+			bestTop   = y + height;
+			bestY     = y;
+		}
+	}
+
+	if( bestIndex == mSkyline.size() )
+		return false;
+
+	rect = Rect(mSkyline[bestIndex].X, bestY, width, height);
+
+	// Raise the skyline over the new rectangle and trim the nodes it covers.
+	SkylineNode node = { rect.X, bestTop, width };
+	mSkyline.insert(mSkyline.begin() + bestIndex, node);
+
+	uint32_t right = rect.X + width;
+	for(size_t i = bestIndex + 1; i < mSkyline.size(); )
+	{
+		if( mSkyline[i].X >= right )
+			break;
+
+		uint32_t overlap = right - mSkyline[i].X;
+		if( mSkyline[i].Width <= overlap )
+		{
+			mSkyline.erase(mSkyline.begin() + i);
+			continue;
+		}
+
+		mSkyline[i].X     += overlap;
+		mSkyline[i].Width -= overlap;
+		break;
+	}
+
+	// Merge neighbors at the same height.
+	for(size_t i = 0; i + 1 < mSkyline.size(); )
+	{
+		if( mSkyline[i].Y == mSkyline[i+1].Y )
+		{
+			mSkyline[i].Width += mSkyline[i+1].Width;
+			mSkyline.erase(mSkyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	return true;
+}
+
+bool AtlasPacker::InsertMaxRects(uint32_t width, uint32_t height, Rect& rect)
+{
+	size_t bestIndex = mFreeRects.size();
+	uint32_t bestShortSide = UINT32_MAX;
+	uint32_t bestLongSide  = UINT32_MAX;
+
+	for(size_t i = 0; i < mFreeRects.size(); ++i)
+	{
+		const Rect& free = mFreeRects[i];
+		if( width > free.Width || height > free.Height )
+			continue;
+
+		uint32_t leftoverX = free.Width - width;
+		uint32_t leftoverY = free.Height - height;
+		uint32_t shortSide = std::min(leftoverX, leftoverY);
+		uint32_t longSide  = std::max(leftoverX, leftoverY);
+
+		if( shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide) )
+		{
+			bestIndex     = i;
+			bestShortSide = shortSide;
+			bestLongSide  = longSide;
+		}
+	}
+
+	if( bestIndex == mFreeRects.size() )
+		return false;
+
+	rect = Rect(mFreeRects[bestIndex].X, mFreeRects[bestIndex].Y, width, height);
+
+	SplitFreeRects(rect);
+	PruneFreeRects();
+
+	return true;
+}
+
+void AtlasPacker::SplitFreeRects(const Rect& used)
+{
+	std::vector<Rect> freeRects;
+	freeRects.reserve(mFreeRects.size() + 4);
+
+	uint32_t usedRight  = used.X + used.Width;
+	uint32_t usedBottom = used.Y + used.Height;
+
+	for(size_t i = 0; i < mFreeRects.size(); ++i)
+	{
+		const Rect& free = mFreeRects[i];
+		uint32_t freeRight  = free.X + free.Width;
+		uint32_t freeBottom = free.Y + free.Height;
+
+		if( used.X >= freeRight || usedRight <= free.X || used.Y >= freeBottom || usedBottom <= free.Y )
+		{
+			freeRects.push_back(free);
+			continue;
+		}
+
+		// Keep the parts of the free rectangle on each side of the used one.  They
+		// overlap each other, which is what makes them maximal.
+		if( used.X > free.X )
+			freeRects.push_back(Rect(free.X, free.Y, used.X - free.X, free.Height));
+		if( usedRight < freeRight )
+			freeRects.push_back(Rect(usedRight, free.Y, freeRight - usedRight, free.Height));
+		if( used.Y > free.Y )
+			freeRects.push_back(Rect(free.X, free.Y, free.Width, used.Y - free.Y));
+		if( usedBottom < freeBottom )
+			freeRects.push_back(Rect(free.X, usedBottom, free.Width, freeBottom - usedBottom));
+	}
+
+	mFreeRects.swap(freeRects);
+}
+
+void AtlasPacker::PruneFreeRects()
+{
+	for(size_t i = 0; i < mFreeRects.size(); ++i)
+	{
+		for(size_t j = i + 1; j < mFreeRects.size(); )
+		{
+			if( Contains(mFreeRects[j], mFreeRects[i]) )
+			{
+				mFreeRects.erase(mFreeRects.begin() + i);
+				--i;
+				break;
+			}
+
+			if( Contains(mFreeRects[i], mFreeRects[j]) )
+				mFreeRects.erase(mFreeRects.begin() + j);
+			else
+				++j;
+		}
+	}
+}
+
+bool AtlasPacker::Pack(const std::vector<Rect>& sizes, uint32_t maxWidth, uint32_t maxHeight, Method method,
+	std::vector<Rect>& rects, uint32_t& width, uint32_t& height)
+{
+	rects.assign(sizes.size(), Rect());
+	width  = 0;
+	height = 0;
+
+	if( sizes.empty() )
+		return true;
+
+	uint64_t area = 0;
+	uint32_t widest  = 0;
+	uint32_t tallest = 0;
+
+	for(size_t i = 0; i < sizes.size(); ++i)
+	{
+		if( sizes[i].Width == 0 || sizes[i].Height == 0 ||
+			sizes[i].Width > maxWidth || sizes[i].Height > maxHeight )
+			return false;
+
+		area   += (uint64_t)sizes[i].Width*sizes[i].Height;
+		widest  = std::max(widest, sizes[i].Width);
+		tallest = std::max(tallest, sizes[i].Height);
+	}
+
+	if( area > (uint64_t)maxWidth*maxHeight )
+		return false;
+
+	std::vector<size_t> order(sizes.size());
+	for(size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	LargerFirst larger = { &sizes };
+	std::stable_sort(order.begin(), order.end(), larger);
+
+	// Start from the smallest power of two area that could hold everything, and
+	// grow the shorter side until the packing succeeds.
+	uint32_t areaW = std::min(NextPowerOfTwo(widest), maxWidth);
+	uint32_t areaH = std::min(NextPowerOfTwo(tallest), maxHeight);
+
+	for(;;)
+	{
+		bool canGrowW = areaW < maxWidth;
+		bool canGrowH = areaH < maxHeight;
+
+		if( (uint64_t)areaW*areaH >= area )
+		{
+			AtlasPacker packer;
+			packer.Reset(areaW, areaH, method);
+
+			size_t placed = 0;
+			while( placed < order.size() )
+			{
+				const Rect& size = sizes[order[placed]];
+				if( !packer.Insert(size.Width, size.Height, rects[order[placed]]) )
+					break;
+				++placed;
+			}
+
+			if( placed == order.size() )
+				break;
+		}
+
+		if( !canGrowW && !canGrowH )
+			return false;
+
+		if( canGrowW && (areaW <= areaH || !canGrowH) )
+			areaW = std::min(areaW*2, maxWidth);
+		else
+			areaH = std::min(areaH*2, maxHeight);
+	}
+
+	for(size_t i = 0; i < rects.size(); ++i)
+	{
+		width  = std::max(width, rects[i].X + rects[i].Width);
+		height = std::max(height, rects[i].Y + rects[i].Height);
+	}
+
+	return true;
+}
@@ -0,0 +1,98 @@
+//***************************************************************************************
+// AtlasPacker.h
+//
+// Places rectangles in a texture atlas without overlap.
+//   -Skyline: tracks the top edge of the placed rectangles and puts each new one as
+//    low as possible (bottom-left rule).  Fast, and good when sizes are similar.
+//   -MaxRects: tracks every maximal free rectangle and picks the one that leaves the
+//    shortest leftover side (best short side fit).  Slower but packs mixed sizes
+//    noticeably tighter.
+//
+// Rectangles are not rotated, so texture coordinates only need a scale and offset.
+// Has no Windows or D3D dependencies; TextureAtlas uses it for textures.
+//***************************************************************************************
+
+#ifndef ATLASPACKER_H
+#define ATLASPACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class AtlasPacker
+{
+public:
+	enum Method
+	{
+		MethodSkyline,
+		MethodMaxRects
+	};
+
+	struct Rect
+	{
+		Rect();
+		Rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+		uint32_t X;
+		uint32_t Y;
+		uint32_t Width;
+		uint32_t Height;
+	};
+
+public:
+	AtlasPacker();
+
+	///<summary>
+	/// Empties the packer and sets the size of the area to fill.
+	///</summary>
+	void Reset(uint32_t width, uint32_t height, Method method);
+
+	///<summary>
+	/// Finds room for a width x height rectangle and marks it used.  Returns false,
+	/// changing nothing, if it does not fit.
+	///</summary>
+	bool Insert(uint32_t width, uint32_t height, Rect& rect);
+
+	// Fraction of the area covered by inserted rectangles.
+	float GetOccupancy()const;
+
+	///<summary>
+	/// Places all sizes (X and Y are ignored) in the smallest power of two area up to
+	/// maxWidth x maxHeight that holds them.  Larger rectangles are inserted first,
+	/// but rects is returned in the order of sizes.  width and height receive the
+	/// extent actually used.  Returns false if they don't fit in the maximum size.
+	///</summary>
+	static bool Pack(const std::vector<Rect>& sizes, uint32_t maxWidth, uint32_t maxHeight, Method method,
+		std::vector<Rect>& rects, uint32_t& width, uint32_t& height);
+
+private:
+	struct SkylineNode
+	{
+		uint32_t X;
+		uint32_t Y;
+		uint32_t Width;
+	};
+
+	bool InsertSkyline(uint32_t width, uint32_t height, Rect& rect);
+	bool InsertMaxRects(uint32_t width, uint32_t height, Rect& rect);
+
+	// Top of the skyline under a width wide rectangle starting at node index, or
+	// false if the rectangle would stick out of the area.
+	bool FitSkyline(size_t index, uint32_t width, uint32_t height, uint32_t& y)const;
+
+	// Cuts the used rectangle out of the free rectangles and drops the free
+	// rectangles that end up inside others.
+	void SplitFreeRects(const Rect& used);
+	void PruneFreeRects();
+
+private:
+	uint32_t mWidth;
+	uint32_t mHeight;
+	Method mMethod;
+	uint64_t mUsedArea;
+
+	std::vector<SkylineNode> mSkyline;
+	std::vector<Rect> mFreeRects;
+};
+
+#endif // ATLASPACKER_H
@@ -0,0 +1,705 @@
+//***************************************************************************************
+// BCEncoder.cpp
+//***************************************************************************************
+
+#include "BCEncoder.h"
+#include "JobSystem.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Texels of one block as separate channel arrays so four texels fit a vector.
+	struct BlockChannels
+	{
+		float R[16];
+		float G[16];
+		float B[16];
+	};
+
+	float Clamp255(float x)
+	{
+		return x < 0.0f ? 0.0f : (x > 255.0f ? 255.0f : x);
+	}
+
+	uint16_t PackRGB565(const float c[3])
+	{
+		uint32_t r = (uint32_t)(Clamp255(c[0])*31.0f/255.0f + 0.5f);
+		uint32_t g = (uint32_t)(Clamp255(c[1])*63.0f/255.0f + 0.5f);
+		uint32_t b = (uint32_t)(Clamp255(c[2])*31.0f/255.0f + 0.5f);
+
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRGB565(uint16_t c, int rgb[3])
+	{
+		int r = (c >> 11) & 31;
+		int g = (c >> 5) & 63;
+		int b = c & 31;
+
+		// Replicate the high bits into the low bits, as the hardware does.
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	float HorizontalSum(__m128 v)
+	{
+		__m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(v, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		sums = _mm_add_ss(sums, shuf);
+
+		return _mm_cvtss_f32(sums);
+	}
+
+	///<summary>
+	/// Picks the closest of four palette colors for every texel, four texels per
+	/// iteration.  Returns the total squared error.
+	///</summary>
+	float SelectColorIndices(const BlockChannels& px, const float palette[4][3], uint32_t indices[16])
+	{
+		__m128 total = _mm_setzero_ps();
+
+		for(int i = 0; i < 16; i += 4)
+		{
+			__m128 r = _mm_loadu_ps(&px.R[i]);
+			__m128 g = _mm_loadu_ps(&px.G[i]);
+			__m128 b = _mm_loadu_ps(&px.B[i]);
+
+			__m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+			__m128i bestIndex = _mm_setzero_si128();
+
+			for(int k = 0; k < 4; ++k)
+			{
+				__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+				__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+				__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+				best = _mm_min_ps(d, best);
+				bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+			}
+
+			total = _mm_add_ps(total, best);
+			_mm_storeu_si128((__m128i*)&indices[i], bestIndex);
+		}
+
+		return HorizontalSum(total);
+	}
+
+	///<summary>
+	/// Quantizes the endpoints, orders them for four color mode and selects the
+	/// indices.  Returns the squared error of the encoded block.
+	///</summary>
+	float EvaluateColorEndpoints(const BlockChannels& px, const float e0[3], const float e1[3],
+		uint16_t& c0, uint16_t& c1, uint32_t indices[16])
+	{
+		c0 = PackRGB565(e0);
+		c1 = PackRGB565(e1);
+
+		// Four color mode needs c0 > c1.  With c0 == c1 every index picks c0.
+		if( c0 < c1 )
+			std::swap(c0, c1);
+
+		int p0[3], p1[3];
+		UnpackRGB565(c0, p0);
+		UnpackRGB565(c1, p1);
+
+		float palette[4][3];
+		for(int i = 0; i < 3; ++i)
+		{
+			palette[0][i] = (float)p0[i];
+			palette[1][i] = (float)p1[i];
+			palette[2][i] = (float)((2*p0[i] + p1[i]) / 3);
+			palette[3][i] = (float)((p0[i] + 2*p1[i]) / 3);
+		}
+
+		return SelectColorIndices(px, palette, indices);
+	}
+
+	///<summary>
+	/// Solves for the endpoints that minimize the squared error for fixed indices.
+	/// weights[i] is how much of e0 palette entry i contains.  Returns false if the
+	/// indices don't constrain both endpoints.
+	///</summary>
+	bool LeastSquaresEndpoints(const float* values[], int numChannels, const uint32_t indices[16],
+		const float weights[], float e0[], float e1[])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[3] = { 0.0f, 0.0f, 0.0f };
+		float bx[3] = { 0.0f, 0.0f, 0.0f };
+
+		for(int i = 0; i < 16; ++i)
+		{
+			float a = weights[indices[i]];
+			float b = 1.0f - a;
+
+			aa += a*a;
+			ab += a*b;
+			bb += b*b;
+
+			for(int c = 0; c < numChannels; ++c)
+			{
+				ax[c] += a*values[c][i];
+				bx[c] += b*values[c][i];
+			}
+		}
+
+		float det = aa*bb - ab*ab;
+		if( fabsf(det) < 1e-6f )
+			return false;
+
+		float invDet = 1.0f / det;
+		for(int c = 0; c < numChannels; ++c)
+		{
+			e0[c] = Clamp255((bb*ax[c] - ab*bx[c])*invDet);
+			e1[c] = Clamp255((aa*bx[c] - ab*ax[c])*invDet);
+		}
+
+		return true;
+	}
+
+	void WriteColorBlock(uint16_t c0, uint16_t c1, const uint32_t indices[16], uint8_t block[8])
+	{
+		uint32_t bits = 0;
+		for(int i = 0; i < 16; ++i)
+			bits |= indices[i] << (2*i);
+
+		block[0] = (uint8_t)(c0 & 0xff);
+		block[1] = (uint8_t)(c0 >> 8);
+		block[2] = (uint8_t)(c1 & 0xff);
+		block[3] = (uint8_t)(c1 >> 8);
+		block[4] = (uint8_t)(bits & 0xff);
+		block[5] = (uint8_t)((bits >> 8) & 0xff);
+		block[6] = (uint8_t)((bits >> 16) & 0xff);
+		block[7] = (uint8_t)(bits >> 24);
+	}
+
+	// Eight value BC4 palette for ep0 > ep1; six values plus 0 and 255 otherwise.
+	void ChannelPalette(int ep0, int ep1, int palette[8])
+	{
+		palette[0] = ep0;
+		palette[1] = ep1;
+
+		if( ep0 > ep1 )
+		{
+			for(int k = 2; k < 8; ++k)
+				palette[k] = ((8-k)*ep0 + (k-1)*ep1) / 7;
+		}
+		else
+		{
+			for(int k = 2; k < 6; ++k)
+				palette[k] = ((6-k)*ep0 + (k-1)*ep1) / 5;
+
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	///<summary>
+	/// Picks the closest of the eight palette values for every texel.  Returns the
+	/// total squared error.
+	///</summary>
+	float SelectChannelIndices(const float values[16], int ep0, int ep1, uint32_t indices[16])
+	{
+		int palette[8];
+		ChannelPalette(ep0, ep1, palette);
+
+		__m128 total = _mm_setzero_ps();
+
+		for(int i = 0; i < 16; i += 4)
+		{
+			__m128 v = _mm_loadu_ps(&values[i]);
+
+			__m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+			__m128i bestIndex = _mm_setzero_si128();
+
+			for(int k = 0; k < 8; ++k)
+			{
+				__m128 d = _mm_sub_ps(v, _mm_set1_ps((float)palette[k]));
+				d = _mm_mul_ps(d, d);
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+				best = _mm_min_ps(d, best);
+				bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+			}
+
+			total = _mm_add_ps(total, best);
+			_mm_storeu_si128((__m128i*)&indices[i], bestIndex);
+		}
+
+		return HorizontalSum(total);
+	}
+
+	void WriteChannelBlock(int ep0, int ep1, const uint32_t indices[16], uint8_t block[8])
+	{
+		uint64_t bits = 0;
+		for(int i = 0; i < 16; ++i)
+			bits |= (uint64_t)indices[i] << (3*i);
+
+		block[0] = (uint8_t)ep0;
+		block[1] = (uint8_t)ep1;
+		for(int i = 0; i < 6; ++i)
+			block[2+i] = (uint8_t)((bits >> (8*i)) & 0xff);
+	}
+}
+
+BCEncoder::Options::Options()
+	: BlockFormat(FormatBC1),
+	  Preset(QualityNormal),
+	  NumThreads(0),
+	  ComputePSNR(false)
+{
+}
+
+uint32_t BCEncoder::GetBlockBytes(Format format)
+{
+	return format == FormatBC1 ? 8 : 16;
+}
+
+size_t BCEncoder::GetCompressedSize(Format format, uint32_t width, uint32_t height)
+{
+	size_t blocksX = std::max(1u, (width + 3)/4);
+	size_t blocksY = std::max(1u, (height + 3)/4);
+
+	return blocksX*blocksY*GetBlockBytes(format);
+}
+
+uint32_t BCEncoder::GetChannelMask(Format format)
+{
+	switch( format )
+	{
+	case FormatBC1: return 0x7;
+	case FormatBC3: return 0xf;
+	case FormatBC5: return 0x3;
+	}
+
+	return 0;
+}
+
+void BCEncoder::Encode(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+	const Options& options, std::vector<uint8_t>& blocks, Report* report)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	blocks.resize(GetCompressedSize(options.BlockFormat, width, height));
+
+	uint32_t blocksY = (height + 3)/4;
+
+	//
+	// Encode the block rows as jobs; the calling thread helps while it waits.
+	//
+
+	EncodeJob job;
+	job.RGBA          = rgba;
+	job.Width         = width;
+	job.Height        = height;
+	job.RowPitch      = rowPitch;
+	job.EncodeOptions = &options;
+	job.Blocks        = &blocks[0];
+
+	if( options.NumThreads == 1 )
+		EncodeRowsJob(&job, 0, blocksY);
+	else
+	{
+		uint32_t grainSize = options.NumThreads > 0 ? (blocksY + options.NumThreads - 1)/options.NumThreads : 0;
+
+		JobCounter counter;
+		JobSystem::ParallelFor(&BCEncoder::EncodeRowsJob, &job, blocksY, grainSize, &counter);
+		JobSystem::Wait(counter);
+	}
+
+	if( report )
+	{
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report->Seconds = elapsed.count();
+		report->PSNR = 0.0;
+
+		if( options.ComputePSNR )
+		{
+			std::vector<uint8_t> decoded;
+			Decode(&blocks[0], options.BlockFormat, width, height, decoded);
+
+			// Compare against a tightly packed copy of the source.
+			std::vector<uint8_t> source(width*height*4);
+			for(uint32_t y = 0; y < height; ++y)
+				std::copy(rgba + y*rowPitch, rgba + y*rowPitch + width*4, &source[y*width*4]);
+
+			report->PSNR = ComputePSNR(&source[0], &decoded[0], width, height, GetChannelMask(options.BlockFormat));
+		}
+	}
+}
+
+void BCEncoder::EncodeRowsJob(void* job, uint32_t firstBlockRow, uint32_t endBlockRow)
+{
+	const EncodeJob& encode = *static_cast<const EncodeJob*>(job);
+
+	EncodeRows(encode.RGBA, encode.Width, encode.Height, encode.RowPitch, *encode.EncodeOptions,
+		firstBlockRow, endBlockRow, encode.Blocks);
+}
+
+void BCEncoder::EncodeRows(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+	const Options& options, uint32_t firstBlockRow, uint32_t endBlockRow, uint8_t* blocks)
+{
+	uint32_t blocksX = (width + 3)/4;
+	uint32_t blockBytes = GetBlockBytes(options.BlockFormat);
+
+	uint8_t texels[64];
+
+	for(uint32_t by = firstBlockRow; by < endBlockRow; ++by)
+	{
+		for(uint32_t bx = 0; bx < blocksX; ++bx)
+		{
+			// Gather the block, repeating the last row/column past the edge.
+			for(uint32_t y = 0; y < 4; ++y)
+			{
+				uint32_t sy = std::min(by*4 + y, height-1);
+				for(uint32_t x = 0; x < 4; ++x)
+				{
+					uint32_t sx = std::min(bx*4 + x, width-1);
+					const uint8_t* src = rgba + sy*rowPitch + sx*4;
+
+					uint8_t* dst = &texels[(y*4 + x)*4];
+					dst[0] = src[0];
+					dst[1] = src[1];
+					dst[2] = src[2];
+					dst[3] = src[3];
+				}
+			}
+
+			uint8_t* block = blocks + (by*blocksX + bx)*blockBytes;
+
+			switch( options.BlockFormat )
+			{
+			case FormatBC1:
+				EncodeColorBlock(texels, options.Preset, block);
+				break;
+
+			case FormatBC3:
+				EncodeChannelBlock(texels, 3, options.Preset, block);
+				EncodeColorBlock(texels, options.Preset, block + 8);
+				break;
+
+			case FormatBC5:
+				EncodeChannelBlock(texels, 0, options.Preset, block);
+				EncodeChannelBlock(texels, 1, options.Preset, block + 8);
+				break;
+			}
+		}
+	}
+}
+
+void BCEncoder::EncodeColorBlock(const uint8_t texels[64], Quality quality, uint8_t block[8])
+{
+	BlockChannels px;
+	for(int i = 0; i < 16; ++i)
+	{
+		px.R[i] = texels[i*4+0];
+		px.G[i] = texels[i*4+1];
+		px.B[i] = texels[i*4+2];
+	}
+
+	const float* channels[3] = { px.R, px.G, px.B };
+
+	float e0[3], e1[3];
+
+	if( quality == QualityFast )
+	{
+		//
+		// Bounding box, inset by 1/16 of its size so the interpolated colors
+		// land closer to the texels.
+		//
+
+		for(int c = 0; c < 3; ++c)
+		{
+			float minC = *std::min_element(channels[c], channels[c] + 16);
+			float maxC = *std::max_element(channels[c], channels[c] + 16);
+			float inset = (maxC - minC)/16.0f;
+
+			e0[c] = maxC - inset;
+			e1[c] = minC + inset;
+		}
+	}
+	else
+	{
+		//
+		// Principal axis of the colors by power iteration on the covariance
+		// matrix; the endpoints are the extreme projections on it.
+		//
+
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for(int c = 0; c < 3; ++c)
+		{
+			for(int i = 0; i < 16; ++i)
+				mean[c] += channels[c][i];
+			mean[c] /= 16.0f;
+		}
+
+		float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		for(int i = 0; i < 16; ++i)
+		{
+			float r = px.R[i] - mean[0];
+			float g = px.G[i] - mean[1];
+			float b = px.B[i] - mean[2];
+
+			cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+			cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+		}
+
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for(int iter = 0; iter < 8; ++iter)
+		{
+			float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+			float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+			float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+
+			float len = std::max(fabsf(x), std::max(fabsf(y), fabsf(z)));
+			if( len < 1e-6f )
+				break;
+
+			axis[0] = x/len;
+			axis[1] = y/len;
+			axis[2] = z/len;
+		}
+
+		float lenSq = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+
+		float tMin = 0.0f, tMax = 0.0f;
+		for(int i = 0; i < 16; ++i)
+		{
+			float t = ((px.R[i] - mean[0])*axis[0] + (px.G[i] - mean[1])*axis[1] + (px.B[i] - mean[2])*axis[2]) / lenSq;
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+
+		// Same inset as the bounding box.
+		float inset = (tMax - tMin)/16.0f;
+		tMin += inset;
+		tMax -= inset;
+
+		for(int c = 0; c < 3; ++c)
+		{
+			e0[c] = Clamp255(mean[c] + axis[c]*tMax);
+			e1[c] = Clamp255(mean[c] + axis[c]*tMin);
+		}
+	}
+
+	uint16_t c0, c1;
+	uint32_t indices[16];
+	float error = EvaluateColorEndpoints(px, e0, e1, c0, c1, indices);
+
+	if( quality == QualityHigh )
+	{
+		// Share of c0 in each palette entry.
+		const float weights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+
+		for(int iter = 0; iter < 4 && error > 0.0f; ++iter)
+		{
+			if( !LeastSquaresEndpoints(channels, 3, indices, weights, e0, e1) )
+				break;
+
+			uint16_t n0, n1;
+			uint32_t newIndices[16];
+			float newError = EvaluateColorEndpoints(px, e0, e1, n0, n1, newIndices);
+
+			if( newError >= error )
+				break;
+
+			error = newError;
+			c0 = n0;
+			c1 = n1;
+			std::copy(newIndices, newIndices + 16, indices);
+		}
+	}
+
+	WriteColorBlock(c0, c1, indices, block);
+}
+
+void BCEncoder::EncodeChannelBlock(const uint8_t texels[64], uint32_t channel, Quality quality, uint8_t block[8])
+{
+	float values[16];
+	for(int i = 0; i < 16; ++i)
+		values[i] = texels[i*4 + channel];
+
+	int ep0 = (int)*std::max_element(values, values + 16);
+	int ep1 = (int)*std::min_element(values, values + 16);
+
+	uint32_t indices[16];
+	float error = SelectChannelIndices(values, ep0, ep1, indices);
+
+	if( quality != QualityFast && ep0 > ep1 )
+	{
+		// Share of ep0 in each palette entry of the eight value mode.
+		const float weights[8] = { 1.0f, 0.0f, 6.0f/7.0f, 5.0f/7.0f, 4.0f/7.0f, 3.0f/7.0f, 2.0f/7.0f, 1.0f/7.0f };
+		const float* channels[1] = { values };
+
+		int iterations = quality == QualityHigh ? 4 : 1;
+		for(int iter = 0; iter < iterations && error > 0.0f; ++iter)
+		{
+			float e0, e1;
+			if( !LeastSquaresEndpoints(channels, 1, indices, weights, &e0, &e1) )
+				break;
+
+			int n0 = (int)(e0 + 0.5f);
+			int n1 = (int)(e1 + 0.5f);
+			if( n0 <= n1 )
+				break;
+
+			uint32_t newIndices[16];
+			float newError = SelectChannelIndices(values, n0, n1, newIndices);
+
+			if( newError >= error )
+				break;
+
+			error = newError;
+			ep0 = n0;
+			ep1 = n1;
+			std::copy(newIndices, newIndices + 16, indices);
+		}
+	}
+
+	WriteChannelBlock(ep0, ep1, indices, block);
+}
+
+void BCEncoder::Decode(const uint8_t* blocks, Format format, uint32_t width, uint32_t height,
+	std::vector<uint8_t>& rgba)
+{
+	rgba.resize(width*height*4);
+
+	uint32_t blocksX = (width + 3)/4;
+	uint32_t blocksY = (height + 3)/4;
+	uint32_t blockBytes = GetBlockBytes(format);
+
+	uint8_t texels[64];
+
+	for(uint32_t by = 0; by < blocksY; ++by)
+	{
+		for(uint32_t bx = 0; bx < blocksX; ++bx)
+		{
+			const uint8_t* block = blocks + (by*blocksX + bx)*blockBytes;
+
+			switch( format )
+			{
+			case FormatBC1:
+				DecodeColorBlock(block, true, texels);
+				break;
+
+			case FormatBC3:
+				DecodeColorBlock(block + 8, false, texels);
+				DecodeChannelBlock(block, 3, texels);
+				break;
+
+			case FormatBC5:
+				for(int i = 0; i < 16; ++i)
+				{
+					texels[i*4+2] = 0;
+					texels[i*4+3] = 255;
+				}
+				DecodeChannelBlock(block, 0, texels);
+				DecodeChannelBlock(block + 8, 1, texels);
+				break;
+			}
+
+			for(uint32_t y = 0; y < 4 && by*4 + y < height; ++y)
+			{
+				for(uint32_t x = 0; x < 4 && bx*4 + x < width; ++x)
+				{
+					const uint8_t* src = &texels[(y*4 + x)*4];
+					uint8_t* dst = &rgba[((by*4 + y)*width + bx*4 + x)*4];
+
+					std::copy(src, src + 4, dst);
+				}
+			}
+		}
+	}
+}
+
+void BCEncoder::DecodeColorBlock(const uint8_t block[8], bool allowTransparent, uint8_t texels[64])
+{
+	uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+	uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+
+	int p0[3], p1[3];
+	UnpackRGB565(c0, p0);
+	UnpackRGB565(c1, p1);
+
+	int palette[4][4];
+	for(int i = 0; i < 3; ++i)
+	{
+		palette[0][i] = p0[i];
+		palette[1][i] = p1[i];
+	}
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+	// BC2/BC3 color blocks are always four color blocks.
+	if( c0 > c1 || !allowTransparent )
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			palette[2][i] = (2*p0[i] + p1[i]) / 3;
+			palette[3][i] = (p0[i] + 2*p1[i]) / 3;
+		}
+	}
+	else
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			palette[2][i] = (p0[i] + p1[i]) / 2;
+			palette[3][i] = 0;
+		}
+		palette[3][3] = 0;
+	}
+
+	for(int i = 0; i < 16; ++i)
+	{
+		const int* p = palette[(bits >> (2*i)) & 3];
+		for(int c = 0; c < 4; ++c)
+			texels[i*4 + c] = (uint8_t)p[c];
+	}
+}
+
+void BCEncoder::DecodeChannelBlock(const uint8_t block[8], uint32_t channel, uint8_t texels[64])
+{
+	int palette[8];
+	ChannelPalette(block[0], block[1], palette);
+
+	uint64_t bits = 0;
+	for(int i = 0; i < 6; ++i)
+		bits |= (uint64_t)block[2+i] << (8*i);
+
+	for(int i = 0; i < 16; ++i)
+		texels[i*4 + channel] = (uint8_t)palette[(bits >> (3*i)) & 7];
+}
+
+double BCEncoder::ComputePSNR(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height,
+	uint32_t channelMask)
+{
+	double sum = 0.0;
+	uint64_t count = 0;
+
+	for(uint32_t i = 0; i < width*height; ++i)
+	{
+		for(uint32_t c = 0; c < 4; ++c)
+		{
+			if( (channelMask & (1u << c)) == 0 )
+				continue;
+
+			double d = (double)a[i*4 + c] - (double)b[i*4 + c];
+			sum += d*d;
+			++count;
+		}
+	}
+
+	if( count == 0 || sum == 0.0 )
+		return std::numeric_limits<double>::infinity();
+
+	double mse = sum / (double)count;
+	return 10.0*log10(255.0*255.0 / mse);
+}
@@ -0,0 +1,118 @@
+//***************************************************************************************
+// BCEncoder.h
+//
+// CPU block compression of RGBA8 images to BC1, BC3 and BC5.
+//   -BC1 stores RGB, BC3 adds a separate alpha block, BC5 stores the red and green
+//    channels in two independent blocks (normal maps, two channel masks).
+//   -Block color selection works on four pixels at a time with SSE2, and block rows
+//    are split into jobs for the JobSystem.
+//   -Presets trade quality for speed:
+//      Fast:   endpoints from the bounding box of the block's colors.
+//      Normal: endpoints along the principal axis of the block's colors.
+//      High:   Normal, then least squares refinement of the endpoints.
+//
+// Has no Windows or D3D dependencies, so asset cooking tools can use it on any
+// platform.  TextureDecoder::Compress() applies it to decoded textures at run time.
+//***************************************************************************************
+
+#ifndef BCENCODER_H
+#define BCENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BCEncoder
+{
+public:
+	enum Format
+	{
+		FormatBC1,
+		FormatBC3,
+		FormatBC5
+	};
+
+	enum Quality
+	{
+		QualityFast,
+		QualityNormal,
+		QualityHigh
+	};
+
+	struct Options
+	{
+		Options();
+
+		Format BlockFormat;
+		Quality Preset;
+
+		// Jobs the block rows are split into on the JobSystem.  0 picks a few per
+		// thread and 1 encodes on the calling thread.
+		uint32_t NumThreads;
+
+		// Decodes the result again to fill Report::PSNR.
+		bool ComputePSNR;
+	};
+
+	struct Report
+	{
+		double Seconds;
+
+		// Peak signal to noise ratio in dB over the channels the format stores.
+		// Infinite for a lossless result.
+		double PSNR;
+	};
+
+public:
+	///<summary>
+	/// Compresses a width x height RGBA8 image.  rowPitch is the number of bytes
+	/// between rows of the source.  Any size is accepted; partial edge blocks repeat
+	/// their last row and column.  Blocks are written row major to blocks.
+	///</summary>
+	static void Encode(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+		const Options& options, std::vector<uint8_t>& blocks, Report* report = 0);
+
+	///<summary>
+	/// Expands blocks back to a tightly packed RGBA8 image.  Channels a format does
+	/// not store come back as 0 (BC5 blue) or 255 (BC1 and BC5 alpha).
+	///</summary>
+	static void Decode(const uint8_t* blocks, Format format, uint32_t width, uint32_t height,
+		std::vector<uint8_t>& rgba);
+
+	///<summary>
+	/// PSNR between two tightly packed RGBA8 images over the channels set in
+	/// channelMask (bit 0 = red ... bit 3 = alpha).
+	///</summary>
+	static double ComputePSNR(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height,
+		uint32_t channelMask);
+
+	static uint32_t GetBlockBytes(Format format);
+	static size_t GetCompressedSize(Format format, uint32_t width, uint32_t height);
+
+	// Channels stored by the format, as a channelMask for ComputePSNR().
+	static uint32_t GetChannelMask(Format format);
+
+private:
+	struct EncodeJob
+	{
+		const uint8_t* RGBA;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t RowPitch;
+		const Options* EncodeOptions;
+		uint8_t* Blocks;
+	};
+
+	static void EncodeRowsJob(void* job, uint32_t firstBlockRow, uint32_t endBlockRow);
+
+	static void EncodeRows(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+		const Options& options, uint32_t firstBlockRow, uint32_t endBlockRow, uint8_t* blocks);
+
+	static void EncodeColorBlock(const uint8_t texels[64], Quality quality, uint8_t block[8]);
+	static void EncodeChannelBlock(const uint8_t texels[64], uint32_t channel, Quality quality, uint8_t block[8]);
+
+	static void DecodeColorBlock(const uint8_t block[8], bool allowTransparent, uint8_t texels[64]);
+	static void DecodeChannelBlock(const uint8_t block[8], uint32_t channel, uint8_t texels[64]);
+};
+
+#endif // BCENCODER_H
@@ -0,0 +1,805 @@
+//***************************************************************************************
+// BlendFile.cpp
+//***************************************************************************************
+
+#include "BlendFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// .blend file layout, see "The mystery of the blend" in Blender's documentation.
+//
+
+namespace
+{
+	const uint32_t HeaderSize = 12;
+	const uint32_t MissingField = 0xffffffff;
+	const uint32_t NoVertex = 0xffffffff;
+
+	// The file's data is little-endian and may be unaligned.
+	uint32_t ReadU32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint16_t ReadU16(const uint8_t* p)
+	{
+		uint16_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	int32_t ReadI32(const uint8_t* p)
+	{
+		int32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	int16_t ReadI16(const uint8_t* p)
+	{
+		int16_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	float ReadFloat(const uint8_t* p)
+	{
+		float value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	// Walks the SDNA block, failing instead of reading past its end.
+	struct SDNAReader
+	{
+		const uint8_t* Begin;
+		const uint8_t* P;
+		const uint8_t* End;
+		bool Ok;
+
+		bool Has(size_t bytes)
+		{
+			Ok = Ok && (size_t)(End - P) >= bytes;
+			return Ok;
+		}
+
+		bool Expect(const char* tag)
+		{
+			if( !Has(4) || memcmp(P, tag, 4) != 0 )
+				return Ok = false;
+
+			P += 4;
+			return true;
+		}
+
+		// A count of items of at least one byte each that the block can hold.
+		uint32_t Count()
+		{
+			uint32_t count = U32();
+			if( count > (size_t)(End - P) )
+				Ok = false;
+
+			return Ok ? count : 0;
+		}
+
+		uint32_t U32()
+		{
+			if( !Has(4) )
+				return 0;
+
+			uint32_t value = ReadU32(P);
+			P += 4;
+			return value;
+		}
+
+		uint16_t U16()
+		{
+			if( !Has(2) )
+				return 0;
+
+			uint16_t value = ReadU16(P);
+			P += 2;
+			return value;
+		}
+
+		const char* String()
+		{
+			const uint8_t* end = (const uint8_t*)memchr(P, 0, End - P);
+			if( end == 0 )
+			{
+				Ok = false;
+				return "";
+			}
+
+			const char* s = (const char*)P;
+			P = end + 1;
+			return s;
+		}
+
+		// Sections start 4-byte aligned from the start of the block.
+		void Align()
+		{
+			size_t offset = (size_t)(P - Begin);
+			size_t padding = ((offset + 3) & ~(size_t)3) - offset;
+
+			if( Has(padding) )
+				P += padding;
+		}
+	};
+
+	// "*next" -> "next", "co[3]" -> "co", "(*func)()" -> "func".
+	std::string BareName(const char* name)
+	{
+		while( *name && !(isalnum((unsigned char)*name) || *name == '_') )
+			++name;
+
+		const char* end = name;
+		while( *end && (isalnum((unsigned char)*end) || *end == '_') )
+			++end;
+
+		return std::string(name, end);
+	}
+
+	// Product of the array sizes in a field name, 1 if it is not an array.
+	uint32_t ArrayLength(const char* name)
+	{
+		uint32_t length = 1;
+
+		for(const char* p = strchr(name, '['); p != 0; p = strchr(p + 1, '['))
+			length *= (uint32_t)atoi(p + 1);
+
+		return length;
+	}
+
+	uint32_t FieldOffset(const BlendFile::Struct* s, const char* name)
+	{
+		const BlendFile::Field* field = s ? BlendFile::FindField(*s, name) : 0;
+		return field ? field->Offset : MissingField;
+	}
+}
+
+BlendFile::BlendFile()
+	:
+#ifdef _WIN32
+	  mFile(INVALID_HANDLE_VALUE),
+	  mMapping(0),
+#else
+	  mFile(-1),
+#endif
+	  mMapped(false),
+	  mData(0),
+	  mSize(0),
+	  mPointerSize(0),
+	  mVersion(0),
+	  mHasMeshLayout(false)
+{
+}
+
+BlendFile::~BlendFile()
+{
+	Close();
+}
+
+bool BlendFile::Open(const std::string& filename)
+{
+	Close();
+
+#ifdef _WIN32
+	mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if( mFile == INVALID_HANDLE_VALUE )
+		return Fail("can't open the file");
+#else
+	mFile = open(filename.c_str(), O_RDONLY);
+	if( mFile < 0 )
+		return Fail("can't open the file");
+#endif
+
+	return MapFile();
+}
+
+#ifdef _WIN32
+bool BlendFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if( mFile == INVALID_HANDLE_VALUE )
+		return Fail("can't open the file");
+
+	return MapFile();
+}
+#endif
+
+bool BlendFile::MapFile()
+{
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx(mFile, &fileSize) || fileSize.QuadPart == 0 || (uint64_t)fileSize.QuadPart > (size_t)-1 )
+		return Fail("can't map an empty or oversized file");
+
+	mMapping = CreateFileMappingW(mFile, 0, PAGE_READONLY, 0, 0, 0);
+	if( mMapping == 0 )
+		return Fail("can't map the file");
+
+	mData = (const uint8_t*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	mSize = (size_t)fileSize.QuadPart;
+#else
+	struct stat info;
+	if( fstat(mFile, &info) != 0 || info.st_size <= 0 )
+		return Fail("can't map an empty file");
+
+	void* view = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, mFile, 0);
+	mData = view != MAP_FAILED ? (const uint8_t*)view : 0;
+	mSize = (size_t)info.st_size;
+#endif
+
+	if( mData == 0 )
+		return Fail("can't map the file");
+
+	mMapped = true;
+
+	return ParseBlocks();
+}
+
+bool BlendFile::Parse(const uint8_t* data, size_t size)
+{
+	Close();
+
+	mData = data;
+	mSize = size;
+
+	return ParseBlocks();
+}
+
+void BlendFile::Close()
+{
+#ifdef _WIN32
+	if( mMapped )
+		UnmapViewOfFile(mData);
+	if( mMapping != 0 )
+		CloseHandle(mMapping);
+	if( mFile != INVALID_HANDLE_VALUE )
+		CloseHandle(mFile);
+
+	mFile = INVALID_HANDLE_VALUE;
+	mMapping = 0;
+#else
+	if( mMapped )
+		munmap((void*)mData, mSize);
+	if( mFile >= 0 )
+		close(mFile);
+
+	mFile = -1;
+#endif
+
+	mMapped = false;
+	mData = 0;
+	mSize = 0;
+	mPointerSize = 0;
+	mVersion = 0;
+	mBlocks.clear();
+	mBlocksByAddress.clear();
+	mStructs.clear();
+	mMeshBlocks.clear();
+	mHasMeshLayout = false;
+	mError.clear();
+}
+
+bool BlendFile::Fail(const std::string& error)
+{
+	Close();
+	mError = error;
+
+	return false;
+}
+
+bool BlendFile::ParseBlocks()
+{
+	//
+	// Header: "BLENDER", '_' or '-' for 32- or 64-bit pointers, 'v' or 'V' for
+	// little- or big-endian, and the version, "273".
+	//
+
+	if( mSize < HeaderSize || memcmp(mData, "BLENDER", 7) != 0 )
+	{
+		// Files saved with compression are gzip streams.
+		if( mSize >= 2 && mData[0] == 0x1f && mData[1] == 0x8b )
+			return Fail("compressed .blend files are not supported");
+
+		return Fail("not a .blend file");
+	}
+
+	mPointerSize = mData[7] == '-' ? 8 : mData[7] == '_' ? 4 : 0;
+	if( mPointerSize == 0 )
+		return Fail("unknown pointer size");
+
+	if( mData[8] != 'v' )
+		return Fail("big-endian .blend files are not supported");
+
+	mVersion = (mData[9] - '0')*100 + (mData[10] - '0')*10 + (mData[11] - '0');
+
+	//
+	// File blocks, up to the "ENDB" block.
+	//
+
+	size_t blockHeaderSize = 16 + mPointerSize;
+	size_t offset = HeaderSize;
+	bool ended = false;
+
+	while( offset + blockHeaderSize <= mSize )
+	{
+		const uint8_t* p = mData + offset;
+
+		Block block;
+		memcpy(block.Code, p, 4);
+		block.Code[4] = 0;
+
+		block.Size        = ReadU32(p + 4);
+		block.Address     = ReadPointer(p + 8);
+		block.StructIndex = ReadU32(p + 8 + mPointerSize);
+		block.Count       = ReadU32(p + 12 + mPointerSize);
+		block.Data        = p + blockHeaderSize;
+
+		if( strcmp(block.Code, "ENDB") == 0 )
+		{
+			ended = true;
+			break;
+		}
+
+		if( block.Size > mSize - offset - blockHeaderSize )
+			return Fail("truncated file block");
+
+		mBlocks.push_back(block);
+		offset += blockHeaderSize + block.Size;
+	}
+
+	if( !ended )
+		return Fail("truncated file, no ENDB block");
+
+	const Block* dna = 0;
+	for(size_t i = 0; i < mBlocks.size(); ++i)
+	{
+		if( strcmp(mBlocks[i].Code, "DNA1") == 0 )
+			dna = &mBlocks[i];
+		else if( strcmp(mBlocks[i].Code, "ME") == 0 )
+			mMeshBlocks.push_back((uint32_t)i);
+	}
+
+	if( dna == 0 )
+		return Fail("no DNA1 block");
+
+	if( !ParseSDNA(*dna) )
+		return false;
+
+	mBlocksByAddress.resize(mBlocks.size());
+	for(uint32_t i = 0; i < (uint32_t)mBlocks.size(); ++i)
+		mBlocksByAddress[i] = i;
+
+	struct ByAddress
+	{
+		const std::vector<Block>* Blocks;
+
+		bool operator()(uint32_t a, uint32_t b)const
+		{
+			return (*Blocks)[a].Address < (*Blocks)[b].Address;
+		}
+	};
+
+	ByAddress byAddress = { &mBlocks };
+	std::sort(mBlocksByAddress.begin(), mBlocksByAddress.end(), byAddress);
+
+	mHasMeshLayout = FindMeshLayout();
+
+	return true;
+}
+
+bool BlendFile::ParseSDNA(const Block& block)
+{
+	SDNAReader reader = { block.Data, block.Data, block.Data + block.Size, true };
+
+	reader.Expect("SDNA");
+
+	// Field names, with their pointer stars and array sizes.
+	reader.Expect("NAME");
+	std::vector<const char*> names(reader.Count());
+	for(size_t i = 0; i < names.size() && reader.Ok; ++i)
+		names[i] = reader.String();
+
+	reader.Align();
+	reader.Expect("TYPE");
+	std::vector<const char*> types(reader.Count());
+	for(size_t i = 0; i < types.size() && reader.Ok; ++i)
+		types[i] = reader.String();
+
+	reader.Align();
+	reader.Expect("TLEN");
+	std::vector<uint16_t> lengths(types.size());
+	for(size_t i = 0; i < lengths.size() && reader.Ok; ++i)
+		lengths[i] = reader.U16();
+
+	reader.Align();
+	reader.Expect("STRC");
+	mStructs.resize(reader.Count());
+
+	for(size_t i = 0; i < mStructs.size() && reader.Ok; ++i)
+	{
+		uint16_t type = reader.U16();
+		uint16_t numFields = reader.U16();
+
+		if( type >= types.size() )
+			return Fail("bad SDNA struct type");
+
+		Struct& s = mStructs[i];
+		s.Name = types[type];
+		s.Size = lengths[type];
+		s.Fields.resize(numFields);
+
+		uint32_t offset = 0;
+		for(uint16_t f = 0; f < numFields && reader.Ok; ++f)
+		{
+			uint16_t fieldType = reader.U16();
+			uint16_t fieldName = reader.U16();
+
+			if( fieldType >= types.size() || fieldName >= names.size() )
+				return Fail("bad SDNA field");
+
+			const char* name = names[fieldName];
+
+			Field& field = s.Fields[f];
+			field.Type      = types[fieldType];
+			field.Name      = BareName(name);
+			field.IsPointer = name[0] == '*' || name[0] == '(';
+			field.Offset    = offset;
+			field.Size      = (field.IsPointer ? mPointerSize : lengths[fieldType])*ArrayLength(name);
+
+			offset += field.Size;
+		}
+
+		if( reader.Ok && offset != s.Size )
+			return Fail("SDNA fields don't add up to the size of " + s.Name);
+	}
+
+	if( !reader.Ok )
+		return Fail("truncated SDNA");
+
+	return true;
+}
+
+bool BlendFile::FindMeshLayout()
+{
+	const Struct* mesh   = FindStruct("Mesh");
+	const Struct* id     = FindStruct("ID");
+	const Struct* vert   = FindStruct("MVert");
+	const Struct* poly   = FindStruct("MPoly");
+	const Struct* loop   = FindStruct("MLoop");
+	const Struct* loopUV = FindStruct("MLoopUV");
+
+	if( mesh == 0 || id == 0 || vert == 0 || poly == 0 || loop == 0 )
+		return false;
+
+	MeshLayout& layout = mMeshLayout;
+
+	uint32_t meshId = FieldOffset(mesh, "id");
+	uint32_t idName = FieldOffset(id, "name");
+	layout.Name = (meshId == MissingField || idName == MissingField) ? MissingField : meshId + idName;
+
+	layout.MVert   = FieldOffset(mesh, "mvert");
+	layout.MPoly   = FieldOffset(mesh, "mpoly");
+	layout.MLoop   = FieldOffset(mesh, "mloop");
+	layout.MLoopUV = FieldOffset(mesh, "mloopuv");
+	layout.TotVert = FieldOffset(mesh, "totvert");
+	layout.TotPoly = FieldOffset(mesh, "totpoly");
+	layout.TotLoop = FieldOffset(mesh, "totloop");
+
+	layout.VertSize = vert->Size;
+	layout.VertCo   = FieldOffset(vert, "co");
+	layout.VertNo   = FieldOffset(vert, "no");
+
+	layout.PolySize      = poly->Size;
+	layout.PolyLoopStart = FieldOffset(poly, "loopstart");
+	layout.PolyTotLoop   = FieldOffset(poly, "totloop");
+
+	layout.LoopSize = loop->Size;
+	layout.LoopV    = FieldOffset(loop, "v");
+
+	// Texture coordinates are optional.
+	layout.LoopUVSize = loopUV ? loopUV->Size : 0;
+	layout.LoopUVUV   = FieldOffset(loopUV, "uv");
+
+	uint32_t required[] =
+	{
+		layout.Name, layout.MVert, layout.MPoly, layout.MLoop, layout.TotVert, layout.TotPoly,
+		layout.TotLoop, layout.VertCo, layout.VertNo, layout.PolyLoopStart, layout.PolyTotLoop,
+		layout.LoopV
+	};
+
+	for(size_t i = 0; i < sizeof(required)/sizeof(required[0]); ++i)
+	{
+		if( required[i] == MissingField )
+			return false;
+	}
+
+	return true;
+}
+
+bool BlendFile::IsOpen()const
+{
+	return !mBlocks.empty();
+}
+
+const std::string& BlendFile::GetError()const
+{
+	return mError;
+}
+
+uint32_t BlendFile::GetPointerSize()const
+{
+	return mPointerSize;
+}
+
+uint32_t BlendFile::GetVersion()const
+{
+	return mVersion;
+}
+
+uint32_t BlendFile::GetBlockCount()const
+{
+	return (uint32_t)mBlocks.size();
+}
+
+const BlendFile::Block& BlendFile::GetBlock(uint32_t index)const
+{
+	return mBlocks[index];
+}
+
+const BlendFile::Block* BlendFile::FindBlock(uint64_t address)const
+{
+	size_t first = 0;
+	size_t count = mBlocksByAddress.size();
+
+	// Binary search; there can be thousands of blocks.
+	while( count > 0 )
+	{
+		size_t half = count / 2;
+		if( mBlocks[mBlocksByAddress[first + half]].Address < address )
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+
+	if( first < mBlocksByAddress.size() && mBlocks[mBlocksByAddress[first]].Address == address )
+		return &mBlocks[mBlocksByAddress[first]];
+
+	return 0;
+}
+
+const BlendFile::Struct* BlendFile::FindStruct(const std::string& name)const
+{
+	for(size_t i = 0; i < mStructs.size(); ++i)
+	{
+		if( mStructs[i].Name == name )
+			return &mStructs[i];
+	}
+
+	return 0;
+}
+
+const BlendFile::Field* BlendFile::FindField(const Struct& s, const std::string& name)
+{
+	for(size_t i = 0; i < s.Fields.size(); ++i)
+	{
+		if( s.Fields[i].Name == name )
+			return &s.Fields[i];
+	}
+
+	return 0;
+}
+
+uint32_t BlendFile::GetMeshCount()const
+{
+	return (uint32_t)mMeshBlocks.size();
+}
+
+uint64_t BlendFile::ReadPointer(const uint8_t* p)const
+{
+	if( mPointerSize == 4 )
+		return ReadU32(p);
+
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+const uint8_t* BlendFile::ResolveArray(const uint8_t* p, uint32_t pointerOffset, uint32_t count,
+	uint32_t elementSize)const
+{
+	uint64_t address = ReadPointer(p + pointerOffset);
+	if( address == 0 )
+		return 0;
+
+	const Block* block = FindBlock(address);
+	if( block == 0 || (uint64_t)count*elementSize > block->Size )
+		return 0;
+
+	return block->Data;
+}
+
+bool BlendFile::ReadMesh(uint32_t index, Mesh& mesh)
+{
+	mesh.Name.clear();
+	mesh.Vertices.clear();
+	mesh.Indices.clear();
+
+	if( index >= mMeshBlocks.size() )
+	{
+		mError = "no such mesh";
+		return false;
+	}
+
+	if( !mHasMeshLayout )
+	{
+		mError = "the file's SDNA has no Mesh layout this reader knows";
+		return false;
+	}
+
+	const MeshLayout& layout = mMeshLayout;
+	const Block& block = mBlocks[mMeshBlocks[index]];
+	const uint8_t* me = block.Data;
+
+	if( block.StructIndex >= mStructs.size() || mStructs[block.StructIndex].Name != "Mesh" ||
+		block.Size < mStructs[block.StructIndex].Size )
+	{
+		mError = "ME block does not hold a Mesh";
+		return false;
+	}
+
+	// ID names start with the ID code, "ME".
+	const char* name = (const char*)me + layout.Name;
+	const char* nameEnd = (const char*)memchr(name, 0, 66);
+	mesh.Name.assign(name + 2, nameEnd ? nameEnd : name + 66);
+
+	int32_t totVert = ReadI32(me + layout.TotVert);
+	int32_t totPoly = ReadI32(me + layout.TotPoly);
+	int32_t totLoop = ReadI32(me + layout.TotLoop);
+
+	if( totVert < 0 || totPoly < 0 || totLoop < 0 )
+	{
+		mError = "bad mesh element counts";
+		return false;
+	}
+
+	const uint8_t* verts = ResolveArray(me, layout.MVert, totVert, layout.VertSize);
+	const uint8_t* polys = ResolveArray(me, layout.MPoly, totPoly, layout.PolySize);
+	const uint8_t* loops = ResolveArray(me, layout.MLoop, totLoop, layout.LoopSize);
+	const uint8_t* uvs   = layout.LoopUVUV != MissingField ?
+		ResolveArray(me, layout.MLoopUV, totLoop, layout.LoopUVSize) : 0;
+
+	if( (totVert > 0 && verts == 0) || (totPoly > 0 && polys == 0) || (totLoop > 0 && loops == 0) )
+	{
+		mError = "mesh " + mesh.Name + " has missing or short arrays";
+		return false;
+	}
+
+	//
+	// A vertex per distinct (mesh vertex, texture coordinate) pair of the loops.
+	// The vertices made from one mesh vertex are chained, and the chains are short.
+	//
+
+	std::vector<uint32_t> firstVertex(totVert, NoVertex);
+	std::vector<uint32_t> nextVertex;
+	std::vector<uint32_t> loopVertex(totLoop);
+
+	mesh.Vertices.reserve(totVert);
+	nextVertex.reserve(totVert);
+
+	for(int32_t l = 0; l < totLoop; ++l)
+	{
+		int32_t v = ReadI32(loops + (size_t)l*layout.LoopSize + layout.LoopV);
+		if( v < 0 || v >= totVert )
+		{
+			mError = "mesh " + mesh.Name + " has a loop with a bad vertex";
+			return false;
+		}
+
+		// Blender's v axis points up, Direct3D's down.
+		float texC[2] = { 0.0f, 0.0f };
+		if( uvs )
+		{
+			const uint8_t* uv = uvs + (size_t)l*layout.LoopUVSize + layout.LoopUVUV;
+			texC[0] = ReadFloat(uv);
+			texC[1] = 1.0f - ReadFloat(uv + 4);
+		}
+
+		uint32_t out = firstVertex[v];
+		while( out != NoVertex &&
+			(mesh.Vertices[out].TexC[0] != texC[0] || mesh.Vertices[out].TexC[1] != texC[1]) )
+		{
+			out = nextVertex[out];
+		}
+
+		if( out == NoVertex )
+		{
+			const uint8_t* src = verts + (size_t)v*layout.VertSize;
+			const uint8_t* co = src + layout.VertCo;
+			const uint8_t* no = src + layout.VertNo;
+
+			MeshVertex vertex;
+			vertex.Position[0] = ReadFloat(co);
+			vertex.Position[1] = ReadFloat(co + 8);
+			vertex.Position[2] = ReadFloat(co + 4);
+
+			// Normals are stored as shorts scaled by 32767.
+			vertex.Normal[0] = ReadI16(no)/32767.0f;
+			vertex.Normal[1] = ReadI16(no + 4)/32767.0f;
+			vertex.Normal[2] = ReadI16(no + 2)/32767.0f;
+
+			vertex.TexC[0] = texC[0];
+			vertex.TexC[1] = texC[1];
+
+			out = (uint32_t)mesh.Vertices.size();
+			mesh.Vertices.push_back(vertex);
+			nextVertex.push_back(firstVertex[v]);
+			firstVertex[v] = out;
+		}
+
+		loopVertex[l] = out;
+	}
+
+	//
+	// Fan-triangulate the polygons.  Fine for the convex faces modelling produces.
+	//
+
+	size_t numTriangles = 0;
+	for(int32_t p = 0; p < totPoly; ++p)
+	{
+		int32_t count = ReadI32(polys + (size_t)p*layout.PolySize + layout.PolyTotLoop);
+		numTriangles += count > 2 ? count - 2 : 0;
+	}
+
+	mesh.Indices.reserve(numTriangles*3);
+
+	for(int32_t p = 0; p < totPoly; ++p)
+	{
+		const uint8_t* poly = polys + (size_t)p*layout.PolySize;
+		int32_t start = ReadI32(poly + layout.PolyLoopStart);
+		int32_t count = ReadI32(poly + layout.PolyTotLoop);
+
+		if( start < 0 || count < 0 || start > totLoop - count )
+		{
+			mError = "mesh " + mesh.Name + " has a polygon with bad loops";
+			return false;
+		}
+
+		// Reversed, so the counterclockwise loops become clockwise front faces.
+		for(int32_t k = 1; k + 1 < count; ++k)
+		{
+			mesh.Indices.push_back(loopVertex[start]);
+			mesh.Indices.push_back(loopVertex[start + k + 1]);
+			mesh.Indices.push_back(loopVertex[start + k]);
+		}
+	}
+
+	return true;
+}
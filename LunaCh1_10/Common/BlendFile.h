@@ -0,0 +1,203 @@
+//***************************************************************************************
+// BlendFile.h
+//
+// Reads meshes straight out of Blender's .blend files, without exporting to FBX and
+// importing through assimp.
+//   -Open() maps the file and walks its file blocks.  Every block is a header (code,
+//    size, the address it had in Blender's memory, struct index, count) followed by
+//    its data, which is left in the mapping.
+//   -The DNA1 block is the file's SDNA: the names, types, sizes and fields of every
+//    struct, as dumped in Hills/dna.txt.  Field offsets are computed from it when
+//    the file is opened instead of being hard-coded, so files saved by other
+//    Blender versions read the same way.
+//   -ReadMesh() follows a Mesh's pointers (mvert, mpoly, mloop, mloopuv) to the
+//    blocks that held them and triangulates the polygons.  Nothing else of the
+//    scene is converted.
+//
+// Only little-endian files are read, with 32- or 64-bit pointers.  Like DDSFile,
+// it maps the file with POSIX calls outside Windows, so it can be used by tools.
+//***************************************************************************************
+
+#ifndef BLENDFILE_H
+#define BLENDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BlendFile
+{
+public:
+	struct Field
+	{
+		std::string Type;
+
+		// Without pointer stars or array sizes: "co" for "co[3]".
+		std::string Name;
+
+		uint32_t Offset;
+		uint32_t Size;
+		bool IsPointer;
+	};
+
+	struct Struct
+	{
+		std::string Name;
+		uint32_t Size;
+		std::vector<Field> Fields;
+	};
+
+	struct Block
+	{
+		// Two or four characters, "ME" for meshes, "DATA" for arrays.
+		char Code[5];
+
+		uint32_t Size;
+		uint64_t Address;
+		uint32_t StructIndex;
+		uint32_t Count;
+
+		const uint8_t* Data;
+	};
+
+	struct MeshVertex
+	{
+		float Position[3];
+		float Normal[3];
+		float TexC[2];
+	};
+
+	struct Mesh
+	{
+		std::string Name;
+
+		// A vertex per distinct position and texture coordinate, three indices per
+		// triangle.
+		std::vector<MeshVertex> Vertices;
+		std::vector<uint32_t> Indices;
+	};
+
+public:
+	BlendFile();
+	~BlendFile();
+
+	bool Open(const std::string& filename);
+#ifdef _WIN32
+	bool Open(const std::wstring& filename);
+#endif
+
+	///<summary>
+	/// Reads a .blend file that is already in memory.  The memory is not copied and
+	/// must outlive the object.
+	///</summary>
+	bool Parse(const uint8_t* data, size_t size);
+
+	void Close();
+
+	bool IsOpen()const;
+
+	// Why the last Open(), Parse() or ReadMesh() failed.
+	const std::string& GetError()const;
+
+	// 4 or 8, and the Blender version that saved the file, e.g. 273.
+	uint32_t GetPointerSize()const;
+	uint32_t GetVersion()const;
+
+	uint32_t GetBlockCount()const;
+	const Block& GetBlock(uint32_t index)const;
+
+	// The block that was at this address in Blender's memory, or null.
+	const Block* FindBlock(uint64_t address)const;
+
+	const Struct* FindStruct(const std::string& name)const;
+	static const Field* FindField(const Struct& s, const std::string& name);
+
+	uint32_t GetMeshCount()const;
+
+	///<summary>
+	/// Triangulates a mesh.  Positions and normals are converted to the demos'
+	/// left-handed, y-up space by swapping y and z.  That mirrors the mesh, so the
+	/// triangles are emitted in reverse order to turn Blender's counterclockwise
+	/// faces clockwise, the Direct3D front face.
+	///</summary>
+	bool ReadMesh(uint32_t index, Mesh& mesh);
+
+private:
+	bool MapFile();
+	bool Fail(const std::string& error);
+	bool ParseBlocks();
+	bool ParseSDNA(const Block& block);
+	bool FindMeshLayout();
+
+	uint64_t ReadPointer(const uint8_t* p)const;
+
+	// The array a pointer field points to, if its block holds count elements of
+	// elementSize bytes.
+	const uint8_t* ResolveArray(const uint8_t* p, uint32_t pointerOffset, uint32_t count,
+		uint32_t elementSize)const;
+
+private:
+	BlendFile(const BlendFile& rhs);
+	BlendFile& operator=(const BlendFile& rhs);
+
+private:
+#ifdef _WIN32
+	void* mFile;
+	void* mMapping;
+#else
+	int mFile;
+#endif
+	bool mMapped;
+
+	const uint8_t* mData;
+	size_t mSize;
+
+	uint32_t mPointerSize;
+	uint32_t mVersion;
+
+	std::vector<Block> mBlocks;
+
+	// Block indices sorted by address, for following pointers.
+	std::vector<uint32_t> mBlocksByAddress;
+
+	std::vector<Struct> mStructs;
+
+	// Indices of the "ME" blocks.
+	std::vector<uint32_t> mMeshBlocks;
+
+	// Offsets and sizes ReadMesh() needs, found in the SDNA.  Offset is ~0 if the
+	// field is missing.
+	struct MeshLayout
+	{
+		uint32_t Name;
+		uint32_t MVert;
+		uint32_t MPoly;
+		uint32_t MLoop;
+		uint32_t MLoopUV;
+		uint32_t TotVert;
+		uint32_t TotPoly;
+		uint32_t TotLoop;
+
+		uint32_t VertSize;
+		uint32_t VertCo;
+		uint32_t VertNo;
+
+		uint32_t PolySize;
+		uint32_t PolyLoopStart;
+		uint32_t PolyTotLoop;
+
+		uint32_t LoopSize;
+		uint32_t LoopV;
+
+		uint32_t LoopUVSize;
+		uint32_t LoopUVUV;
+	};
+
+	MeshLayout mMeshLayout;
+	bool mHasMeshLayout;
+
+	std::string mError;
+};
+
+#endif // BLENDFILE_H
@@ -8,7 +8,10 @@ Camera::Camera()
 	: mPosition(0.0f, 0.0f, 0.0f), 
 	  mRight(1.0f, 0.0f, 0.0f),
 	  mUp(0.0f, 1.0f, 0.0f),
-	  mLook(0.0f, 0.0f, 1.0f)
+	  mLook(0.0f, 0.0f, 1.0f),
+	  mViewDirty(true),
+	  mProjDirty(true),
+	  mVersion(0)
 {
 	SetLens(0.25f*MathHelper::Pi, 1.0f, 1.0f, 1000.0f);
 }
@@ -30,11 +33,13 @@ XMFLOAT3 Camera::GetPosition()const
 void Camera::SetPosition(float x, float y, float z)
 {
 	mPosition = XMFLOAT3(x, y, z);
+	mViewDirty = true;
 }
 
 void Camera::SetPosition(const XMFLOAT3& v)
 {
 	mPosition = v;
+	mViewDirty = true;
 }
 
 XMVECTOR Camera::GetRightXM()const
@@ -126,6 +131,8 @@ void Camera::SetLens(float fovY, float aspect, float zn, float zf)
 
 	XMMATRIX P = XMMatrixPerspectiveFovLH(mFovY, mAspect, mNearZ, mFarZ);
 	XMStoreFloat4x4(&mProj, P);
+
+	mProjDirty = true;
 }
 
 void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR worldUp)
@@ -134,10 +141,17 @@ void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR worldUp)
 	XMVECTOR R = XMVector3Normalize(XMVector3Cross(worldUp, L));
 	XMVECTOR U = XMVector3Cross(L, R);
 
+	// Orbit style cameras call LookAt every frame; keep the cache if nothing moved.
+	if( XMVector3Equal(pos, XMLoadFloat3(&mPosition)) && XMVector3Equal(L, XMLoadFloat3(&mLook)) &&
+		XMVector3Equal(R, XMLoadFloat3(&mRight)) )
+		return;
+
 	XMStoreFloat3(&mPosition, pos);
 	XMStoreFloat3(&mLook, L);
 	XMStoreFloat3(&mRight, R);
 	XMStoreFloat3(&mUp, U);
+
+	mViewDirty = true;
 }
 
 void Camera::LookAt(const XMFLOAT3& pos, const XMFLOAT3& target, const XMFLOAT3& up)
@@ -151,6 +165,7 @@ void Camera::LookAt(const XMFLOAT3& pos, const XMFLOAT3& target, const XMFLOAT3&
 
 XMMATRIX Camera::View()const
 {
+	UpdateCache();
 	return XMLoadFloat4x4(&mView);
 }
 
@@ -161,7 +176,56 @@ XMMATRIX Camera::Proj()const
 
 XMMATRIX Camera::ViewProj()const
 {
-	return XMMatrixMultiply(View(), Proj());
+	UpdateCache();
+	return XMLoadFloat4x4(&mViewProj);
+}
+
+XMMATRIX Camera::InvView()const
+{
+	UpdateCache();
+	return XMLoadFloat4x4(&mInvView);
+}
+
+XMMATRIX Camera::InvViewProj()const
+{
+	UpdateCache();
+	return XMLoadFloat4x4(&mInvViewProj);
+}
+
+const XMFLOAT4* Camera::GetFrustumPlanesW()const
+{
+	UpdateCache();
+	return mFrustumPlanesW;
+}
+
+bool Camera::IsVisible(const XMFLOAT3& center, const XMFLOAT3& extents)const
+{
+	UpdateCache();
+
+	XMVECTOR C = XMLoadFloat3(&center);
+	XMVECTOR E = XMLoadFloat3(&extents);
+
+	for(int i = 0; i < 6; ++i)
+	{
+		XMVECTOR plane = XMLoadFloat4(&mFrustumPlanesW[i]);
+
+		// Signed distance of the box center and the projected radius of the box
+		// onto the plane normal.  If the center is further behind the plane than
+		// the radius, the whole box is outside.
+		XMVECTOR d = XMPlaneDotCoord(plane, C);
+		XMVECTOR r = XMVector3Dot(XMVectorAbs(plane), E);
+
+		if( XMVector4Less(XMVectorAdd(d, r), XMVectorZero()) )
+			return false;
+	}
+
+	return true;
+}
+
+UINT Camera::GetVersion()const
+{
+	UpdateCache();
+	return mVersion;
 }
 
 void Camera::Strafe(float d)
@@ -171,6 +235,8 @@ void Camera::Strafe(float d)
 	XMVECTOR r = XMLoadFloat3(&mRight);
 	XMVECTOR p = XMLoadFloat3(&mPosition);
 	XMStoreFloat3(&mPosition, XMVectorMultiplyAdd(s, r, p));
+
+	mViewDirty = true;
 }
 
 void Camera::Walk(float d)
@@ -180,6 +246,8 @@ void Camera::Walk(float d)
 	XMVECTOR l = XMLoadFloat3(&mLook);
 	XMVECTOR p = XMLoadFloat3(&mPosition);
 	XMStoreFloat3(&mPosition, XMVectorMultiplyAdd(s, l, p));
+
+	mViewDirty = true;
 }
 
 void Camera::Pitch(float angle)
@@ -188,8 +256,10 @@ void Camera::Pitch(float angle)
 
 	XMMATRIX R = XMMatrixRotationAxis(XMLoadFloat3(&mRight), angle);
 
-	XMStoreFloat3(&mUp,   XMVector3TransformNormal(XMLoadFloat3(&mUp), R));
-	XMStoreFloat3(&mLook, XMVector3TransformNormal(XMLoadFloat3(&mLook), R));
+	XMVECTOR U = XMVector3TransformNormal(XMLoadFloat3(&mUp), R);
+	XMVECTOR L = XMVector3TransformNormal(XMLoadFloat3(&mLook), R);
+
+	Orthonormalize(XMLoadFloat3(&mRight), U, L);
 }
 
 void Camera::RotateY(float angle)
@@ -198,53 +268,92 @@ void Camera::RotateY(float angle)
 
 	XMMATRIX R = XMMatrixRotationY(angle);
 
-	XMStoreFloat3(&mRight,   XMVector3TransformNormal(XMLoadFloat3(&mRight), R));
-	XMStoreFloat3(&mUp, XMVector3TransformNormal(XMLoadFloat3(&mUp), R));
-	XMStoreFloat3(&mLook, XMVector3TransformNormal(XMLoadFloat3(&mLook), R));
+	XMVECTOR Rt = XMVector3TransformNormal(XMLoadFloat3(&mRight), R);
+	XMVECTOR U  = XMVector3TransformNormal(XMLoadFloat3(&mUp), R);
+	XMVECTOR L  = XMVector3TransformNormal(XMLoadFloat3(&mLook), R);
+
+	Orthonormalize(Rt, U, L);
 }
 
-void Camera::UpdateViewMatrix()
+void Camera::Orthonormalize(FXMVECTOR right, FXMVECTOR up, FXMVECTOR look)
 {
-	XMVECTOR R = XMLoadFloat3(&mRight);
-	XMVECTOR U = XMLoadFloat3(&mUp);
-	XMVECTOR L = XMLoadFloat3(&mLook);
-	XMVECTOR P = XMLoadFloat3(&mPosition);
-
-	// Keep camera's axes orthogonal to each other and of unit length.
-	L = XMVector3Normalize(L);
-	U = XMVector3Normalize(XMVector3Cross(L, R));
+	// Rotations accumulate numerical error, so keep the camera's axes orthogonal
+	// to each other and of unit length.  Only done when the basis was rotated,
+	// translating the camera does not touch it.
+	XMVECTOR L = XMVector3Normalize(look);
+	XMVECTOR U = XMVector3Normalize(XMVector3Cross(L, right));
 
 	// U, L already ortho-normal, so no need to normalize cross product.
-	R = XMVector3Cross(U, L); 
-
-	// Fill in the view matrix entries.
-	float x = -XMVectorGetX(XMVector3Dot(P, R));
-	float y = -XMVectorGetX(XMVector3Dot(P, U));
-	float z = -XMVectorGetX(XMVector3Dot(P, L));
+	XMVECTOR R = XMVector3Cross(U, L); 
 
 	XMStoreFloat3(&mRight, R);
 	XMStoreFloat3(&mUp, U);
 	XMStoreFloat3(&mLook, L);
 
-	mView(0,0) = mRight.x; 
-	mView(1,0) = mRight.y; 
-	mView(2,0) = mRight.z; 
-	mView(3,0) = x;   
+	mViewDirty = true;
+}
+
+void Camera::UpdateViewMatrix()
+{
+	UpdateCache();
+}
+
+void Camera::UpdateCache()const
+{
+	if( !mViewDirty && !mProjDirty )
+		return;
 
-	mView(0,1) = mUp.x;
-	mView(1,1) = mUp.y;
-	mView(2,1) = mUp.z;
-	mView(3,1) = y;  
+	if( mViewDirty )
+	{
+		XMVECTOR R = XMLoadFloat3(&mRight);
+		XMVECTOR U = XMLoadFloat3(&mUp);
+		XMVECTOR L = XMLoadFloat3(&mLook);
+		XMVECTOR P = XMLoadFloat3(&mPosition);
 
-	mView(0,2) = mLook.x; 
-	mView(1,2) = mLook.y; 
-	mView(2,2) = mLook.z; 
-	mView(3,2) = z;   
+		// Fill in the view matrix entries.
+		float x = -XMVectorGetX(XMVector3Dot(P, R));
+		float y = -XMVectorGetX(XMVector3Dot(P, U));
+		float z = -XMVectorGetX(XMVector3Dot(P, L));
 
-	mView(0,3) = 0.0f;
-	mView(1,3) = 0.0f;
-	mView(2,3) = 0.0f;
-	mView(3,3) = 1.0f;
-}
+		mView(0,0) = mRight.x; 
+		mView(1,0) = mRight.y; 
+		mView(2,0) = mRight.z; 
+		mView(3,0) = x;   
+
+		mView(0,1) = mUp.x;
+		mView(1,1) = mUp.y;
+		mView(2,1) = mUp.z;
+		mView(3,1) = y;  
+
+		mView(0,2) = mLook.x; 
+		mView(1,2) = mLook.y; 
+		mView(2,2) = mLook.z; 
+		mView(3,2) = z;   
+
+		mView(0,3) = 0.0f;
+		mView(1,3) = 0.0f;
+		mView(2,3) = 0.0f;
+		mView(3,3) = 1.0f;
+
+		// The view matrix is a rigid transform, so its inverse is just the
+		// camera's world matrix: the basis vectors as rows plus the position.
+		mInvView(0,0) = mRight.x;    mInvView(0,1) = mRight.y;    mInvView(0,2) = mRight.z;    mInvView(0,3) = 0.0f;
+		mInvView(1,0) = mUp.x;       mInvView(1,1) = mUp.y;       mInvView(1,2) = mUp.z;       mInvView(1,3) = 0.0f;
+		mInvView(2,0) = mLook.x;     mInvView(2,1) = mLook.y;     mInvView(2,2) = mLook.z;     mInvView(2,3) = 0.0f;
+		mInvView(3,0) = mPosition.x; mInvView(3,1) = mPosition.y; mInvView(3,2) = mPosition.z; mInvView(3,3) = 1.0f;
+	}
+
+	XMMATRIX V  = XMLoadFloat4x4(&mView);
+	XMMATRIX VP = XMMatrixMultiply(V, XMLoadFloat4x4(&mProj));
+	XMStoreFloat4x4(&mViewProj, VP);
+
+	XMVECTOR det = XMMatrixDeterminant(VP);
+	XMStoreFloat4x4(&mInvViewProj, XMMatrixInverse(&det, VP));
 
+	// Planes extracted from the view-projection matrix are in world space.
+	ExtractFrustumPlanes(mFrustumPlanesW, VP);
 
+	mViewDirty = false;
+	mProjDirty = false;
+	++mVersion;
+}
\ No newline at end of file
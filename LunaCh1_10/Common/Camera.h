@@ -53,10 +53,24 @@ public:
 	void LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR worldUp);
 	void LookAt(const XMFLOAT3& pos, const XMFLOAT3& target, const XMFLOAT3& up);
 
-	// Get View/Proj matrices.
+	// Get View/Proj matrices.  These are cached; they are only rebuilt the first
+	// time they are requested after the position, orientation or lens changed.
 	XMMATRIX View()const;
 	XMMATRIX Proj()const;
 	XMMATRIX ViewProj()const;
+	XMMATRIX InvView()const;
+	XMMATRIX InvViewProj()const;
+
+	// World space frustum planes with normals pointing inward.
+	// Order: left, right, bottom, top, near, far.
+	const XMFLOAT4* GetFrustumPlanesW()const;
+
+	// Returns false if the world space box is completely outside the frustum.
+	bool IsVisible(const XMFLOAT3& center, const XMFLOAT3& extents)const;
+
+	// Incremented every time the cached matrices are rebuilt.  Clients can store
+	// the value to skip recomputing data derived from the camera.
+	UINT GetVersion()const;
 
 	// Strafe/Walk the camera a distance d.
 	void Strafe(float d);
@@ -66,9 +80,14 @@ public:
 	void Pitch(float angle);
 	void RotateY(float angle);
 
-	// After modifying camera position/orientation, call to rebuild the view matrix.
+	// Rebuilds the cached matrices if the camera changed.  Calling this is optional,
+	// the getters above rebuild on demand.
 	void UpdateViewMatrix();
 
+private:
+	void Orthonormalize(FXMVECTOR right, FXMVECTOR up, FXMVECTOR look);
+	void UpdateCache()const;
+
 private:
 
 	// Camera coordinate system with coordinates relative to world space.
@@ -85,9 +104,19 @@ private:
 	float mNearWindowHeight;
 	float mFarWindowHeight;
 
-	// Cache View/Proj matrices.
-	XMFLOAT4X4 mView;
+	// Cache View/Proj matrices and everything derived from them.
+	mutable XMFLOAT4X4 mView;
+	mutable XMFLOAT4X4 mViewProj;
+	mutable XMFLOAT4X4 mInvView;
+	mutable XMFLOAT4X4 mInvViewProj;
+	mutable XMFLOAT4 mFrustumPlanesW[6];
 	XMFLOAT4X4 mProj;
+
+	// mViewDirty is set when position/orientation changed, mProjDirty when the
+	// lens changed.  Either one invalidates the combined matrices and planes.
+	mutable bool mViewDirty;
+	mutable bool mProjDirty;
+	mutable UINT mVersion;
 };
 
 #endif // CAMERA_H
\ No newline at end of file
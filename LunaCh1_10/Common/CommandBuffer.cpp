@@ -0,0 +1,135 @@
+//***************************************************************************************
+// CommandBuffer.cpp
+//***************************************************************************************
+
+#include "CommandBuffer.h"
+
+CommandBuffer::CommandBuffer()
+	: mDrawCount(0)
+{
+	ForgetState();
+}
+
+void CommandBuffer::Clear()
+{
+	// Keeps the memory from frame to frame.
+	mCommands.clear();
+	mDrawCount = 0;
+
+	ForgetState();
+}
+
+void CommandBuffer::SetShader(UINT shader)
+{
+	SetState(OpSetShader, shader);
+}
+
+void CommandBuffer::SetGeometry(UINT geometry)
+{
+	SetState(OpSetGeometry, geometry);
+}
+
+void CommandBuffer::SetBlend(UINT blend)
+{
+	SetState(OpSetBlend, blend);
+}
+
+void CommandBuffer::SetMaterial(UINT material)
+{
+	SetState(OpSetMaterial, material);
+}
+
+void CommandBuffer::SetObject(UINT object)
+{
+	SetState(OpSetObject, object);
+}
+
+void CommandBuffer::Draw(UINT vertexCount, UINT startVertex)
+{
+	Push(OpDraw, vertexCount, startVertex, 0);
+	++mDrawCount;
+}
+
+void CommandBuffer::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	Push(OpDrawIndexed, indexCount, startIndex, (UINT)baseVertex);
+	++mDrawCount;
+}
+
+void CommandBuffer::Append(const CommandBuffer& other)
+{
+	mCommands.insert(mCommands.end(), other.mCommands.begin(), other.mCommands.end());
+	mDrawCount += other.mDrawCount;
+
+	ForgetState();
+}
+
+void CommandBuffer::Execute(ID3D11DeviceContext* dc, Translator& translator)const
+{
+	translator.BeginContext(dc);
+
+	for(size_t i = 0; i < mCommands.size(); ++i)
+	{
+		const Command& command = mCommands[i];
+
+		switch( command.Op )
+		{
+		case OpSetShader:   translator.SetShader(dc, command.Arg0);   break;
+		case OpSetGeometry: translator.SetGeometry(dc, command.Arg0); break;
+		case OpSetBlend:    translator.SetBlend(dc, command.Arg0);    break;
+		case OpSetMaterial: translator.SetMaterial(dc, command.Arg0); break;
+		case OpSetObject:   translator.SetObject(dc, command.Arg0);   break;
+
+		case OpDraw:
+			translator.PrepareDraw(dc);
+			dc->Draw(command.Arg0, command.Arg1);
+			break;
+
+		case OpDrawIndexed:
+			translator.PrepareDraw(dc);
+			dc->DrawIndexed(command.Arg0, command.Arg1, (INT)command.Arg2);
+			break;
+		}
+	}
+}
+
+UINT CommandBuffer::GetCommandCount()const
+{
+	return (UINT)mCommands.size();
+}
+
+UINT CommandBuffer::GetDrawCount()const
+{
+	return mDrawCount;
+}
+
+const CommandBuffer::Command* CommandBuffer::GetCommands()const
+{
+	return mCommands.empty() ? 0 : &mCommands[0];
+}
+
+void CommandBuffer::SetState(UINT op, UINT value)
+{
+	if( mState[op] == value )
+		return;
+
+	mState[op] = value;
+	Push(op, value, 0, 0);
+}
+
+void CommandBuffer::Push(UINT op, UINT arg0, UINT arg1, UINT arg2)
+{
+	Command command;
+	command.Op   = op;
+	command.Arg0 = arg0;
+	command.Arg1 = arg1;
+	command.Arg2 = arg2;
+
+	mCommands.push_back(command);
+}
+
+void CommandBuffer::ForgetState()
+{
+	for(UINT i = 0; i < NumStates; ++i)
+		mState[i] = InvalidState;
+}
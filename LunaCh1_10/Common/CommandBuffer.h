@@ -0,0 +1,107 @@
+//***************************************************************************************
+// CommandBuffer.h
+//
+// A CPU-side list of draw commands that does not depend on Direct3D, so scenes can
+// be traversed and recorded (and timed) without a device.
+//   -Commands are 16 byte records: an opcode and three arguments.  States are ids
+//    of the caller's own shaders, geometry, blend states, materials and objects,
+//    as in RenderQueue.
+//   -Setting a state that the buffer already set is not recorded.  Each buffer
+//    starts with no state known, so buffers recorded apart can be appended or
+//    executed in any context.
+//   -Execute() replays the commands on a device context.  A Translator turns the
+//    state ids into effect and pipeline calls; draws are issued directly.
+//***************************************************************************************
+
+#ifndef COMMANDBUFFER_H
+#define COMMANDBUFFER_H
+
+#include "d3dUtil.h"
+
+class CommandBuffer
+{
+public:
+	enum Opcode
+	{
+		OpSetShader,
+		OpSetGeometry,
+		OpSetBlend,
+		OpSetMaterial,
+		OpSetObject,
+		OpDraw,
+		OpDrawIndexed
+	};
+
+	struct Command
+	{
+		UINT Op;
+		UINT Arg0;
+		UINT Arg1;
+		UINT Arg2;
+	};
+
+	class Translator
+	{
+	public:
+		virtual ~Translator() {}
+
+		// Called before the first command of every context a buffer is replayed
+		// on.  Deferred contexts start with no render targets or viewport bound.
+		virtual void BeginContext(ID3D11DeviceContext* dc) {}
+
+		virtual void SetShader(ID3D11DeviceContext* dc, UINT shader) = 0;
+		virtual void SetGeometry(ID3D11DeviceContext* dc, UINT geometry) = 0;
+		virtual void SetBlend(ID3D11DeviceContext* dc, UINT blend) = 0;
+		virtual void SetMaterial(ID3D11DeviceContext* dc, UINT material) = 0;
+		virtual void SetObject(ID3D11DeviceContext* dc, UINT object) = 0;
+
+		// Called before every draw, e.g. to apply the effect pass.
+		virtual void PrepareDraw(ID3D11DeviceContext* dc) = 0;
+
+		// Whether buffers may be replayed on several contexts at once.  Effect
+		// variables are shared, so a translator that sets them is not.
+		virtual bool IsThreadSafe()const { return false; }
+	};
+
+public:
+	CommandBuffer();
+
+	void Clear();
+
+	void SetShader(UINT shader);
+	void SetGeometry(UINT geometry);
+	void SetBlend(UINT blend);
+	void SetMaterial(UINT material);
+	void SetObject(UINT object);
+
+	void Draw(UINT vertexCount, UINT startVertex);
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+
+	///<summary>
+	/// Appends the commands of another buffer.  Its state is unknown afterwards,
+	/// so the next state set is always recorded.
+	///</summary>
+	void Append(const CommandBuffer& other);
+
+	void Execute(ID3D11DeviceContext* dc, Translator& translator)const;
+
+	UINT GetCommandCount()const;
+	UINT GetDrawCount()const;
+	const Command* GetCommands()const;
+
+private:
+	void SetState(UINT op, UINT value);
+	void Push(UINT op, UINT arg0, UINT arg1, UINT arg2);
+	void ForgetState();
+
+private:
+	std::vector<Command> mCommands;
+	UINT mDrawCount;
+
+	// Last value set for each state opcode, or InvalidState.
+	static const UINT InvalidState = 0xFFFFFFFF;
+	static const UINT NumStates = OpSetObject + 1;
+	UINT mState[NumStates];
+};
+
+#endif // COMMANDBUFFER_H
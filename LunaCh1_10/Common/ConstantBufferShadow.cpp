@@ -0,0 +1,100 @@
+//***************************************************************************************
+// ConstantBufferShadow.cpp
+//***************************************************************************************
+
+#include "ConstantBufferShadow.h"
+
+ConstantBufferShadow::ConstantBufferShadow()
+	: mBuffer(0), mDirty(false), mVersion(0), mSkippedUpdates(0)
+{
+}
+
+void ConstantBufferShadow::Init(ID3DX11Effect* fx, const char* name)
+{
+	mBuffer = fx->GetConstantBufferByName(name);
+	mTracked.clear();
+	mDirty = false;
+
+	// The effect owns the buffer; its size is all that is needed from it.
+	ID3D11Buffer* buffer = 0;
+	HR(mBuffer->GetConstantBuffer(&buffer));
+
+	D3D11_BUFFER_DESC desc;
+	buffer->GetDesc(&desc);
+	ReleaseCOM(buffer);
+
+	mData.assign(desc.ByteWidth, 0);
+}
+
+void ConstantBufferShadow::Track(ID3DX11EffectVariable* variable)
+{
+	assert(variable->GetParentConstantBuffer() == mBuffer);
+
+	D3DX11_EFFECT_VARIABLE_DESC desc;
+	HR(variable->GetDesc(&desc));
+
+	Tracked tracked;
+	tracked.Variable = variable;
+	tracked.Offset   = desc.BufferOffset;
+	tracked.Valid    = false;
+
+	mTracked.push_back(tracked);
+}
+
+bool ConstantBufferShadow::Update(ID3DX11EffectVariable* variable, const void* data, UINT size)
+{
+	// Buffers hold a handful of variables, so a linear search is the fastest.
+	size_t i = 0;
+	while( i < mTracked.size() && mTracked[i].Variable != variable )
+		++i;
+
+	assert(i < mTracked.size());
+	assert(mTracked[i].Offset + size <= mData.size());
+
+	Tracked& tracked = mTracked[i];
+	BYTE* copy = &mData[tracked.Offset];
+
+	if( tracked.Valid && memcmp(copy, data, size) == 0 )
+	{
+		++mSkippedUpdates;
+		return false;
+	}
+
+	memcpy(copy, data, size);
+	tracked.Valid = true;
+
+	mDirty = true;
+	++mVersion;
+
+	return true;
+}
+
+bool ConstantBufferShadow::IsDirty()const
+{
+	return mDirty;
+}
+
+UINT ConstantBufferShadow::GetVersion()const
+{
+	return mVersion;
+}
+
+UINT ConstantBufferShadow::GetSize()const
+{
+	return (UINT)mData.size();
+}
+
+UINT ConstantBufferShadow::Commit()
+{
+	if( !mDirty )
+		return 0;
+
+	mDirty = false;
+
+	return (UINT)mData.size();
+}
+
+UINT ConstantBufferShadow::GetSkippedUpdates()const
+{
+	return mSkippedUpdates;
+}
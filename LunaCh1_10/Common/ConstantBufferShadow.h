@@ -0,0 +1,72 @@
+//***************************************************************************************
+// ConstantBufferShadow.h
+//
+// CPU copy of one constant buffer of an effect, used to skip redundant updates.
+//   -Update() compares a variable's new value with the copy and returns false if it
+//    is unchanged, so the caller does not touch the effect variable.  The effect
+//    framework only uploads buffers whose variables were set, so an unchanged
+//    buffer costs nothing at Apply time.
+//   -A changed value marks the buffer dirty and bumps its version.  Commit(),
+//    called when a pass is applied, clears the dirty flag and returns the bytes
+//    the framework uploads for it (the whole buffer).
+//
+// Effects split their constants into buffers by update frequency (per frame, per
+// material, per object) so a change only uploads its own buffer; see BasicEffect.
+//***************************************************************************************
+
+#ifndef CONSTANTBUFFERSHADOW_H
+#define CONSTANTBUFFERSHADOW_H
+
+#include "d3dUtil.h"
+
+class ConstantBufferShadow
+{
+public:
+	ConstantBufferShadow();
+
+	///<summary>
+	/// Finds the named constant buffer of the effect and sizes the copy to match.
+	///</summary>
+	void Init(ID3DX11Effect* fx, const char* name);
+
+	///<summary>
+	/// Registers a variable of the buffer; only registered variables can be
+	/// updated.
+	///</summary>
+	void Track(ID3DX11EffectVariable* variable);
+
+	///<summary>
+	/// Stores the value if it differs from the copy and returns whether it did.
+	///</summary>
+	bool Update(ID3DX11EffectVariable* variable, const void* data, UINT size);
+
+	bool IsDirty()const;
+	UINT GetVersion()const;
+	UINT GetSize()const;
+
+	// Returns the bytes uploaded for this buffer by the pass being applied.
+	UINT Commit();
+
+	// Updates skipped because the value was already set.
+	UINT GetSkippedUpdates()const;
+
+private:
+	struct Tracked
+	{
+		ID3DX11EffectVariable* Variable;
+		UINT Offset;
+
+		// The copy holds nothing until the variable is first set.
+		bool Valid;
+	};
+
+	ID3DX11EffectConstantBuffer* mBuffer;
+	std::vector<Tracked> mTracked;
+	std::vector<BYTE> mData;
+
+	bool mDirty;
+	UINT mVersion;
+	UINT mSkippedUpdates;
+};
+
+#endif // CONSTANTBUFFERSHADOW_H
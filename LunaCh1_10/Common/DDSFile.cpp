@@ -0,0 +1,720 @@
+//***************************************************************************************
+// DDSFile.cpp
+//***************************************************************************************
+
+#include "DDSFile.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// DDS file layout, see "DDS" in the DirectX documentation.
+//
+
+namespace
+{
+	const uint32_t DDPF_ALPHAPIXELS = 0x00000001;
+	const uint32_t DDPF_ALPHA       = 0x00000002;
+	const uint32_t DDPF_FOURCC      = 0x00000004;
+	const uint32_t DDPF_RGB         = 0x00000040;
+	const uint32_t DDPF_LUMINANCE   = 0x00020000;
+
+	const uint32_t DDSD_CAPS        = 0x00000001;
+	const uint32_t DDSD_HEIGHT      = 0x00000002;
+	const uint32_t DDSD_WIDTH       = 0x00000004;
+	const uint32_t DDSD_PITCH       = 0x00000008;
+	const uint32_t DDSD_PIXELFORMAT = 0x00001000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x00020000;
+	const uint32_t DDSD_LINEARSIZE  = 0x00080000;
+	const uint32_t DDSD_DEPTH       = 0x00800000;
+
+	const uint32_t DDSCAPS_COMPLEX  = 0x00000008;
+	const uint32_t DDSCAPS_TEXTURE  = 0x00001000;
+	const uint32_t DDSCAPS_MIPMAP   = 0x00400000;
+
+	const uint32_t DDSCAPS2_CUBEMAP          = 0x00000200;
+	const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0x0000FC00;
+	const uint32_t DDSCAPS2_VOLUME           = 0x00200000;
+
+	const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+	// D3D11 resource limits.
+	const uint32_t MaxTexture1DSize = 16384;
+	const uint32_t MaxTexture2DSize = 16384;
+	const uint32_t MaxTexture3DSize = 2048;
+	const uint32_t MaxArraySize     = 2048;
+
+	struct DDS_PIXELFORMAT
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct DDS_HEADER
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t Reserved1[11];
+		DDS_PIXELFORMAT PixelFormat;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct DDS_HEADER_DXT10
+	{
+		uint32_t DxgiFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	// The DXGI_FORMAT values the legacy header maps to, so no DXGI header is needed.
+	enum LegacyFormat
+	{
+		FormatUnknown              = 0,
+		FormatR32G32B32A32Float    = 2,
+		FormatR16G16B16A16Float    = 10,
+		FormatR16G16B16A16UNorm    = 11,
+		FormatR32G32Float          = 16,
+		FormatR10G10B10A2UNorm     = 24,
+		FormatR8G8B8A8UNorm        = 28,
+		FormatR16G16Float          = 34,
+		FormatR16G16UNorm          = 35,
+		FormatR32Float             = 41,
+		FormatR8G8UNorm            = 49,
+		FormatR16Float             = 54,
+		FormatR16UNorm             = 56,
+		FormatR8UNorm              = 61,
+		FormatA8UNorm              = 65,
+		FormatBC1UNorm             = 71,
+		FormatBC2UNorm             = 74,
+		FormatBC3UNorm             = 77,
+		FormatBC4UNorm             = 80,
+		FormatBC4SNorm             = 81,
+		FormatBC5UNorm             = 83,
+		FormatBC5SNorm             = 84,
+		FormatB5G6R5UNorm          = 85,
+		FormatB5G5R5A1UNorm        = 86,
+		FormatB8G8R8A8UNorm        = 87,
+		FormatB8G8R8X8UNorm        = 88
+	};
+
+	uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+	}
+
+	bool IsBitMask(const DDS_PIXELFORMAT& pf, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return pf.RBitMask == r && pf.GBitMask == g && pf.BBitMask == b && pf.ABitMask == a;
+	}
+
+	uint32_t GetLegacyFormat(const DDS_PIXELFORMAT& pf)
+	{
+		if( pf.Flags & DDPF_FOURCC )
+		{
+			uint32_t cc = pf.FourCC;
+
+			if( cc == MakeFourCC('D','X','T','1') ) return FormatBC1UNorm;
+			if( cc == MakeFourCC('D','X','T','2') ) return FormatBC2UNorm;
+			if( cc == MakeFourCC('D','X','T','3') ) return FormatBC2UNorm;
+			if( cc == MakeFourCC('D','X','T','4') ) return FormatBC3UNorm;
+			if( cc == MakeFourCC('D','X','T','5') ) return FormatBC3UNorm;
+			if( cc == MakeFourCC('A','T','I','1') ) return FormatBC4UNorm;
+			if( cc == MakeFourCC('B','C','4','U') ) return FormatBC4UNorm;
+			if( cc == MakeFourCC('B','C','4','S') ) return FormatBC4SNorm;
+			if( cc == MakeFourCC('A','T','I','2') ) return FormatBC5UNorm;
+			if( cc == MakeFourCC('B','C','5','U') ) return FormatBC5UNorm;
+			if( cc == MakeFourCC('B','C','5','S') ) return FormatBC5SNorm;
+
+			// D3DFORMAT values stored as FourCC by D3DX.
+			switch( cc )
+			{
+			case 36:  return FormatR16G16B16A16UNorm;
+			case 111: return FormatR16Float;
+			case 112: return FormatR16G16Float;
+			case 113: return FormatR16G16B16A16Float;
+			case 114: return FormatR32Float;
+			case 115: return FormatR32G32Float;
+			case 116: return FormatR32G32B32A32Float;
+			}
+
+			return FormatUnknown;
+		}
+
+		if( pf.Flags & DDPF_RGB )
+		{
+			if( pf.RGBBitCount == 32 )
+			{
+				if( IsBitMask(pf, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000) ) return FormatR8G8B8A8UNorm;
+				if( IsBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000) ) return FormatB8G8R8A8UNorm;
+				if( IsBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000) ) return FormatB8G8R8X8UNorm;
+				if( IsBitMask(pf, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000) ) return FormatR10G10B10A2UNorm;
+				if( IsBitMask(pf, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000) ) return FormatR16G16UNorm;
+				if( IsBitMask(pf, 0xffffffff, 0x00000000, 0x00000000, 0x00000000) ) return FormatR32Float;
+			}
+			else if( pf.RGBBitCount == 16 )
+			{
+				if( IsBitMask(pf, 0xf800, 0x07e0, 0x001f, 0x0000) ) return FormatB5G6R5UNorm;
+				if( IsBitMask(pf, 0x7c00, 0x03e0, 0x001f, 0x8000) ) return FormatB5G5R5A1UNorm;
+			}
+
+			// 24 bit RGB has no DXGI equivalent.
+			return FormatUnknown;
+		}
+
+		if( pf.Flags & DDPF_LUMINANCE )
+		{
+			if( pf.RGBBitCount == 8 )
+				return FormatR8UNorm;
+			if( pf.RGBBitCount == 16 && (pf.Flags & DDPF_ALPHAPIXELS) )
+				return FormatR8G8UNorm;
+			if( pf.RGBBitCount == 16 )
+				return FormatR16UNorm;
+
+			return FormatUnknown;
+		}
+
+		if( (pf.Flags & DDPF_ALPHA) && pf.RGBBitCount == 8 )
+			return FormatA8UNorm;
+
+		return FormatUnknown;
+	}
+
+	bool SetError(std::string* error, const char* message)
+	{
+		if( error )
+			*error = message;
+
+		return false;
+	}
+}
+
+DDSFile::Description::Description()
+	: Width(0),
+	  Height(0),
+	  Depth(0),
+	  MipLevels(0),
+	  ArraySize(0),
+	  Format(0),
+	  ResourceDimension(DimensionUnknown),
+	  IsCubemap(false)
+{
+}
+
+DDSFile::DDSFile()
+	:
+#ifdef _WIN32
+	  mFile(INVALID_HANDLE_VALUE),
+	  mMapping(0),
+#else
+	  mFile(-1),
+#endif
+	  mMapped(false),
+	  mData(0),
+	  mSize(0),
+	  mDataOffset(0),
+	  mDataSize(0)
+{
+}
+
+DDSFile::~DDSFile()
+{
+	Close();
+}
+
+bool DDSFile::Open(const std::string& filename)
+{
+	Close();
+
+#ifdef _WIN32
+	mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if( mFile == INVALID_HANDLE_VALUE )
+		return Fail("can't open the file");
+#else
+	mFile = open(filename.c_str(), O_RDONLY);
+	if( mFile < 0 )
+		return Fail("can't open the file");
+#endif
+
+	return MapFile();
+}
+
+#ifdef _WIN32
+bool DDSFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if( mFile == INVALID_HANDLE_VALUE )
+		return Fail("can't open the file");
+
+	return MapFile();
+}
+#endif
+
+bool DDSFile::MapFile()
+{
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx(mFile, &fileSize) || fileSize.QuadPart == 0 || (uint64_t)fileSize.QuadPart > (size_t)-1 )
+		return Fail("can't map an empty or oversized file");
+
+	mMapping = CreateFileMappingW(mFile, 0, PAGE_READONLY, 0, 0, 0);
+	if( mMapping == 0 )
+		return Fail("can't map the file");
+
+	mData = (const uint8_t*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	mSize = (size_t)fileSize.QuadPart;
+#else
+	struct stat info;
+	if( fstat(mFile, &info) != 0 || info.st_size <= 0 )
+		return Fail("can't map an empty file");
+
+	void* view = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, mFile, 0);
+	mData = view != MAP_FAILED ? (const uint8_t*)view : 0;
+	mSize = (size_t)info.st_size;
+#endif
+
+	if( mData == 0 )
+		return Fail("can't map the file");
+
+	mMapped = true;
+
+	std::string error;
+	if( !ParseHeader(mData, mSize, mDesc, mDataOffset, &error) )
+		return Fail(error);
+
+	return BuildSubresources();
+}
+
+bool DDSFile::Parse(const uint8_t* data, size_t size)
+{
+	Close();
+
+	mData = data;
+	mSize = size;
+
+	std::string error;
+	if( !ParseHeader(mData, mSize, mDesc, mDataOffset, &error) )
+		return Fail(error);
+
+	return BuildSubresources();
+}
+
+void DDSFile::Close()
+{
+#ifdef _WIN32
+	if( mMapped )
+		UnmapViewOfFile(mData);
+	if( mMapping != 0 )
+		CloseHandle(mMapping);
+	if( mFile != INVALID_HANDLE_VALUE )
+		CloseHandle(mFile);
+
+	mFile = INVALID_HANDLE_VALUE;
+	mMapping = 0;
+#else
+	if( mMapped )
+		munmap((void*)mData, mSize);
+	if( mFile >= 0 )
+		close(mFile);
+
+	mFile = -1;
+#endif
+
+	mMapped = false;
+	mData = 0;
+	mSize = 0;
+	mDataOffset = 0;
+	mDataSize = 0;
+	mDesc = Description();
+	mSubresources.clear();
+	mError.clear();
+}
+
+bool DDSFile::Fail(const std::string& error)
+{
+	Close();
+	mError = error;
+
+	return false;
+}
+
+bool DDSFile::IsOpen()const
+{
+	return !mSubresources.empty();
+}
+
+const std::string& DDSFile::GetError()const
+{
+	return mError;
+}
+
+const DDSFile::Description& DDSFile::GetDesc()const
+{
+	return mDesc;
+}
+
+const uint8_t* DDSFile::GetData()const
+{
+	return mData;
+}
+
+size_t DDSFile::GetSize()const
+{
+	return mSize;
+}
+
+uint64_t DDSFile::GetDataSize()const
+{
+	return mDataSize;
+}
+
+uint32_t DDSFile::GetItemCount()const
+{
+	return mDesc.ArraySize * (mDesc.IsCubemap ? 6 : 1);
+}
+
+uint32_t DDSFile::GetSubresourceCount()const
+{
+	return (uint32_t)mSubresources.size();
+}
+
+const DDSFile::Subresource& DDSFile::GetSubresource(uint32_t index)const
+{
+	return mSubresources[index];
+}
+
+const DDSFile::Subresource& DDSFile::GetSubresource(uint32_t mip, uint32_t item)const
+{
+	return mSubresources[item*mDesc.MipLevels + mip];
+}
+
+void DDSFile::Prefetch()const
+{
+	// volatile keeps the reads from being optimized away.
+	const volatile uint8_t* data = mData;
+
+	uint8_t sum = 0;
+	for(size_t i = 0; i < mSize; i += 4096)
+		sum ^= data[i];
+
+	(void)sum;
+}
+
+bool DDSFile::BuildSubresources()
+{
+	mSubresources.clear();
+
+	uint64_t offset = mDataOffset;
+
+	for(uint32_t item = 0; item < GetItemCount(); ++item)
+	{
+		uint32_t w = mDesc.Width;
+		uint32_t h = mDesc.Height;
+		uint32_t d = mDesc.Depth;
+
+		for(uint32_t mip = 0; mip < mDesc.MipLevels; ++mip)
+		{
+			uint32_t rowPitch, numRows;
+			GetSurfaceInfo(w, h, mDesc.Format, rowPitch, numRows);
+
+			Subresource sub;
+			sub.Offset     = offset;
+			sub.Width      = w;
+			sub.Height     = h;
+			sub.Depth      = d;
+			sub.RowPitch   = rowPitch;
+			sub.SlicePitch = rowPitch*numRows;
+			sub.Size       = (uint64_t)sub.SlicePitch*d;
+
+			if( offset + sub.Size > mSize )
+				return Fail("the file is shorter than its header says");
+
+			sub.Data = mData + (size_t)offset;
+			mSubresources.push_back(sub);
+
+			offset += sub.Size;
+
+			w = std::max(1u, w/2);
+			h = std::max(1u, h/2);
+			d = std::max(1u, d/2);
+		}
+	}
+
+	mDataSize = offset - mDataOffset;
+
+	return true;
+}
+
+bool DDSFile::ParseHeader(const uint8_t* data, size_t size, Description& desc, size_t& dataOffset, std::string* error)
+{
+	uint32_t magic;
+	if( size < sizeof(uint32_t) + sizeof(DDS_HEADER) )
+		return SetError(error, "too small for a DDS header");
+
+	memcpy(&magic, data, sizeof(magic));
+	if( magic != Magic )
+		return SetError(error, "not a DDS file");
+
+	DDS_HEADER header;
+	memcpy(&header, data + sizeof(uint32_t), sizeof(header));
+
+	if( header.Size != sizeof(DDS_HEADER) || header.PixelFormat.Size != sizeof(DDS_PIXELFORMAT) )
+		return SetError(error, "bad header size");
+
+	size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+	desc = Description();
+	desc.Width     = header.Width;
+	desc.Height    = std::max(header.Height, 1u);
+	desc.Depth     = 1;
+	desc.MipLevels = (header.Flags & DDSD_MIPMAPCOUNT) ? std::max(header.MipMapCount, 1u) : 1;
+	desc.ArraySize = 1;
+
+	if( (header.PixelFormat.Flags & DDPF_FOURCC) && header.PixelFormat.FourCC == MakeFourCC('D','X','1','0') )
+	{
+		if( size < offset + sizeof(DDS_HEADER_DXT10) )
+			return SetError(error, "too small for a DX10 header");
+
+		DDS_HEADER_DXT10 dx10;
+		memcpy(&dx10, data + offset, sizeof(dx10));
+		offset += sizeof(DDS_HEADER_DXT10);
+
+		desc.Format    = dx10.DxgiFormat;
+		desc.ArraySize = dx10.ArraySize;
+
+		switch( dx10.ResourceDimension )
+		{
+		case Dimension1D:
+			desc.Height = 1;
+			break;
+
+		case Dimension2D:
+			desc.IsCubemap = (dx10.MiscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+			break;
+
+		case Dimension3D:
+			if( !(header.Flags & DDSD_DEPTH) )
+				return SetError(error, "volume texture without a depth");
+
+			desc.Depth = header.Depth;
+			break;
+
+		default:
+			return SetError(error, "unknown resource dimension");
+		}
+
+		desc.ResourceDimension = (Dimension)dx10.ResourceDimension;
+	}
+	else
+	{
+		desc.Format = GetLegacyFormat(header.PixelFormat);
+		desc.ResourceDimension = Dimension2D;
+
+		if( header.Caps2 & DDSCAPS2_CUBEMAP )
+		{
+			// Direct3D 10 and later need all six faces.
+			if( (header.Caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES )
+				return SetError(error, "cube map without all six faces");
+
+			desc.IsCubemap = true;
+		}
+		else if( (header.Caps2 & DDSCAPS2_VOLUME) && (header.Flags & DDSD_DEPTH) )
+		{
+			desc.ResourceDimension = Dimension3D;
+			desc.Depth = header.Depth;
+		}
+	}
+
+	//
+	// Validate against what Direct3D 11 can create.
+	//
+
+	uint32_t rowPitch, numRows;
+	if( !GetSurfaceInfo(1, 1, desc.Format, rowPitch, numRows) )
+		return SetError(error, "unsupported format");
+
+	if( desc.Width == 0 || desc.Depth == 0 || desc.ArraySize == 0 )
+		return SetError(error, "empty texture");
+
+	uint32_t maxSize = std::max(std::max(desc.Width, desc.Height), desc.Depth);
+
+	uint32_t maxLevels = 1;
+	for(uint32_t s = maxSize; s > 1; s /= 2)
+		++maxLevels;
+
+	if( desc.MipLevels > maxLevels )
+		return SetError(error, "more mip levels than the size allows");
+
+	switch( desc.ResourceDimension )
+	{
+	case Dimension1D:
+		if( desc.Width > MaxTexture1DSize || desc.ArraySize > MaxArraySize )
+			return SetError(error, "too large for a 1D texture");
+		break;
+
+	case Dimension2D:
+		if( desc.IsCubemap && desc.Width != desc.Height )
+			return SetError(error, "cube map faces are not square");
+		if( desc.Width > MaxTexture2DSize || desc.Height > MaxTexture2DSize ||
+			(uint64_t)desc.ArraySize*(desc.IsCubemap ? 6 : 1) > MaxArraySize )
+			return SetError(error, "too large for a 2D texture");
+		break;
+
+	case Dimension3D:
+		if( desc.ArraySize != 1 )
+			return SetError(error, "volume texture arrays are not supported");
+		if( desc.Width > MaxTexture3DSize || desc.Height > MaxTexture3DSize || desc.Depth > MaxTexture3DSize )
+			return SetError(error, "too large for a volume texture");
+		break;
+
+	default:
+		break;
+	}
+
+	// Block compressed textures need whole blocks at the top level.
+	if( GetBlockBytes(desc.Format) > 0 && (desc.Width % 4 != 0 || desc.Height % 4 != 0) )
+		return SetError(error, "block compressed size is not a multiple of 4");
+
+	dataOffset = offset;
+
+	return true;
+}
+
+void DDSFile::WriteHeader(const Description& desc, std::vector<uint8_t>& bytes)
+{
+	uint32_t rowPitch = 0;
+	uint32_t numRows = 0;
+	GetSurfaceInfo(desc.Width, desc.Height, desc.Format, rowPitch, numRows);
+
+	DDS_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.Size        = sizeof(DDS_HEADER);
+	header.Flags       = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+	header.Height      = desc.Height;
+	header.Width       = desc.Width;
+	header.MipMapCount = desc.MipLevels;
+	header.Caps        = DDSCAPS_TEXTURE;
+
+	if( GetBlockBytes(desc.Format) > 0 )
+	{
+		header.Flags |= DDSD_LINEARSIZE;
+		header.PitchOrLinearSize = rowPitch*numRows;
+	}
+	else
+	{
+		header.Flags |= DDSD_PITCH;
+		header.PitchOrLinearSize = rowPitch;
+	}
+
+	if( desc.MipLevels > 1 )
+		header.Caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	if( desc.ResourceDimension == Dimension3D )
+	{
+		header.Flags |= DDSD_DEPTH;
+		header.Depth  = desc.Depth;
+		header.Caps2 |= DDSCAPS2_VOLUME;
+	}
+	else if( desc.IsCubemap )
+	{
+		header.Caps  |= DDSCAPS_COMPLEX;
+		header.Caps2 |= DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+	}
+
+	header.PixelFormat.Size   = sizeof(DDS_PIXELFORMAT);
+	header.PixelFormat.Flags  = DDPF_FOURCC;
+	header.PixelFormat.FourCC = MakeFourCC('D','X','1','0');
+
+	DDS_HEADER_DXT10 dx10;
+	memset(&dx10, 0, sizeof(dx10));
+	dx10.DxgiFormat        = desc.Format;
+	dx10.ResourceDimension = desc.ResourceDimension != DimensionUnknown ? desc.ResourceDimension : Dimension2D;
+	dx10.MiscFlag          = desc.IsCubemap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+	dx10.ArraySize         = desc.ArraySize;
+
+	uint32_t magic = Magic;
+
+	bytes.clear();
+	bytes.insert(bytes.end(), (const uint8_t*)&magic, (const uint8_t*)(&magic + 1));
+	bytes.insert(bytes.end(), (const uint8_t*)&header, (const uint8_t*)(&header + 1));
+	bytes.insert(bytes.end(), (const uint8_t*)&dx10, (const uint8_t*)(&dx10 + 1));
+}
+
+bool DDSFile::GetSurfaceInfo(uint32_t width, uint32_t height, uint32_t format, uint32_t& rowPitch, uint32_t& numRows)
+{
+	uint32_t blockBytes = GetBlockBytes(format);
+	if( blockBytes > 0 )
+	{
+		rowPitch = std::max(1u, (width + 3)/4) * blockBytes;
+		numRows  = std::max(1u, (height + 3)/4);
+		return true;
+	}
+
+	uint32_t bpp = GetBitsPerPixel(format);
+	if( bpp > 0 )
+	{
+		rowPitch = (width*bpp + 7)/8;
+		numRows  = height;
+		return true;
+	}
+
+	return false;
+}
+
+uint32_t DDSFile::GetBlockBytes(uint32_t format)
+{
+	// BC1 and BC4, then BC2, BC3, BC5, BC6H and BC7 (TYPELESS through the
+	// UNORM/SNORM/SRGB variants of each).
+	if( (format >= 70 && format <= 72) || (format >= 79 && format <= 81) )
+		return 8;
+
+	if( (format >= 73 && format <= 78) || (format >= 82 && format <= 84) || (format >= 94 && format <= 99) )
+		return 16;
+
+	return 0;
+}
+
+uint32_t DDSFile::GetBitsPerPixel(uint32_t format)
+{
+	// Ranges of DXGI_FORMAT values sharing a texel size, see dxgiformat.h.
+	if( format >= 1  && format <= 4  ) return 128; // R32G32B32A32
+	if( format >= 5  && format <= 8  ) return 96;  // R32G32B32
+	if( format >= 9  && format <= 22 ) return 64;  // R16G16B16A16, R32G32, R32G8X24
+	if( format >= 23 && format <= 47 ) return 32;  // R10G10B10A2 through R24G8
+	if( format >= 48 && format <= 59 ) return 16;  // R8G8, R16
+	if( format >= 60 && format <= 65 ) return 8;   // R8, A8
+	if( format == 67 )                 return 32;  // R9G9B9E5_SHAREDEXP
+	if( format >= 85 && format <= 86 ) return 16;  // B5G6R5, B5G5R5A1
+	if( format >= 87 && format <= 93 ) return 32;  // B8G8R8A8, B8G8R8X8
+
+	return 0;
+}
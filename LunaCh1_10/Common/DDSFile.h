@@ -0,0 +1,173 @@
+//***************************************************************************************
+// DDSFile.h
+//
+// Reads DDS files without D3DX and without copying them.
+//   -Open() maps the file into memory and validates its header and size.  Every
+//    subresource is then a pointer into the mapping plus its pitches, ready to be
+//    passed as D3D11_SUBRESOURCE_DATA (see TextureDecoder::CreateSRV()).
+//   -Handles legacy and DX10 headers, mip chains, 1D, 2D and volume textures,
+//    texture arrays and cube maps (and cube map arrays).
+//   -Formats are DXGI_FORMAT values kept as plain integers, and the file is mapped
+//    with POSIX calls outside Windows, so tools and tests can inspect textures
+//    on any platform.
+//
+// Subresources are ordered as D3D11CalcSubresource() expects: array element major
+// (six faces per element for cube maps), then mip level.
+//***************************************************************************************
+
+#ifndef DDSFILE_H
+#define DDSFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class DDSFile
+{
+public:
+	// Values of D3D11_RESOURCE_DIMENSION.
+	enum Dimension
+	{
+		DimensionUnknown = 0,
+		Dimension1D = 2,
+		Dimension2D = 3,
+		Dimension3D = 4
+	};
+
+	struct Description
+	{
+		Description();
+
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+		uint32_t MipLevels;
+
+		// Array elements; each element of a cube map is six faces.
+		uint32_t ArraySize;
+
+		// A DXGI_FORMAT value.
+		uint32_t Format;
+
+		Dimension ResourceDimension;
+		bool IsCubemap;
+	};
+
+	struct Subresource
+	{
+		const uint8_t* Data;
+
+		// From the start of the file.
+		uint64_t Offset;
+
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+
+		// Bytes per row (of blocks for compressed formats), per depth slice, and
+		// for the whole subresource.
+		uint32_t RowPitch;
+		uint32_t SlicePitch;
+		uint64_t Size;
+	};
+
+	static const uint32_t Magic = 0x20534444; // "DDS "
+
+public:
+	DDSFile();
+	~DDSFile();
+
+	bool Open(const std::string& filename);
+#ifdef _WIN32
+	bool Open(const std::wstring& filename);
+#endif
+
+	///<summary>
+	/// Reads a DDS image that is already in memory.  The memory is not copied and
+	/// must outlive the object.
+	///</summary>
+	bool Parse(const uint8_t* data, size_t size);
+
+	void Close();
+
+	bool IsOpen()const;
+
+	// Why the last Open() or Parse() failed.
+	const std::string& GetError()const;
+
+	const Description& GetDesc()const;
+
+	// The whole file, and the bytes of all subresources.
+	const uint8_t* GetData()const;
+	size_t GetSize()const;
+	uint64_t GetDataSize()const;
+
+	// Array elements times faces.
+	uint32_t GetItemCount()const;
+
+	uint32_t GetSubresourceCount()const;
+	const Subresource& GetSubresource(uint32_t index)const;
+	const Subresource& GetSubresource(uint32_t mip, uint32_t item)const;
+
+	///<summary>
+	/// Touches every page of the mapping, so a loader thread can take the page
+	/// faults instead of the thread that creates the texture.
+	///</summary>
+	void Prefetch()const;
+
+	///<summary>
+	/// Reads the description from the start of a DDS file.  Only the header has to be
+	/// present; dataOffset receives where the subresources start.
+	///</summary>
+	static bool ParseHeader(const uint8_t* data, size_t size, Description& desc, size_t& dataOffset,
+		std::string* error = 0);
+
+	///<summary>
+	/// Writes a DDS header with a DX10 extension for the description.  The
+	/// subresources follow it in the file.
+	///</summary>
+	static void WriteHeader(const Description& desc, std::vector<uint8_t>& bytes);
+
+	///<summary>
+	/// Row pitch and number of rows (block rows for compressed formats) of a surface.
+	/// Returns false for formats with no fixed texel size.
+	///</summary>
+	static bool GetSurfaceInfo(uint32_t width, uint32_t height, uint32_t format, uint32_t& rowPitch, uint32_t& numRows);
+
+	// Bytes per 4x4 block of compressed formats, 0 for others.
+	static uint32_t GetBlockBytes(uint32_t format);
+
+	// Bits per texel of uncompressed formats, 0 for others.
+	static uint32_t GetBitsPerPixel(uint32_t format);
+
+private:
+	bool MapFile();
+	bool Fail(const std::string& error);
+	bool BuildSubresources();
+
+private:
+	DDSFile(const DDSFile& rhs);
+	DDSFile& operator=(const DDSFile& rhs);
+
+private:
+#ifdef _WIN32
+	void* mFile;
+	void* mMapping;
+#else
+	int mFile;
+#endif
+	bool mMapped;
+
+	const uint8_t* mData;
+	size_t mSize;
+	size_t mDataOffset;
+
+	Description mDesc;
+	std::vector<Subresource> mSubresources;
+	uint64_t mDataSize;
+
+	std::string mError;
+};
+
+#endif // DDSFILE_H
@@ -0,0 +1,287 @@
+//***************************************************************************************
+// Flipbook.cpp
+//***************************************************************************************
+
+#include "Flipbook.h"
+#include "MemoryTracker.h"
+
+namespace
+{
+	UINT RoundUp(UINT value, UINT multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+}
+
+Flipbook::CookOptions::CookOptions()
+	: FramesPerSecond(30.0f),
+	  Padding(4),
+	  MipLevels(0),
+	  Compress(true),
+	  CompressedFormat(BCEncoder::FormatBC1),
+	  CompressedQuality(BCEncoder::QualityNormal),
+	  NumThreads(0)
+{
+}
+
+Flipbook::Flipbook()
+	: mSRV(0), mTextureBytes(0), mFramesPerSecond(0.0f)
+{
+}
+
+Flipbook::~Flipbook()
+{
+	MemoryTracker::Free(MemoryTracker::Textures, (size_t)mTextureBytes);
+	ReleaseCOM(mSRV);
+}
+
+bool Flipbook::Cook(const std::vector<std::wstring>& frameFiles, const std::wstring& filename,
+	const CookOptions& options)
+{
+	UINT numFrames = (UINT)frameFiles.size();
+	if( numFrames == 0 )
+		return false;
+
+	//
+	// Decode the frames.  Reading and decoding dominate for long sequences of
+	// small files, so they are spread over threads.
+	//
+
+	std::vector<DecodedTexture> frames;
+	if( !TextureDecoder::DecodeFiles(frameFiles, frames, options.NumThreads) )
+		return false;
+
+	UINT frameW = frames[0].Width;
+	UINT frameH = frames[0].Height;
+
+	for(UINT i = 0; i < numFrames; ++i)
+	{
+		if( frames[i].Format != DXGI_FORMAT_R8G8B8A8_UNORM ||
+			frames[i].MipLevels != 1 || frames[i].ArraySize != 1 ||
+			frames[i].Width != frameW || frames[i].Height != frameH )
+			return false;
+	}
+
+	//
+	// Lay the frames out in a grid.  Each mip halves the padding, so stop once it
+	// would drop below a texel.  Cells are sized so cell borders land on whole texels
+	// in every mip (and on whole blocks if compressed).
+	//
+
+	UINT maxMips = 1;
+	while( (options.Padding >> (maxMips-1)) > 1 )
+		++maxMips;
+
+	UINT mipLevels = options.MipLevels > 0 ? MathHelper::Min(options.MipLevels, maxMips) : maxMips;
+
+	UINT align = 1 << (mipLevels-1);
+	if( options.Compress )
+		align = MathHelper::Max(align, 4u);
+
+	UINT pad   = options.Padding;
+	UINT cellW = RoundUp(frameW + 2*pad, align);
+	UINT cellH = RoundUp(frameH + 2*pad, align);
+
+	UINT cols = (UINT)ceilf(sqrtf((float)numFrames));
+	UINT rows = (numFrames + cols - 1) / cols;
+
+	DecodedTexture atlas;
+	atlas.Width     = cols*cellW;
+	atlas.Height    = rows*cellH;
+	atlas.MipLevels = 1;
+	atlas.ArraySize = 1;
+	atlas.Format    = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	if( atlas.Width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || atlas.Height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION )
+		return false;
+
+	UINT atlasPitch = atlas.Width*4;
+	atlas.Data.assign(atlasPitch*atlas.Height, 0);
+
+	DecodedTexture::Subresource top;
+	top.Offset     = 0;
+	top.RowPitch   = atlasPitch;
+	top.SlicePitch = atlasPitch*atlas.Height;
+	atlas.Subresources.push_back(top);
+
+	std::vector<XMFLOAT4> rects(numFrames);
+
+	for(UINT i = 0; i < numFrames; ++i)
+	{
+		UINT cellX = (i % cols)*cellW;
+		UINT cellY = (i / cols)*cellH;
+
+		// Copy the frame into its cell, extending its edges into the padding.
+		const BYTE* src = &frames[i].Data[0];
+		UINT srcPitch = frames[i].Subresources[0].RowPitch;
+
+		for(UINT y = 0; y < cellH; ++y)
+		{
+			UINT srcY = (UINT)MathHelper::Clamp((int)y - (int)pad, 0, (int)frameH-1);
+			BYTE* dst = &atlas.Data[(cellY + y)*atlasPitch + cellX*4];
+
+			for(UINT x = 0; x < cellW; ++x)
+			{
+				UINT srcX = (UINT)MathHelper::Clamp((int)x - (int)pad, 0, (int)frameW-1);
+				*(UINT*)(dst + x*4) = *(const UINT*)(src + srcY*srcPitch + srcX*4);
+			}
+		}
+
+		rects[i] = XMFLOAT4(
+			(float)(cellX + pad) / atlas.Width,
+			(float)(cellY + pad) / atlas.Height,
+			(float)frameW / atlas.Width,
+			(float)frameH / atlas.Height);
+	}
+
+	// The frames are not needed anymore and can be large.
+	std::vector<DecodedTexture>().swap(frames);
+
+	// A box filter stays within the padding; wider filters would pick up neighbors.
+	MipGenerator::Options mipOptions;
+	mipOptions.MipFilter = MipGenerator::FilterBox;
+	mipOptions.MaxLevels = mipLevels;
+
+	if( mipLevels > 1 && !TextureDecoder::GenerateMips(atlas, mipOptions) )
+		return false;
+
+	if( options.Compress && !TextureDecoder::Compress(atlas, options.CompressedFormat, options.CompressedQuality) )
+		return false;
+
+	std::vector<BYTE> dds;
+	if( !TextureDecoder::EncodeDDS(atlas, dds) )
+		return false;
+
+	//
+	// Write the file.  The texture is 16 byte aligned within it.
+	//
+
+	FlipbookFileHeader header;
+	ZeroMemory(&header, sizeof(header));
+	header.Magic           = FlipbookFileHeader::FileMagic;
+	header.Version         = FlipbookFileHeader::FileVersion;
+	header.NumFrames       = numFrames;
+	header.FramesPerSecond = options.FramesPerSecond;
+	header.FramesOffset    = sizeof(FlipbookFileHeader);
+	header.TextureOffset   = RoundUp((UINT)(header.FramesOffset + numFrames*sizeof(XMFLOAT4)), 16);
+	header.TextureSize     = dds.size();
+
+	std::ofstream fout(filename.c_str(), std::ios_base::binary);
+	if( !fout )
+		return false;
+
+	BYTE zeros[16] = {0};
+	UINT alignBytes = (UINT)(header.TextureOffset - header.FramesOffset - numFrames*sizeof(XMFLOAT4));
+
+	fout.write((const char*)&header, sizeof(header));
+	fout.write((const char*)&rects[0], numFrames*sizeof(XMFLOAT4));
+	fout.write((const char*)zeros, alignBytes);
+	fout.write((const char*)&dds[0], dds.size());
+
+	return !fout.fail();
+}
+
+bool Flipbook::Load(ID3D11Device* device, const std::wstring& filename)
+{
+	MemoryTracker::Free(MemoryTracker::Textures, (size_t)mTextureBytes);
+	mTextureBytes = 0;
+
+	ReleaseCOM(mSRV);
+	mFrames.clear();
+
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = 0;
+	GetFileSizeEx(file, &fileSize);
+
+	// The texture is created straight from the mapped view, without an intermediate
+	// copy of the file.
+	HANDLE mapping = fileSize.QuadPart > 0 ? CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0) : 0;
+	const BYTE* view = mapping != 0 ? (const BYTE*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+
+	bool loaded = view != 0 && LoadFromMemory(device, view, (UINT64)fileSize.QuadPart);
+
+	if( view != 0 )
+		UnmapViewOfFile(view);
+	if( mapping != 0 )
+		CloseHandle(mapping);
+	CloseHandle(file);
+
+	return loaded;
+}
+
+bool Flipbook::LoadFromMemory(ID3D11Device* device, const BYTE* data, UINT64 size)
+{
+	if( size < sizeof(FlipbookFileHeader) )
+		return false;
+
+	const FlipbookFileHeader* header = (const FlipbookFileHeader*)data;
+	if( header->Magic != FlipbookFileHeader::FileMagic || header->Version != FlipbookFileHeader::FileVersion ||
+		header->NumFrames == 0 ||
+		header->FramesOffset + header->NumFrames*sizeof(XMFLOAT4) > size ||
+		header->TextureOffset + header->TextureSize > size )
+		return false;
+
+	const BYTE* dds = data + header->TextureOffset;
+
+	DecodedTexture texture;
+	size_t dataOffset = 0;
+	if( !TextureDecoder::DecodeDDSHeader(dds, (size_t)header->TextureSize, texture, dataOffset) )
+		return false;
+
+	const DecodedTexture::Subresource& last = texture.Subresources.back();
+	if( dataOffset + last.Offset + last.SlicePitch > header->TextureSize )
+		return false;
+
+	mSRV = TextureDecoder::CreateSRV(device, texture, dds + dataOffset);
+	if( mSRV == 0 )
+		return false;
+
+	mTextureBytes = last.Offset + last.SlicePitch;
+	MemoryTracker::Allocate(MemoryTracker::Textures, (size_t)mTextureBytes);
+
+	const XMFLOAT4* rects = (const XMFLOAT4*)(data + header->FramesOffset);
+	mFrames.assign(rects, rects + header->NumFrames);
+	mFramesPerSecond = header->FramesPerSecond;
+
+	return true;
+}
+
+ID3D11ShaderResourceView* Flipbook::GetSRV()const
+{
+	return mSRV;
+}
+
+UINT Flipbook::GetFrameCount()const
+{
+	return (UINT)mFrames.size();
+}
+
+float Flipbook::GetFramesPerSecond()const
+{
+	return mFramesPerSecond;
+}
+
+UINT Flipbook::GetFrame(float time)const
+{
+	if( mFrames.empty() )
+		return 0;
+
+	return (UINT)(MathHelper::Max(time, 0.0f)*mFramesPerSecond) % (UINT)mFrames.size();
+}
+
+const XMFLOAT4& Flipbook::GetFrameRect(UINT frame)const
+{
+	return mFrames[frame];
+}
+
+XMMATRIX Flipbook::GetFrameTransform(UINT frame)const
+{
+	const XMFLOAT4& rect = mFrames[frame];
+
+	return XMMatrixScaling(rect.z, rect.w, 1.0f) * XMMatrixTranslation(rect.x, rect.y, 0.0f);
+}
@@ -0,0 +1,105 @@
+//***************************************************************************************
+// Flipbook.h
+//
+// Packs the frames of an animated sprite sequence into one texture atlas so the
+// animation needs a single texture and a single load.
+//   -Cook() reads and decodes the frame files on worker threads, lays the frames out
+//    in a grid with edge-extended padding, builds the mip chain and optionally block
+//    compresses the atlas.  The result is one file: a header, the UV rectangle of
+//    each frame and a DDS image of the atlas.
+//   -Load() maps the file and creates the texture straight from the mapped view.
+//   -Playback binds the atlas once; a frame is picked by the texture transform
+//    returned by GetFrameTransform(), which maps [0,1]^2 onto the frame's rectangle.
+//
+// The padding keeps neighboring frames from bleeding into each other under bilinear
+// filtering and in the mips, so the number of mips is limited by it.
+//***************************************************************************************
+
+#ifndef FLIPBOOK_H
+#define FLIPBOOK_H
+
+#include "d3dUtil.h"
+#include "TextureDecoder.h"
+
+struct FlipbookFileHeader
+{
+	UINT Magic;
+	UINT Version;
+	UINT NumFrames;
+	float FramesPerSecond;
+	UINT64 FramesOffset;
+	UINT64 TextureOffset;
+	UINT64 TextureSize;
+
+	static const UINT FileMagic   = 0x50494C46; // 'FLIP'
+	static const UINT FileVersion = 1;
+};
+
+class Flipbook
+{
+public:
+	struct CookOptions
+	{
+		CookOptions();
+
+		float FramesPerSecond;
+
+		// Texels of padding around every frame.
+		UINT Padding;
+
+		// 0 makes as many mips as the padding allows.
+		UINT MipLevels;
+
+		bool Compress;
+		BCEncoder::Format CompressedFormat;
+		BCEncoder::Quality CompressedQuality;
+
+		// Jobs the files are decoded in, 0 makes each file a job and 1 decodes
+		// them on the calling thread.
+		UINT NumThreads;
+	};
+
+public:
+	Flipbook();
+	~Flipbook();
+
+	///<summary>
+	/// Packs the frame files, which must all have the same size, into filename.
+	/// Returns false if a frame can't be decoded or the file can't be written.
+	///</summary>
+	static bool Cook(const std::vector<std::wstring>& frameFiles, const std::wstring& filename,
+		const CookOptions& options);
+
+	bool Load(ID3D11Device* device, const std::wstring& filename);
+
+	ID3D11ShaderResourceView* GetSRV()const;
+
+	UINT GetFrameCount()const;
+	float GetFramesPerSecond()const;
+
+	// Frame shown at time seconds into a looping playback.
+	UINT GetFrame(float time)const;
+
+	// Atlas rectangle of the frame: x, y = top left uv, z, w = size in uv.
+	const XMFLOAT4& GetFrameRect(UINT frame)const;
+
+	XMMATRIX GetFrameTransform(UINT frame)const;
+
+private:
+	bool LoadFromMemory(ID3D11Device* device, const BYTE* data, UINT64 size);
+
+private:
+	Flipbook(const Flipbook& rhs);
+	Flipbook& operator=(const Flipbook& rhs);
+
+private:
+	ID3D11ShaderResourceView* mSRV;
+
+	// Size of the atlas texels, reported to MemoryTracker.
+	UINT64 mTextureBytes;
+
+	std::vector<XMFLOAT4> mFrames;
+	float mFramesPerSecond;
+};
+
+#endif // FLIPBOOK_H
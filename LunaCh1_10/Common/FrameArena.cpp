@@ -0,0 +1,221 @@
+//***************************************************************************************
+// FrameArena.cpp
+//***************************************************************************************
+
+#include "FrameArena.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+
+#if defined(_MSC_VER)
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+	THREAD_LOCAL FrameArena* gThreadArena = 0;
+
+	// Every thread's arena, for the totals and for deleting them.
+	std::mutex gArenasMutex;
+	std::vector<FrameArena*> gArenas;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+FrameArena::FrameArena(size_t capacity)
+	: mBlock(0), mCapacity(capacity), mOffset(0),
+	  mSpills(0), mNumSpills(0), mSpilledBytes(0),
+	  mFramePeak(0), mHighWater(0), mHeapAllocations(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	FreeSpills(0);
+	FreeBlock();
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	if( mBlock == 0 )
+	{
+		mBlock = new char[mCapacity];
+		MemoryTracker::Allocate(MemoryTracker::FrameArenas, mCapacity);
+	}
+
+	// new[] only guarantees the alignment of the fundamental types (8 bytes on
+	// 32-bit x86), less than an XMMATRIX needs, so align the address rather
+	// than the offset.
+	size_t base = reinterpret_cast<size_t>(mBlock);
+	size_t offset = AlignUp(base + mOffset, alignment) - base;
+
+	if( offset + size > mCapacity )
+		return Spill(size, alignment);
+
+	mOffset = offset + size;
+	NoteUsage();
+
+	return mBlock + offset;
+}
+
+void* FrameArena::Spill(size_t size, size_t alignment)
+{
+	// Over-allocate so the memory after the header can be aligned whatever
+	// address new[] returns.
+	char* memory = new char[sizeof(SpillBlock) + alignment - 1 + size];
+	MemoryTracker::Allocate(MemoryTracker::FrameArenas, size);
+
+	size_t address = AlignUp(reinterpret_cast<size_t>(memory + sizeof(SpillBlock)), alignment);
+
+	SpillBlock* spill = reinterpret_cast<SpillBlock*>(memory);
+	spill->Next = mSpills;
+	spill->Size = size;
+
+	mSpills = spill;
+	++mNumSpills;
+	mSpilledBytes += size;
+	++mHeapAllocations;
+
+	NoteUsage();
+
+	return reinterpret_cast<void*>(address);
+}
+
+void FrameArena::FreeSpills(uint32_t keep)
+{
+	while( mNumSpills > keep )
+	{
+		SpillBlock* spill = mSpills;
+		mSpills = spill->Next;
+
+		mSpilledBytes -= spill->Size;
+		--mNumSpills;
+
+		MemoryTracker::Free(MemoryTracker::FrameArenas, spill->Size);
+
+		delete[] reinterpret_cast<char*>(spill);
+	}
+}
+
+FrameArena::Marker FrameArena::GetMarker()const
+{
+	Marker marker;
+	marker.Offset    = mOffset;
+	marker.NumSpills = mNumSpills;
+
+	return marker;
+}
+
+void FrameArena::Rewind(const Marker& marker)
+{
+	assert(marker.Offset <= mOffset && marker.NumSpills <= mNumSpills);
+
+	FreeSpills(marker.NumSpills);
+	mOffset = marker.Offset;
+}
+
+void FrameArena::Reset()
+{
+	FreeSpills(0);
+	mOffset = 0;
+
+	// Grow with some slack so a frame a little larger does not spill again.
+	if( mFramePeak > mCapacity )
+	{
+		FreeBlock();
+		mCapacity = mFramePeak + mFramePeak/4;
+	}
+
+	mFramePeak = 0;
+}
+
+void FrameArena::FreeBlock()
+{
+	if( mBlock )
+		MemoryTracker::Free(MemoryTracker::FrameArenas, mCapacity);
+
+	delete[] mBlock;
+	mBlock = 0;
+}
+
+void FrameArena::NoteUsage()
+{
+	mFramePeak = std::max(mFramePeak, GetUsed());
+	mHighWater = std::max(mHighWater, mFramePeak);
+}
+
+size_t FrameArena::GetCapacity()const
+{
+	return mCapacity;
+}
+
+size_t FrameArena::GetUsed()const
+{
+	return mOffset + mSpilledBytes;
+}
+
+size_t FrameArena::GetHighWater()const
+{
+	return mHighWater;
+}
+
+uint32_t FrameArena::GetHeapAllocations()const
+{
+	return mHeapAllocations;
+}
+
+FrameArena& FrameArena::ForThread()
+{
+	if( gThreadArena == 0 )
+	{
+		gThreadArena = new FrameArena();
+
+		std::lock_guard<std::mutex> lock(gArenasMutex);
+		gArenas.push_back(gThreadArena);
+	}
+
+	return *gThreadArena;
+}
+
+size_t FrameArena::GetTotalHighWater()
+{
+	std::lock_guard<std::mutex> lock(gArenasMutex);
+
+	size_t total = 0;
+	for(size_t i = 0; i < gArenas.size(); ++i)
+		total += gArenas[i]->GetHighWater();
+
+	return total;
+}
+
+uint32_t FrameArena::GetTotalHeapAllocations()
+{
+	std::lock_guard<std::mutex> lock(gArenasMutex);
+
+	uint32_t total = 0;
+	for(size_t i = 0; i < gArenas.size(); ++i)
+		total += gArenas[i]->GetHeapAllocations();
+
+	return total;
+}
+
+void FrameArena::ReleaseAll()
+{
+	std::lock_guard<std::mutex> lock(gArenasMutex);
+
+	for(size_t i = 0; i < gArenas.size(); ++i)
+		delete gArenas[i];
+
+	gArenas.clear();
+
+	// Only the calling thread's pointer can be cleared; the others are gone.
+	gThreadArena = 0;
+}
@@ -0,0 +1,186 @@
+//***************************************************************************************
+// FrameArena.h
+//
+// A bump allocator for temporaries that live no longer than a frame.
+//   -Allocate() hands out the next aligned bytes of one block; nothing is freed on
+//    its own.  Reset() frees everything at once, and Rewind() frees everything
+//    allocated after a marker.
+//   -Each thread has its own arena (ForThread()), so allocating takes no lock.
+//    D3DApp resets the main thread's at the start of every frame and the render
+//    thread's before every pipelined frame.  JobSystem rewinds a thread's arena
+//    after each job, so a job's temporaries must not outlive the job.
+//   -When a frame needs more than the block, the rest comes from the heap and is
+//    counted.  The next Reset() grows the block to the frame's high-water mark,
+//    so once the frames settle they stop touching the heap.
+//   -FrameAllocator<T> lets the STL containers allocate from an arena.  Memory a
+//    container lets go of is not reused before the reset, so reserve() up front.
+//
+// Has no Windows dependencies, like the JobSystem that uses it.
+//***************************************************************************************
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+class FrameArena
+{
+public:
+	static const size_t DefaultCapacity = 256*1024;
+
+	// Where the arena was; Rewind() frees everything allocated after it.
+	struct Marker
+	{
+		size_t Offset;
+		uint32_t NumSpills;
+	};
+
+public:
+	// The block is allocated on first use.
+	explicit FrameArena(size_t capacity = DefaultCapacity);
+	~FrameArena();
+
+	void* Allocate(size_t size, size_t alignment);
+
+	template<class T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(count*sizeof(T), std::alignment_of<T>::value));
+	}
+
+	Marker GetMarker()const;
+	void Rewind(const Marker& marker);
+
+	///<summary>
+	/// Frees everything.  If the frame spilled onto the heap, the block grows to
+	/// hold the whole frame next time.
+	///</summary>
+	void Reset();
+
+	size_t GetCapacity()const;
+
+	// Bytes handed out since the last Reset().
+	size_t GetUsed()const;
+
+	// Most bytes any frame used, and heap allocations made for spills.
+	size_t GetHighWater()const;
+	uint32_t GetHeapAllocations()const;
+
+	///<summary>
+	/// The calling thread's arena, created on first use.
+	///</summary>
+	static FrameArena& ForThread();
+
+	// Totals over every thread's arena.
+	static size_t GetTotalHighWater();
+	static uint32_t GetTotalHeapAllocations();
+
+	///<summary>
+	/// Deletes every thread's arena.  No other thread may be using one.
+	///</summary>
+	static void ReleaseAll();
+
+private:
+	FrameArena(const FrameArena& rhs);
+	FrameArena& operator=(const FrameArena& rhs);
+
+	void* Spill(size_t size, size_t alignment);
+	void FreeSpills(uint32_t keep);
+	void FreeBlock();
+	void NoteUsage();
+
+private:
+	char* mBlock;
+	size_t mCapacity;
+	size_t mOffset;
+
+	// Heap allocations of this frame that did not fit, newest first.
+	struct SpillBlock
+	{
+		SpillBlock* Next;
+		size_t Size;
+	};
+
+	SpillBlock* mSpills;
+	uint32_t mNumSpills;
+	size_t mSpilledBytes;
+
+	// Most bytes used since the last Reset(), and by any frame.
+	size_t mFramePeak;
+	size_t mHighWater;
+	uint32_t mHeapAllocations;
+};
+
+//---------------------------------------------------------------------------------------
+// Allocates from a FrameArena, by default the calling thread's.  Deallocation does
+// nothing; the memory comes back at the arena's reset.
+//---------------------------------------------------------------------------------------
+
+template<class T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef FrameAllocator<U> other;
+	};
+
+	FrameAllocator() : mArena(&FrameArena::ForThread()) {}
+	explicit FrameAllocator(FrameArena& arena) : mArena(&arena) {}
+
+	template<class U>
+	FrameAllocator(const FrameAllocator<U>& rhs) : mArena(rhs.GetArena()) {}
+
+	T* allocate(size_t count)
+	{
+		return mArena->Allocate<T>(count);
+	}
+
+	void deallocate(T*, size_t) {}
+
+	size_t max_size()const
+	{
+		return ((size_t)-1) / sizeof(T);
+	}
+
+	FrameArena* GetArena()const
+	{
+		return mArena;
+	}
+
+private:
+	FrameArena* mArena;
+};
+
+template<class T, class U>
+bool operator==(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs)
+{
+	return lhs.GetArena() == rhs.GetArena();
+}
+
+template<class T, class U>
+bool operator!=(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs)
+{
+	return lhs.GetArena() != rhs.GetArena();
+}
+
+// A vector of frame temporaries: FrameVector<UINT>::Type counts(n);
+template<class T>
+struct FrameVector
+{
+	typedef std::vector<T, FrameAllocator<T> > Type;
+};
+
+#endif // FRAMEARENA_H
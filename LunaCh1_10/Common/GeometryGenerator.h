@@ -16,6 +16,7 @@
 #define GEOMETRYGENERATOR_H
 
 #include "d3dUtil.h"
+#include "MemoryTracker.h"
 
 class GeometryGenerator
 {
@@ -71,8 +72,8 @@ public:
 
 	struct MeshData
 	{
-		std::vector<Vertex> Vertices;
-		std::vector<UINT> Indices;
+		std::vector<Vertex, TrackedAllocator<Vertex, MemoryTracker::Geometry> > Vertices;
+		std::vector<UINT, TrackedAllocator<UINT, MemoryTracker::Geometry> > Indices;
 	};
 
 	void CreateMultiTexBox(float width, float height, float depth, MeshData& meshData);
@@ -0,0 +1,527 @@
+//***************************************************************************************
+// Heightfield.cpp
+//***************************************************************************************
+
+#include "Heightfield.h"
+
+// Slab test of a ray against an axis aligned box.  On a hit, [tmin, tmax] is the part
+// of the ray in front of the origin that lies inside the box.
+static bool RayBox(const float origin[3], const float invDir[3],
+	const float boxMin[3], const float boxMax[3], float& tmin, float& tmax)
+{
+	tmin = 0.0f;
+	tmax = MathHelper::Infinity;
+
+	for(int i = 0; i < 3; ++i)
+	{
+		float t0 = (boxMin[i] - origin[i])*invDir[i];
+		float t1 = (boxMax[i] - origin[i])*invDir[i];
+		if( t0 > t1 )
+			std::swap(t0, t1);
+
+		tmin = MathHelper::Max(tmin, t0);
+		tmax = MathHelper::Min(tmax, t1);
+
+		if( tmin > tmax )
+			return false;
+	}
+
+	return true;
+}
+
+// Two sided Moller-Trumbore ray/triangle test.
+static bool RayTriangle(FXMVECTOR origin, FXMVECTOR dir, FXMVECTOR v0, CXMVECTOR v1, CXMVECTOR v2, float& t)
+{
+	XMVECTOR e1 = XMVectorSubtract(v1, v0);
+	XMVECTOR e2 = XMVectorSubtract(v2, v0);
+
+	XMVECTOR p = XMVector3Cross(dir, e2);
+	float det = XMVectorGetX(XMVector3Dot(e1, p));
+	if( fabsf(det) < 1e-12f )
+		return false;
+
+	float invDet = 1.0f / det;
+
+	XMVECTOR s = XMVectorSubtract(origin, v0);
+	float u = XMVectorGetX(XMVector3Dot(s, p))*invDet;
+	if( u < 0.0f || u > 1.0f )
+		return false;
+
+	XMVECTOR q = XMVector3Cross(s, e1);
+	float v = XMVectorGetX(XMVector3Dot(dir, q))*invDet;
+	if( v < 0.0f || u + v > 1.0f )
+		return false;
+
+	t = XMVectorGetX(XMVector3Dot(e2, q))*invDet;
+	return t >= 0.0f;
+}
+
+Heightfield::Heightfield()
+	: mNumRows(0),
+	  mNumCols(0),
+	  mCellSpacing(1.0f)
+{
+}
+
+Heightfield::~Heightfield()
+{
+}
+
+UINT Heightfield::RowCount()const
+{
+	return mNumRows;
+}
+
+UINT Heightfield::ColumnCount()const
+{
+	return mNumCols;
+}
+
+float Heightfield::CellSpacing()const
+{
+	return mCellSpacing;
+}
+
+float Heightfield::Width()const
+{
+	return (mNumCols-1)*mCellSpacing;
+}
+
+float Heightfield::Depth()const
+{
+	return (mNumRows-1)*mCellSpacing;
+}
+
+void Heightfield::Init(UINT numRows, UINT numCols, float cellSpacing, const float* heights, UINT stride)
+{
+	assert(numRows >= 2 && numCols >= 2);
+
+	mNumRows = numRows;
+	mNumCols = numCols;
+	mCellSpacing = cellSpacing;
+
+	const BYTE* src = reinterpret_cast<const BYTE*>(heights);
+
+	mHeights.resize(numRows*numCols);
+	for(UINT i = 0; i < numRows*numCols; ++i)
+	{
+		mHeights[i] = *reinterpret_cast<const float*>(src + i*stride);
+	}
+
+	BuildPyramid();
+}
+
+void Heightfield::Init(UINT numRows, UINT numCols, float cellSpacing, float (*heightFunc)(float x, float z))
+{
+	assert(numRows >= 2 && numCols >= 2);
+
+	mNumRows = numRows;
+	mNumCols = numCols;
+	mCellSpacing = cellSpacing;
+
+	float halfWidth = 0.5f*Width();
+	float halfDepth = 0.5f*Depth();
+
+	mHeights.resize(numRows*numCols);
+	for(UINT i = 0; i < numRows; ++i)
+	{
+		float z = halfDepth - i*cellSpacing;
+		for(UINT j = 0; j < numCols; ++j)
+		{
+			float x = -halfWidth + j*cellSpacing;
+			mHeights[i*numCols+j] = heightFunc(x, z);
+		}
+	}
+
+	BuildPyramid();
+}
+
+float Heightfield::GetSample(int row, int col)const
+{
+	row = MathHelper::Clamp(row, 0, (int)mNumRows-1);
+	col = MathHelper::Clamp(col, 0, (int)mNumCols-1);
+
+	return mHeights[row*mNumCols + col];
+}
+
+void Heightfield::GetCell(float x, float z, UINT& row, UINT& col, float& s, float& t)const
+{
+	// Transform from world space to "cell" space and clamp to the grid.
+	float c = (x + 0.5f*Width()) / mCellSpacing;
+	float d = (0.5f*Depth() - z) / mCellSpacing;
+
+	c = MathHelper::Clamp(c, 0.0f, (float)(mNumCols-1));
+	d = MathHelper::Clamp(d, 0.0f, (float)(mNumRows-1));
+
+	// The last row/column belongs to the cell before it.
+	col = MathHelper::Min((UINT)c, mNumCols-2);
+	row = MathHelper::Min((UINT)d, mNumRows-2);
+
+	s = c - (float)col;
+	t = d - (float)row;
+}
+
+float Heightfield::GetHeight(float x, float z)const
+{
+	UINT row, col;
+	float s, t;
+	GetCell(x, z, row, col, s, t);
+
+	// A*--*B
+	//  |  |
+	// C*--*D
+	const float* p = &mHeights[row*mNumCols + col];
+	float A = p[0];
+	float B = p[1];
+	float C = p[mNumCols];
+	float D = p[mNumCols+1];
+
+	return MathHelper::Lerp(MathHelper::Lerp(A, B, s), MathHelper::Lerp(C, D, s), t);
+}
+
+XMFLOAT3 Heightfield::GetNormal(float x, float z)const
+{
+	UINT row, col;
+	float s, t;
+	GetCell(x, z, row, col, s, t);
+
+	const float* p = &mHeights[row*mNumCols + col];
+	float A = p[0];
+	float B = p[1];
+	float C = p[mNumCols];
+	float D = p[mNumCols+1];
+
+	// Partial derivatives of the bilinear patch.  s grows with x and t grows
+	// with -z, so dh/dx = dh/ds / dx and dh/dz = -dh/dt / dx.
+	float dhds = (B - A)*(1.0f - t) + (D - C)*t;
+	float dhdt = (C - A)*(1.0f - s) + (D - B)*s;
+
+	// n = (-df/dx, 1, -df/dz)
+	XMVECTOR n = XMVectorSet(-dhds / mCellSpacing, 1.0f, dhdt / mCellSpacing, 0.0f);
+
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, XMVector3Normalize(n));
+
+	return normal;
+}
+
+void Heightfield::GetHeights(const XMFLOAT3* points, UINT count, float* heights)const
+{
+	XMVECTOR halfWidth = XMVectorReplicate(0.5f*Width());
+	XMVECTOR halfDepth = XMVectorReplicate(0.5f*Depth());
+	XMVECTOR invDx     = XMVectorReplicate(1.0f / mCellSpacing);
+	XMVECTOR maxCol    = XMVectorReplicate((float)(mNumCols-1));
+	XMVECTOR maxRow    = XMVectorReplicate((float)(mNumRows-1));
+	XMVECTOR lastCol   = XMVectorReplicate((float)(mNumCols-2));
+	XMVECTOR lastRow   = XMVectorReplicate((float)(mNumRows-2));
+
+	//
+	// Four points per iteration: the cell lookup and the interpolation are done
+	// in vectors; only fetching the corner heights is per point.
+	//
+
+	UINT i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		const XMFLOAT3* p = &points[i];
+
+		XMVECTOR x = XMVectorSet(p[0].x, p[1].x, p[2].x, p[3].x);
+		XMVECTOR z = XMVectorSet(p[0].z, p[1].z, p[2].z, p[3].z);
+
+		XMVECTOR c = XMVectorMultiply(XMVectorAdd(x, halfWidth), invDx);
+		XMVECTOR d = XMVectorMultiply(XMVectorSubtract(halfDepth, z), invDx);
+		c = XMVectorClamp(c, XMVectorZero(), maxCol);
+		d = XMVectorClamp(d, XMVectorZero(), maxRow);
+
+		XMVECTOR col = XMVectorMin(XMVectorFloor(c), lastCol);
+		XMVECTOR row = XMVectorMin(XMVectorFloor(d), lastRow);
+		XMVECTOR s = XMVectorSubtract(c, col);
+		XMVECTOR t = XMVectorSubtract(d, row);
+
+		XMFLOAT4 fcol, frow;
+		XMStoreFloat4(&fcol, col);
+		XMStoreFloat4(&frow, row);
+
+		const float* p0 = &mHeights[(UINT)frow.x*mNumCols + (UINT)fcol.x];
+		const float* p1 = &mHeights[(UINT)frow.y*mNumCols + (UINT)fcol.y];
+		const float* p2 = &mHeights[(UINT)frow.z*mNumCols + (UINT)fcol.z];
+		const float* p3 = &mHeights[(UINT)frow.w*mNumCols + (UINT)fcol.w];
+
+		XMVECTOR A = XMVectorSet(p0[0], p1[0], p2[0], p3[0]);
+		XMVECTOR B = XMVectorSet(p0[1], p1[1], p2[1], p3[1]);
+		XMVECTOR C = XMVectorSet(p0[mNumCols], p1[mNumCols], p2[mNumCols], p3[mNumCols]);
+		XMVECTOR D = XMVectorSet(p0[mNumCols+1], p1[mNumCols+1], p2[mNumCols+1], p3[mNumCols+1]);
+
+		XMVECTOR h = XMVectorLerpV(XMVectorLerpV(A, B, s), XMVectorLerpV(C, D, s), t);
+
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&heights[i]), h);
+	}
+
+	for(; i < count; ++i)
+	{
+		heights[i] = GetHeight(points[i].x, points[i].z);
+	}
+}
+
+void Heightfield::GetNormals(const XMFLOAT3* points, UINT count, XMFLOAT3* normals)const
+{
+	XMVECTOR halfWidth = XMVectorReplicate(0.5f*Width());
+	XMVECTOR halfDepth = XMVectorReplicate(0.5f*Depth());
+	XMVECTOR invDx     = XMVectorReplicate(1.0f / mCellSpacing);
+	XMVECTOR maxCol    = XMVectorReplicate((float)(mNumCols-1));
+	XMVECTOR maxRow    = XMVectorReplicate((float)(mNumRows-1));
+	XMVECTOR lastCol   = XMVectorReplicate((float)(mNumCols-2));
+	XMVECTOR lastRow   = XMVectorReplicate((float)(mNumRows-2));
+	XMVECTOR one       = XMVectorSplatOne();
+
+	UINT i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		const XMFLOAT3* p = &points[i];
+
+		XMVECTOR x = XMVectorSet(p[0].x, p[1].x, p[2].x, p[3].x);
+		XMVECTOR z = XMVectorSet(p[0].z, p[1].z, p[2].z, p[3].z);
+
+		XMVECTOR c = XMVectorMultiply(XMVectorAdd(x, halfWidth), invDx);
+		XMVECTOR d = XMVectorMultiply(XMVectorSubtract(halfDepth, z), invDx);
+		c = XMVectorClamp(c, XMVectorZero(), maxCol);
+		d = XMVectorClamp(d, XMVectorZero(), maxRow);
+
+		XMVECTOR col = XMVectorMin(XMVectorFloor(c), lastCol);
+		XMVECTOR row = XMVectorMin(XMVectorFloor(d), lastRow);
+		XMVECTOR s = XMVectorSubtract(c, col);
+		XMVECTOR t = XMVectorSubtract(d, row);
+
+		XMFLOAT4 fcol, frow;
+		XMStoreFloat4(&fcol, col);
+		XMStoreFloat4(&frow, row);
+
+		const float* p0 = &mHeights[(UINT)frow.x*mNumCols + (UINT)fcol.x];
+		const float* p1 = &mHeights[(UINT)frow.y*mNumCols + (UINT)fcol.y];
+		const float* p2 = &mHeights[(UINT)frow.z*mNumCols + (UINT)fcol.z];
+		const float* p3 = &mHeights[(UINT)frow.w*mNumCols + (UINT)fcol.w];
+
+		XMVECTOR A = XMVectorSet(p0[0], p1[0], p2[0], p3[0]);
+		XMVECTOR B = XMVectorSet(p0[1], p1[1], p2[1], p3[1]);
+		XMVECTOR C = XMVectorSet(p0[mNumCols], p1[mNumCols], p2[mNumCols], p3[mNumCols]);
+		XMVECTOR D = XMVectorSet(p0[mNumCols+1], p1[mNumCols+1], p2[mNumCols+1], p3[mNumCols+1]);
+
+		// Same gradient as GetNormal(), for four points at once.
+		XMVECTOR dhds = XMVectorLerpV(XMVectorSubtract(B, A), XMVectorSubtract(D, C), t);
+		XMVECTOR dhdt = XMVectorLerpV(XMVectorSubtract(C, A), XMVectorSubtract(D, B), s);
+
+		XMVECTOR nx = XMVectorNegate(XMVectorMultiply(dhds, invDx));
+		XMVECTOR nz = XMVectorMultiply(dhdt, invDx);
+
+		XMVECTOR lenSq = XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(nz, nz, one));
+		XMVECTOR invLen = XMVectorReciprocalSqrt(lenSq);
+
+		XMFLOAT4 fx, fy, fz;
+		XMStoreFloat4(&fx, XMVectorMultiply(nx, invLen));
+		XMStoreFloat4(&fy, invLen);
+		XMStoreFloat4(&fz, XMVectorMultiply(nz, invLen));
+
+		normals[i+0] = XMFLOAT3(fx.x, fy.x, fz.x);
+		normals[i+1] = XMFLOAT3(fx.y, fy.y, fz.y);
+		normals[i+2] = XMFLOAT3(fx.z, fy.z, fz.z);
+		normals[i+3] = XMFLOAT3(fx.w, fy.w, fz.w);
+	}
+
+	for(; i < count; ++i)
+	{
+		normals[i] = GetNormal(points[i].x, points[i].z);
+	}
+}
+
+bool Heightfield::Intersect(FXMVECTOR rayOrigin, FXMVECTOR rayDir, float& dist)const
+{
+	if( mPyramid.empty() )
+		return false;
+
+	XMFLOAT3 o, d;
+	XMStoreFloat3(&o, rayOrigin);
+	XMStoreFloat3(&d, rayDir);
+
+	float origin[3] = { o.x, o.y, o.z };
+	float dir[3]    = { d.x, d.y, d.z };
+	float invDir[3];
+	for(int i = 0; i < 3; ++i)
+	{
+		// Avoid 0*inf in the slab test for rays parallel to an axis.
+		invDir[i] = fabsf(dir[i]) > 1e-12f ? 1.0f / dir[i] : (dir[i] < 0.0f ? -1e30f : 1e30f);
+	}
+
+	float halfWidth = 0.5f*Width();
+	float halfDepth = 0.5f*Depth();
+
+	// The child the ray enters first.  Rows go towards -z.
+	UINT nearRow = d.z < 0.0f ? 0 : 1;
+	UINT nearCol = d.x >= 0.0f ? 0 : 1;
+
+	struct StackNode
+	{
+		UINT Level;
+		UINT Row;
+		UINT Col;
+	};
+
+	StackNode stack[128];
+	UINT stackSize = 0;
+
+	StackNode root = { (UINT)mPyramid.size()-1, 0, 0 };
+	stack[stackSize++] = root;
+
+	float closest = MathHelper::Infinity;
+	bool hit = false;
+
+	while( stackSize > 0 )
+	{
+		StackNode node = stack[--stackSize];
+
+		// Cells covered by the node.
+		UINT span = 1u << node.Level;
+		UINT row0 = node.Row*span;
+		UINT col0 = node.Col*span;
+		UINT row1 = MathHelper::Min(row0 + span, mNumRows-1);
+		UINT col1 = MathHelper::Min(col0 + span, mNumCols-1);
+
+		const XMFLOAT2& range = mPyramid[node.Level][node.Row*mPyramidCols[node.Level] + node.Col];
+
+		float boxMin[3] = { -halfWidth + col0*mCellSpacing, range.x, halfDepth - row1*mCellSpacing };
+		float boxMax[3] = { -halfWidth + col1*mCellSpacing, range.y, halfDepth - row0*mCellSpacing };
+
+		float tmin, tmax;
+		if( !RayBox(origin, invDir, boxMin, boxMax, tmin, tmax) || tmin > closest )
+			continue;
+
+		if( node.Level == 0 )
+		{
+			float t;
+			if( IntersectCell(node.Row, node.Col, rayOrigin, rayDir, t) && t < closest )
+			{
+				closest = t;
+				hit = true;
+			}
+			continue;
+		}
+
+		// Push the children far to near so the nearest one is popped first; once a
+		// hit is found, farther nodes are rejected by the box test above.
+		UINT childLevel = node.Level-1;
+		for(int i = 3; i >= 0; --i)
+		{
+			StackNode child;
+			child.Level = childLevel;
+			child.Row = 2*node.Row + (nearRow ^ (UINT)(i >> 1));
+			child.Col = 2*node.Col + (nearCol ^ (UINT)(i & 1));
+
+			if( child.Row < mPyramidRows[childLevel] && child.Col < mPyramidCols[childLevel] )
+				stack[stackSize++] = child;
+		}
+	}
+
+	if( hit )
+		dist = closest;
+
+	return hit;
+}
+
+bool Heightfield::IntersectCell(UINT row, UINT col, FXMVECTOR rayOrigin, FXMVECTOR rayDir, float& dist)const
+{
+	float x0 = -0.5f*Width() + col*mCellSpacing;
+	float z0 = 0.5f*Depth() - row*mCellSpacing;
+	float x1 = x0 + mCellSpacing;
+	float z1 = z0 - mCellSpacing;
+
+	const float* p = &mHeights[row*mNumCols + col];
+
+	// A*--*B
+	//  | /|
+	//  |/ |
+	// C*--*D
+	XMVECTOR A = XMVectorSet(x0, p[0], z0, 0.0f);
+	XMVECTOR B = XMVectorSet(x1, p[1], z0, 0.0f);
+	XMVECTOR C = XMVectorSet(x0, p[mNumCols], z1, 0.0f);
+	XMVECTOR D = XMVectorSet(x1, p[mNumCols+1], z1, 0.0f);
+
+	float t0 = MathHelper::Infinity;
+	float t1 = MathHelper::Infinity;
+	bool hit0 = RayTriangle(rayOrigin, rayDir, A, B, C, t0);
+	bool hit1 = RayTriangle(rayOrigin, rayDir, C, B, D, t1);
+
+	if( !hit0 && !hit1 )
+		return false;
+
+	dist = MathHelper::Min(t0, t1);
+	return true;
+}
+
+void Heightfield::BuildPyramid()
+{
+	mPyramid.clear();
+	mPyramidRows.clear();
+	mPyramidCols.clear();
+
+	//
+	// Level 0: the height range of each cell's four corners.
+	//
+
+	UINT rows = mNumRows-1;
+	UINT cols = mNumCols-1;
+
+	mPyramid.push_back(std::vector<XMFLOAT2>(rows*cols));
+	mPyramidRows.push_back(rows);
+	mPyramidCols.push_back(cols);
+
+	for(UINT i = 0; i < rows; ++i)
+	{
+		for(UINT j = 0; j < cols; ++j)
+		{
+			const float* p = &mHeights[i*mNumCols + j];
+
+			mPyramid[0][i*cols+j] = XMFLOAT2(
+				MathHelper::Min(MathHelper::Min(p[0], p[1]), MathHelper::Min(p[mNumCols], p[mNumCols+1])),
+				MathHelper::Max(MathHelper::Max(p[0], p[1]), MathHelper::Max(p[mNumCols], p[mNumCols+1])));
+		}
+	}
+
+	//
+	// Each following level combines 2x2 nodes of the level below until a single
+	// node covers the whole grid.  Odd sized levels have partial nodes at the edge.
+	//
+
+	while( rows > 1 || cols > 1 )
+	{
+		UINT parentRows = (rows+1)/2;
+		UINT parentCols = (cols+1)/2;
+
+		const std::vector<XMFLOAT2>& child = mPyramid.back();
+		std::vector<XMFLOAT2> parent(parentRows*parentCols);
+
+		for(UINT i = 0; i < parentRows; ++i)
+		{
+			for(UINT j = 0; j < parentCols; ++j)
+			{
+				XMFLOAT2 range(+MathHelper::Infinity, -MathHelper::Infinity);
+
+				for(UINT ci = 2*i; ci < MathHelper::Min(2*i+2, rows); ++ci)
+				{
+					for(UINT cj = 2*j; cj < MathHelper::Min(2*j+2, cols); ++cj)
+					{
+						range.x = MathHelper::Min(range.x, child[ci*cols+cj].x);
+						range.y = MathHelper::Max(range.y, child[ci*cols+cj].y);
+					}
+				}
+
+				parent[i*parentCols+j] = range;
+			}
+		}
+
+		mPyramid.push_back(parent);
+		mPyramidRows.push_back(parentRows);
+		mPyramidCols.push_back(parentCols);
+
+		rows = parentRows;
+		cols = parentCols;
+	}
+}
@@ -0,0 +1,82 @@
+//***************************************************************************************
+// Heightfield.h
+//
+// Height and normal queries over a regular grid of heights, for placing objects on
+// terrain and picking it.
+//   -The grid follows GeometryGenerator::CreateGrid: row i lies at z = depth/2 - i*dx
+//    and column j at x = -width/2 + j*dx, centered on the origin.
+//   -Heights are bilinearly interpolated; normals are the analytic gradient of that
+//    bilinear surface, so they match the heights exactly.
+//   -The batched queries process four points per iteration with XNA Math vectors.
+//   -Ray casts walk a min/max pyramid over the cells (each level stores the height
+//    range of 2x2 nodes of the level below), so only the cells near the ray are
+//    tested against their two triangles.
+//
+// Heights are copied, so a Waves simulation or a loaded heightmap can be queried by
+// calling Init() again whenever the source changes.
+//***************************************************************************************
+
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include "d3dUtil.h"
+
+class Heightfield
+{
+public:
+	Heightfield();
+	~Heightfield();
+
+	UINT RowCount()const;
+	UINT ColumnCount()const;
+	float CellSpacing()const;
+	float Width()const;
+	float Depth()const;
+
+	// Copies numRows*numCols heights.  stride is the number of bytes between
+	// consecutive heights, so the y components of an XMFLOAT3 array can be passed
+	// directly, e.g. Init(waves.RowCount(), waves.ColumnCount(), dx, &waves[0].y, sizeof(XMFLOAT3)).
+	void Init(UINT numRows, UINT numCols, float cellSpacing, const float* heights, UINT stride = sizeof(float));
+
+	// Samples heightFunc at every grid point.
+	void Init(UINT numRows, UINT numCols, float cellSpacing, float (*heightFunc)(float x, float z));
+
+	// Height of grid point (row, col), clamped to the edge of the grid.
+	float GetSample(int row, int col)const;
+
+	// Bilinearly interpolated height and surface normal at world space (x, z).
+	// Points outside the grid get the height of the nearest edge.
+	float GetHeight(float x, float z)const;
+	XMFLOAT3 GetNormal(float x, float z)const;
+
+	// Batched versions of the above; only the x and z of each point are read.
+	void GetHeights(const XMFLOAT3* points, UINT count, float* heights)const;
+	void GetNormals(const XMFLOAT3* points, UINT count, XMFLOAT3* normals)const;
+
+	// Finds the closest intersection of the ray with the triangulated grid.
+	// rayDir need not be normalized; dist is in units of rayDir.
+	bool Intersect(FXMVECTOR rayOrigin, FXMVECTOR rayDir, float& dist)const;
+
+private:
+	void BuildPyramid();
+
+	// Maps world (x, z) to the containing cell and the position (s, t) in it.
+	void GetCell(float x, float z, UINT& row, UINT& col, float& s, float& t)const;
+
+	// Tests the cell's two triangles, split like GeometryGenerator::CreateGrid.
+	bool IntersectCell(UINT row, UINT col, FXMVECTOR rayOrigin, FXMVECTOR rayDir, float& dist)const;
+
+private:
+	UINT mNumRows;
+	UINT mNumCols;
+	float mCellSpacing;
+
+	std::vector<float> mHeights;
+
+	// Min/max height (x, y) per node; level 0 has one node per cell.
+	std::vector<std::vector<XMFLOAT2>> mPyramid;
+	std::vector<UINT> mPyramidRows;
+	std::vector<UINT> mPyramidCols;
+};
+
+#endif // HEIGHTFIELD_H
@@ -0,0 +1,257 @@
+//***************************************************************************************
+// InstanceRenderer.cpp
+//***************************************************************************************
+
+#include "InstanceRenderer.h"
+#include "FrameArena.h"
+
+namespace
+{
+	// Fewer instances than this per range are not worth a job.
+	const UINT MinInstancesPerThread = 4096;
+}
+
+const D3D11_INPUT_ELEMENT_DESC InstanceRenderer::InstanceInputDesc[InstanceRenderer::InstanceInputCount] =
+{
+	{"WORLD",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1,  0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLD",    1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLD",    2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLD",    3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"MATERIAL", 0, DXGI_FORMAT_R32_UINT,           1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+};
+
+InstanceRenderer::InstanceRenderer()
+	: md3dDevice(0), mInstanceBuffer(0), mInstanceCapacity(0), mNumThreads(1), mVisibleCount(0)
+{
+	ZeroMemory(mFrustumPlanes, sizeof(mFrustumPlanes));
+}
+
+InstanceRenderer::~InstanceRenderer()
+{
+	ReleaseCOM(mInstanceBuffer);
+}
+
+void InstanceRenderer::Init(ID3D11Device* device, UINT numThreads)
+{
+	md3dDevice = device;
+
+	mNumThreads = numThreads > 0 ? numThreads : JobSystem::GetThreadCount();
+
+	mThreadLists.resize(mNumThreads);
+	for(UINT t = 0; t < mNumThreads; ++t)
+		mThreadLists[t].Meshes.resize(mMeshes.size());
+}
+
+UINT InstanceRenderer::AddMesh(UINT indexCount, UINT startIndex, INT baseVertex,
+	const XMFLOAT3& boundsCenter, float boundsRadius)
+{
+	Mesh mesh;
+	mesh.IndexCount   = indexCount;
+	mesh.StartIndex   = startIndex;
+	mesh.BaseVertex   = baseVertex;
+	mesh.BoundsCenter = boundsCenter;
+	mesh.BoundsRadius = boundsRadius;
+
+	mMeshes.push_back(mesh);
+
+	for(size_t t = 0; t < mThreadLists.size(); ++t)
+		mThreadLists[t].Meshes.resize(mMeshes.size());
+
+	return (UINT)mMeshes.size() - 1;
+}
+
+UINT InstanceRenderer::AddInstance(UINT mesh, const XMFLOAT4X4& world, UINT materialId)
+{
+	InstanceData data;
+	data.World      = world;
+	data.MaterialId = materialId;
+
+	mInstanceMesh.push_back(mesh);
+	mInstanceData.push_back(data);
+	mInstanceBounds.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+
+	UINT instance = (UINT)mInstanceData.size() - 1;
+	UpdateBounds(instance);
+
+	return instance;
+}
+
+void InstanceRenderer::SetWorld(UINT instance, const XMFLOAT4X4& world)
+{
+	mInstanceData[instance].World = world;
+	UpdateBounds(instance);
+}
+
+void InstanceRenderer::SetMaterial(UINT instance, UINT materialId)
+{
+	mInstanceData[instance].MaterialId = materialId;
+}
+
+void InstanceRenderer::ClearInstances()
+{
+	mInstanceMesh.clear();
+	mInstanceData.clear();
+	mInstanceBounds.clear();
+}
+
+UINT InstanceRenderer::GetInstanceCount()const
+{
+	return (UINT)mInstanceData.size();
+}
+
+UINT InstanceRenderer::GetVisibleCount()const
+{
+	return mVisibleCount;
+}
+
+void InstanceRenderer::UpdateBounds(UINT instance)
+{
+	const Mesh& mesh = mMeshes[mInstanceMesh[instance]];
+	XMMATRIX W = XMLoadFloat4x4(&mInstanceData[instance].World);
+
+	XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&mesh.BoundsCenter), W);
+
+	// Scale the radius by the largest axis scale so the sphere stays conservative
+	// under non-uniform scaling.
+	float scale = MathHelper::Max(
+		XMVectorGetX(XMVector3Length(W.r[0])), MathHelper::Max(
+		XMVectorGetX(XMVector3Length(W.r[1])),
+		XMVectorGetX(XMVector3Length(W.r[2]))));
+
+	XMStoreFloat4(&mInstanceBounds[instance], XMVectorSetW(center, mesh.BoundsRadius*scale));
+}
+
+void InstanceRenderer::Cull(CXMMATRIX viewProj)
+{
+	ExtractFrustumPlanes(mFrustumPlanes, viewProj);
+
+	UINT numInstances = (UINT)mInstanceData.size();
+
+	UINT numThreads = MathHelper::Min(mNumThreads, MathHelper::Max(1u, numInstances / MinInstancesPerThread));
+
+	// Empty the lists but keep their memory from frame to frame.
+	for(size_t t = 0; t < mThreadLists.size(); ++t)
+	{
+		for(size_t m = 0; m < mThreadLists[t].Meshes.size(); ++m)
+			mThreadLists[t].Meshes[m].clear();
+	}
+
+	// Each range is a job; the calling thread culls too while it waits.
+	CullJob job;
+	job.Renderer     = this;
+	job.NumRanges    = numThreads;
+	job.NumInstances = numInstances;
+
+	JobCounter counter;
+	JobSystem::ParallelFor(&InstanceRenderer::CullRangesJob, &job, numThreads, 1, &counter);
+	JobSystem::Wait(counter);
+
+	mVisibleCount = 0;
+	for(UINT t = 0; t < numThreads; ++t)
+	{
+		for(size_t m = 0; m < mThreadLists[t].Meshes.size(); ++m)
+			mVisibleCount += (UINT)mThreadLists[t].Meshes[m].size();
+	}
+}
+
+void InstanceRenderer::CullRangesJob(void* job, UINT firstRange, UINT endRange)
+{
+	const CullJob& cull = *static_cast<const CullJob*>(job);
+
+	for(UINT r = firstRange; r < endRange; ++r)
+	{
+		cull.Renderer->CullRange(r, cull.NumInstances*r/cull.NumRanges,
+			cull.NumInstances*(r+1)/cull.NumRanges);
+	}
+}
+
+void InstanceRenderer::CullRange(UINT thread, UINT firstInstance, UINT endInstance)
+{
+	XMVECTOR planes[6];
+	for(int i = 0; i < 6; ++i)
+		planes[i] = XMLoadFloat4(&mFrustumPlanes[i]);
+
+	std::vector<std::vector<InstanceData> >& lists = mThreadLists[thread].Meshes;
+
+	for(UINT i = firstInstance; i < endInstance; ++i)
+	{
+		if( SphereInFrustum(planes, XMLoadFloat4(&mInstanceBounds[i])) )
+			lists[mInstanceMesh[i]].push_back(mInstanceData[i]);
+	}
+}
+
+void InstanceRenderer::ResizeInstanceBuffer(UINT numInstances)
+{
+	if( numInstances <= mInstanceCapacity )
+		return;
+
+	ReleaseCOM(mInstanceBuffer);
+
+	// Grow geometrically so a slowly rising instance count does not recreate the
+	// buffer every frame.
+	mInstanceCapacity = MathHelper::Max(numInstances, mInstanceCapacity*2);
+
+	D3D11_BUFFER_DESC vbd;
+	vbd.Usage = D3D11_USAGE_DYNAMIC;
+	vbd.ByteWidth = sizeof(InstanceData) * mInstanceCapacity;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	vbd.MiscFlags = 0;
+	vbd.StructureByteStride = 0;
+
+	HR(md3dDevice->CreateBuffer(&vbd, 0, &mInstanceBuffer));
+}
+
+void InstanceRenderer::Draw(ID3D11DeviceContext* dc)
+{
+	if( mVisibleCount == 0 )
+		return;
+
+	ResizeInstanceBuffer(mVisibleCount);
+
+	//
+	// Copy the lists into the buffer grouped by mesh, so each mesh's instances are
+	// one contiguous range.
+	//
+
+	FrameVector<UINT>::Type startInstance(mMeshes.size(), 0);
+	FrameVector<UINT>::Type instanceCount(mMeshes.size(), 0);
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(dc->Map(mInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+	InstanceData* dst = reinterpret_cast<InstanceData*>(mappedData.pData);
+	UINT cursor = 0;
+
+	for(size_t m = 0; m < mMeshes.size(); ++m)
+	{
+		startInstance[m] = cursor;
+
+		for(size_t t = 0; t < mThreadLists.size(); ++t)
+		{
+			const std::vector<InstanceData>& list = mThreadLists[t].Meshes[m];
+			if( list.empty() )
+				continue;
+
+			memcpy(dst + cursor, &list[0], list.size()*sizeof(InstanceData));
+			cursor += (UINT)list.size();
+		}
+
+		instanceCount[m] = cursor - startInstance[m];
+	}
+
+	dc->Unmap(mInstanceBuffer, 0);
+
+	UINT stride = sizeof(InstanceData);
+	UINT offset = 0;
+	dc->IASetVertexBuffers(1, 1, &mInstanceBuffer, &stride, &offset);
+
+	for(size_t m = 0; m < mMeshes.size(); ++m)
+	{
+		if( instanceCount[m] == 0 )
+			continue;
+
+		const Mesh& mesh = mMeshes[m];
+		dc->DrawIndexedInstanced(mesh.IndexCount, instanceCount[m], mesh.StartIndex, mesh.BaseVertex, startInstance[m]);
+	}
+}
@@ -0,0 +1,132 @@
+//***************************************************************************************
+// InstanceRenderer.h
+//
+// Draws many copies of a few meshes with one DrawIndexedInstanced() per mesh, instead
+// of one SetMatrix(), Apply() and DrawIndexed() per object.
+//   -Instances are registered once with a world matrix and a material id, and can be
+//    moved or re-colored afterwards.
+//   -Cull() tests the bounding sphere of every instance against the view frustum.
+//    The instances are split into ranges culled as jobs, and each range gathers
+//    the instance data of its visible instances into its own lists, one per mesh.
+//   -Draw() copies the lists into a dynamic instance buffer with a single Map() and
+//    draws each mesh once for all of its visible instances.
+//
+// Techniques drawn with it read InstanceData from vertex buffer slot 1 as per
+// instance WORLD0-3 and MATERIAL elements (see InstanceInputDesc).
+//***************************************************************************************
+
+#ifndef INSTANCERENDERER_H
+#define INSTANCERENDERER_H
+
+#include "d3dUtil.h"
+#include "JobSystem.h"
+
+struct InstanceData
+{
+	XMFLOAT4X4 World;
+	UINT MaterialId;
+};
+
+class InstanceRenderer
+{
+public:
+	// The per instance part of an input layout, to be appended to the per vertex
+	// elements of slot 0.
+	static const UINT InstanceInputCount = 5;
+	static const D3D11_INPUT_ELEMENT_DESC InstanceInputDesc[InstanceInputCount];
+
+public:
+	InstanceRenderer();
+	~InstanceRenderer();
+
+	///<summary>
+	/// Culling is split into numThreads ranges, run as JobSystem jobs; 0 uses one
+	/// per thread of the job system.
+	///</summary>
+	void Init(ID3D11Device* device, UINT numThreads = 0);
+
+	///<summary>
+	/// Registers a mesh stored in the buffers the caller binds before Draw().  The
+	/// sphere bounds it in its local space.  Returns the mesh id.
+	///</summary>
+	UINT AddMesh(UINT indexCount, UINT startIndex, INT baseVertex,
+		const XMFLOAT3& boundsCenter, float boundsRadius);
+
+	// Returns the instance id.
+	UINT AddInstance(UINT mesh, const XMFLOAT4X4& world, UINT materialId);
+
+	void SetWorld(UINT instance, const XMFLOAT4X4& world);
+	void SetMaterial(UINT instance, UINT materialId);
+
+	void ClearInstances();
+
+	UINT GetInstanceCount()const;
+
+	// Instances that passed the last Cull().
+	UINT GetVisibleCount()const;
+
+	///<summary>
+	/// Finds the instances inside the frustum of viewProj and gathers their data for
+	/// Draw().
+	///</summary>
+	void Cull(CXMMATRIX viewProj);
+
+	///<summary>
+	/// Uploads the visible instances and draws every mesh that has any.  The caller
+	/// binds the input layout, topology, vertex buffer slot 0 and index buffer, and
+	/// applies the effect pass first.
+	///</summary>
+	void Draw(ID3D11DeviceContext* dc);
+
+private:
+	struct Mesh
+	{
+		UINT IndexCount;
+		UINT StartIndex;
+		INT BaseVertex;
+		XMFLOAT3 BoundsCenter;
+		float BoundsRadius;
+	};
+
+	// Visible instances found in one culling range, by mesh.
+	struct ThreadLists
+	{
+		std::vector<std::vector<InstanceData> > Meshes;
+	};
+
+	struct CullJob
+	{
+		InstanceRenderer* Renderer;
+		UINT NumRanges;
+		UINT NumInstances;
+	};
+
+	static void CullRangesJob(void* job, UINT firstRange, UINT endRange);
+	void CullRange(UINT thread, UINT firstInstance, UINT endInstance);
+	void UpdateBounds(UINT instance);
+	void ResizeInstanceBuffer(UINT numInstances);
+
+private:
+	InstanceRenderer(const InstanceRenderer& rhs);
+	InstanceRenderer& operator=(const InstanceRenderer& rhs);
+
+private:
+	ID3D11Device* md3dDevice;
+	ID3D11Buffer* mInstanceBuffer;
+	UINT mInstanceCapacity;
+	UINT mNumThreads;
+
+	std::vector<Mesh> mMeshes;
+
+	// Instances, structure of arrays.  Bounds are world space spheres (center,
+	// radius) kept up to date by SetWorld() so culling does not touch the matrices.
+	std::vector<UINT> mInstanceMesh;
+	std::vector<InstanceData> mInstanceData;
+	std::vector<XMFLOAT4> mInstanceBounds;
+
+	XMFLOAT4 mFrustumPlanes[6];
+	std::vector<ThreadLists> mThreadLists;
+	UINT mVisibleCount;
+};
+
+#endif // INSTANCERENDERER_H
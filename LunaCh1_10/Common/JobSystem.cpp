@@ -0,0 +1,374 @@
+//***************************************************************************************
+// JobSystem.cpp
+//***************************************************************************************
+
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <thread>
+
+namespace
+{
+	// Jobs a queue holds before it has to grow.
+	const size_t InitialQueueCapacity = 1024;
+
+	// A ring of jobs that only grows when it is full, so once the queues have
+	// reached what a frame needs, queueing allocates nothing.  std::deque would
+	// allocate a new block every few jobs.
+	struct JobQueue
+	{
+		JobQueue()
+			: Jobs(InitialQueueCapacity), Head(0), Count(0)
+		{
+		}
+
+		bool Empty()const
+		{
+			return Count == 0;
+		}
+
+		void PushBack(const Job& job)
+		{
+			if( Count == Jobs.size() )
+				Grow();
+
+			Jobs[(Head + Count) % Jobs.size()] = job;
+			++Count;
+		}
+
+		Job PopBack()
+		{
+			--Count;
+			return Jobs[(Head + Count) % Jobs.size()];
+		}
+
+		Job PopFront()
+		{
+			Job job = Jobs[Head];
+			Head = (Head + 1) % Jobs.size();
+			--Count;
+			return job;
+		}
+
+		void Grow()
+		{
+			std::vector<Job> jobs(2*Jobs.size());
+			for(size_t i = 0; i < Count; ++i)
+				jobs[i] = Jobs[(Head + i) % Jobs.size()];
+
+			Jobs.swap(jobs);
+			Head = 0;
+		}
+
+		std::mutex Mutex;
+		std::vector<Job> Jobs;
+		size_t Head;
+		size_t Count;
+	};
+
+	struct Scheduler
+	{
+		// Queue 0 is shared by the threads outside the pool; queue i+1 belongs to
+		// worker i.
+		std::vector<JobQueue*> Queues;
+		std::vector<std::thread> Workers;
+		std::vector<std::thread::id> WorkerIds;
+
+		// Jobs in the queues, for waking and parking the workers.
+		std::atomic<long> Queued;
+		std::mutex SleepMutex;
+		std::condition_variable WakeUp;
+		bool Quit;
+
+		std::atomic<long> JobsRun;
+		std::atomic<long> JobsStolen;
+	};
+
+	Scheduler* gScheduler = 0;
+
+	uint32_t QueueIndex()
+	{
+		std::thread::id id = std::this_thread::get_id();
+
+		for(size_t i = 0; i < gScheduler->WorkerIds.size(); ++i)
+		{
+			if( gScheduler->WorkerIds[i] == id )
+				return (uint32_t)i + 1;
+		}
+
+		return 0;
+	}
+}
+
+JobCounter::JobCounter()
+	: mPending(0)
+{
+}
+
+bool JobCounter::IsDone()const
+{
+	return mPending == 0;
+}
+
+void JobSystem::Init(uint32_t numWorkers)
+{
+	assert(gScheduler == 0);
+
+	if( numWorkers == 0 )
+		numWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	gScheduler = new Scheduler();
+	gScheduler->Queued = 0;
+	gScheduler->Quit = false;
+	gScheduler->JobsRun = 0;
+	gScheduler->JobsStolen = 0;
+
+	for(uint32_t i = 0; i < numWorkers + 1; ++i)
+		gScheduler->Queues.push_back(new JobQueue());
+
+	// The ids are filled in before any worker can look itself up.
+	std::lock_guard<std::mutex> lock(gScheduler->SleepMutex);
+
+	for(uint32_t i = 0; i < numWorkers; ++i)
+	{
+		gScheduler->Workers.push_back(std::thread(&JobSystem::WorkerMain));
+		gScheduler->WorkerIds.push_back(gScheduler->Workers.back().get_id());
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	if( gScheduler == 0 )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(gScheduler->SleepMutex);
+		gScheduler->Quit = true;
+	}
+	gScheduler->WakeUp.notify_all();
+
+	for(size_t i = 0; i < gScheduler->Workers.size(); ++i)
+		gScheduler->Workers[i].join();
+
+	// Whatever the workers left is run here.
+	Job job;
+	while( TakeJob(job) )
+		Execute(job);
+
+	for(size_t i = 0; i < gScheduler->Queues.size(); ++i)
+		delete gScheduler->Queues[i];
+
+	delete gScheduler;
+	gScheduler = 0;
+}
+
+uint32_t JobSystem::GetThreadCount()
+{
+	return gScheduler ? (uint32_t)gScheduler->Workers.size() + 1 : 1;
+}
+
+void JobSystem::Run(JobFunction function, void* data, uint32_t first, uint32_t end,
+	JobCounter* counter, JobCounter* dependency)
+{
+	Job job;
+	job.Function = function;
+	job.Data     = data;
+	job.First    = first;
+	job.End      = end;
+	job.Counter  = counter;
+
+	if( counter )
+		++counter->mPending;
+
+	if( dependency )
+	{
+		std::lock_guard<std::mutex> lock(dependency->mMutex);
+		if( dependency->mPending != 0 )
+		{
+			dependency->mContinuations.push_back(job);
+			return;
+		}
+	}
+
+	Push(job);
+}
+
+void JobSystem::ParallelFor(JobFunction function, void* data, uint32_t count, uint32_t grainSize,
+	JobCounter* counter)
+{
+	assert(counter != 0);
+
+	if( count == 0 )
+		return;
+
+	if( grainSize == 0 )
+		grainSize = std::max(1u, count / (GetThreadCount()*4));
+
+	uint32_t numJobs = (count + grainSize - 1) / grainSize;
+	counter->mPending += numJobs;
+
+	// The owner pops from the back, so pushing the last range first makes it
+	// work through the range in order while thieves take the far end.
+	for(uint32_t i = numJobs; i > 0; --i)
+	{
+		Job job;
+		job.Function = function;
+		job.Data     = data;
+		job.First    = (i-1)*grainSize;
+		job.End      = std::min(count, i*grainSize);
+		job.Counter  = counter;
+
+		Push(job);
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while( !counter.IsDone() )
+	{
+		Job job;
+		if( TakeJob(job) )
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+
+	// The last job may still be inside Finish(); the counter must not go away
+	// before it leaves.
+	std::lock_guard<std::mutex> lock(counter.mMutex);
+}
+
+uint32_t JobSystem::GetJobsRun()
+{
+	return gScheduler ? (uint32_t)gScheduler->JobsRun : 0;
+}
+
+uint32_t JobSystem::GetJobsStolen()
+{
+	return gScheduler ? (uint32_t)gScheduler->JobsStolen : 0;
+}
+
+void JobSystem::Push(const Job& job)
+{
+	if( gScheduler == 0 )
+	{
+		Execute(job);
+		return;
+	}
+
+	JobQueue* queue = gScheduler->Queues[QueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue->Mutex);
+		queue->PushBack(job);
+	}
+
+	++gScheduler->Queued;
+
+	// Taking the lock orders this with a worker about to park.
+	{
+		std::lock_guard<std::mutex> lock(gScheduler->SleepMutex);
+	}
+	gScheduler->WakeUp.notify_one();
+}
+
+bool JobSystem::TakeJob(Job& job)
+{
+	if( gScheduler == 0 || gScheduler->Queued == 0 )
+		return false;
+
+	uint32_t self = QueueIndex();
+	uint32_t numQueues = (uint32_t)gScheduler->Queues.size();
+
+	// The newest job of our own queue is the one whose data is still in cache.
+	{
+		JobQueue* queue = gScheduler->Queues[self];
+		std::lock_guard<std::mutex> lock(queue->Mutex);
+
+		if( !queue->Empty() )
+		{
+			job = queue->PopBack();
+			--gScheduler->Queued;
+			return true;
+		}
+	}
+
+	// Steal the oldest job of another queue, which is likely the largest
+	// remaining piece of its work.
+	for(uint32_t i = 1; i < numQueues; ++i)
+	{
+		JobQueue* queue = gScheduler->Queues[(self + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue->Mutex);
+
+		if( !queue->Empty() )
+		{
+			job = queue->PopFront();
+			--gScheduler->Queued;
+			++gScheduler->JobsStolen;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	// A job's frame temporaries go with it; the thread may be a worker that is
+	// never reset, or a waiting thread whose own temporaries must survive.
+	FrameArena& arena = FrameArena::ForThread();
+	FrameArena::Marker marker = arena.GetMarker();
+
+	job.Function(job.Data, job.First, job.End);
+
+	arena.Rewind(marker);
+
+	if( gScheduler )
+		++gScheduler->JobsRun;
+
+	Finish(job.Counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if( counter == 0 )
+		return;
+
+	std::vector<Job> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->mMutex);
+
+		if( --counter->mPending == 0 )
+			continuations.swap(counter->mContinuations);
+	}
+
+	for(size_t i = 0; i < continuations.size(); ++i)
+		Push(continuations[i]);
+}
+
+void JobSystem::WorkerMain()
+{
+	// Wait until Init() has recorded our id.
+	{
+		std::lock_guard<std::mutex> lock(gScheduler->SleepMutex);
+	}
+
+	for(;;)
+	{
+		Job job;
+		if( TakeJob(job) )
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(gScheduler->SleepMutex);
+
+		while( gScheduler->Queued == 0 && !gScheduler->Quit )
+			gScheduler->WakeUp.wait(lock);
+
+		if( gScheduler->Quit && gScheduler->Queued == 0 )
+			return;
+	}
+}
@@ -0,0 +1,115 @@
+//***************************************************************************************
+// JobSystem.h
+//
+// One pool of worker threads shared by everything in Common that splits its work,
+// instead of each class starting and joining its own threads.
+//   -A job is a function, a data pointer and an item range.  Jobs are pushed onto
+//    the deque of the thread that creates them; a thread pops its own newest job
+//    and, when its deque is empty, steals the oldest job of another thread.
+//    Threads outside the pool share one deque.
+//   -A JobCounter counts a group of unfinished jobs.  A job can be made to wait for
+//    a counter; it is only queued when the counter reaches zero.
+//   -ParallelFor() splits a range into jobs of grainSize items.
+//   -Wait() runs queued jobs until the counter reaches zero, so the waiting thread
+//    helps instead of blocking.
+//   -Whatever a job allocates from its thread's FrameArena is freed when it returns.
+//
+// Before Init(), and with no workers, jobs run on the calling thread, so the
+// classes using it also work in tools that never start the pool.  D3DApp starts
+// it with one worker per hardware thread besides the main thread.  Has no Windows
+// dependencies, like the asset cooking code that uses it.
+//***************************************************************************************
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class JobCounter;
+
+// Runs the items [first, end) of data.
+typedef void (*JobFunction)(void* data, uint32_t first, uint32_t end);
+
+struct Job
+{
+	JobFunction Function;
+	void* Data;
+	uint32_t First;
+	uint32_t End;
+
+	// Decremented when the job is done; may be null.
+	JobCounter* Counter;
+};
+
+class JobCounter
+{
+public:
+	JobCounter();
+
+	bool IsDone()const;
+
+private:
+	JobCounter(const JobCounter& rhs);
+	JobCounter& operator=(const JobCounter& rhs);
+
+private:
+	friend class JobSystem;
+
+	std::atomic<long> mPending;
+
+	// Jobs queued when the counter reaches zero.
+	std::mutex mMutex;
+	std::vector<Job> mContinuations;
+};
+
+class JobSystem
+{
+public:
+	///<summary>
+	/// Starts the workers.  0 means one per hardware thread besides the caller.
+	///</summary>
+	static void Init(uint32_t numWorkers = 0);
+
+	///<summary>
+	/// Stops the workers after they finish the queued jobs.
+	///</summary>
+	static void Shutdown();
+
+	// Threads that run jobs: the workers and the thread that waits.
+	static uint32_t GetThreadCount();
+
+	///<summary>
+	/// Queues one job for the items [first, end).  If dependency is given the job
+	/// is queued once it reaches zero.
+	///</summary>
+	static void Run(JobFunction function, void* data, uint32_t first, uint32_t end,
+		JobCounter* counter, JobCounter* dependency = 0);
+
+	///<summary>
+	/// Queues the items [0, count) as jobs of grainSize items; 0 picks a grain
+	/// that gives each thread a few jobs.
+	///</summary>
+	static void ParallelFor(JobFunction function, void* data, uint32_t count, uint32_t grainSize,
+		JobCounter* counter);
+
+	///<summary>
+	/// Runs queued jobs until the counter reaches zero.
+	///</summary>
+	static void Wait(JobCounter& counter);
+
+	// Counts of jobs run since Init(), and of those taken from another deque.
+	static uint32_t GetJobsRun();
+	static uint32_t GetJobsStolen();
+
+private:
+	static void Push(const Job& job);
+	static bool TakeJob(Job& job);
+	static void Execute(const Job& job);
+	static void Finish(JobCounter* counter);
+	static void WorkerMain();
+};
+
+#endif // JOBSYSTEM_H
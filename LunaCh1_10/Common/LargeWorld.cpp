@@ -0,0 +1,100 @@
+//***************************************************************************************
+// LargeWorld.cpp
+//***************************************************************************************
+
+#include "LargeWorld.h"
+#include <emmintrin.h>
+
+WorldTransform::WorldTransform()
+{
+	XMStoreFloat3x3(&Linear, XMMatrixIdentity());
+}
+
+WorldTransform::WorldTransform(CXMMATRIX linear, const WorldPosition& translation)
+	: Translation(translation)
+{
+	XMStoreFloat3x3(&Linear, linear);
+}
+
+RenderOrigin::RenderOrigin()
+{
+}
+
+const WorldPosition& RenderOrigin::GetOrigin()const
+{
+	return mOrigin;
+}
+
+void RenderOrigin::SetCameraPosition(Camera& cam, const WorldPosition& eyeW)
+{
+	mOrigin = eyeW;
+	cam.SetPosition(0.0f, 0.0f, 0.0f);
+}
+
+void RenderOrigin::Recenter(Camera& cam)
+{
+	XMFLOAT3 offset = cam.GetPosition();
+
+	// Nothing to do if the camera did not move; this also keeps the camera's
+	// cached matrices valid.
+	if( offset.x == 0.0f && offset.y == 0.0f && offset.z == 0.0f )
+		return;
+
+	mOrigin.x += offset.x;
+	mOrigin.y += offset.y;
+	mOrigin.z += offset.z;
+
+	cam.SetPosition(0.0f, 0.0f, 0.0f);
+}
+
+XMFLOAT3 RenderOrigin::ToRender(const WorldPosition& p)const
+{
+	return XMFLOAT3(
+		static_cast<float>(p.x - mOrigin.x),
+		static_cast<float>(p.y - mOrigin.y),
+		static_cast<float>(p.z - mOrigin.z));
+}
+
+WorldPosition RenderOrigin::ToWorld(const XMFLOAT3& p)const
+{
+	return WorldPosition(mOrigin.x + p.x, mOrigin.y + p.y, mOrigin.z + p.z);
+}
+
+XMMATRIX RenderOrigin::RenderWorld(const WorldTransform& transform)const
+{
+	XMMATRIX W = XMLoadFloat3x3(&transform.Linear);
+
+	XMFLOAT3 t = ToRender(transform.Translation);
+	W.r[3] = XMVectorSet(t.x, t.y, t.z, 1.0f);
+
+	return W;
+}
+
+void RenderOrigin::RebaseTransforms(const WorldTransform* transforms, UINT count, XMFLOAT4X4* out)const
+{
+	// Origin is the same for every object, so load it once.
+	__m128d originXY = _mm_set_pd(mOrigin.y, mOrigin.x);
+	__m128d originZ  = _mm_set_sd(mOrigin.z);
+
+	XMVECTOR wOne = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		const WorldTransform& src = transforms[i];
+
+		// Relative translation in double, then narrow to float.  After the
+		// subtraction the values are small, so no precision is lost here.
+		__m128d xy = _mm_sub_pd(_mm_loadu_pd(&src.Translation.x), originXY);
+		__m128d z  = _mm_sub_sd(_mm_load_sd(&src.Translation.z), originZ);
+
+		__m128 t = _mm_movelh_ps(_mm_cvtpd_ps(xy), _mm_cvtpd_ps(z));
+
+		// (tx, ty, tz, 1)
+		XMVECTOR r3 = XMVectorSelect(wOne, t, XMVectorSelectControl(1, 1, 1, 0));
+
+		XMMATRIX W = XMLoadFloat3x3(&src.Linear);
+		W.r[3] = r3;
+
+		XMStoreFloat4x4(&out[i], W);
+	}
+}
@@ -0,0 +1,81 @@
+//***************************************************************************************
+// LargeWorld.h
+//
+// Support for worlds that are too large for single precision positions.
+//   -Object and camera positions are stored in double precision.
+//   -Each frame the float coordinate system is re-centered on the camera (the
+//    "render origin") and all world matrices are rebased to camera-relative
+//    float matrices in one batched pass.
+//
+// A float has 24 bits of mantissa, so at 10km from the origin positions can only be
+// represented to about a millimeter and vertices start to visibly jitter.  Relative
+// to the camera, everything close enough to see in detail is small again.
+//***************************************************************************************
+
+#ifndef LARGEWORLD_H
+#define LARGEWORLD_H
+
+#include "d3dUtil.h"
+#include "Camera.h"
+
+///<summary>
+/// Double precision world space position.
+///</summary>
+struct WorldPosition
+{
+	WorldPosition() : x(0.0), y(0.0), z(0.0) {}
+	WorldPosition(double px, double py, double pz) : x(px), y(py), z(pz) {}
+
+	double x;
+	double y;
+	double z;
+};
+
+///<summary>
+/// World transform of an object in a large world.  The rotation/scale part is
+/// small in magnitude and stays in float; only the translation needs double.
+///</summary>
+struct WorldTransform
+{
+	WorldTransform();
+	WorldTransform(CXMMATRIX linear, const WorldPosition& translation);
+
+	XMFLOAT3X3 Linear;
+	WorldPosition Translation;
+};
+
+///<summary>
+/// Tracks the double precision origin of the float coordinate system used for
+/// rendering.  The origin follows the camera, so the camera always sits at (0,0,0)
+/// in render space and the view matrix only contains the camera rotation.
+///</summary>
+class RenderOrigin
+{
+public:
+	RenderOrigin();
+
+	const WorldPosition& GetOrigin()const;
+
+	// Places the camera at the given world position and moves the origin there.
+	void SetCameraPosition(Camera& cam, const WorldPosition& eyeW);
+
+	// Camera::Walk/Strafe move the camera in render space.  Call once per frame
+	// after moving the camera to fold its offset back into the double origin.
+	void Recenter(Camera& cam);
+
+	// Conversions between world space and render (camera-relative) space.
+	XMFLOAT3 ToRender(const WorldPosition& p)const;
+	WorldPosition ToWorld(const XMFLOAT3& p)const;
+
+	// Camera-relative world matrix for a single object.
+	XMMATRIX RenderWorld(const WorldTransform& transform)const;
+
+	// Rebases count transforms to camera-relative float matrices.  The double
+	// subtraction and conversion is done with SSE2, two components at a time.
+	void RebaseTransforms(const WorldTransform* transforms, UINT count, XMFLOAT4X4* out)const;
+
+private:
+	WorldPosition mOrigin;
+};
+
+#endif // LARGEWORLD_H
@@ -0,0 +1,135 @@
+//***************************************************************************************
+// MemoryTracker.cpp
+//***************************************************************************************
+
+#include "MemoryTracker.h"
+#include <atomic>
+#include <cassert>
+#include <iomanip>
+
+namespace
+{
+	struct TagCounters
+	{
+		std::atomic<uint64_t> LiveBytes;
+		std::atomic<uint64_t> PeakBytes;
+		std::atomic<uint64_t> Allocations;
+		std::atomic<uint64_t> AllocatedBytes;
+
+		// Totals at the last EndFrame(), touched by that thread only.
+		uint64_t FrameStartAllocations;
+		uint64_t FrameStartBytes;
+
+		// Differences over the last frame.
+		std::atomic<uint64_t> FrameAllocations;
+		std::atomic<uint64_t> FrameBytes;
+	};
+
+	// Zero-initialized before any constructor runs, so allocations made during
+	// static initialization are counted too.
+	TagCounters gCounters[MemoryTracker::NumTags];
+
+	const char* gTagNames[MemoryTracker::NumTags] =
+	{
+		"General",
+		"Waves",
+		"Geometry",
+		"Textures",
+		"Models",
+		"FrameArenas"
+	};
+}
+
+void MemoryTracker::Allocate(Tag tag, size_t bytes)
+{
+	assert(tag < NumTags);
+	TagCounters& counters = gCounters[tag];
+
+	uint64_t live = counters.LiveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	counters.Allocations.fetch_add(1, std::memory_order_relaxed);
+	counters.AllocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+	// Another thread may raise the peak between the load and the exchange.
+	uint64_t peak = counters.PeakBytes.load(std::memory_order_relaxed);
+	while( live > peak && !counters.PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed) )
+	{
+	}
+}
+
+void MemoryTracker::Free(Tag tag, size_t bytes)
+{
+	assert(tag < NumTags);
+	gCounters[tag].LiveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryTracker::EndFrame()
+{
+	for(int t = 0; t < NumTags; ++t)
+	{
+		TagCounters& counters = gCounters[t];
+
+		uint64_t allocations = counters.Allocations.load(std::memory_order_relaxed);
+		uint64_t bytes = counters.AllocatedBytes.load(std::memory_order_relaxed);
+
+		counters.FrameAllocations.store(allocations - counters.FrameStartAllocations, std::memory_order_relaxed);
+		counters.FrameBytes.store(bytes - counters.FrameStartBytes, std::memory_order_relaxed);
+
+		counters.FrameStartAllocations = allocations;
+		counters.FrameStartBytes = bytes;
+	}
+}
+
+MemoryTracker::TagStats MemoryTracker::GetStats(Tag tag)
+{
+	assert(tag < NumTags);
+	const TagCounters& counters = gCounters[tag];
+
+	TagStats stats;
+	stats.LiveBytes        = counters.LiveBytes.load(std::memory_order_relaxed);
+	stats.PeakBytes        = counters.PeakBytes.load(std::memory_order_relaxed);
+	stats.Allocations      = counters.Allocations.load(std::memory_order_relaxed);
+	stats.FrameAllocations = counters.FrameAllocations.load(std::memory_order_relaxed);
+	stats.FrameBytes       = counters.FrameBytes.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+const char* MemoryTracker::GetTagName(Tag tag)
+{
+	assert(tag < NumTags);
+	return gTagNames[tag];
+}
+
+uint64_t MemoryTracker::GetTotalLiveBytes()
+{
+	uint64_t total = 0;
+	for(int t = 0; t < NumTags; ++t)
+		total += gCounters[t].LiveBytes.load(std::memory_order_relaxed);
+
+	return total;
+}
+
+void MemoryTracker::WriteReport(std::ostream& out)
+{
+	out << std::left << std::setw(14) << "Tag"
+		<< std::right << std::setw(14) << "Live KB"
+		<< std::setw(14) << "Peak KB"
+		<< std::setw(14) << "Allocations"
+		<< std::setw(14) << "Allocs/frame"
+		<< std::setw(14) << "KB/frame" << "\n";
+
+	for(int t = 0; t < NumTags; ++t)
+	{
+		TagStats stats = GetStats((Tag)t);
+
+		out << std::left << std::setw(14) << gTagNames[t]
+			<< std::right << std::setw(14) << stats.LiveBytes/1024
+			<< std::setw(14) << stats.PeakBytes/1024
+			<< std::setw(14) << stats.Allocations
+			<< std::setw(14) << stats.FrameAllocations
+			<< std::setw(14) << stats.FrameBytes/1024 << "\n";
+	}
+
+	out << std::left << std::setw(14) << "Total"
+		<< std::right << std::setw(14) << GetTotalLiveBytes()/1024 << "\n";
+}
@@ -0,0 +1,131 @@
+//***************************************************************************************
+// MemoryTracker.h
+//
+// Counts the memory each subsystem holds.
+//   -Code that owns memory reports it with Allocate() and Free() under a tag.  For
+//    STL containers, TrackedAllocator<T, Tag> does this itself.
+//   -Each tag keeps its live and peak bytes and how many allocations it made.
+//    EndFrame(), which D3DApp calls once per frame, latches the allocations and
+//    bytes of the frame just finished.
+//   -WriteReport() prints all of it; D3DApp writes MemoryReport.txt on F8.
+//
+// The counters are relaxed atomics and nothing takes a lock, so it is cheap enough
+// to leave on in release builds.  Memory nobody reports (the CRT, the driver,
+// assimp's internals) is not counted; the Models tag holds assimp's own estimate of
+// each scene.  Has no Windows dependencies.
+//***************************************************************************************
+
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <ostream>
+
+class MemoryTracker
+{
+public:
+	enum Tag
+	{
+		General,
+		Waves,
+		Geometry,
+		Textures,
+		Models,
+		FrameArenas,
+		NumTags
+	};
+
+	struct TagStats
+	{
+		uint64_t LiveBytes;
+		uint64_t PeakBytes;
+		uint64_t Allocations;
+
+		// Of the last frame passed to EndFrame().
+		uint64_t FrameAllocations;
+		uint64_t FrameBytes;
+	};
+
+public:
+	static void Allocate(Tag tag, size_t bytes);
+	static void Free(Tag tag, size_t bytes);
+
+	///<summary>
+	/// Latches the allocations made since the last call as the frame's.
+	///</summary>
+	static void EndFrame();
+
+	static TagStats GetStats(Tag tag);
+	static const char* GetTagName(Tag tag);
+
+	// Sum of the live bytes of every tag.
+	static uint64_t GetTotalLiveBytes();
+
+	///<summary>
+	/// Writes a table of every tag's counters.
+	///</summary>
+	static void WriteReport(std::ostream& out);
+};
+
+//---------------------------------------------------------------------------------------
+// A std::allocator that reports what it allocates under a tag.
+//---------------------------------------------------------------------------------------
+
+template<class T, MemoryTracker::Tag tag>
+class TrackedAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef TrackedAllocator<U, tag> other;
+	};
+
+	TrackedAllocator() {}
+
+	template<class U>
+	TrackedAllocator(const TrackedAllocator<U, tag>&) {}
+
+	T* allocate(size_t count)
+	{
+		T* p = static_cast<T*>(::operator new(count*sizeof(T)));
+		MemoryTracker::Allocate(tag, count*sizeof(T));
+
+		return p;
+	}
+
+	void deallocate(T* p, size_t count)
+	{
+		MemoryTracker::Free(tag, count*sizeof(T));
+		::operator delete(p);
+	}
+
+	size_t max_size()const
+	{
+		return ((size_t)-1) / sizeof(T);
+	}
+};
+
+template<class T, class U, MemoryTracker::Tag tag>
+bool operator==(const TrackedAllocator<T, tag>&, const TrackedAllocator<U, tag>&)
+{
+	return true;
+}
+
+template<class T, class U, MemoryTracker::Tag tag>
+bool operator!=(const TrackedAllocator<T, tag>&, const TrackedAllocator<U, tag>&)
+{
+	return false;
+}
+
+#endif // MEMORYTRACKER_H
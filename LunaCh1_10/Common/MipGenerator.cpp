@@ -0,0 +1,503 @@
+//***************************************************************************************
+// MipGenerator.cpp
+//***************************************************************************************
+
+#include "MipGenerator.h"
+#include "JobSystem.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// Entries of the linear to 8-bit table; fine enough that the steep start of the
+	// sRGB curve is off by less than a quarter of a step.
+	const uint32_t LinearTableSize = 16384;
+
+	// Bands of fewer rows are not worth a job.
+	const uint32_t MinRowsPerJob = 16;
+
+	///<summary>
+	/// Contributions of source texels to each destination texel along one axis.  The
+	/// taps of destination texel i are [First[i], First[i+1]).
+	///</summary>
+	struct FilterTaps
+	{
+		std::vector<uint32_t> First;
+		std::vector<uint32_t> Index;
+		std::vector<float> Weight;
+	};
+
+	float SRGBToLinear(float c)
+	{
+		return c <= 0.04045f ? c/12.92f : powf((c + 0.055f)/1.055f, 2.4f);
+	}
+
+	float LinearToSRGB(float c)
+	{
+		return c <= 0.0031308f ? c*12.92f : 1.055f*powf(c, 1.0f/2.4f) - 0.055f;
+	}
+
+	float Sinc(float x)
+	{
+		if( fabsf(x) < 1e-4f )
+			return 1.0f;
+
+		x *= Pi;
+		return sinf(x)/x;
+	}
+
+	// Zeroth order modified Bessel function of the first kind, from its power series.
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+
+		for(int k = 1; k < 32 && term > sum*1e-8f; ++k)
+		{
+			float t = x/(2.0f*k);
+			term *= t*t;
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	// Half width of the filter in destination texels.
+	float FilterRadius(MipGenerator::Filter filter)
+	{
+		return filter == MipGenerator::FilterBox ? 0.5f : 3.0f;
+	}
+
+	// Weight of a source texel x destination texels away from the destination center.
+	float EvaluateFilter(MipGenerator::Filter filter, float x)
+	{
+		switch( filter )
+		{
+		case MipGenerator::FilterKaiser:
+			{
+				const float alpha = 4.0f;
+				float t = x/FilterRadius(filter);
+				if( fabsf(t) >= 1.0f )
+					return 0.0f;
+
+				return Sinc(x) * BesselI0(alpha*sqrtf(1.0f - t*t)) / BesselI0(alpha);
+			}
+
+		case MipGenerator::FilterLanczos:
+			if( fabsf(x) >= 3.0f )
+				return 0.0f;
+
+			return Sinc(x) * Sinc(x/3.0f);
+
+		case MipGenerator::FilterBox:
+			break;
+		}
+
+		return fabsf(x) <= 0.5f ? 1.0f : 0.0f;
+	}
+
+	uint32_t AddressTexel(int i, uint32_t size, bool wrap)
+	{
+		if( wrap )
+		{
+			int m = i % (int)size;
+			return (uint32_t)(m < 0 ? m + (int)size : m);
+		}
+
+		return (uint32_t)std::min(std::max(i, 0), (int)size - 1);
+	}
+
+	void BuildTaps(MipGenerator::Filter filter, bool wrap, uint32_t srcSize, uint32_t dstSize, FilterTaps& taps)
+	{
+		taps.First.clear();
+		taps.Index.clear();
+		taps.Weight.clear();
+
+		float scale = (float)srcSize/dstSize;
+		float support = FilterRadius(filter)*scale;
+
+		for(uint32_t dst = 0; dst < dstSize; ++dst)
+		{
+			uint32_t first = (uint32_t)taps.Index.size();
+			taps.First.push_back(first);
+
+			float center = (dst + 0.5f)*scale;
+			int lo = (int)floorf(center - support);
+			int hi = (int)ceilf(center + support);
+
+			float total = 0.0f;
+			for(int i = lo; i < hi; ++i)
+			{
+				float w;
+				if( filter == MipGenerator::FilterBox )
+				{
+					// Area of the source texel inside the destination texel, so odd sizes
+					// are weighted exactly.
+					w = std::min(i + 1.0f, center + 0.5f*scale) - std::max((float)i, center - 0.5f*scale);
+					if( w <= 0.0f )
+						continue;
+				}
+				else
+				{
+					w = EvaluateFilter(filter, (i + 0.5f - center)/scale);
+					if( w == 0.0f )
+						continue;
+				}
+
+				taps.Index.push_back(AddressTexel(i, srcSize, wrap));
+				taps.Weight.push_back(w);
+				total += w;
+			}
+
+			for(size_t t = first; t < taps.Weight.size(); ++t)
+				taps.Weight[t] /= total;
+		}
+
+		taps.First.push_back((uint32_t)taps.Index.size());
+	}
+
+	//
+	// Passes over image rows.  Run() processes rows [firstRow, endRow) so ParallelRows()
+	// can hand bands of rows to jobs.
+	//
+
+	// Filters each row of Src (SrcWidth texels) into Dst (DstWidth texels).
+	struct HorizontalPass
+	{
+		const float* Src;
+		uint32_t SrcWidth;
+		float* Dst;
+		uint32_t DstWidth;
+		const FilterTaps* Taps;
+
+		void Run(uint32_t firstRow, uint32_t endRow)const
+		{
+			const uint32_t* first = &Taps->First[0];
+			const uint32_t* index = &Taps->Index[0];
+			const float* weight = &Taps->Weight[0];
+
+			for(uint32_t y = firstRow; y < endRow; ++y)
+			{
+				const float* src = Src + (size_t)y*SrcWidth*4;
+				float* dst = Dst + (size_t)y*DstWidth*4;
+
+				// A texel's four channels make one vector.
+				for(uint32_t x = 0; x < DstWidth; ++x)
+				{
+					__m128 sum = _mm_setzero_ps();
+					for(uint32_t t = first[x]; t < first[x+1]; ++t)
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[t]), _mm_loadu_ps(src + index[t]*4)));
+
+					_mm_storeu_ps(dst + x*4, sum);
+				}
+			}
+		}
+	};
+
+	// Filters the columns of Src into Dst, both Width texels wide.
+	struct VerticalPass
+	{
+		const float* Src;
+		float* Dst;
+		uint32_t Width;
+		const FilterTaps* Taps;
+
+		void Run(uint32_t firstRow, uint32_t endRow)const
+		{
+			size_t rowFloats = (size_t)Width*4;
+
+			for(uint32_t y = firstRow; y < endRow; ++y)
+			{
+				float* dst = Dst + y*rowFloats;
+
+				// Accumulate whole source rows, four floats at a time.
+				for(uint32_t t = Taps->First[y]; t < Taps->First[y+1]; ++t)
+				{
+					const float* src = Src + Taps->Index[t]*rowFloats;
+					__m128 w = _mm_set1_ps(Taps->Weight[t]);
+
+					if( t == Taps->First[y] )
+					{
+						for(size_t i = 0; i < rowFloats; i += 4)
+							_mm_storeu_ps(dst + i, _mm_mul_ps(w, _mm_loadu_ps(src + i)));
+					}
+					else
+					{
+						for(size_t i = 0; i < rowFloats; i += 4)
+							_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+					}
+				}
+			}
+		}
+	};
+
+	// Converts linear float texels to RGBA8, scaling alpha on the way.
+	struct EncodePass
+	{
+		const float* Src;
+		uint8_t* Dst;
+		uint32_t Width;
+		float AlphaScale;
+		const uint8_t* FromLinear;
+
+		void Run(uint32_t firstRow, uint32_t endRow)const
+		{
+			const __m128 scale = _mm_setr_ps(1.0f, 1.0f, 1.0f, AlphaScale);
+			const __m128 zero  = _mm_setzero_ps();
+			const __m128 one   = _mm_set1_ps(1.0f);
+			const __m128 tableScale = _mm_set1_ps((float)(LinearTableSize - 1));
+
+			for(uint32_t y = firstRow; y < endRow; ++y)
+			{
+				const float* src = Src + (size_t)y*Width*4;
+				uint8_t* dst = Dst + (size_t)y*Width*4;
+
+				for(uint32_t x = 0; x < Width; ++x)
+				{
+					__m128 c = _mm_mul_ps(_mm_loadu_ps(src + x*4), scale);
+					c = _mm_min_ps(_mm_max_ps(c, zero), one);
+
+					// Rounds to the nearest table entry.
+					__m128i i = _mm_cvtps_epi32(_mm_mul_ps(c, tableScale));
+
+					int32_t index[4];
+					_mm_storeu_si128((__m128i*)index, i);
+
+					float alpha[4];
+					_mm_storeu_ps(alpha, c);
+
+					dst[x*4 + 0] = FromLinear[index[0]];
+					dst[x*4 + 1] = FromLinear[index[1]];
+					dst[x*4 + 2] = FromLinear[index[2]];
+					dst[x*4 + 3] = (uint8_t)(alpha[3]*255.0f + 0.5f);
+				}
+			}
+		}
+	};
+
+	template<typename Pass>
+	void RunPassJob(void* pass, uint32_t firstRow, uint32_t endRow)
+	{
+		static_cast<const Pass*>(pass)->Run(firstRow, endRow);
+	}
+
+	template<typename Pass>
+	void ParallelRows(const Pass& pass, uint32_t numRows, uint32_t numJobs)
+	{
+		if( numJobs == 1 || numRows < MinRowsPerJob*2 )
+		{
+			pass.Run(0, numRows);
+			return;
+		}
+
+		if( numJobs == 0 )
+			numJobs = JobSystem::GetThreadCount()*4;
+
+		uint32_t grainSize = std::max(MinRowsPerJob, (numRows + numJobs - 1)/numJobs);
+
+		// The calling thread works on the bands too while it waits.
+		JobCounter counter;
+		JobSystem::ParallelFor(&RunPassJob<Pass>, const_cast<Pass*>(&pass), numRows, grainSize, &counter);
+		JobSystem::Wait(counter);
+	}
+
+	float AlphaCoverage(const std::vector<float>& level, float alphaScale, float alphaReference)
+	{
+		size_t numTexels = level.size()/4;
+		size_t passed = 0;
+
+		for(size_t i = 0; i < numTexels; ++i)
+		{
+			if( level[i*4 + 3]*alphaScale > alphaReference )
+				++passed;
+		}
+
+		return (float)passed/numTexels;
+	}
+}
+
+MipGenerator::Options::Options()
+	: MipFilter(FilterBox),
+	  SRGB(false),
+	  Wrap(false),
+	  PreserveAlphaCoverage(false),
+	  AlphaReference(0.5f),
+	  MaxLevels(0),
+	  NumThreads(0)
+{
+}
+
+uint32_t MipGenerator::GetLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for(uint32_t size = std::max(width, height); size > 1; size /= 2)
+		++levels;
+
+	return levels;
+}
+
+void MipGenerator::Generate(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+	const Options& options, std::vector<std::vector<uint8_t> >& levels)
+{
+	uint32_t numLevels = GetLevelCount(width, height);
+	if( options.MaxLevels > 0 )
+		numLevels = std::min(numLevels, options.MaxLevels);
+
+	//
+	// Expand the top level to linear float.
+	//
+
+	float toLinear[256];
+	for(uint32_t i = 0; i < 256; ++i)
+		toLinear[i] = options.SRGB ? SRGBToLinear(i/255.0f) : i/255.0f;
+
+	std::vector<std::vector<float> > linear(numLevels);
+	linear[0].resize((size_t)width*height*4);
+
+	for(uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* src = rgba + (size_t)y*rowPitch;
+		float* dst = &linear[0][(size_t)y*width*4];
+
+		for(uint32_t x = 0; x < width*4; x += 4)
+		{
+			dst[x + 0] = toLinear[src[x + 0]];
+			dst[x + 1] = toLinear[src[x + 1]];
+			dst[x + 2] = toLinear[src[x + 2]];
+			dst[x + 3] = src[x + 3]/255.0f;
+		}
+	}
+
+	Downsample(options, width, height, linear);
+
+	std::vector<float> alphaScales;
+	ComputeAlphaScales(options, linear, alphaScales);
+
+	//
+	// Back to 8 bits.  The top level is copied so it round trips exactly.
+	//
+
+	std::vector<uint8_t> fromLinear(LinearTableSize);
+	for(uint32_t i = 0; i < LinearTableSize; ++i)
+	{
+		float c = (float)i/(LinearTableSize - 1);
+		fromLinear[i] = (uint8_t)((options.SRGB ? LinearToSRGB(c) : c)*255.0f + 0.5f);
+	}
+
+	levels.resize(numLevels);
+
+	levels[0].resize((size_t)width*height*4);
+	for(uint32_t y = 0; y < height; ++y)
+		std::copy(rgba + (size_t)y*rowPitch, rgba + (size_t)y*rowPitch + width*4, &levels[0][(size_t)y*width*4]);
+
+	uint32_t w = width;
+	uint32_t h = height;
+	for(uint32_t level = 1; level < numLevels; ++level)
+	{
+		w = std::max(1u, w/2);
+		h = std::max(1u, h/2);
+
+		levels[level].resize((size_t)w*h*4);
+
+		EncodePass pass = { &linear[level][0], &levels[level][0], w, alphaScales[level], &fromLinear[0] };
+		ParallelRows(pass, h, options.NumThreads);
+	}
+}
+
+void MipGenerator::Generate(const float* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+	const Options& options, std::vector<std::vector<float> >& levels)
+{
+	uint32_t numLevels = GetLevelCount(width, height);
+	if( options.MaxLevels > 0 )
+		numLevels = std::min(numLevels, options.MaxLevels);
+
+	levels.assign(numLevels, std::vector<float>());
+
+	levels[0].resize((size_t)width*height*4);
+	for(uint32_t y = 0; y < height; ++y)
+	{
+		const float* src = (const float*)((const uint8_t*)rgba + (size_t)y*rowPitch);
+		std::copy(src, src + width*4, &levels[0][(size_t)y*width*4]);
+	}
+
+	Downsample(options, width, height, levels);
+
+	std::vector<float> alphaScales;
+	ComputeAlphaScales(options, levels, alphaScales);
+
+	// Levels are filtered from unscaled alpha, so scale only after all are built.
+	for(uint32_t level = 1; level < numLevels; ++level)
+	{
+		if( alphaScales[level] == 1.0f )
+			continue;
+
+		std::vector<float>& texels = levels[level];
+		for(size_t i = 3; i < texels.size(); i += 4)
+			texels[i] = std::min(texels[i]*alphaScales[level], 1.0f);
+	}
+}
+
+void MipGenerator::Downsample(const Options& options, uint32_t width, uint32_t height,
+	std::vector<std::vector<float> >& levels)
+{
+	FilterTaps tapsX;
+	FilterTaps tapsY;
+	std::vector<float> rows;
+
+	uint32_t w = width;
+	uint32_t h = height;
+
+	for(size_t level = 1; level < levels.size(); ++level)
+	{
+		uint32_t dstW = std::max(1u, w/2);
+		uint32_t dstH = std::max(1u, h/2);
+
+		BuildTaps(options.MipFilter, options.Wrap, w, dstW, tapsX);
+		BuildTaps(options.MipFilter, options.Wrap, h, dstH, tapsY);
+
+		// Filter the rows of the level above, then the columns of the result.
+		rows.resize((size_t)h*dstW*4);
+		levels[level].resize((size_t)dstW*dstH*4);
+
+		HorizontalPass horizontal = { &levels[level-1][0], w, &rows[0], dstW, &tapsX };
+		ParallelRows(horizontal, h, options.NumThreads);
+
+		VerticalPass vertical = { &rows[0], &levels[level][0], dstW, &tapsY };
+		ParallelRows(vertical, dstH, options.NumThreads);
+
+		w = dstW;
+		h = dstH;
+	}
+}
+
+void MipGenerator::ComputeAlphaScales(const Options& options, const std::vector<std::vector<float> >& levels,
+	std::vector<float>& alphaScales)
+{
+	alphaScales.assign(levels.size(), 1.0f);
+
+	if( !options.PreserveAlphaCoverage )
+		return;
+
+	float target = AlphaCoverage(levels[0], 1.0f, options.AlphaReference);
+
+	// Coverage grows with the scale, so bisect for the scale that matches the top level.
+	for(size_t level = 1; level < levels.size(); ++level)
+	{
+		float lo = 0.0f;
+		float hi = 4.0f;
+
+		for(int i = 0; i < 16; ++i)
+		{
+			float mid = 0.5f*(lo + hi);
+			if( AlphaCoverage(levels[level], mid, options.AlphaReference) < target )
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		alphaScales[level] = 0.5f*(lo + hi);
+	}
+}
@@ -0,0 +1,88 @@
+//***************************************************************************************
+// MipGenerator.h
+//
+// Builds mip chains of RGBA8 and RGBA float images on the CPU.
+//   -Each level is resampled from the one above it with a separable filter: box,
+//    Kaiser windowed sinc or Lanczos (3 lobes).  The filters also handle odd sizes,
+//    where a level is not exactly half the one above it.
+//   -sRGB encoded color is converted to linear before filtering and back after, so
+//    the mips of bright and dark detail do not darken.
+//   -Alpha coverage preservation scales the alpha of each level so the fraction of
+//    texels passing an alpha test matches the top level, which keeps cutout foliage
+//    and fences from thinning out in the distance.
+//   -Texels are filtered as four-wide SSE2 vectors, and the rows of each pass are
+//    split into jobs for the JobSystem.
+//
+// Like BCEncoder it has no Windows or D3D dependencies, so it can be used by asset
+// cooking tools on any platform.  TextureDecoder::GenerateMips() applies it to
+// decoded textures.
+//***************************************************************************************
+
+#ifndef MIPGENERATOR_H
+#define MIPGENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MipGenerator
+{
+public:
+	enum Filter
+	{
+		FilterBox,
+		FilterKaiser,
+		FilterLanczos
+	};
+
+	struct Options
+	{
+		Options();
+
+		Filter MipFilter;
+
+		// RGBA8 color channels are sRGB encoded.  Float images are always linear.
+		bool SRGB;
+
+		// Filters across the edges of tiling textures instead of clamping.
+		bool Wrap;
+
+		bool PreserveAlphaCoverage;
+		float AlphaReference;
+
+		// Levels to produce, including the top level.  0 makes a full chain.
+		uint32_t MaxLevels;
+
+		// Jobs each pass is split into on the JobSystem.  0 picks a few per thread
+		// and 1 runs on the calling thread.
+		uint32_t NumThreads;
+	};
+
+public:
+	static uint32_t GetLevelCount(uint32_t width, uint32_t height);
+
+	///<summary>
+	/// Builds the mip chain of a width x height RGBA8 image; rowPitch is the number
+	/// of bytes between rows of the source.  Each level is returned tightly packed;
+	/// levels[0] is a copy of the source.
+	///</summary>
+	static void Generate(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+		const Options& options, std::vector<std::vector<uint8_t> >& levels);
+
+	///<summary>
+	/// Float version of the above, four floats per texel.
+	///</summary>
+	static void Generate(const float* rgba, uint32_t width, uint32_t height, uint32_t rowPitch,
+		const Options& options, std::vector<std::vector<float> >& levels);
+
+private:
+	// Filters linear float levels[0] down into the rest of the chain.
+	static void Downsample(const Options& options, uint32_t width, uint32_t height,
+		std::vector<std::vector<float> >& levels);
+
+	// Alpha scale of each level that matches its alpha test coverage to the top level.
+	static void ComputeAlphaScales(const Options& options, const std::vector<std::vector<float> >& levels,
+		std::vector<float>& alphaScales);
+};
+
+#endif // MIPGENERATOR_H
@@ -0,0 +1,200 @@
+//***************************************************************************************
+// ModelImporter.cpp
+//***************************************************************************************
+
+#include "ModelImporter.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+namespace
+{
+	// A mesh being converted, and the job converting it.
+	struct Slot
+	{
+		const aiMesh* Source;
+		ModelImporter::Mesh Output;
+		JobCounter Counter;
+	};
+}
+
+ModelImporter::ModelImporter()
+{
+}
+
+bool ModelImporter::Import(const std::string& filename, unsigned int postProcessFlags, Consumer& consumer)
+{
+	mError.clear();
+
+	Assimp::Importer importer;
+	if( importer.ReadFile(filename, postProcessFlags | aiProcess_Triangulate) == 0 )
+	{
+		mError = importer.GetErrorString();
+		return false;
+	}
+
+	// Take the scene from the importer so each mesh can be deleted as soon as it
+	// has been consumed.
+	aiScene* scene = importer.GetOrphanedScene();
+	uint32_t numMeshes = scene->mNumMeshes;
+
+	std::vector<uint32_t> baseVertices(numMeshes);
+	std::vector<uint32_t> startIndices(numMeshes);
+	std::vector<size_t> sourceBytes(numMeshes);
+
+	uint32_t numVertices = 0;
+	uint32_t numIndices = 0;
+	for(uint32_t m = 0; m < numMeshes; ++m)
+	{
+		const aiMesh& source = *scene->mMeshes[m];
+
+		baseVertices[m] = numVertices;
+		startIndices[m] = numIndices;
+
+		numVertices += source.mNumVertices;
+		numIndices  += CountTriangleIndices(source);
+
+		sourceBytes[m] = GetMeshBytes(source);
+		MemoryTracker::Allocate(MemoryTracker::Models, sourceBytes[m]);
+	}
+
+	consumer.BeginModel(numMeshes, numVertices, numIndices);
+
+	Slot slots[MaxMeshesInFlight];
+
+	uint32_t next = 0;
+	for(uint32_t m = 0; m < numMeshes; ++m)
+	{
+		// Keep the slots busy: start every mesh that has a free slot.
+		for( ; next < numMeshes && next < m + MaxMeshesInFlight; ++next)
+		{
+			Slot& slot = slots[next % MaxMeshesInFlight];
+
+			slot.Source            = scene->mMeshes[next];
+			slot.Output.Index      = next;
+			slot.Output.BaseVertex = baseVertices[next];
+			slot.Output.StartIndex = startIndices[next];
+
+			JobSystem::Run(&ModelImporter::ConvertJob, &slot, 0, 1, &slot.Counter);
+		}
+
+		Slot& slot = slots[m % MaxMeshesInFlight];
+		JobSystem::Wait(slot.Counter);
+
+		consumer.ConsumeMesh(slot.Output);
+
+		// aiScene's destructor skips the null entries.
+		delete scene->mMeshes[m];
+		scene->mMeshes[m] = 0;
+		MemoryTracker::Free(MemoryTracker::Models, sourceBytes[m]);
+	}
+
+	delete scene;
+
+	return true;
+}
+
+const std::string& ModelImporter::GetError()const
+{
+	return mError;
+}
+
+uint32_t ModelImporter::CountTriangleIndices(const aiMesh& source)
+{
+	// SortByPType leaves meshes of one primitive type, which need no scan.
+	if( source.mPrimitiveTypes == aiPrimitiveType_TRIANGLE )
+		return 3*source.mNumFaces;
+
+	uint32_t count = 0;
+	for(uint32_t f = 0; f < source.mNumFaces; ++f)
+	{
+		if( source.mFaces[f].mNumIndices == 3 )
+			count += 3;
+	}
+
+	return count;
+}
+
+void ModelImporter::ConvertMesh(const aiMesh& source, Mesh& mesh)
+{
+	mesh.Vertices.resize(source.mNumVertices);
+	mesh.Indices.resize(CountTriangleIndices(source));
+
+	bool hasNormals = source.HasNormals();
+	bool hasTexC    = source.HasTextureCoords(0);
+	bool hasColors  = source.HasVertexColors(0);
+
+	for(uint32_t i = 0; i < source.mNumVertices; ++i)
+	{
+		Vertex& v = mesh.Vertices[i];
+
+		const aiVector3D& p = source.mVertices[i];
+		v.Position[0] = p.x;
+		v.Position[1] = p.y;
+		v.Position[2] = p.z;
+
+		const aiVector3D n = hasNormals ? source.mNormals[i] : aiVector3D(0.0f, 0.0f, 0.0f);
+		v.Normal[0] = n.x;
+		v.Normal[1] = n.y;
+		v.Normal[2] = n.z;
+
+		const aiVector3D t = hasTexC ? source.mTextureCoords[0][i] : aiVector3D(0.0f, 0.0f, 0.0f);
+		v.TexC[0] = t.x;
+		v.TexC[1] = t.y;
+
+		const aiColor4D c = hasColors ? source.mColors[0][i] : aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
+		v.Color[0] = c.r;
+		v.Color[1] = c.g;
+		v.Color[2] = c.b;
+		v.Color[3] = c.a;
+	}
+
+	uint32_t k = 0;
+	for(uint32_t f = 0; f < source.mNumFaces; ++f)
+	{
+		const aiFace& face = source.mFaces[f];
+		if( face.mNumIndices != 3 )
+			continue;
+
+		mesh.Indices[k++] = mesh.BaseVertex + face.mIndices[0];
+		mesh.Indices[k++] = mesh.BaseVertex + face.mIndices[1];
+		mesh.Indices[k++] = mesh.BaseVertex + face.mIndices[2];
+	}
+}
+
+void ModelImporter::ConvertJob(void* data, uint32_t /*first*/, uint32_t /*end*/)
+{
+	Slot* slot = static_cast<Slot*>(data);
+	ConvertMesh(*slot->Source, slot->Output);
+}
+
+size_t ModelImporter::GetMeshBytes(const aiMesh& source)
+{
+	size_t perVertex = sizeof(aiVector3D);
+
+	if( source.HasNormals() )
+		perVertex += sizeof(aiVector3D);
+	if( source.HasTangentsAndBitangents() )
+		perVertex += 2*sizeof(aiVector3D);
+
+	for(uint32_t c = 0; c < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++c)
+	{
+		if( source.HasTextureCoords(c) )
+			perVertex += sizeof(aiVector3D);
+	}
+
+	for(uint32_t c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; ++c)
+	{
+		if( source.HasVertexColors(c) )
+			perVertex += sizeof(aiColor4D);
+	}
+
+	size_t bytes = sizeof(aiMesh) + perVertex*source.mNumVertices;
+	for(uint32_t f = 0; f < source.mNumFaces; ++f)
+		bytes += sizeof(aiFace) + sizeof(unsigned int)*source.mFaces[f].mNumIndices;
+
+	return bytes;
+}
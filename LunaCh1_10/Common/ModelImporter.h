@@ -0,0 +1,104 @@
+//***************************************************************************************
+// ModelImporter.h
+//
+// Imports models through assimp and hands their meshes over one at a time, so
+// large models never need a second full copy of the scene in memory.
+//   -Each aiMesh is converted on the JobSystem into its own Mesh.  The vertex and
+//    index arrays are sized from mNumVertices and mNumFaces before the job starts,
+//    and the job writes into them directly.
+//   -Where each mesh starts in the model is known from those counts too, so its
+//    indices are already offset to the model's vertices when they arrive.
+//   -Meshes are given to the Consumer in scene order on the thread that called
+//    Import(), while the next few still convert.  Once the Consumer returns, the
+//    aiMesh is deleted and its Mesh reused, so the converted copy of the model is
+//    never more than MaxMeshesInFlight meshes.
+//
+// Only triangles are kept; points and lines are skipped.  Has no Windows
+// dependencies.
+//***************************************************************************************
+
+#ifndef MODELIMPORTER_H
+#define MODELIMPORTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct aiMesh;
+
+class ModelImporter
+{
+public:
+	struct Vertex
+	{
+		float Position[3];
+		float Normal[3];
+		float TexC[2];
+
+		// White if the mesh has no vertex colors.
+		float Color[4];
+	};
+
+	struct Mesh
+	{
+		// Index of the aiMesh in the scene.
+		uint32_t Index;
+
+		// Where the mesh's vertices and indices start in the whole model.
+		uint32_t BaseVertex;
+		uint32_t StartIndex;
+
+		std::vector<Vertex> Vertices;
+
+		// Three per triangle, already offset by BaseVertex.
+		std::vector<uint32_t> Indices;
+	};
+
+	class Consumer
+	{
+	public:
+		virtual ~Consumer() {}
+
+		///<summary>
+		/// Called once, before the first mesh, with the size of the whole model.
+		///</summary>
+		virtual void BeginModel(uint32_t numMeshes, uint32_t numVertices, uint32_t numIndices) = 0;
+
+		///<summary>
+		/// Called for each mesh in scene order.  The mesh is reused once this returns.
+		///</summary>
+		virtual void ConsumeMesh(const Mesh& mesh) = 0;
+	};
+
+	// Meshes converted ahead of the one being consumed.
+	static const uint32_t MaxMeshesInFlight = 4;
+
+public:
+	ModelImporter();
+
+	///<summary>
+	/// Reads the file with the aiPostProcessSteps flags (aiProcess_Triangulate is
+	/// always added) and streams its meshes to the consumer.
+	///</summary>
+	bool Import(const std::string& filename, unsigned int postProcessFlags, Consumer& consumer);
+
+	// Why the last Import() failed.
+	const std::string& GetError()const;
+
+private:
+	ModelImporter(const ModelImporter& rhs);
+	ModelImporter& operator=(const ModelImporter& rhs);
+
+	static uint32_t CountTriangleIndices(const aiMesh& source);
+	static void ConvertMesh(const aiMesh& source, Mesh& mesh);
+	// One slot per job, so the item range is unused.
+	static void ConvertJob(void* data, uint32_t first, uint32_t end);
+
+	// Roughly what assimp holds for the mesh, for MemoryTracker.
+	static size_t GetMeshBytes(const aiMesh& source);
+
+private:
+	std::string mError;
+};
+
+#endif // MODELIMPORTER_H
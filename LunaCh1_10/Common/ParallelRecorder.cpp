@@ -0,0 +1,162 @@
+//***************************************************************************************
+// ParallelRecorder.cpp
+//***************************************************************************************
+
+#include "ParallelRecorder.h"
+
+namespace
+{
+	// Fewer items than this per range are not worth a job.
+	const UINT MinItemsPerThread = 256;
+}
+
+ParallelRecorder::ParallelRecorder()
+	: mNumThreads(1), mActiveThreads(0)
+{
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+	for(size_t i = 0; i < mCommandLists.size(); ++i)
+		ReleaseCOM(mCommandLists[i]);
+
+	for(size_t i = 0; i < mDeferredContexts.size(); ++i)
+		ReleaseCOM(mDeferredContexts[i]);
+}
+
+void ParallelRecorder::Init(ID3D11Device* device, UINT numThreads)
+{
+	mNumThreads = numThreads > 0 ? numThreads : JobSystem::GetThreadCount();
+
+	mBuffers.resize(mNumThreads);
+	mActiveThreads = 0;
+
+	if( device == 0 )
+		return;
+
+	// Deferred contexts work on every driver, but without driver command lists
+	// the runtime emulates them and replaying on them saves nothing.
+	D3D11_FEATURE_DATA_THREADING threading;
+	HR(device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading)));
+
+	if( !threading.DriverCommandLists )
+		return;
+
+	mDeferredContexts.resize(mNumThreads, 0);
+	mCommandLists.resize(mNumThreads, 0);
+
+	for(UINT t = 0; t < mNumThreads; ++t)
+		HR(device->CreateDeferredContext(0, &mDeferredContexts[t]));
+}
+
+void ParallelRecorder::Record(Job& job, UINT numItems)
+{
+	mActiveThreads = MathHelper::Min(mNumThreads, MathHelper::Max(1u, numItems / MinItemsPerThread));
+
+	// Each range is a job; the calling thread records too while it waits.
+	RecordJob record;
+	record.Recorder = this;
+	record.RecordingJob = &job;
+	record.NumItems = numItems;
+
+	JobCounter counter;
+	JobSystem::ParallelFor(&ParallelRecorder::RecordRangesJob, &record, mActiveThreads, 1, &counter);
+	JobSystem::Wait(counter);
+}
+
+void ParallelRecorder::RecordRangesJob(void* job, UINT firstRange, UINT endRange)
+{
+	const RecordJob& record = *static_cast<const RecordJob*>(job);
+	UINT numRanges = record.Recorder->mActiveThreads;
+
+	for(UINT r = firstRange; r < endRange; ++r)
+	{
+		record.Recorder->RecordRange(record.RecordingJob, r, record.NumItems*r/numRanges,
+			record.NumItems*(r+1)/numRanges);
+	}
+}
+
+void ParallelRecorder::RecordRange(Job* job, UINT thread, UINT firstItem, UINT endItem)
+{
+	CommandBuffer& commands = mBuffers[thread];
+
+	commands.Clear();
+	job->Record(firstItem, endItem, commands);
+}
+
+void ParallelRecorder::Submit(ID3D11DeviceContext* immediate, CommandBuffer::Translator& translator)
+{
+	if( mDeferredContexts.empty() || !translator.IsThreadSafe() || mActiveThreads < 2 )
+	{
+		for(UINT t = 0; t < mActiveThreads; ++t)
+			mBuffers[t].Execute(immediate, translator);
+
+		return;
+	}
+
+	ReplayJob replay;
+	replay.Recorder = this;
+	replay.ReplayTranslator = &translator;
+
+	JobCounter counter;
+	JobSystem::ParallelFor(&ParallelRecorder::ReplayDeferredJob, &replay, mActiveThreads, 1, &counter);
+	JobSystem::Wait(counter);
+
+	// Executing restores the immediate context's state after each list.
+	for(UINT t = 0; t < mActiveThreads; ++t)
+	{
+		immediate->ExecuteCommandList(mCommandLists[t], TRUE);
+		ReleaseCOM(mCommandLists[t]);
+	}
+}
+
+void ParallelRecorder::ReplayDeferredJob(void* job, UINT firstRange, UINT endRange)
+{
+	const ReplayJob& replay = *static_cast<const ReplayJob*>(job);
+
+	for(UINT r = firstRange; r < endRange; ++r)
+		replay.Recorder->ReplayDeferred(replay.ReplayTranslator, r);
+}
+
+void ParallelRecorder::ReplayDeferred(CommandBuffer::Translator* translator, UINT thread)
+{
+	ID3D11DeviceContext* dc = mDeferredContexts[thread];
+
+	mBuffers[thread].Execute(dc, *translator);
+
+	HR(dc->FinishCommandList(FALSE, &mCommandLists[thread]));
+}
+
+void ParallelRecorder::Merge(CommandBuffer& commands)const
+{
+	for(UINT t = 0; t < mActiveThreads; ++t)
+		commands.Append(mBuffers[t]);
+}
+
+UINT ParallelRecorder::GetThreadCount()const
+{
+	return mNumThreads;
+}
+
+UINT ParallelRecorder::GetActiveThreadCount()const
+{
+	return mActiveThreads;
+}
+
+UINT ParallelRecorder::GetCommandCount()const
+{
+	UINT count = 0;
+	for(UINT t = 0; t < mActiveThreads; ++t)
+		count += mBuffers[t].GetCommandCount();
+
+	return count;
+}
+
+UINT ParallelRecorder::GetDrawCount()const
+{
+	UINT count = 0;
+	for(UINT t = 0; t < mActiveThreads; ++t)
+		count += mBuffers[t].GetDrawCount();
+
+	return count;
+}
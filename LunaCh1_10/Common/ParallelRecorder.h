@@ -0,0 +1,104 @@
+//***************************************************************************************
+// ParallelRecorder.h
+//
+// Records the draws of a scene on several threads and submits them in order.
+//   -Record() splits the scene's items (objects, cells, whatever the Job counts)
+//    into contiguous ranges, one per thread, run as JobSystem jobs.  Each range is
+//    traversed, culled and recorded into its own CommandBuffer; the calling thread
+//    records too while it waits.  Nothing is shared between the ranges.
+//   -Submit() replays the buffers in range order, so the result is the same as
+//    recording the whole scene on one thread.  With a thread-safe Translator each
+//    buffer is replayed on its own deferred context in parallel and the command
+//    lists are executed on the immediate context in order; otherwise the buffers
+//    are replayed on the immediate context one after the other.
+//   -Init() with a null device records only, for timing the CPU side headless.
+//***************************************************************************************
+
+#ifndef PARALLELRECORDER_H
+#define PARALLELRECORDER_H
+
+#include "CommandBuffer.h"
+#include "JobSystem.h"
+
+class ParallelRecorder
+{
+public:
+	class Job
+	{
+	public:
+		virtual ~Job() {}
+
+		// Records the items [firstItem, endItem).  Called on several threads at
+		// once, so it may only write to the commands it is given.
+		virtual void Record(UINT firstItem, UINT endItem, CommandBuffer& commands) = 0;
+	};
+
+public:
+	ParallelRecorder();
+	~ParallelRecorder();
+
+	///<summary>
+	/// Creates a deferred context per range if the device is given and supports
+	/// them natively.  0 threads means one per thread of the job system.
+	///</summary>
+	void Init(ID3D11Device* device, UINT numThreads);
+
+	///<summary>
+	/// Records numItems items of the job, split across the threads.
+	///</summary>
+	void Record(Job& job, UINT numItems);
+
+	///<summary>
+	/// Replays what was last recorded, in item order.
+	///</summary>
+	void Submit(ID3D11DeviceContext* immediate, CommandBuffer::Translator& translator);
+
+	///<summary>
+	/// Appends what was last recorded, in item order, to a single buffer.
+	///</summary>
+	void Merge(CommandBuffer& commands)const;
+
+	UINT GetThreadCount()const;
+
+	// Threads used by the last Record().
+	UINT GetActiveThreadCount()const;
+
+	UINT GetCommandCount()const;
+	UINT GetDrawCount()const;
+
+private:
+	struct RecordJob
+	{
+		ParallelRecorder* Recorder;
+		Job* RecordingJob;
+		UINT NumItems;
+	};
+
+	struct ReplayJob
+	{
+		ParallelRecorder* Recorder;
+		CommandBuffer::Translator* ReplayTranslator;
+	};
+
+	static void RecordRangesJob(void* job, UINT firstRange, UINT endRange);
+	static void ReplayDeferredJob(void* job, UINT firstRange, UINT endRange);
+
+	void RecordRange(Job* job, UINT thread, UINT firstItem, UINT endItem);
+	void ReplayDeferred(CommandBuffer::Translator* translator, UINT thread);
+
+private:
+	ParallelRecorder(const ParallelRecorder& rhs);
+	ParallelRecorder& operator=(const ParallelRecorder& rhs);
+
+private:
+	UINT mNumThreads;
+	UINT mActiveThreads;
+
+	std::vector<CommandBuffer> mBuffers;
+
+	// One per thread, or empty when replaying on the immediate context.
+	std::vector<ID3D11DeviceContext*> mDeferredContexts;
+	std::vector<ID3D11CommandList*> mCommandLists;
+};
+
+#endif // PARALLELRECORDER_H
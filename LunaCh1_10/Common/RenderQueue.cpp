@@ -0,0 +1,295 @@
+//***************************************************************************************
+// RenderQueue.cpp
+//***************************************************************************************
+
+#include "RenderQueue.h"
+
+namespace
+{
+	//
+	// Key fields, as (bits, shift).  Ids wider than their field only lose sorting
+	// quality; state changes are still detected from the full ids.
+	//
+
+	const UINT LayerBits = 4;        const UINT LayerShift = 60;
+	const UINT TranslucentShift = 59;
+
+	// Opaque packets.
+	const UINT BlendBits = 4;        const UINT OpaqueBlendShift = 55;
+	const UINT ShaderBits = 10;      const UINT OpaqueShaderShift = 45;
+	const UINT MaterialBits = 14;    const UINT OpaqueMaterialShift = 31;
+	const UINT GeometryBits = 7;     const UINT OpaqueGeometryShift = 24;
+	const UINT DepthBits = 24;       const UINT OpaqueDepthShift = 0;
+
+	// Blended packets.
+	const UINT TranslucentDepthShift = 35;
+	const UINT TranslucentBlendShift = 31;
+	const UINT TranslucentShaderShift = 21;
+	const UINT TranslucentMaterialShift = 7;
+	const UINT TranslucentGeometryShift = 0;
+
+	UINT64 Field(UINT value, UINT bits, UINT shift)
+	{
+		return (UINT64)(value & ((1u << bits) - 1)) << shift;
+	}
+}
+
+RenderQueue::Packet::Packet()
+	: Layer(0),
+	  Shader(0),
+	  Blend(OpaqueBlend),
+	  Material(0),
+	  Geometry(0),
+	  Object(0),
+	  Count(0),
+	  Start(0),
+	  BaseVertex(0),
+	  Depth(0.0f)
+{
+}
+
+RenderQueue::RenderQueue()
+	: mNearZ(1.0f), mFarZ(1000.0f)
+{
+	ZeroMemory(&mStats, sizeof(mStats));
+
+	// Blend id 0 is the default state.
+	mBlendStates.push_back(0);
+}
+
+void RenderQueue::SetDepthRange(float nearZ, float farZ)
+{
+	mNearZ = nearZ;
+	mFarZ  = farZ;
+}
+
+UINT RenderQueue::AddShader(ID3DX11EffectTechnique* technique, UINT pass, ID3D11InputLayout* inputLayout)
+{
+	Shader shader;
+	shader.Pass        = technique->GetPassByIndex(pass);
+	shader.InputLayout = inputLayout;
+
+	mShaders.push_back(shader);
+
+	return (UINT)mShaders.size() - 1;
+}
+
+UINT RenderQueue::AddBlendState(ID3D11BlendState* blendState)
+{
+	mBlendStates.push_back(blendState);
+
+	return (UINT)mBlendStates.size() - 1;
+}
+
+UINT RenderQueue::AddGeometry(ID3D11Buffer* vertexBuffer, UINT stride, ID3D11Buffer* indexBuffer,
+	DXGI_FORMAT indexFormat, D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	Geometry geometry;
+	geometry.VertexBuffer = vertexBuffer;
+	geometry.Stride       = stride;
+	geometry.IndexBuffer  = indexBuffer;
+	geometry.IndexFormat  = indexFormat;
+	geometry.Topology     = topology;
+
+	mGeometries.push_back(geometry);
+
+	return (UINT)mGeometries.size() - 1;
+}
+
+void RenderQueue::Submit(const Packet& packet)
+{
+	assert(packet.Shader < mShaders.size());
+	assert(packet.Blend < mBlendStates.size());
+	assert(packet.Geometry < mGeometries.size());
+
+	mPackets.push_back(packet);
+}
+
+void RenderQueue::Clear()
+{
+	mPackets.clear();
+}
+
+UINT RenderQueue::GetPacketCount()const
+{
+	return (UINT)mPackets.size();
+}
+
+const RenderQueue::Stats& RenderQueue::GetStats()const
+{
+	return mStats;
+}
+
+UINT64 RenderQueue::MakeKey(const Packet& packet)const
+{
+	float t = (packet.Depth - mNearZ) / (mFarZ - mNearZ);
+	UINT depth = (UINT)(MathHelper::Clamp(t, 0.0f, 1.0f) * ((1u << DepthBits) - 1));
+
+	UINT64 key = Field(packet.Layer, LayerBits, LayerShift);
+
+	if( packet.Blend == OpaqueBlend )
+	{
+		key |= Field(packet.Blend, BlendBits, OpaqueBlendShift);
+		key |= Field(packet.Shader, ShaderBits, OpaqueShaderShift);
+		key |= Field(packet.Material, MaterialBits, OpaqueMaterialShift);
+		key |= Field(packet.Geometry, GeometryBits, OpaqueGeometryShift);
+		key |= Field(depth, DepthBits, OpaqueDepthShift);
+	}
+	else
+	{
+		// Inverting the depth makes the furthest packets come first.
+		key |= (UINT64)1 << TranslucentShift;
+		key |= Field(~depth, DepthBits, TranslucentDepthShift);
+		key |= Field(packet.Blend, BlendBits, TranslucentBlendShift);
+		key |= Field(packet.Shader, ShaderBits, TranslucentShaderShift);
+		key |= Field(packet.Material, MaterialBits, TranslucentMaterialShift);
+		key |= Field(packet.Geometry, GeometryBits, TranslucentGeometryShift);
+	}
+
+	return key;
+}
+
+void RenderQueue::Sort()
+{
+	UINT numPackets = (UINT)mPackets.size();
+
+	mSorted.resize(numPackets);
+	mSortTemp.resize(numPackets);
+
+	for(UINT i = 0; i < numPackets; ++i)
+	{
+		mSorted[i].Key    = MakeKey(mPackets[i]);
+		mSorted[i].Packet = i;
+	}
+
+	// Least significant byte first.  Each pass is stable, so packets with equal
+	// keys stay in submission order.
+	for(UINT shift = 0; shift < 64; shift += 8)
+	{
+		UINT counts[256] = {0};
+		for(UINT i = 0; i < numPackets; ++i)
+			++counts[(mSorted[i].Key >> shift) & 0xFF];
+
+		// Nothing to do if every key has the same byte here.
+		if( counts[(mSorted[0].Key >> shift) & 0xFF] == numPackets )
+			continue;
+
+		UINT offsets[256];
+		UINT sum = 0;
+		for(UINT b = 0; b < 256; ++b)
+		{
+			offsets[b] = sum;
+			sum += counts[b];
+		}
+
+		for(UINT i = 0; i < numPackets; ++i)
+			mSortTemp[offsets[(mSorted[i].Key >> shift) & 0xFF]++] = mSorted[i];
+
+		mSorted.swap(mSortTemp);
+	}
+}
+
+void RenderQueue::Execute(ID3D11DeviceContext* dc, Binder& binder)
+{
+	ZeroMemory(&mStats, sizeof(mStats));
+
+	if( mPackets.empty() )
+		return;
+
+	Sort();
+
+	// Nothing is known to be bound when the walk starts.
+	ID3D11InputLayout* inputLayout = 0;
+	ID3D11BlendState* blendState = 0;
+	ID3D11Buffer* vertexBuffer = 0;
+	ID3D11Buffer* indexBuffer = 0;
+	D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	UINT material = 0;
+	bool first = true;
+
+	float blendFactor[] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+	for(size_t i = 0; i < mSorted.size(); ++i)
+	{
+		const Packet& packet = mPackets[mSorted[i].Packet];
+		const Shader& shader = mShaders[packet.Shader];
+		const Geometry& geometry = mGeometries[packet.Geometry];
+		ID3D11BlendState* packetBlend = mBlendStates[packet.Blend];
+
+		if( first || shader.InputLayout != inputLayout )
+		{
+			inputLayout = shader.InputLayout;
+			dc->IASetInputLayout(inputLayout);
+			++mStats.StateChanges;
+		}
+		else
+			++mStats.StateChangesRemoved;
+
+		if( first || geometry.Topology != topology )
+		{
+			topology = geometry.Topology;
+			dc->IASetPrimitiveTopology(topology);
+			++mStats.StateChanges;
+		}
+		else
+			++mStats.StateChangesRemoved;
+
+		if( first || geometry.VertexBuffer != vertexBuffer )
+		{
+			UINT offset = 0;
+			vertexBuffer = geometry.VertexBuffer;
+			dc->IASetVertexBuffers(0, 1, &vertexBuffer, &geometry.Stride, &offset);
+			++mStats.StateChanges;
+		}
+		else
+			++mStats.StateChangesRemoved;
+
+		if( geometry.IndexBuffer != 0 )
+		{
+			if( first || geometry.IndexBuffer != indexBuffer )
+			{
+				indexBuffer = geometry.IndexBuffer;
+				dc->IASetIndexBuffer(indexBuffer, geometry.IndexFormat, 0);
+				++mStats.StateChanges;
+			}
+			else
+				++mStats.StateChangesRemoved;
+		}
+
+		if( first || packetBlend != blendState )
+		{
+			blendState = packetBlend;
+			dc->OMSetBlendState(blendState, blendFactor, 0xffffffff);
+			++mStats.StateChanges;
+		}
+		else
+			++mStats.StateChangesRemoved;
+
+		if( first || packet.Material != material )
+		{
+			material = packet.Material;
+			binder.ApplyMaterial(material);
+			++mStats.StateChanges;
+		}
+		else
+			++mStats.StateChangesRemoved;
+
+		first = false;
+
+		// The pass is applied for every draw, since it commits the per object
+		// constants.
+		binder.ApplyObject(packet.Object);
+		binder.ApplyPass(shader.Pass, dc);
+
+		if( geometry.IndexBuffer != 0 )
+			dc->DrawIndexed(packet.Count, packet.Start, packet.BaseVertex);
+		else
+			dc->Draw(packet.Count, packet.Start);
+
+		++mStats.Draws;
+	}
+
+	// Leave the default blend state bound for whatever is drawn next.
+	if( blendState != 0 )
+		dc->OMSetBlendState(0, blendFactor, 0xffffffff);
+}
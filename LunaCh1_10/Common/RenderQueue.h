@@ -0,0 +1,156 @@
+//***************************************************************************************
+// RenderQueue.h
+//
+// Collects the draws of a frame as small packets, sorts them by state and draws them
+// with as few state changes as possible.
+//   -Shaders (technique pass + input layout), blend states and geometry (vertex and
+//    index buffers + topology) are registered once and referred to by id.  Materials
+//    and objects are ids of the caller's own, applied through a Binder, so the queue
+//    does not depend on any particular effect wrapper.
+//   -Each packet gets a 64-bit sort key.  Opaque packets sort by
+//        layer | blend | shader | material | geometry | depth (front to back)
+//    and blended packets, which must be drawn in depth order, by
+//        layer | depth (back to front) | blend | shader | material | geometry,
+//    with a translucent bit after the layer so they follow the opaque packets.
+//   -The keys are radix sorted, 8 bits per pass, skipping passes where all keys
+//    share the byte.
+//   -Execute() walks the sorted packets and only sets the states that differ from
+//    the previous packet, counting the changes it skipped.
+//***************************************************************************************
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include "d3dUtil.h"
+
+class RenderQueue
+{
+public:
+	///<summary>
+	/// Applies the caller's per material and per object state, usually by setting
+	/// effect variables.  The queue applies the effect pass after both.
+	///</summary>
+	class Binder
+	{
+	public:
+		virtual ~Binder() {}
+
+		virtual void ApplyMaterial(UINT material) = 0;
+		virtual void ApplyObject(UINT object) = 0;
+
+		// Called for every draw; effect wrappers that track their constants
+		// override it to apply the pass themselves.
+		virtual void ApplyPass(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc) { pass->Apply(0, dc); }
+	};
+
+	struct Packet
+	{
+		Packet();
+
+		// Drawn in increasing order, 0-15.
+		UINT Layer;
+
+		UINT Shader;
+		UINT Blend;
+		UINT Material;
+		UINT Geometry;
+		UINT Object;
+
+		// Index count and start index if the geometry has an index buffer, vertex
+		// count and start vertex otherwise.
+		UINT Count;
+		UINT Start;
+		INT BaseVertex;
+
+		// View space depth, for ordering within the same state.
+		float Depth;
+	};
+
+	struct Stats
+	{
+		UINT Draws;
+
+		// State changes issued, and state sets a draw-everything walk would have
+		// issued that were skipped because the state was already bound.
+		UINT StateChanges;
+		UINT StateChangesRemoved;
+	};
+
+	// Blend id of the default (opaque) blend state.
+	static const UINT OpaqueBlend = 0;
+
+public:
+	RenderQueue();
+
+	///<summary>
+	/// View space depth range packets are quantized to for sorting.
+	///</summary>
+	void SetDepthRange(float nearZ, float farZ);
+
+	UINT AddShader(ID3DX11EffectTechnique* technique, UINT pass, ID3D11InputLayout* inputLayout);
+
+	// Packets with any blend state other than OpaqueBlend are sorted back to front.
+	UINT AddBlendState(ID3D11BlendState* blendState);
+
+	UINT AddGeometry(ID3D11Buffer* vertexBuffer, UINT stride, ID3D11Buffer* indexBuffer,
+		DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT,
+		D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	void Submit(const Packet& packet);
+
+	// Drops the submitted packets; registered states are kept.
+	void Clear();
+
+	UINT GetPacketCount()const;
+
+	///<summary>
+	/// Sorts and draws the submitted packets.  The packets stay in the queue until
+	/// Clear(), so the same frame can be drawn again.
+	///</summary>
+	void Execute(ID3D11DeviceContext* dc, Binder& binder);
+
+	// Counts of the last Execute().
+	const Stats& GetStats()const;
+
+	UINT64 MakeKey(const Packet& packet)const;
+
+private:
+	struct Shader
+	{
+		ID3DX11EffectPass* Pass;
+		ID3D11InputLayout* InputLayout;
+	};
+
+	struct Geometry
+	{
+		ID3D11Buffer* VertexBuffer;
+		UINT Stride;
+		ID3D11Buffer* IndexBuffer;
+		DXGI_FORMAT IndexFormat;
+		D3D11_PRIMITIVE_TOPOLOGY Topology;
+	};
+
+	struct SortEntry
+	{
+		UINT64 Key;
+		UINT Packet;
+	};
+
+	void Sort();
+
+private:
+	std::vector<Shader> mShaders;
+	std::vector<ID3D11BlendState*> mBlendStates;
+	std::vector<Geometry> mGeometries;
+
+	std::vector<Packet> mPackets;
+	std::vector<SortEntry> mSorted;
+	std::vector<SortEntry> mSortTemp;
+
+	float mNearZ;
+	float mFarZ;
+
+	Stats mStats;
+};
+
+#endif // RENDERQUEUE_H
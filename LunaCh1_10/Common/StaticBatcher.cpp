@@ -0,0 +1,380 @@
+//***************************************************************************************
+// StaticBatcher.cpp
+//***************************************************************************************
+
+#include "StaticBatcher.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Spreads the low 10 bits of x so there are two zero bits between each.
+	UINT SpreadBits(UINT x)
+	{
+		x &= 0x3ff;
+		x = (x | (x << 16)) & 0x030000ff;
+		x = (x | (x <<  8)) & 0x0300f00f;
+		x = (x | (x <<  4)) & 0x030c30c3;
+		x = (x | (x <<  2)) & 0x09249249;
+
+		return x;
+	}
+
+	struct SortKey
+	{
+		UINT MaterialId;
+		UINT Morton;
+		UINT Mesh;
+	};
+
+	struct SortKeyLess
+	{
+		bool operator()(const SortKey& a, const SortKey& b)const
+		{
+			if( a.MaterialId != b.MaterialId )
+				return a.MaterialId < b.MaterialId;
+
+			if( a.Morton != b.Morton )
+				return a.Morton < b.Morton;
+
+			return a.Mesh < b.Mesh;
+		}
+	};
+}
+
+StaticBatcher::StaticBatcher()
+	: mVB(0), mIB(0), mVisibleCount(0)
+{
+	mFormat.Stride         = 0;
+	mFormat.PositionOffset = 0;
+	mFormat.NormalOffset   = NoElement;
+
+	ZeroMemory(mFrustumPlanes, sizeof(mFrustumPlanes));
+}
+
+StaticBatcher::~StaticBatcher()
+{
+	ReleaseCOM(mVB);
+	ReleaseCOM(mIB);
+}
+
+void StaticBatcher::Init(const VertexFormat& format)
+{
+	assert(format.Stride >= format.PositionOffset + sizeof(XMFLOAT3));
+	assert(format.NormalOffset == NoElement || format.Stride >= format.NormalOffset + sizeof(XMFLOAT3));
+
+	mFormat = format;
+}
+
+UINT StaticBatcher::AddMesh(const void* vertices, UINT numVertices, const UINT* indices, UINT numIndices,
+	const XMFLOAT4X4& world, UINT materialId)
+{
+	assert(mFormat.Stride > 0);
+
+	PendingMesh mesh;
+	mesh.FirstVertexByte = (UINT)mPendingVertices.size();
+	mesh.NumVertices     = numVertices;
+	mesh.FirstIndex      = (UINT)mPendingIndices.size();
+	mesh.NumIndices      = numIndices;
+	mesh.World           = world;
+	mesh.MaterialId      = materialId;
+
+	const char* bytes = static_cast<const char*>(vertices);
+	mPendingVertices.insert(mPendingVertices.end(), bytes, bytes + numVertices*mFormat.Stride);
+	mPendingIndices.insert(mPendingIndices.end(), indices, indices + numIndices);
+
+	mPending.push_back(mesh);
+
+	return (UINT)mPending.size() - 1;
+}
+
+XMFLOAT3 StaticBatcher::GetWorldCenter(const PendingMesh& mesh)const
+{
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+	const char* vertex = &mPendingVertices[0] + mesh.FirstVertexByte + mFormat.PositionOffset;
+	for(UINT i = 0; i < mesh.NumVertices; ++i, vertex += mFormat.Stride)
+	{
+		XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex));
+
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	XMVECTOR center = 0.5f*(vMin + vMax);
+
+	XMFLOAT3 worldCenter;
+	XMStoreFloat3(&worldCenter, XMVector3TransformCoord(center, XMLoadFloat4x4(&mesh.World)));
+
+	return worldCenter;
+}
+
+XMFLOAT4 StaticBatcher::TransformVertices(char* vertices, UINT numVertices, CXMMATRIX world)const
+{
+	XMMATRIX normalWorld = MathHelper::InverseTranspose(world);
+
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+	char* vertex = vertices;
+	for(UINT i = 0; i < numVertices; ++i, vertex += mFormat.Stride)
+	{
+		XMFLOAT3* position = reinterpret_cast<XMFLOAT3*>(vertex + mFormat.PositionOffset);
+
+		XMVECTOR p = XMVector3TransformCoord(XMLoadFloat3(position), world);
+		XMStoreFloat3(position, p);
+
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+
+		if( mFormat.NormalOffset != NoElement )
+		{
+			XMFLOAT3* normal = reinterpret_cast<XMFLOAT3*>(vertex + mFormat.NormalOffset);
+
+			XMVECTOR n = XMVector3TransformNormal(XMLoadFloat3(normal), normalWorld);
+			XMStoreFloat3(normal, XMVector3Normalize(n));
+		}
+	}
+
+	// A sphere around the box; a second pass for the furthest vertex from the
+	// center gives a tighter one.
+	XMVECTOR center = 0.5f*(vMin + vMax);
+	XMVECTOR radiusSq = XMVectorZero();
+
+	vertex = vertices;
+	for(UINT i = 0; i < numVertices; ++i, vertex += mFormat.Stride)
+	{
+		XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex + mFormat.PositionOffset));
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(p - center));
+	}
+
+	XMFLOAT4 bounds;
+	XMStoreFloat4(&bounds, XMVectorSetW(center, XMVectorGetX(XMVectorSqrt(radiusSq))));
+
+	return bounds;
+}
+
+void StaticBatcher::Build(ID3D11Device* device)
+{
+	ReleaseCOM(mVB);
+	ReleaseCOM(mIB);
+
+	mSubMeshes.clear();
+	mSubMeshOfMesh.assign(mPending.size(), 0);
+
+	UINT numMeshes = (UINT)mPending.size();
+	if( numMeshes == 0 || mPendingIndices.empty() )
+		return;
+
+	//
+	// Order the meshes by material, then along a Morton curve through the box
+	// around their centers, quantized to 1024 steps per axis.
+	//
+
+	std::vector<XMFLOAT3> centers(numMeshes);
+
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+	for(UINT m = 0; m < numMeshes; ++m)
+	{
+		centers[m] = GetWorldCenter(mPending[m]);
+
+		vMin = XMVectorMin(vMin, XMLoadFloat3(&centers[m]));
+		vMax = XMVectorMax(vMax, XMLoadFloat3(&centers[m]));
+	}
+
+	XMVECTOR extent = XMVectorMax(vMax - vMin, XMVectorReplicate(1e-6f));
+	XMVECTOR scale = XMVectorReplicate(1023.0f) / extent;
+
+	std::vector<SortKey> keys(numMeshes);
+	for(UINT m = 0; m < numMeshes; ++m)
+	{
+		XMFLOAT3 cell;
+		XMStoreFloat3(&cell, (XMLoadFloat3(&centers[m]) - vMin)*scale);
+
+		keys[m].MaterialId = mPending[m].MaterialId;
+		keys[m].Morton     = SpreadBits((UINT)cell.x) | (SpreadBits((UINT)cell.y) << 1) | (SpreadBits((UINT)cell.z) << 2);
+		keys[m].Mesh       = m;
+	}
+
+	std::sort(keys.begin(), keys.end(), SortKeyLess());
+
+	//
+	// Copy the meshes in that order into the merged vertices and indices, baking
+	// in their world matrices.
+	//
+
+	std::vector<char> vertices(mPendingVertices.size());
+	std::vector<UINT> indices(mPendingIndices.size());
+
+	UINT vertexCursor = 0;
+	UINT indexCursor = 0;
+
+	mSubMeshes.resize(numMeshes);
+	for(UINT s = 0; s < numMeshes; ++s)
+	{
+		const PendingMesh& mesh = mPending[keys[s].Mesh];
+
+		char* dstVertices = &vertices[0] + vertexCursor*mFormat.Stride;
+		memcpy(dstVertices, &mPendingVertices[0] + mesh.FirstVertexByte, mesh.NumVertices*mFormat.Stride);
+
+		for(UINT i = 0; i < mesh.NumIndices; ++i)
+			indices[indexCursor + i] = vertexCursor + mPendingIndices[mesh.FirstIndex + i];
+
+		SubMesh& subMesh = mSubMeshes[s];
+		subMesh.MaterialId  = mesh.MaterialId;
+		subMesh.StartIndex  = indexCursor;
+		subMesh.IndexCount  = mesh.NumIndices;
+		subMesh.BaseVertex  = vertexCursor;
+		subMesh.VertexCount = mesh.NumVertices;
+		subMesh.Bounds      = TransformVertices(dstVertices, mesh.NumVertices, XMLoadFloat4x4(&mesh.World));
+
+		mSubMeshOfMesh[keys[s].Mesh] = s;
+
+		vertexCursor += mesh.NumVertices;
+		indexCursor  += mesh.NumIndices;
+	}
+
+	D3D11_BUFFER_DESC vbd;
+	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = (UINT)vertices.size();
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = 0;
+	vbd.MiscFlags = 0;
+	vbd.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA vinitData;
+	vinitData.pSysMem = &vertices[0];
+	HR(device->CreateBuffer(&vbd, &vinitData, &mVB));
+
+	D3D11_BUFFER_DESC ibd;
+	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.ByteWidth = sizeof(UINT) * (UINT)indices.size();
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibd.CPUAccessFlags = 0;
+	ibd.MiscFlags = 0;
+	ibd.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA iinitData;
+	iinitData.pSysMem = &indices[0];
+	HR(device->CreateBuffer(&ibd, &iinitData, &mIB));
+
+	// The copies are not needed once the buffers hold the data.
+	std::vector<PendingMesh>().swap(mPending);
+	mPendingVertices.clear();
+	mPendingVertices.shrink_to_fit();
+	mPendingIndices.clear();
+	mPendingIndices.shrink_to_fit();
+
+	mVisible.assign(numMeshes, 0);
+	mRanges.reserve(numMeshes);
+}
+
+UINT StaticBatcher::GetSubMeshCount()const
+{
+	return (UINT)mSubMeshes.size();
+}
+
+const StaticBatcher::SubMesh& StaticBatcher::GetSubMesh(UINT index)const
+{
+	return mSubMeshes[index];
+}
+
+UINT StaticBatcher::GetSubMeshIndex(UINT mesh)const
+{
+	return mSubMeshOfMesh[mesh];
+}
+
+void StaticBatcher::Cull(CXMMATRIX viewProj)
+{
+	ExtractFrustumPlanes(mFrustumPlanes, viewProj);
+
+	UINT numSubMeshes = (UINT)mSubMeshes.size();
+
+	mRanges.clear();
+	mVisibleCount = 0;
+
+	if( numSubMeshes == 0 )
+		return;
+
+	JobCounter counter;
+	JobSystem::ParallelFor(&StaticBatcher::CullSubMeshesJob, this, numSubMeshes, 0, &counter);
+	JobSystem::Wait(counter);
+
+	//
+	// Sub-meshes next to each other in the index buffer draw as one range if they
+	// are both visible and share a material.
+	//
+
+	for(UINT s = 0; s < numSubMeshes; ++s)
+	{
+		if( !mVisible[s] )
+			continue;
+
+		const SubMesh& subMesh = mSubMeshes[s];
+		++mVisibleCount;
+
+		if( !mRanges.empty() )
+		{
+			DrawRange& last = mRanges.back();
+			if( last.MaterialId == subMesh.MaterialId && last.StartIndex + last.IndexCount == subMesh.StartIndex )
+			{
+				last.IndexCount += subMesh.IndexCount;
+				continue;
+			}
+		}
+
+		DrawRange range;
+		range.MaterialId = subMesh.MaterialId;
+		range.StartIndex = subMesh.StartIndex;
+		range.IndexCount = subMesh.IndexCount;
+		mRanges.push_back(range);
+	}
+}
+
+void StaticBatcher::CullSubMeshesJob(void* job, UINT first, UINT end)
+{
+	static_cast<StaticBatcher*>(job)->CullSubMeshes(first, end);
+}
+
+void StaticBatcher::CullSubMeshes(UINT first, UINT end)
+{
+	XMVECTOR planes[6];
+	for(int i = 0; i < 6; ++i)
+		planes[i] = XMLoadFloat4(&mFrustumPlanes[i]);
+
+	for(UINT s = first; s < end; ++s)
+		mVisible[s] = SphereInFrustum(planes, XMLoadFloat4(&mSubMeshes[s].Bounds)) ? 1 : 0;
+}
+
+UINT StaticBatcher::GetVisibleCount()const
+{
+	return mVisibleCount;
+}
+
+UINT StaticBatcher::GetRangeCount()const
+{
+	return (UINT)mRanges.size();
+}
+
+const StaticBatcher::DrawRange& StaticBatcher::GetRange(UINT index)const
+{
+	return mRanges[index];
+}
+
+void StaticBatcher::Bind(ID3D11DeviceContext* dc)
+{
+	UINT stride = mFormat.Stride;
+	UINT offset = 0;
+	dc->IASetVertexBuffers(0, 1, &mVB, &stride, &offset);
+	dc->IASetIndexBuffer(mIB, DXGI_FORMAT_R32_UINT, 0);
+}
+
+void StaticBatcher::Draw(ID3D11DeviceContext* dc, UINT materialId)
+{
+	for(size_t r = 0; r < mRanges.size(); ++r)
+	{
+		const DrawRange& range = mRanges[r];
+		if( range.MaterialId == materialId )
+			dc->DrawIndexed(range.IndexCount, range.StartIndex, 0);
+	}
+}
@@ -0,0 +1,159 @@
+//***************************************************************************************
+// StaticBatcher.h
+//
+// Merges static meshes of one vertex format into a single vertex and index buffer,
+// so scenery made of many small meshes is drawn with a few DrawIndexed() calls
+// instead of one per object.
+//   -AddMesh() copies a mesh with its world matrix and material.  Build() bakes the
+//    world matrices into the vertices (positions, and normals if the format has
+//    them), so every sub-mesh is drawn with the identity world matrix.
+//   -Build() orders the sub-meshes by material, and within a material along a
+//    Morton curve of their centers, so objects that are near each other are also
+//    next to each other in the index buffer.  Indices are offset to the merged
+//    vertices, so any run of sub-meshes is one contiguous index range.
+//   -Cull() tests each sub-mesh's bounding sphere against the view frustum on the
+//    JobSystem, then merges runs of visible sub-meshes of one material into draw
+//    ranges.
+//   -Draw() issues one DrawIndexed() per range of a material.
+//
+// Meshes that move, or many copies of one mesh, are better drawn with
+// InstanceRenderer.  Indices are 32 bit.
+//***************************************************************************************
+
+#ifndef STATICBATCHER_H
+#define STATICBATCHER_H
+
+#include "d3dUtil.h"
+#include "MemoryTracker.h"
+
+class StaticBatcher
+{
+public:
+	// Where the elements the batcher transforms are in a vertex.
+	struct VertexFormat
+	{
+		UINT Stride;
+		UINT PositionOffset;
+
+		// NoElement if the vertices have no normal.
+		UINT NormalOffset;
+	};
+
+	static const UINT NoElement = ~0u;
+
+	// A sub-mesh after Build().  Bounds are a world space sphere (center, radius).
+	struct SubMesh
+	{
+		UINT MaterialId;
+		UINT StartIndex;
+		UINT IndexCount;
+		UINT BaseVertex;
+		UINT VertexCount;
+		XMFLOAT4 Bounds;
+	};
+
+	struct DrawRange
+	{
+		UINT MaterialId;
+		UINT StartIndex;
+		UINT IndexCount;
+	};
+
+public:
+	StaticBatcher();
+	~StaticBatcher();
+
+	void Init(const VertexFormat& format);
+
+	///<summary>
+	/// Copies a mesh to be merged by Build().  vertices are in the format given to
+	/// Init().  Returns the order the mesh was added in; Build() reorders the
+	/// sub-meshes, GetSubMeshIndex() maps it.
+	///</summary>
+	UINT AddMesh(const void* vertices, UINT numVertices, const UINT* indices, UINT numIndices,
+		const XMFLOAT4X4& world, UINT materialId);
+
+	///<summary>
+	/// Transforms and merges the added meshes into immutable buffers, and frees the
+	/// copies.
+	///</summary>
+	void Build(ID3D11Device* device);
+
+	UINT GetSubMeshCount()const;
+	const SubMesh& GetSubMesh(UINT index)const;
+	UINT GetSubMeshIndex(UINT mesh)const;
+
+	///<summary>
+	/// Finds the sub-meshes inside the frustum of viewProj and merges them into draw
+	/// ranges.
+	///</summary>
+	void Cull(CXMMATRIX viewProj);
+
+	// Of the last Cull().
+	UINT GetVisibleCount()const;
+	UINT GetRangeCount()const;
+	const DrawRange& GetRange(UINT index)const;
+
+	///<summary>
+	/// Binds the merged buffers to vertex buffer slot 0 and the index buffer.
+	///</summary>
+	void Bind(ID3D11DeviceContext* dc);
+
+	///<summary>
+	/// Draws the visible ranges of a material.  The caller binds the buffers, input
+	/// layout and topology, and applies the effect pass with the identity world
+	/// matrix first.
+	///</summary>
+	void Draw(ID3D11DeviceContext* dc, UINT materialId);
+
+private:
+	// A mesh between AddMesh() and Build().
+	struct PendingMesh
+	{
+		UINT FirstVertexByte;
+		UINT NumVertices;
+		UINT FirstIndex;
+		UINT NumIndices;
+		XMFLOAT4X4 World;
+		UINT MaterialId;
+	};
+
+	static void CullSubMeshesJob(void* job, UINT first, UINT end);
+	void CullSubMeshes(UINT first, UINT end);
+
+	// Transforms vertices in place and returns their world space sphere.
+	XMFLOAT4 TransformVertices(char* vertices, UINT numVertices, CXMMATRIX world)const;
+
+	// The center of the box around the vertices, in world space.
+	XMFLOAT3 GetWorldCenter(const PendingMesh& mesh)const;
+
+private:
+	StaticBatcher(const StaticBatcher& rhs);
+	StaticBatcher& operator=(const StaticBatcher& rhs);
+
+private:
+	VertexFormat mFormat;
+
+	ID3D11Buffer* mVB;
+	ID3D11Buffer* mIB;
+
+	std::vector<PendingMesh> mPending;
+	std::vector<char, TrackedAllocator<char, MemoryTracker::Geometry> > mPendingVertices;
+	std::vector<UINT, TrackedAllocator<UINT, MemoryTracker::Geometry> > mPendingIndices;
+
+	// Ordered by material, then spatially.
+	std::vector<SubMesh> mSubMeshes;
+
+	// The sub-mesh of each AddMesh() call.
+	std::vector<UINT> mSubMeshOfMesh;
+
+	XMFLOAT4 mFrustumPlanes[6];
+
+	// Written by the culling jobs, one per sub-mesh.
+	std::vector<UINT8> mVisible;
+
+	std::vector<DrawRange> mRanges;
+	UINT mVisibleCount;
+};
+
+#endif // STATICBATCHER_H
@@ -0,0 +1,105 @@
+//***************************************************************************************
+// TechniqueRegistry.cpp
+//***************************************************************************************
+
+#include "TechniqueRegistry.h"
+
+TechniqueRegistry::TechniqueRegistry()
+	: mFX(0), mBits(0)
+{
+	mTechniques.resize(1, 0);
+}
+
+void TechniqueRegistry::Init(ID3DX11Effect* fx)
+{
+	mFX = fx;
+	mOptions.clear();
+	mBits = 0;
+
+	mTechniques.assign(1, 0);
+}
+
+UINT TechniqueRegistry::AddOption(const char* const* parts, UINT count)
+{
+	assert(count >= 2);
+
+	UINT bits = 0;
+	while( (1u << bits) < count )
+		++bits;
+
+	// The table grows with every bit; a handful of options is all it is for.
+	assert(mBits + bits <= 16);
+
+	Option option;
+	option.Parts.assign(parts, parts + count);
+	option.Shift = mBits;
+	option.Mask  = (1u << bits) - 1;
+
+	mOptions.push_back(option);
+	mBits += bits;
+
+	mTechniques.assign((size_t)1 << mBits, 0);
+
+	return option.Shift;
+}
+
+ID3DX11EffectTechnique* TechniqueRegistry::Get(UINT features)
+{
+	assert(features < mTechniques.size());
+
+	ID3DX11EffectTechnique* technique = mTechniques[features];
+	if( technique == 0 )
+	{
+		technique = mFX->GetTechniqueByName(GetName(features).c_str());
+		assert(technique->IsValid());
+
+		mTechniques[features] = technique;
+	}
+
+	return technique;
+}
+
+std::string TechniqueRegistry::GetName(UINT features)const
+{
+	std::string name;
+
+	for(size_t i = 0; i < mOptions.size(); ++i)
+	{
+		const Option& option = mOptions[i];
+
+		UINT choice = (features >> option.Shift) & option.Mask;
+		assert(choice < option.Parts.size());
+
+		name += option.Parts[choice];
+	}
+
+	return name;
+}
+
+bool TechniqueRegistry::IsUsed(UINT features)const
+{
+	return features < mTechniques.size() && mTechniques[features] != 0;
+}
+
+UINT TechniqueRegistry::GetUsedCount()const
+{
+	UINT count = 0;
+	for(size_t i = 0; i < mTechniques.size(); ++i)
+	{
+		if( mTechniques[i] != 0 )
+			++count;
+	}
+
+	return count;
+}
+
+void TechniqueRegistry::GetUsedNames(std::vector<std::string>& names)const
+{
+	names.clear();
+
+	for(UINT i = 0; i < (UINT)mTechniques.size(); ++i)
+	{
+		if( mTechniques[i] != 0 )
+			names.push_back(GetName(i));
+	}
+}
@@ -0,0 +1,71 @@
+//***************************************************************************************
+// TechniqueRegistry.h
+//
+// Looks up the techniques of an effect by a bitmask of features instead of one
+// named member per permutation.
+//   -Each option is a list of name parts, e.g. {"Light0", "Light1", "Light2",
+//    "Light3"} or {"", "Tex"}.  Options take the next bits of the mask in the order
+//    they are added, enough for their part count.  A technique's name is the
+//    concatenation of the selected parts, so Light2|Tex is "Light2Tex".
+//   -Get() indexes a table by the mask.  A technique's name is built and looked up
+//    only the first time its mask is asked for; after that it is a table read.
+//   -This only saves the name lookups.  Every permutation is still compiled into
+//    the one .fxo and created with the effect when it loads, used or not, so it
+//    does not shorten effect creation or save the memory of unused shaders.
+//   -Every mask asked for is recorded, so the permutations a demo really uses can
+//    be listed.
+//***************************************************************************************
+
+#ifndef TECHNIQUEREGISTRY_H
+#define TECHNIQUEREGISTRY_H
+
+#include "d3dUtil.h"
+
+class TechniqueRegistry
+{
+public:
+	TechniqueRegistry();
+
+	void Init(ID3DX11Effect* fx);
+
+	///<summary>
+	/// Adds an option with count name parts and returns the shift of its bits.
+	///</summary>
+	UINT AddOption(const char* const* parts, UINT count);
+
+	///<summary>
+	/// Returns the technique for the features, looking it up by name the first
+	/// time.  The permutation must exist in the effect.
+	///</summary>
+	ID3DX11EffectTechnique* Get(UINT features);
+
+	std::string GetName(UINT features)const;
+
+	bool IsUsed(UINT features)const;
+	UINT GetUsedCount()const;
+
+	// Names of the permutations asked for so far, in mask order.
+	void GetUsedNames(std::vector<std::string>& names)const;
+
+private:
+	TechniqueRegistry(const TechniqueRegistry& rhs);
+	TechniqueRegistry& operator=(const TechniqueRegistry& rhs);
+
+private:
+	struct Option
+	{
+		std::vector<std::string> Parts;
+		UINT Shift;
+		UINT Mask;
+	};
+
+	ID3DX11Effect* mFX;
+
+	std::vector<Option> mOptions;
+	UINT mBits;
+
+	// Indexed by the feature mask; null until the mask is asked for.
+	std::vector<ID3DX11EffectTechnique*> mTechniques;
+};
+
+#endif // TECHNIQUEREGISTRY_H
@@ -0,0 +1,941 @@
+//***************************************************************************************
+// Terrain.cpp
+//***************************************************************************************
+
+#include "Terrain.h"
+
+Terrain::InitInfo::InitInfo()
+	: HeightFunc(0),
+	  HeightScale(1.0f),
+	  NumSamples(257),
+	  PatchCells(32),
+	  CellSpacing(1.0f),
+	  LodDistance(100.0f),
+	  MaxCachedPatches(512),
+	  TileMemoryBudget(64*1024*1024),
+	  StreamingThreads(2),
+	  PrefetchFrames(30.0f)
+{
+}
+
+Terrain::Terrain()
+	: md3dDevice(0),
+	  mNumLevels(0),
+	  mPatternIB(0),
+	  mFrame(0),
+	  mStreaming(false),
+	  mLastEyePos(0.0f, 0.0f, 0.0f)
+{
+	ZeroMemory(mPatternStart, sizeof(mPatternStart));
+	ZeroMemory(mPatternCount, sizeof(mPatternCount));
+}
+
+Terrain::~Terrain()
+{
+	ReleaseCOM(mPatternIB);
+
+	for(auto it = mPatchCache.begin(); it != mPatchCache.end(); ++it)
+	{
+		ReleaseCOM(it->second.VB);
+	}
+
+	mPatchCache.clear();
+}
+
+float Terrain::GetWidth()const
+{
+	return (mInfo.NumSamples-1)*mInfo.CellSpacing;
+}
+
+float Terrain::GetDepth()const
+{
+	return (mInfo.NumSamples-1)*mInfo.CellSpacing;
+}
+
+UINT Terrain::GetNumLevels()const
+{
+	return mNumLevels;
+}
+
+UINT Terrain::GetVisiblePatchCount()const
+{
+	return (UINT)mSelected.size();
+}
+
+UINT Terrain::GetVisibleTriangleCount()const
+{
+	UINT count = 0;
+	for(size_t i = 0; i < mSelected.size(); ++i)
+		count += mPatternCount[mSelected[i].StitchMask] / 3;
+
+	return count;
+}
+
+const Heightfield& Terrain::GetHeightfield()const
+{
+	return mHeightfield;
+}
+
+const TerrainStreamer& Terrain::GetStreamer()const
+{
+	return mStreamer;
+}
+
+float Terrain::GetHeight(float x, float z)const
+{
+	if( mStreaming )
+		return GetStreamedHeight(x, z);
+
+	return mHeightfield.GetHeight(x, z);
+}
+
+bool Terrain::Init(ID3D11Device* device, const InitInfo& initInfo)
+{
+	md3dDevice = device;
+	mInfo = initInfo;
+	mStreaming = !mInfo.TileFilename.empty();
+	mNumLevels = 0;
+
+	// Streamed terrains take their dimensions from the tile file.
+	if( mStreaming )
+	{
+		if( !mStreamer.Open(mInfo.TileFilename, mInfo.TileMemoryBudget, mInfo.StreamingThreads) )
+			return false;
+
+		const TerrainTileFileHeader& header = mStreamer.GetHeader();
+		mInfo.NumSamples  = header.NumSamples;
+		mInfo.PatchCells  = header.PatchCells;
+		mInfo.CellSpacing = header.CellSpacing;
+	}
+
+	// The patch grid is triangulated in 2x2 cell blocks.
+	assert(mInfo.PatchCells >= 2 && (mInfo.PatchCells & (mInfo.PatchCells-1)) == 0);
+
+	// The heightfield must be a whole power of two number of patches wide.
+	UINT patches = (mInfo.NumSamples-1) / mInfo.PatchCells;
+	assert(patches*mInfo.PatchCells + 1 == mInfo.NumSamples);
+	assert((patches & (patches-1)) == 0);
+
+	UINT numLevels = 1;
+	while( (1u << (numLevels-1)) < patches )
+		++numLevels;
+
+	// Neighboring patches may differ by at most one level, otherwise the stitch
+	// patterns leave cracks.  That holds as long as a level's range is larger
+	// than the diagonal of a node of that level.
+	float nodeSize = mInfo.PatchCells*mInfo.CellSpacing;
+	float minRange = 2.0f*sqrtf(2.0f)*nodeSize;
+
+	mLodRanges.resize(numLevels);
+	for(UINT i = 0; i < numLevels; ++i)
+	{
+		float range = mInfo.LodDistance*(float)(1u << i);
+		mLodRanges[i] = MathHelper::Max(range, minRange*(float)(1u << i));
+	}
+
+	// Set only once there is data behind every level; Update() walks nothing
+	// while it is zero.
+	mNumLevels = numLevels;
+
+	// A frame selects about as many patches as the cache holds.
+	mSelected.reserve(mInfo.MaxCachedPatches);
+	mSelectedKeys.reserve(mInfo.MaxCachedPatches);
+	mSelectedVBs.reserve(mInfo.MaxCachedPatches);
+	mEvictCandidates.reserve(mInfo.MaxCachedPatches);
+
+	if( mStreaming )
+	{
+		InitStreaming();
+	}
+	else
+	{
+		if( !LoadHeightmap() )
+		{
+			mNumLevels = 0;
+			return false;
+		}
+
+		BuildHeightBounds();
+	}
+
+	BuildIndexPatterns(device);
+
+	return true;
+}
+
+void Terrain::Update(const Camera& cam)
+{
+	++mFrame;
+
+	mSelected.clear();
+	mSelectedKeys.clear();
+
+	if( mNumLevels == 0 )
+		return;
+
+	XMVECTOR eyePos = cam.GetPositionXM();
+	SelectNode(mNumLevels-1, 0, 0, cam, eyePos);
+	std::sort(mSelectedKeys.begin(), mSelectedKeys.end());
+
+	if( mStreaming )
+	{
+		// Queue the tiles we will need if the camera keeps moving the way it
+		// moved since the last update.  These are requested after the visible
+		// ones with a lower priority, and regardless of the view direction
+		// since the camera may turn.
+		XMVECTOR velocity = XMVectorSubtract(eyePos, XMLoadFloat3(&mLastEyePos));
+		XMVECTOR predicted = XMVectorMultiplyAdd(velocity, XMVectorReplicate(mInfo.PrefetchFrames), eyePos);
+
+		PrefetchNode(mNumLevels-1, 0, 0, predicted);
+
+		XMStoreFloat3(&mLastEyePos, eyePos);
+	}
+
+	// Only a streamed terrain falls back to coarser nodes while tiles load; a
+	// fully resident one keeps its neighbors within a level through the LOD
+	// ranges alone.
+	if( mStreaming )
+		RestrictNeighborLevels();
+
+	// The neighbor levels are only known once the whole selection is done.
+	for(size_t i = 0; i < mSelected.size(); ++i)
+		mSelected[i].StitchMask = ComputeStitchMask(mSelected[i]);
+
+	mSelectedVBs.resize(mSelected.size());
+	for(size_t i = 0; i < mSelected.size(); ++i)
+		mSelectedVBs[i] = GetPatchVB(mSelected[i]);
+
+	EvictPatches();
+
+	if( mStreaming )
+		mStreamer.EndFrame();
+}
+
+void Terrain::Draw(ID3D11DeviceContext* dc)
+{
+	UINT stride = sizeof(Terrain::Vertex);
+	UINT offset = 0;
+
+	dc->IASetIndexBuffer(mPatternIB, DXGI_FORMAT_R32_UINT, 0);
+
+	for(size_t i = 0; i < mSelected.size(); ++i)
+	{
+		UINT mask = mSelected[i].StitchMask;
+
+		dc->IASetVertexBuffers(0, 1, &mSelectedVBs[i], &stride, &offset);
+		dc->DrawIndexed(mPatternCount[mask], mPatternStart[mask], 0);
+	}
+}
+
+bool Terrain::LoadHeightmap()
+{
+	UINT numSamples = mInfo.NumSamples;
+	std::vector<float> heightmap(numSamples*numSamples, 0.0f);
+
+	if( !mInfo.HeightMapFilename.empty() )
+	{
+		std::vector<USHORT> in(numSamples*numSamples);
+
+		std::ifstream fin(mInfo.HeightMapFilename.c_str(), std::ios_base::binary);
+		if( !fin )
+			return false;
+
+		fin.read((char*)&in[0], (std::streamsize)in.size()*sizeof(USHORT));
+		if( !fin )
+			return false;
+
+		fin.close();
+
+		for(UINT i = 0; i < numSamples*numSamples; ++i)
+		{
+			heightmap[i] = (in[i] / 65535.0f)*mInfo.HeightScale;
+		}
+	}
+	else if( mInfo.HeightFunc )
+	{
+		float halfWidth = 0.5f*GetWidth();
+		float halfDepth = 0.5f*GetDepth();
+
+		for(UINT i = 0; i < numSamples; ++i)
+		{
+			float z = halfDepth - i*mInfo.CellSpacing;
+			for(UINT j = 0; j < numSamples; ++j)
+			{
+				float x = -halfWidth + j*mInfo.CellSpacing;
+				heightmap[i*numSamples+j] = mInfo.HeightFunc(x, z);
+			}
+		}
+	}
+
+	mHeightfield.Init(numSamples, numSamples, mInfo.CellSpacing, &heightmap[0]);
+
+	return true;
+}
+
+void Terrain::InitStreaming()
+{
+	mHeightBounds.resize(mNumLevels);
+
+	for(UINT level = 0; level < mNumLevels; ++level)
+	{
+		UINT n = NodesPerSide(level);
+		mHeightBounds[level].resize(n*n);
+
+		for(UINT z = 0; z < n; ++z)
+		{
+			for(UINT x = 0; x < n; ++x)
+				mHeightBounds[level][z*n+x] = mStreamer.GetBounds(level, x, z);
+		}
+	}
+
+	// Keep the coarsest two levels resident so there is always a patch to fall
+	// back to while finer tiles load.
+	UINT firstPinned = mNumLevels > 2 ? mNumLevels-2 : 0;
+	for(UINT level = firstPinned; level < mNumLevels; ++level)
+	{
+		UINT n = NodesPerSide(level);
+		for(UINT z = 0; z < n; ++z)
+		{
+			for(UINT x = 0; x < n; ++x)
+				mStreamer.Pin(level, x, z);
+		}
+	}
+}
+
+void Terrain::BuildHeightBounds()
+{
+	mHeightBounds.resize(mNumLevels);
+
+	//
+	// Level 0 nodes scan their samples.
+	//
+
+	UINT n = NodesPerSide(0);
+	UINT p = mInfo.PatchCells;
+	mHeightBounds[0].resize(n*n);
+
+	for(UINT nz = 0; nz < n; ++nz)
+	{
+		for(UINT nx = 0; nx < n; ++nx)
+		{
+			float minY = +MathHelper::Infinity;
+			float maxY = -MathHelper::Infinity;
+
+			for(UINT i = nz*p; i <= (nz+1)*p; ++i)
+			{
+				for(UINT j = nx*p; j <= (nx+1)*p; ++j)
+				{
+					float h = Sample(i, j);
+					minY = MathHelper::Min(minY, h);
+					maxY = MathHelper::Max(maxY, h);
+				}
+			}
+
+			mHeightBounds[0][nz*n+nx] = XMFLOAT2(minY, maxY);
+		}
+	}
+
+	//
+	// Higher levels combine their four children.
+	//
+
+	for(UINT level = 1; level < mNumLevels; ++level)
+	{
+		UINT parentN = NodesPerSide(level);
+		UINT childN  = NodesPerSide(level-1);
+		mHeightBounds[level].resize(parentN*parentN);
+
+		for(UINT nz = 0; nz < parentN; ++nz)
+		{
+			for(UINT nx = 0; nx < parentN; ++nx)
+			{
+				const XMFLOAT2& a = mHeightBounds[level-1][(2*nz+0)*childN + 2*nx+0];
+				const XMFLOAT2& b = mHeightBounds[level-1][(2*nz+0)*childN + 2*nx+1];
+				const XMFLOAT2& c = mHeightBounds[level-1][(2*nz+1)*childN + 2*nx+0];
+				const XMFLOAT2& d = mHeightBounds[level-1][(2*nz+1)*childN + 2*nx+1];
+
+				mHeightBounds[level][nz*parentN+nx] = XMFLOAT2(
+					MathHelper::Min(MathHelper::Min(a.x, b.x), MathHelper::Min(c.x, d.x)),
+					MathHelper::Max(MathHelper::Max(a.y, b.y), MathHelper::Max(c.y, d.y)));
+			}
+		}
+	}
+}
+
+void Terrain::BuildIndexPatterns(ID3D11Device* device)
+{
+	//
+	// The patch is triangulated as a fan around the center of every 2x2 cell
+	// block.  A block side that lies on a stitched patch edge drops its middle
+	// vertex, so that side matches the coarser neighbor's single edge.
+	//
+	// Ring of a block in clockwise order (row 0 is the north edge, +z):
+	//
+	//   0---1---2
+	//   |       |
+	//   7   C   3
+	//   |       |
+	//   6---5---4
+	//
+
+	UINT p = mInfo.PatchCells;
+	UINT n = p + 1;
+
+	std::vector<UINT> indices;
+
+	for(UINT mask = 0; mask < 16; ++mask)
+	{
+		mPatternStart[mask] = (UINT)indices.size();
+
+		for(UINT bi = 0; bi < p; bi += 2)
+		{
+			for(UINT bj = 0; bj < p; bj += 2)
+			{
+				UINT ring[8] =
+				{
+					(bi+0)*n + bj+0, (bi+0)*n + bj+1, (bi+0)*n + bj+2,
+					(bi+1)*n + bj+2,
+					(bi+2)*n + bj+2, (bi+2)*n + bj+1, (bi+2)*n + bj+0,
+					(bi+1)*n + bj+0
+				};
+				UINT center = (bi+1)*n + bj+1;
+
+				// Block sides in ring order: north, east, south, west.
+				bool skipMid[4] =
+				{
+					(mask & EdgeNorth) != 0 && bi == 0,
+					(mask & EdgeEast)  != 0 && bj+2 == p,
+					(mask & EdgeSouth) != 0 && bi+2 == p,
+					(mask & EdgeWest)  != 0 && bj == 0
+				};
+
+				for(UINT side = 0; side < 4; ++side)
+				{
+					UINT corner0 = ring[2*side];
+					UINT mid     = ring[2*side+1];
+					UINT corner1 = ring[(2*side+2) % 8];
+
+					if( skipMid[side] )
+					{
+						indices.push_back(center);
+						indices.push_back(corner0);
+						indices.push_back(corner1);
+					}
+					else
+					{
+						indices.push_back(center);
+						indices.push_back(corner0);
+						indices.push_back(mid);
+
+						indices.push_back(center);
+						indices.push_back(mid);
+						indices.push_back(corner1);
+					}
+				}
+			}
+		}
+
+		mPatternCount[mask] = (UINT)indices.size() - mPatternStart[mask];
+	}
+
+	D3D11_BUFFER_DESC ibd;
+	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.ByteWidth = sizeof(UINT) * indices.size();
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibd.CPUAccessFlags = 0;
+	ibd.MiscFlags = 0;
+	ibd.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA iinitData;
+	iinitData.pSysMem = &indices[0];
+	HR(device->CreateBuffer(&ibd, &iinitData, &mPatternIB));
+}
+
+void Terrain::SelectNode(UINT level, UINT x, UINT z, const Camera& cam, FXMVECTOR eyePos)
+{
+	XMFLOAT3 center, extents;
+	GetNodeBounds(level, x, z, center, extents);
+
+	if( !cam.IsVisible(center, extents) )
+		return;
+
+	float dist = DistanceToNode(level, x, z, eyePos);
+
+	// Keep drawing this node until all of its children can be drawn; while a
+	// streamed child is still loading, the coarser node fills in for it.
+	if( level == 0 || dist > mLodRanges[level-1] || !AreChildrenReady(level, x, z, dist) )
+	{
+		Node node;
+		node.Level = level;
+		node.X = x;
+		node.Z = z;
+		node.StitchMask = 0;
+
+		mSelected.push_back(node);
+		mSelectedKeys.push_back(NodeKey(level, x, z));
+		return;
+	}
+
+	SelectNode(level-1, 2*x+0, 2*z+0, cam, eyePos);
+	SelectNode(level-1, 2*x+1, 2*z+0, cam, eyePos);
+	SelectNode(level-1, 2*x+0, 2*z+1, cam, eyePos);
+	SelectNode(level-1, 2*x+1, 2*z+1, cam, eyePos);
+}
+
+void Terrain::PrefetchNode(UINT level, UINT x, UINT z, FXMVECTOR eyePos)
+{
+	if( level == 0 )
+		return;
+
+	float dist = DistanceToNode(level, x, z, eyePos);
+	if( dist > mLodRanges[level-1] )
+		return;
+
+	// Offset the priority so visible requests of this frame go first.
+	float priority = mLodRanges[mNumLevels-1] + dist;
+
+	for(UINT i = 0; i < 4; ++i)
+	{
+		UINT cx = 2*x + (i & 1);
+		UINT cz = 2*z + (i >> 1);
+
+		mStreamer.Request(level-1, cx, cz, priority);
+		PrefetchNode(level-1, cx, cz, eyePos);
+	}
+}
+
+bool Terrain::AreChildrenReady(UINT level, UINT x, UINT z, float priority)
+{
+	if( !mStreaming )
+		return true;
+
+	// Request all four, even if one is missing, so they arrive together.
+	bool ready = true;
+	for(UINT i = 0; i < 4; ++i)
+	{
+		UINT cx = 2*x + (i & 1);
+		UINT cz = 2*z + (i >> 1);
+
+		if( mPatchCache.count(NodeKey(level-1, cx, cz)) )
+			continue;
+
+		if( !mStreamer.Request(level-1, cx, cz, priority) )
+			ready = false;
+	}
+
+	return ready;
+}
+
+float Terrain::DistanceToNode(UINT level, UINT x, UINT z, FXMVECTOR eyePos)const
+{
+	XMFLOAT3 center, extents;
+	GetNodeBounds(level, x, z, center, extents);
+
+	// Distance from the eye to the closest point of the node's box.
+	XMVECTOR C = XMLoadFloat3(&center);
+	XMVECTOR E = XMLoadFloat3(&extents);
+	XMVECTOR closest = XMVectorClamp(eyePos, XMVectorSubtract(C, E), XMVectorAdd(C, E));
+
+	return XMVectorGetX(XMVector3Length(XMVectorSubtract(eyePos, closest)));
+}
+
+UINT Terrain::ComputeStitchMask(const Node& node)const
+{
+	// Level 0 coordinates of the node's first cell.
+	int x0 = (int)(node.X << node.Level);
+	int z0 = (int)(node.Z << node.Level);
+	int size = 1 << node.Level;
+
+	UINT mask = 0;
+
+	if( IsCoarserSelected(node.Level, x0, z0-1) )     mask |= EdgeNorth;
+	if( IsCoarserSelected(node.Level, x0+size, z0) )  mask |= EdgeEast;
+	if( IsCoarserSelected(node.Level, x0, z0+size) )  mask |= EdgeSouth;
+	if( IsCoarserSelected(node.Level, x0-1, z0) )     mask |= EdgeWest;
+
+	return mask;
+}
+
+bool Terrain::IsCoarserSelected(UINT level, int x0, int z0)const
+{
+	return FindSelectedLevel(x0, z0, level+1) >= 0;
+}
+
+int Terrain::FindSelectedLevel(int x0, int z0, UINT firstLevel)const
+{
+	int n = (int)NodesPerSide(0);
+	if( x0 < 0 || z0 < 0 || x0 >= n || z0 >= n )
+		return -1;
+
+	for(UINT l = firstLevel; l < mNumLevels; ++l)
+	{
+		if( std::binary_search(mSelectedKeys.begin(), mSelectedKeys.end(), NodeKey(l, x0 >> l, z0 >> l)) )
+			return (int)l;
+	}
+
+	return -1;
+}
+
+void Terrain::RestrictNeighborLevels()
+{
+	// A node drawn in place of children that are still loading can end up next to
+	// nodes two or more levels finer, and the stitch patterns only close a one
+	// level step.  Such a neighbor is merged back into its ancestor one level
+	// finer than the node.  Every ancestor of a selected node was refined, so
+	// its tile is resident.  A merge can expose another such edge, hence the loop.
+	bool merged = true;
+	while( merged )
+	{
+		merged = false;
+
+		for(size_t i = 0; i < mSelected.size() && !merged; ++i)
+		{
+			Node node = mSelected[i];
+
+			Node fine;
+			if( !FindFinerNeighbor(node, fine) )
+				continue;
+
+			UINT shift = node.Level-1 - fine.Level;
+			MergeSelected(node.Level-1, fine.X >> shift, fine.Z >> shift);
+			merged = true;
+		}
+	}
+}
+
+bool Terrain::FindFinerNeighbor(const Node& node, Node& fine)const
+{
+	if( node.Level < 2 )
+		return false;
+
+	// Level 0 coordinates of the node's first cell.
+	int x0 = (int)(node.X << node.Level);
+	int z0 = (int)(node.Z << node.Level);
+	int size = 1 << node.Level;
+
+	// The level 0 cell just outside each edge, and the direction along it:
+	// north, east, south, west.
+	const int startX[4] = { x0, x0+size, x0, x0-1 };
+	const int startZ[4] = { z0-1, z0, z0+size, z0 };
+	const int stepX[4]  = { 1, 0, 1, 0 };
+	const int stepZ[4]  = { 0, 1, 0, 1 };
+
+	for(int edge = 0; edge < 4; ++edge)
+	{
+		// Walk the edge one neighbor at a time, skipping the cells each one covers.
+		for(int p = 0; p < size; )
+		{
+			int x = startX[edge] + p*stepX[edge];
+			int z = startZ[edge] + p*stepZ[edge];
+
+			int level = FindSelectedLevel(x, z, 0);
+			if( level < 0 )
+			{
+				++p;
+				continue;
+			}
+
+			if( (UINT)level+1 < node.Level )
+			{
+				fine.Level = (UINT)level;
+				fine.X = (UINT)x >> level;
+				fine.Z = (UINT)z >> level;
+				fine.StitchMask = 0;
+				return true;
+			}
+
+			// The next cell along the edge that this neighbor does not cover.
+			int along = stepX[edge] ? x : z;
+			p += (((along >> level) + 1) << level) - along;
+		}
+	}
+
+	return false;
+}
+
+void Terrain::MergeSelected(UINT level, UINT x, UINT z)
+{
+	// Drop the selected nodes inside the ancestor, then select the ancestor.
+	size_t count = 0;
+	for(size_t i = 0; i < mSelected.size(); ++i)
+	{
+		const Node& node = mSelected[i];
+
+		UINT shift = level - node.Level;
+		bool inside = node.Level < level && (node.X >> shift) == x && (node.Z >> shift) == z;
+
+		if( !inside )
+			mSelected[count++] = node;
+	}
+	mSelected.resize(count);
+
+	Node ancestor;
+	ancestor.Level = level;
+	ancestor.X = x;
+	ancestor.Z = z;
+	ancestor.StitchMask = 0;
+	mSelected.push_back(ancestor);
+
+	mSelectedKeys.clear();
+	for(size_t i = 0; i < mSelected.size(); ++i)
+		mSelectedKeys.push_back(NodeKey(mSelected[i].Level, mSelected[i].X, mSelected[i].Z));
+	std::sort(mSelectedKeys.begin(), mSelectedKeys.end());
+}
+
+void Terrain::GetNodeBounds(UINT level, UINT x, UINT z, XMFLOAT3& center, XMFLOAT3& extents)const
+{
+	float nodeSize = (float)(mInfo.PatchCells << level)*mInfo.CellSpacing;
+	const XMFLOAT2& bounds = mHeightBounds[level][z*NodesPerSide(level) + x];
+
+	center.x  = -0.5f*GetWidth() + (x + 0.5f)*nodeSize;
+	center.y  = 0.5f*(bounds.x + bounds.y);
+	center.z  = 0.5f*GetDepth() - (z + 0.5f)*nodeSize;
+
+	extents.x = 0.5f*nodeSize;
+	extents.y = 0.5f*(bounds.y - bounds.x);
+	extents.z = 0.5f*nodeSize;
+}
+
+ID3D11Buffer* Terrain::GetPatchVB(const Node& node)
+{
+	UINT64 key = NodeKey(node.Level, node.X, node.Z);
+
+	auto it = mPatchCache.find(key);
+	if( it != mPatchCache.end() )
+	{
+		it->second.LastUsedFrame = mFrame;
+		return it->second.VB;
+	}
+
+	std::vector<Vertex> vertices;
+	BuildPatchVertices(node, vertices);
+
+	D3D11_BUFFER_DESC vbd;
+	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(Vertex) * vertices.size();
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = 0;
+	vbd.MiscFlags = 0;
+	vbd.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA vinitData;
+	vinitData.pSysMem = &vertices[0];
+
+	CachedPatch patch;
+	patch.VB = 0;
+	patch.LastUsedFrame = mFrame;
+	HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &patch.VB));
+
+	mPatchCache[key] = patch;
+
+	return patch.VB;
+}
+
+void Terrain::BuildPatchVertices(const Node& node, std::vector<Vertex>& vertices)const
+{
+	UINT p = mInfo.PatchCells;
+	UINT n = p + 1;
+	int stride = 1 << node.Level;
+
+	int row0 = (int)(node.Z*p) * stride;
+	int col0 = (int)(node.X*p) * stride;
+
+	float halfWidth = 0.5f*GetWidth();
+	float halfDepth = 0.5f*GetDepth();
+	float invSize = 1.0f / (mInfo.NumSamples-1);
+
+	// Normals use central differences over the patch's own sample spacing so
+	// coarse patches are shaded like the terrain they approximate.
+	float twoDx = 2.0f*stride*mInfo.CellSpacing;
+
+	// Streamed tiles already hold the patch's heights and normals.  The caller
+	// only selects nodes whose tile is resident.
+	const TerrainTile* tile = 0;
+	if( mStreaming )
+	{
+		tile = mStreamer.Find(node.Level, node.X, node.Z);
+		assert(tile);
+	}
+
+	vertices.resize(n*n);
+	for(UINT i = 0; i < n; ++i)
+	{
+		int row = row0 + (int)i*stride;
+		for(UINT j = 0; j < n; ++j)
+		{
+			int col = col0 + (int)j*stride;
+
+			Vertex& v = vertices[i*n+j];
+			v.Pos.x = -halfWidth + col*mInfo.CellSpacing;
+			v.Pos.z = halfDepth - row*mInfo.CellSpacing;
+
+			// Stretch texture over the whole terrain, like GeometryGenerator::CreateGrid.
+			v.Tex.x = col*invSize;
+			v.Tex.y = row*invSize;
+
+			if( tile )
+			{
+				v.Pos.y  = tile->Heights[i*n+j];
+				v.Normal = TerrainTile::UnpackNormal(tile->Normals[i*n+j]);
+				continue;
+			}
+
+			v.Pos.y = Sample(row, col);
+
+			float l = Sample(row, col-stride);
+			float r = Sample(row, col+stride);
+			float t = Sample(row-stride, col);
+			float b = Sample(row+stride, col);
+
+			XMVECTOR N = XMVector3Normalize(XMVectorSet(l-r, twoDx, b-t, 0.0f));
+			XMStoreFloat3(&v.Normal, N);
+		}
+	}
+}
+
+void Terrain::EvictPatches()
+{
+	if( mPatchCache.size() <= mInfo.MaxCachedPatches )
+		return;
+
+	// Never evict patches that are drawn this frame.
+	mEvictCandidates.clear();
+	for(auto it = mPatchCache.begin(); it != mPatchCache.end(); ++it)
+	{
+		if( it->second.LastUsedFrame != mFrame )
+			mEvictCandidates.push_back(std::make_pair(it->second.LastUsedFrame, it->first));
+	}
+
+	size_t excess = MathHelper::Min(mPatchCache.size() - mInfo.MaxCachedPatches, mEvictCandidates.size());
+
+	std::partial_sort(mEvictCandidates.begin(), mEvictCandidates.begin() + excess, mEvictCandidates.end());
+
+	for(size_t i = 0; i < excess; ++i)
+	{
+		auto it = mPatchCache.find(mEvictCandidates[i].second);
+		ReleaseCOM(it->second.VB);
+		mPatchCache.erase(it);
+	}
+}
+
+bool Terrain::WriteTileFile(const std::wstring& filename)const
+{
+	assert(!mStreaming);
+
+	std::ofstream fout(filename.c_str(), std::ios_base::binary);
+	if( !fout )
+		return false;
+
+	UINT p = mInfo.PatchCells;
+	UINT samples = (p+1)*(p+1);
+
+	TerrainTileFileHeader header;
+	ZeroMemory(&header, sizeof(header));
+	header.Magic       = TerrainTileFileHeader::FileMagic;
+	header.Version     = TerrainTileFileHeader::FileVersion;
+	header.NumSamples  = mInfo.NumSamples;
+	header.PatchCells  = p;
+	header.CellSpacing = mInfo.CellSpacing;
+	header.NumLevels   = mNumLevels;
+	header.RecordSize  = samples*(sizeof(float) + sizeof(UINT));
+
+	for(UINT level = 0; level < mNumLevels; ++level)
+		header.NodeCount += NodesPerSide(level)*NodesPerSide(level);
+
+	header.BoundsOffset = sizeof(TerrainTileFileHeader);
+	header.TilesOffset  = header.BoundsOffset + header.NodeCount*sizeof(XMFLOAT2);
+
+	fout.write((const char*)&header, sizeof(header));
+
+	for(UINT level = 0; level < mNumLevels; ++level)
+		fout.write((const char*)&mHeightBounds[level][0], mHeightBounds[level].size()*sizeof(XMFLOAT2));
+
+	std::vector<Vertex> vertices;
+	std::vector<float> heights(samples);
+	std::vector<UINT> normals(samples);
+
+	for(UINT level = 0; level < mNumLevels; ++level)
+	{
+		UINT n = NodesPerSide(level);
+		for(UINT z = 0; z < n; ++z)
+		{
+			for(UINT x = 0; x < n; ++x)
+			{
+				Node node;
+				node.Level = level;
+				node.X = x;
+				node.Z = z;
+				node.StitchMask = 0;
+
+				BuildPatchVertices(node, vertices);
+
+				for(UINT i = 0; i < samples; ++i)
+				{
+					heights[i] = vertices[i].Pos.y;
+					normals[i] = TerrainTile::PackNormal(vertices[i].Normal);
+				}
+
+				fout.write((const char*)&heights[0], samples*sizeof(float));
+				fout.write((const char*)&normals[0], samples*sizeof(UINT));
+			}
+		}
+	}
+
+	return fout.good();
+}
+
+float Terrain::GetStreamedHeight(float x, float z)const
+{
+	float nodeSize0 = mInfo.PatchCells*mInfo.CellSpacing;
+
+	// Position relative to the north west corner, in world units.
+	float u = x + 0.5f*GetWidth();
+	float v = 0.5f*GetDepth() - z;
+
+	// Use the finest resident tile that contains the point.
+	for(UINT level = 0; level < mNumLevels; ++level)
+	{
+		float nodeSize = nodeSize0*(float)(1u << level);
+		UINT n = NodesPerSide(level);
+
+		int nx = MathHelper::Clamp((int)floorf(u / nodeSize), 0, (int)n-1);
+		int nz = MathHelper::Clamp((int)floorf(v / nodeSize), 0, (int)n-1);
+
+		const TerrainTile* tile = mStreamer.Find(level, nx, nz);
+		if( !tile )
+			continue;
+
+		// Bilinear filter within the tile's grid.
+		float spacing = nodeSize / mInfo.PatchCells;
+		float c = MathHelper::Clamp((u - nx*nodeSize) / spacing, 0.0f, (float)mInfo.PatchCells);
+		float d = MathHelper::Clamp((v - nz*nodeSize) / spacing, 0.0f, (float)mInfo.PatchCells);
+
+		UINT col = MathHelper::Min((UINT)c, mInfo.PatchCells-1);
+		UINT row = MathHelper::Min((UINT)d, mInfo.PatchCells-1);
+		float s = c - col;
+		float t = d - row;
+
+		UINT stride = mInfo.PatchCells + 1;
+		float A = tile->Heights[row*stride + col];
+		float B = tile->Heights[row*stride + col+1];
+		float C = tile->Heights[(row+1)*stride + col];
+		float D = tile->Heights[(row+1)*stride + col+1];
+
+		return MathHelper::Lerp(MathHelper::Lerp(A, B, s), MathHelper::Lerp(C, D, s), t);
+	}
+
+	return 0.0f;
+}
+
+float Terrain::Sample(int row, int col)const
+{
+	return mHeightfield.GetSample(row, col);
+}
+
+UINT Terrain::NodesPerSide(UINT level)const
+{
+	return (mInfo.NumSamples-1) / (mInfo.PatchCells << level);
+}
+
+UINT64 Terrain::NodeKey(UINT level, UINT x, UINT z)
+{
+	return ((UINT64)level << 56) | ((UINT64)x << 28) | (UINT64)z;
+}
@@ -0,0 +1,209 @@
+//***************************************************************************************
+// Terrain.h
+//
+// Heightfield terrain rendered as a quadtree of fixed size patches (geomipmapping).
+//   -Every quadtree node is drawn with the same (PatchCells+1)^2 vertex grid; a node
+//    at level L samples the heightfield with a stride of 2^L.  The number of vertices
+//    drawn therefore depends on the camera, not on the size of the heightfield.
+//   -Each frame the tree is walked from the root; a node is refined while the camera
+//    is closer than its LOD range and skipped if its bounds are outside the frustum.
+//   -Where a patch borders a coarser patch, the odd vertices on that edge are skipped
+//    by one of 16 shared index patterns, so there are no cracks between levels.
+//
+// Terrains too large for memory can be streamed: WriteTileFile() cooks a terrain into
+// a tile file holding one record per quadtree node, and a terrain initialized with
+// InitInfo::TileFilename pages those tiles in on background threads.  A node is only
+// refined once its children's tiles are resident, so while loads are in flight the
+// coarser parent keeps being drawn.  Neighbors of that parent which are more than one
+// level finer are merged back until they are one level finer, so the stitching
+// still holds.
+//
+// The vertex format matches Vertex::Basic32 of the demos so the terrain can be drawn
+// with the Basic effect.
+//***************************************************************************************
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include "d3dUtil.h"
+#include "Camera.h"
+#include "TerrainStreamer.h"
+#include "Heightfield.h"
+#include <unordered_map>
+
+class Terrain
+{
+public:
+	struct Vertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT3 Normal;
+		XMFLOAT2 Tex;
+	};
+
+	struct InitInfo
+	{
+		InitInfo();
+
+		// 16-bit RAW heightmap.  If empty, HeightFunc is evaluated instead.
+		std::wstring HeightMapFilename;
+		float (*HeightFunc)(float x, float z);
+
+		// Scales the [0,1] RAW samples to world units.
+		float HeightScale;
+
+		// Samples per side.  Must be PatchCells*2^k + 1.
+		UINT NumSamples;
+
+		// Cells per patch side.  Must be a power of two.
+		UINT PatchCells;
+
+		// World space distance between samples.
+		float CellSpacing;
+
+		// Distance at which level 0 patches are replaced by level 1 patches.  Each
+		// following level doubles the range.
+		float LodDistance;
+
+		// Number of patch vertex buffers kept alive before the least recently
+		// used ones are released.
+		UINT MaxCachedPatches;
+
+		// Cooked tile file to stream from.  When set, the heightmap settings above
+		// are ignored and the dimensions come from the file.
+		std::wstring TileFilename;
+
+		// Resident tile memory before least recently used tiles are evicted.
+		UINT64 TileMemoryBudget;
+
+		// Background threads that page in tiles.
+		UINT StreamingThreads;
+
+		// Tiles are prefetched around where the camera will be in this many frames
+		// if it keeps its current velocity.
+		float PrefetchFrames;
+	};
+
+public:
+	Terrain();
+	~Terrain();
+
+	float GetWidth()const;
+	float GetDepth()const;
+	UINT GetNumLevels()const;
+
+	// Bilinearly interpolated height at world space (x, z).
+	float GetHeight(float x, float z)const;
+
+	// Full resolution heights for normal and ray queries.  Empty for streamed
+	// terrains, which never hold all of their heights in memory.
+	const Heightfield& GetHeightfield()const;
+
+	// Returns false if the heightmap or tile file cannot be read; the terrain is
+	// then empty and Update() and Draw() do nothing.
+	bool Init(ID3D11Device* device, const InitInfo& initInfo);
+
+	// Selects the patches to draw for this camera and builds missing patch buffers.
+	void Update(const Camera& cam);
+
+	// Draws the selected patches.  The caller sets the input layout, topology and
+	// applies the effect pass (world matrix = identity) beforehand.
+	void Draw(ID3D11DeviceContext* dc);
+
+	UINT GetVisiblePatchCount()const;
+	UINT GetVisibleTriangleCount()const;
+
+	// Writes every quadtree node's patch to a tile file for streaming.  Only
+	// valid for terrains built from a heightmap or height function.
+	bool WriteTileFile(const std::wstring& filename)const;
+
+	const TerrainStreamer& GetStreamer()const;
+
+private:
+	// Edges of a patch; a set bit in the pattern mask means that neighbor is coarser.
+	enum Edge
+	{
+		EdgeNorth = 1,
+		EdgeEast  = 2,
+		EdgeSouth = 4,
+		EdgeWest  = 8
+	};
+
+	struct Node
+	{
+		UINT Level;
+		UINT X;
+		UINT Z;
+		UINT StitchMask;
+	};
+
+	struct CachedPatch
+	{
+		ID3D11Buffer* VB;
+		UINT LastUsedFrame;
+	};
+
+	bool LoadHeightmap();
+	void InitStreaming();
+	void BuildHeightBounds();
+	void BuildIndexPatterns(ID3D11Device* device);
+
+	void SelectNode(UINT level, UINT x, UINT z, const Camera& cam, FXMVECTOR eyePos);
+	void PrefetchNode(UINT level, UINT x, UINT z, FXMVECTOR eyePos);
+	bool AreChildrenReady(UINT level, UINT x, UINT z, float priority);
+	float DistanceToNode(UINT level, UINT x, UINT z, FXMVECTOR eyePos)const;
+	UINT ComputeStitchMask(const Node& node)const;
+	bool IsCoarserSelected(UINT level, int x0, int z0)const;
+	int FindSelectedLevel(int x0, int z0, UINT firstLevel)const;
+	void RestrictNeighborLevels();
+	bool FindFinerNeighbor(const Node& node, Node& fine)const;
+	void MergeSelected(UINT level, UINT x, UINT z);
+	void GetNodeBounds(UINT level, UINT x, UINT z, XMFLOAT3& center, XMFLOAT3& extents)const;
+
+	ID3D11Buffer* GetPatchVB(const Node& node);
+	void BuildPatchVertices(const Node& node, std::vector<Vertex>& vertices)const;
+	void EvictPatches();
+
+	float Sample(int row, int col)const;
+	float GetStreamedHeight(float x, float z)const;
+	UINT NodesPerSide(UINT level)const;
+
+	static UINT64 NodeKey(UINT level, UINT x, UINT z);
+
+private:
+	Terrain(const Terrain& rhs);
+	Terrain& operator=(const Terrain& rhs);
+
+private:
+	ID3D11Device* md3dDevice;
+
+	InitInfo mInfo;
+	UINT mNumLevels;
+
+	Heightfield mHeightfield;
+
+	// Min/max height (x, y) of every node, one array per level.
+	std::vector<std::vector<XMFLOAT2>> mHeightBounds;
+	std::vector<float> mLodRanges;
+
+	// All 16 stitch patterns live in one index buffer.
+	ID3D11Buffer* mPatternIB;
+	UINT mPatternStart[16];
+	UINT mPatternCount[16];
+
+	// Rebuilt every Update() without allocating once they have grown to the
+	// largest selection.  mSelectedKeys is sorted for IsCoarserSelected().
+	std::vector<Node> mSelected;
+	std::vector<UINT64> mSelectedKeys;
+	std::vector<ID3D11Buffer*> mSelectedVBs;
+
+	std::unordered_map<UINT64, CachedPatch> mPatchCache;
+	std::vector<std::pair<UINT, UINT64>> mEvictCandidates;
+	UINT mFrame;
+
+	bool mStreaming;
+	TerrainStreamer mStreamer;
+	XMFLOAT3 mLastEyePos;
+};
+
+#endif // TERRAIN_H
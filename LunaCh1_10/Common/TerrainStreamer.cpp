@@ -0,0 +1,450 @@
+//***************************************************************************************
+// TerrainStreamer.cpp
+//***************************************************************************************
+
+#include "TerrainStreamer.h"
+#include "FrameArena.h"
+
+UINT TerrainTile::PackNormal(const XMFLOAT3& n)
+{
+	int x = (int)MathHelper::Clamp(n.x*127.0f, -127.0f, 127.0f);
+	int y = (int)MathHelper::Clamp(n.y*127.0f, -127.0f, 127.0f);
+	int z = (int)MathHelper::Clamp(n.z*127.0f, -127.0f, 127.0f);
+
+	return ((UINT)(x & 0xff) << 0) | ((UINT)(y & 0xff) << 8) | ((UINT)(z & 0xff) << 16);
+}
+
+XMFLOAT3 TerrainTile::UnpackNormal(UINT packed)
+{
+	// Sign extend each byte.
+	signed char x = (signed char)((packed >> 0)  & 0xff);
+	signed char y = (signed char)((packed >> 8)  & 0xff);
+	signed char z = (signed char)((packed >> 16) & 0xff);
+
+	return XMFLOAT3(x / 127.0f, y / 127.0f, z / 127.0f);
+}
+
+TerrainStreamer::TerrainStreamer()
+	: mFile(INVALID_HANDLE_VALUE),
+	  mMapping(0),
+	  mAllocationGranularity(0),
+	  mMemoryBudget(0),
+	  mResidentBytes(0),
+	  mTileBytes(0),
+	  mFrame(0),
+	  mLoadCount(0),
+	  mEvictionCount(0),
+	  mQuit(false)
+{
+	ZeroMemory(&mHeader, sizeof(mHeader));
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+	Close();
+}
+
+bool TerrainStreamer::Open(const std::wstring& filename, UINT64 memoryBudget, UINT numThreads)
+{
+	Close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 0);
+
+	if( mFile == INVALID_HANDLE_VALUE )
+		return false;
+
+	//
+	// Validate the header and read the node bounds.  They are small compared
+	// to the tiles and needed every frame for culling, so they stay in memory.
+	//
+
+	DWORD bytesRead = 0;
+	if( !ReadFile(mFile, &mHeader, sizeof(mHeader), &bytesRead, 0) || bytesRead != sizeof(mHeader) ||
+		mHeader.Magic != TerrainTileFileHeader::FileMagic ||
+		mHeader.Version != TerrainTileFileHeader::FileVersion )
+	{
+		Close();
+		return false;
+	}
+
+	mLevelStart.resize(mHeader.NumLevels);
+	UINT nodeCount = 0;
+	for(UINT level = 0; level < mHeader.NumLevels; ++level)
+	{
+		mLevelStart[level] = nodeCount;
+		nodeCount += NodesPerSide(level)*NodesPerSide(level);
+	}
+	assert(nodeCount == mHeader.NodeCount);
+
+	mBounds.resize(mHeader.NodeCount);
+
+	LARGE_INTEGER pos;
+	pos.QuadPart = (LONGLONG)mHeader.BoundsOffset;
+	SetFilePointerEx(mFile, pos, 0, FILE_BEGIN);
+
+	DWORD boundsSize = mHeader.NodeCount*sizeof(XMFLOAT2);
+	if( !ReadFile(mFile, &mBounds[0], boundsSize, &bytesRead, 0) || bytesRead != boundsSize )
+	{
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingW(mFile, 0, PAGE_READONLY, 0, 0, 0);
+	if( mMapping == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	mAllocationGranularity = sysInfo.dwAllocationGranularity;
+
+	UINT samples = (mHeader.PatchCells+1)*(mHeader.PatchCells+1);
+	mTileBytes = sizeof(TerrainTile) + samples*(sizeof(float) + sizeof(UINT));
+
+	mMemoryBudget = memoryBudget;
+
+	mQuit = false;
+	for(UINT i = 0; i < MathHelper::Max(numThreads, 1u); ++i)
+		mWorkers.push_back(std::thread(&TerrainStreamer::WorkerMain, this));
+
+	return true;
+}
+
+void TerrainStreamer::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeWorkers.notify_all();
+
+	for(size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+	mWorkers.clear();
+
+	for(size_t i = 0; i < mCompleted.size(); ++i)
+		delete mCompleted[i].Tile;
+	mCompleted.clear();
+	mQueue.clear();
+	mInFlight.clear();
+
+	for(auto it = mResident.begin(); it != mResident.end(); ++it)
+		delete it->second.Tile;
+	mResident.clear();
+	mResidentBytes = 0;
+
+	if( mMapping )
+	{
+		CloseHandle(mMapping);
+		mMapping = 0;
+	}
+
+	if( mFile != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+}
+
+const TerrainTileFileHeader& TerrainStreamer::GetHeader()const
+{
+	return mHeader;
+}
+
+const XMFLOAT2& TerrainStreamer::GetBounds(UINT level, UINT x, UINT z)const
+{
+	return mBounds[mLevelStart[level] + z*NodesPerSide(level) + x];
+}
+
+const TerrainTile* TerrainStreamer::Request(UINT level, UINT x, UINT z, float priority)
+{
+	UINT64 key = TileKey(level, x, z);
+
+	auto it = mResident.find(key);
+	if( it != mResident.end() )
+	{
+		it->second.LastUsedFrame = mFrame;
+		return it->second.Tile;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto pending = mInFlight.find(key);
+	if( pending != mInFlight.end() )
+	{
+		// Queued or loading.  A queued request is kept alive and takes the more
+		// urgent priority.
+		if( pending->second != Loading )
+		{
+			LoadRequest& queued = mQueue[pending->second];
+			queued.Priority = MathHelper::Min(queued.Priority, priority);
+			queued.LastRequestedFrame = mFrame;
+		}
+
+		return 0;
+	}
+
+	LoadRequest request;
+	request.Key = key;
+	request.Priority = priority;
+	request.LastRequestedFrame = mFrame;
+
+	mInFlight[key] = (UINT)mQueue.size();
+	mQueue.push_back(request);
+
+	mWakeWorkers.notify_one();
+
+	return 0;
+}
+
+const TerrainTile* TerrainStreamer::Find(UINT level, UINT x, UINT z)const
+{
+	auto it = mResident.find(TileKey(level, x, z));
+	return it != mResident.end() ? it->second.Tile : 0;
+}
+
+const TerrainTile* TerrainStreamer::Pin(UINT level, UINT x, UINT z)
+{
+	UINT64 key = TileKey(level, x, z);
+
+	auto it = mResident.find(key);
+	if( it != mResident.end() )
+	{
+		it->second.Pinned = true;
+		return it->second.Tile;
+	}
+
+	Resident resident;
+	resident.Tile = LoadTile(key);
+	resident.LastUsedFrame = mFrame;
+	resident.Pinned = true;
+
+	mResident[key] = resident;
+	mResidentBytes += mTileBytes;
+	++mLoadCount;
+
+	return resident.Tile;
+}
+
+void TerrainStreamer::EndFrame()
+{
+	std::vector<LoadResult> completed;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		completed.swap(mCompleted);
+
+		for(size_t i = 0; i < completed.size(); ++i)
+			mInFlight.erase(completed[i].Key);
+
+		// Drop queued requests nobody asked for this frame; the camera has moved
+		// on and the tile would just be evicted again.
+		for(size_t i = 0; i < mQueue.size(); )
+		{
+			if( mQueue[i].LastRequestedFrame != mFrame )
+			{
+				mInFlight.erase(mQueue[i].Key);
+				RemoveQueued(i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	for(size_t i = 0; i < completed.size(); ++i)
+	{
+		// Pin() may have loaded the same tile while the worker was busy.
+		if( mResident.count(completed[i].Key) )
+		{
+			delete completed[i].Tile;
+			continue;
+		}
+
+		Resident resident;
+		resident.Tile = completed[i].Tile;
+		resident.LastUsedFrame = mFrame;
+		resident.Pinned = false;
+
+		mResident[completed[i].Key] = resident;
+		mResidentBytes += mTileBytes;
+		++mLoadCount;
+	}
+
+	//
+	// Evict least recently used tiles until we are within budget.
+	//
+
+	if( mResidentBytes > mMemoryBudget )
+	{
+		FrameVector<std::pair<UINT, UINT64> >::Type candidates;
+		candidates.reserve(mResident.size());
+
+		for(auto it = mResident.begin(); it != mResident.end(); ++it)
+		{
+			if( !it->second.Pinned && it->second.LastUsedFrame != mFrame )
+				candidates.push_back(std::make_pair(it->second.LastUsedFrame, it->first));
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+
+		for(size_t i = 0; i < candidates.size() && mResidentBytes > mMemoryBudget; ++i)
+		{
+			auto it = mResident.find(candidates[i].second);
+			delete it->second.Tile;
+			mResident.erase(it);
+
+			mResidentBytes -= mTileBytes;
+			++mEvictionCount;
+		}
+	}
+
+	++mFrame;
+}
+
+UINT64 TerrainStreamer::GetResidentBytes()const
+{
+	return mResidentBytes;
+}
+
+UINT TerrainStreamer::GetResidentTileCount()const
+{
+	return (UINT)mResident.size();
+}
+
+UINT TerrainStreamer::GetPendingCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return (UINT)mInFlight.size();
+}
+
+UINT TerrainStreamer::GetLoadCount()const
+{
+	return mLoadCount;
+}
+
+UINT TerrainStreamer::GetEvictionCount()const
+{
+	return mEvictionCount;
+}
+
+void TerrainStreamer::WorkerMain()
+{
+	while(true)
+	{
+		LoadRequest request;
+
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			while( !mQuit && mQueue.empty() )
+				mWakeWorkers.wait(lock);
+
+			if( mQuit )
+				return;
+
+			// Most urgent request first.
+			size_t best = 0;
+			for(size_t i = 1; i < mQueue.size(); ++i)
+			{
+				if( mQueue[i].Priority < mQueue[best].Priority )
+					best = i;
+			}
+
+			request = mQueue[best];
+			RemoveQueued(best);
+			mInFlight[request.Key] = Loading;
+		}
+
+		TerrainTile* tile = LoadTile(request.Key);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			LoadResult result;
+			result.Key = request.Key;
+			result.Tile = tile;
+			mCompleted.push_back(result);
+		}
+	}
+}
+
+void TerrainStreamer::RemoveQueued(size_t index)
+{
+	// Move the last request into the hole and point its key at the new slot.
+	if( index + 1 < mQueue.size() )
+	{
+		mQueue[index] = mQueue.back();
+		mInFlight[mQueue[index].Key] = (UINT)index;
+	}
+
+	mQueue.pop_back();
+}
+
+TerrainTile* TerrainStreamer::LoadTile(UINT64 key)const
+{
+	UINT level, x, z;
+	SplitKey(key, level, x, z);
+
+	UINT samples = (mHeader.PatchCells+1)*(mHeader.PatchCells+1);
+
+	TerrainTile* tile = new TerrainTile();
+	tile->Heights.resize(samples);
+	tile->Normals.resize(samples);
+
+	//
+	// Views must start on the allocation granularity, so map from the aligned
+	// offset below the record and skip the difference.  Copying out of the view
+	// is what faults the pages in, which keeps the disk reads on this thread.
+	//
+
+	UINT64 offset  = RecordOffset(level, x, z);
+	UINT64 aligned = offset - (offset % mAllocationGranularity);
+	SIZE_T delta   = (SIZE_T)(offset - aligned);
+
+	const BYTE* view = (const BYTE*)MapViewOfFile(mMapping, FILE_MAP_READ,
+		(DWORD)(aligned >> 32), (DWORD)(aligned & 0xffffffff), delta + mHeader.RecordSize);
+
+	if( view )
+	{
+		const BYTE* record = view + delta;
+		memcpy(&tile->Heights[0], record, samples*sizeof(float));
+		memcpy(&tile->Normals[0], record + samples*sizeof(float), samples*sizeof(UINT));
+
+		UnmapViewOfFile(view);
+	}
+	else
+	{
+		std::fill(tile->Heights.begin(), tile->Heights.end(), 0.0f);
+		std::fill(tile->Normals.begin(), tile->Normals.end(), TerrainTile::PackNormal(XMFLOAT3(0.0f, 1.0f, 0.0f)));
+	}
+
+	return tile;
+}
+
+UINT64 TerrainStreamer::RecordOffset(UINT level, UINT x, UINT z)const
+{
+	UINT64 index = mLevelStart[level] + z*NodesPerSide(level) + x;
+	return mHeader.TilesOffset + index*mHeader.RecordSize;
+}
+
+UINT TerrainStreamer::NodesPerSide(UINT level)const
+{
+	return (mHeader.NumSamples-1) / (mHeader.PatchCells << level);
+}
+
+UINT64 TerrainStreamer::TileKey(UINT level, UINT x, UINT z)
+{
+	return ((UINT64)level << 56) | ((UINT64)x << 28) | (UINT64)z;
+}
+
+void TerrainStreamer::SplitKey(UINT64 key, UINT& level, UINT& x, UINT& z)
+{
+	level = (UINT)(key >> 56);
+	x     = (UINT)((key >> 28) & 0xfffffff);
+	z     = (UINT)(key & 0xfffffff);
+}
@@ -0,0 +1,165 @@
+//***************************************************************************************
+// TerrainStreamer.h
+//
+// Pages terrain tiles from a cooked tile file on background threads.
+//   -The tile file holds one record per terrain quadtree node: the (PatchCells+1)^2
+//    heights and packed normals of that node's patch, plus the min/max bounds of
+//    every node so the whole tree can be culled without any tile being resident.
+//   -Workers map the tile's region of the file, copy it out and hand it back to the
+//    main thread, which makes it resident in EndFrame().
+//   -Resident tiles are evicted least recently used first once the memory budget is
+//    exceeded.  Pinned tiles (the coarse top of the tree) are never evicted so there
+//    is always something to fall back to.
+//
+// Tile files are written with Terrain::WriteTileFile().
+//***************************************************************************************
+
+#ifndef TERRAINSTREAMER_H
+#define TERRAINSTREAMER_H
+
+#include "d3dUtil.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
+///<summary>
+/// Header at the start of a tile file.  Bounds follow the header (one XMFLOAT2 per
+/// node, level 0 first, row major within a level) and then the tile records in the
+/// same order.
+///</summary>
+struct TerrainTileFileHeader
+{
+	UINT Magic;
+	UINT Version;
+	UINT NumSamples;
+	UINT PatchCells;
+	float CellSpacing;
+	UINT NumLevels;
+	UINT NodeCount;
+	UINT RecordSize;
+	UINT64 BoundsOffset;
+	UINT64 TilesOffset;
+
+	static const UINT FileMagic   = 0x4C495454; // 'TTIL'
+	static const UINT FileVersion = 1;
+};
+
+///<summary>
+/// Patch data of one quadtree node.
+///</summary>
+struct TerrainTile
+{
+	std::vector<float> Heights;
+
+	// Signed 8-bit x, y, z normal components packed in the low three bytes.
+	std::vector<UINT> Normals;
+
+	static UINT PackNormal(const XMFLOAT3& n);
+	static XMFLOAT3 UnpackNormal(UINT packed);
+};
+
+class TerrainStreamer
+{
+public:
+	TerrainStreamer();
+	~TerrainStreamer();
+
+	// Opens the tile file and starts the worker threads.
+	bool Open(const std::wstring& filename, UINT64 memoryBudget, UINT numThreads);
+	void Close();
+
+	const TerrainTileFileHeader& GetHeader()const;
+
+	// Min/max height of a node, available for every node without streaming.
+	const XMFLOAT2& GetBounds(UINT level, UINT x, UINT z)const;
+
+	// Returns the tile if resident, otherwise queues a load and returns 0.  Lower
+	// priority values are loaded first.
+	const TerrainTile* Request(UINT level, UINT x, UINT z, float priority);
+
+	// Returns the tile if resident without queuing a load.
+	const TerrainTile* Find(UINT level, UINT x, UINT z)const;
+
+	// Loads the tile on the calling thread and never evicts it.
+	const TerrainTile* Pin(UINT level, UINT x, UINT z);
+
+	// Makes finished loads resident, drops requests nobody asked for this frame
+	// and evicts tiles until the budget is met.  Call once per frame.
+	void EndFrame();
+
+	UINT64 GetResidentBytes()const;
+	UINT GetResidentTileCount()const;
+	UINT GetPendingCount()const;
+	UINT GetLoadCount()const;
+	UINT GetEvictionCount()const;
+
+private:
+	struct Resident
+	{
+		TerrainTile* Tile;
+		UINT LastUsedFrame;
+		bool Pinned;
+	};
+
+	struct LoadRequest
+	{
+		UINT64 Key;
+		float Priority;
+		UINT LastRequestedFrame;
+	};
+
+	struct LoadResult
+	{
+		UINT64 Key;
+		TerrainTile* Tile;
+	};
+
+	void WorkerMain();
+	void RemoveQueued(size_t index);
+	TerrainTile* LoadTile(UINT64 key)const;
+	UINT64 RecordOffset(UINT level, UINT x, UINT z)const;
+	UINT NodesPerSide(UINT level)const;
+
+	static UINT64 TileKey(UINT level, UINT x, UINT z);
+	static void SplitKey(UINT64 key, UINT& level, UINT& x, UINT& z);
+
+private:
+	TerrainStreamer(const TerrainStreamer& rhs);
+	TerrainStreamer& operator=(const TerrainStreamer& rhs);
+
+private:
+	HANDLE mFile;
+	HANDLE mMapping;
+	DWORD mAllocationGranularity;
+
+	TerrainTileFileHeader mHeader;
+	std::vector<XMFLOAT2> mBounds;
+	std::vector<UINT> mLevelStart;
+
+	UINT64 mMemoryBudget;
+	UINT64 mResidentBytes;
+	UINT64 mTileBytes;
+	UINT mFrame;
+	UINT mLoadCount;
+	UINT mEvictionCount;
+
+	// Only touched by the main thread.
+	std::unordered_map<UINT64, Resident> mResident;
+
+	// Shared with the workers, guarded by mMutex.
+	std::vector<LoadRequest> mQueue;
+
+	// Every requested tile that is not resident yet: its index in mQueue, or
+	// Loading once a worker has taken it.
+	static const UINT Loading = 0xffffffff;
+	std::unordered_map<UINT64, UINT> mInFlight;
+	std::vector<LoadResult> mCompleted;
+	bool mQuit;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mWakeWorkers;
+	std::vector<std::thread> mWorkers;
+};
+
+#endif // TERRAINSTREAMER_H
@@ -0,0 +1,235 @@
+//***************************************************************************************
+// TextureAtlas.cpp
+//***************************************************************************************
+
+#include "TextureAtlas.h"
+
+namespace
+{
+	UINT RoundUp(UINT value, UINT multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	// Texture coordinates this far outside [0,1] are taken as rounding error rather
+	// than tiling.
+	const float TexCoordTolerance = 1.0e-4f;
+}
+
+TextureAtlas::BuildOptions::BuildOptions()
+	: PackMethod(AtlasPacker::MethodMaxRects),
+	  Padding(4),
+	  MipLevels(0),
+	  MaxSize(4096),
+	  Compress(false),
+	  CompressedFormat(BCEncoder::FormatBC1),
+	  CompressedQuality(BCEncoder::QualityNormal),
+	  NumThreads(0)
+{
+}
+
+TextureAtlas::TextureAtlas()
+	: mSRV(0)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	ReleaseCOM(mSRV);
+}
+
+bool TextureAtlas::Pack(const std::vector<DecodedTexture>& textures, const BuildOptions& options,
+	DecodedTexture& atlas, std::vector<XMFLOAT4>& rects)
+{
+	UINT numTextures = (UINT)textures.size();
+	if( numTextures == 0 )
+		return false;
+
+	DXGI_FORMAT format = textures[0].Format;
+	if( format != DXGI_FORMAT_R8G8B8A8_UNORM && format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB )
+		return false;
+
+	for(UINT i = 0; i < numTextures; ++i)
+	{
+		if( textures[i].Format != format || textures[i].ArraySize != 1 ||
+			textures[i].Subresources.empty() || textures[i].Width == 0 || textures[i].Height == 0 )
+			return false;
+	}
+
+	//
+	// Each mip halves the padding, so stop once it would drop below a texel.  Cells
+	// are sized so their borders land on whole texels in every mip (and on whole
+	// blocks if compressed); the packer only ever places them at sums of cell sizes,
+	// which keeps the positions aligned too.
+	//
+
+	UINT maxMips = 1;
+	while( (options.Padding >> (maxMips-1)) > 1 )
+		++maxMips;
+
+	UINT mipLevels = options.MipLevels > 0 ? MathHelper::Min(options.MipLevels, maxMips) : maxMips;
+
+	UINT align = 1 << (mipLevels-1);
+	if( options.Compress )
+		align = MathHelper::Max(align, 4u);
+
+	UINT pad = options.Padding;
+
+	std::vector<AtlasPacker::Rect> sizes(numTextures);
+	for(UINT i = 0; i < numTextures; ++i)
+	{
+		sizes[i].Width  = RoundUp(textures[i].Width + 2*pad, align);
+		sizes[i].Height = RoundUp(textures[i].Height + 2*pad, align);
+	}
+
+	UINT maxSize = MathHelper::Min(options.MaxSize, (UINT)D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION);
+
+	std::vector<AtlasPacker::Rect> cells;
+	uint32_t atlasW = 0;
+	uint32_t atlasH = 0;
+	if( !AtlasPacker::Pack(sizes, maxSize, maxSize, options.PackMethod, cells, atlasW, atlasH) )
+		return false;
+
+	atlas = DecodedTexture();
+	atlas.Width     = atlasW;
+	atlas.Height    = atlasH;
+	atlas.MipLevels = 1;
+	atlas.ArraySize = 1;
+	atlas.Format    = format;
+
+	UINT atlasPitch = atlas.Width*4;
+	atlas.Data.assign(atlasPitch*atlas.Height, 0);
+
+	DecodedTexture::Subresource top;
+	top.Offset     = 0;
+	top.RowPitch   = atlasPitch;
+	top.SlicePitch = atlasPitch*atlas.Height;
+	atlas.Subresources.push_back(top);
+
+	rects.resize(numTextures);
+
+	for(UINT i = 0; i < numTextures; ++i)
+	{
+		const AtlasPacker::Rect& cell = cells[i];
+		UINT texW = textures[i].Width;
+		UINT texH = textures[i].Height;
+
+		// Copy the top mip into its cell, extending its edges into the padding.
+		const BYTE* src = &textures[i].Data[(size_t)textures[i].Subresources[0].Offset];
+		UINT srcPitch = textures[i].Subresources[0].RowPitch;
+
+		for(UINT y = 0; y < cell.Height; ++y)
+		{
+			UINT srcY = (UINT)MathHelper::Clamp((int)y - (int)pad, 0, (int)texH-1);
+			BYTE* dst = &atlas.Data[(cell.Y + y)*atlasPitch + cell.X*4];
+
+			for(UINT x = 0; x < cell.Width; ++x)
+			{
+				UINT srcX = (UINT)MathHelper::Clamp((int)x - (int)pad, 0, (int)texW-1);
+				*(UINT*)(dst + x*4) = *(const UINT*)(src + srcY*srcPitch + srcX*4);
+			}
+		}
+
+		rects[i] = XMFLOAT4(
+			(float)(cell.X + pad) / atlas.Width,
+			(float)(cell.Y + pad) / atlas.Height,
+			(float)texW / atlas.Width,
+			(float)texH / atlas.Height);
+	}
+
+	// A box filter stays within the padding; wider filters would pick up neighbors.
+	MipGenerator::Options mipOptions;
+	mipOptions.MipFilter = MipGenerator::FilterBox;
+	mipOptions.MaxLevels = mipLevels;
+
+	if( mipLevels > 1 && !TextureDecoder::GenerateMips(atlas, mipOptions) )
+		return false;
+
+	if( options.Compress && !TextureDecoder::Compress(atlas, options.CompressedFormat, options.CompressedQuality) )
+		return false;
+
+	return true;
+}
+
+bool TextureAtlas::Build(ID3D11Device* device, const std::vector<std::wstring>& filenames, const BuildOptions& options)
+{
+	std::vector<DecodedTexture> textures;
+	if( !TextureDecoder::DecodeFiles(filenames, textures, options.NumThreads) )
+		return false;
+
+	return Build(device, textures, options);
+}
+
+bool TextureAtlas::Build(ID3D11Device* device, const std::vector<DecodedTexture>& textures, const BuildOptions& options)
+{
+	ReleaseCOM(mSRV);
+	mRects.clear();
+
+	DecodedTexture atlas;
+	std::vector<XMFLOAT4> rects;
+	if( !Pack(textures, options, atlas, rects) )
+		return false;
+
+	mSRV = TextureDecoder::CreateSRV(device, atlas);
+	if( mSRV == 0 )
+		return false;
+
+	mRects.swap(rects);
+
+	return true;
+}
+
+ID3D11ShaderResourceView* TextureAtlas::GetSRV()const
+{
+	return mSRV;
+}
+
+UINT TextureAtlas::GetTextureCount()const
+{
+	return (UINT)mRects.size();
+}
+
+const XMFLOAT4& TextureAtlas::GetRect(UINT texture)const
+{
+	return mRects[texture];
+}
+
+XMMATRIX TextureAtlas::GetTransform(UINT texture)const
+{
+	const XMFLOAT4& rect = mRects[texture];
+
+	return XMMatrixScaling(rect.z, rect.w, 1.0f) * XMMatrixTranslation(rect.x, rect.y, 0.0f);
+}
+
+bool TextureAtlas::RemapTexCoords(UINT texture, GeometryGenerator::MeshData& mesh,
+	UINT firstVertex, UINT vertexCount)const
+{
+	UINT numVertices = (UINT)mesh.Vertices.size();
+	if( firstVertex > numVertices )
+		return false;
+
+	UINT lastVertex = vertexCount > 0 ? firstVertex + vertexCount : numVertices;
+	if( lastVertex > numVertices )
+		return false;
+
+	for(UINT i = firstVertex; i < lastVertex; ++i)
+	{
+		const XMFLOAT2& uv = mesh.Vertices[i].TexC;
+
+		if( uv.x < -TexCoordTolerance || uv.x > 1.0f + TexCoordTolerance ||
+			uv.y < -TexCoordTolerance || uv.y > 1.0f + TexCoordTolerance )
+			return false;
+	}
+
+	const XMFLOAT4& rect = mRects[texture];
+
+	for(UINT i = firstVertex; i < lastVertex; ++i)
+	{
+		XMFLOAT2& uv = mesh.Vertices[i].TexC;
+
+		uv.x = rect.x + MathHelper::Clamp(uv.x, 0.0f, 1.0f)*rect.z;
+		uv.y = rect.y + MathHelper::Clamp(uv.y, 0.0f, 1.0f)*rect.w;
+	}
+
+	return true;
+}
@@ -0,0 +1,97 @@
+//***************************************************************************************
+// TextureAtlas.h
+//
+// Packs many small textures into one so that objects using different textures can
+// share a single SRV binding and be merged into fewer draws.
+//   -Textures are placed by AtlasPacker (skyline or maxrects) with edge-extended
+//    padding around each one, then the mip chain is built and the atlas is
+//    optionally block compressed.
+//   -RemapTexCoords() moves the texture coordinates of a mesh into its texture's
+//    rectangle, so meshes can be merged and drawn with the atlas and an identity
+//    texture transform.  GetTransform() does the same through the texture
+//    transform for meshes that are kept separate.
+//
+// As with Flipbook, the padding keeps neighbors from bleeding in under bilinear
+// filtering and in the mips, so the number of mips is limited by it.  Textures that
+// tile (coordinates outside [0,1]) can't be atlased.
+//***************************************************************************************
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include "d3dUtil.h"
+#include "TextureDecoder.h"
+#include "AtlasPacker.h"
+#include "GeometryGenerator.h"
+
+class TextureAtlas
+{
+public:
+	struct BuildOptions
+	{
+		BuildOptions();
+
+		AtlasPacker::Method PackMethod;
+
+		// Texels of padding around every texture.
+		UINT Padding;
+
+		// 0 makes as many mips as the padding allows.
+		UINT MipLevels;
+
+		// Largest width and height of the atlas.
+		UINT MaxSize;
+
+		bool Compress;
+		BCEncoder::Format CompressedFormat;
+		BCEncoder::Quality CompressedQuality;
+
+		// Jobs the files are decoded in, 0 makes each file a job and 1 decodes
+		// them on the calling thread.
+		UINT NumThreads;
+	};
+
+public:
+	TextureAtlas();
+	~TextureAtlas();
+
+	///<summary>
+	/// Packs the top mips of R8G8B8A8 textures into a system memory atlas.  rects
+	/// receives the rectangle of each texture: x, y = top left uv, z, w = size in uv.
+	/// Returns false if a texture has another format or they don't fit in
+	/// options.MaxSize.
+	///</summary>
+	static bool Pack(const std::vector<DecodedTexture>& textures, const BuildOptions& options,
+		DecodedTexture& atlas, std::vector<XMFLOAT4>& rects);
+
+	bool Build(ID3D11Device* device, const std::vector<std::wstring>& filenames, const BuildOptions& options);
+	bool Build(ID3D11Device* device, const std::vector<DecodedTexture>& textures, const BuildOptions& options);
+
+	ID3D11ShaderResourceView* GetSRV()const;
+
+	UINT GetTextureCount()const;
+
+	const XMFLOAT4& GetRect(UINT texture)const;
+
+	// Maps [0,1]^2 onto the texture's rectangle.
+	XMMATRIX GetTransform(UINT texture)const;
+
+	///<summary>
+	/// Maps the texture coordinates of vertexCount vertices from firstVertex (0 for
+	/// the rest of the mesh) into the texture's rectangle.  Returns false, changing
+	/// nothing, if any of them lies outside [0,1].
+	///</summary>
+	bool RemapTexCoords(UINT texture, GeometryGenerator::MeshData& mesh,
+		UINT firstVertex = 0, UINT vertexCount = 0)const;
+
+private:
+	TextureAtlas(const TextureAtlas& rhs);
+	TextureAtlas& operator=(const TextureAtlas& rhs);
+
+private:
+	ID3D11ShaderResourceView* mSRV;
+
+	std::vector<XMFLOAT4> mRects;
+};
+
+#endif // TEXTUREATLAS_H
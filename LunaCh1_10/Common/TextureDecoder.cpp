@@ -0,0 +1,537 @@
+//***************************************************************************************
+// TextureDecoder.cpp
+//***************************************************************************************
+
+#include "TextureDecoder.h"
+#include "JobSystem.h"
+
+namespace
+{
+	struct DecodeJob
+	{
+		const std::vector<std::wstring>* Files;
+		std::vector<DecodedTexture>* Textures;
+		std::vector<BYTE>* Decoded;
+	};
+
+	void DecodeFilesJob(void* job, UINT firstFile, UINT endFile)
+	{
+		DecodeJob& decode = *static_cast<DecodeJob*>(job);
+
+		for(UINT i = firstFile; i < endFile; ++i)
+			(*decode.Decoded)[i] = TextureDecoder::DecodeFile((*decode.Files)[i], (*decode.Textures)[i]) ? 1 : 0;
+	}
+}
+
+DecodedTexture::DecodedTexture()
+	: Width(0),
+	  Height(0),
+	  MipLevels(0),
+	  ArraySize(0),
+	  Format(DXGI_FORMAT_UNKNOWN)
+{
+}
+
+bool TextureDecoder::ReadFileBytes(const std::wstring& filename, std::vector<BYTE>& bytes)
+{
+	std::ifstream fin(filename.c_str(), std::ios::binary);
+	if( !fin )
+		return false;
+
+	fin.seekg(0, std::ios_base::end);
+	std::streamoff size = fin.tellg();
+	fin.seekg(0, std::ios_base::beg);
+
+	if( size <= 0 )
+		return false;
+
+	bytes.resize((size_t)size);
+	fin.read((char*)&bytes[0], size);
+
+	return !fin.fail();
+}
+
+bool TextureDecoder::DecodeFile(const std::wstring& filename, DecodedTexture& texture)
+{
+	std::vector<BYTE> bytes;
+	if( !ReadFileBytes(filename, bytes) || bytes.size() < 4 )
+		return false;
+
+	if( *(const DWORD*)&bytes[0] == DDSFile::Magic )
+		return DecodeDDS(&bytes[0], bytes.size(), texture);
+
+	if( bytes[0] == 'B' && bytes[1] == 'M' )
+		return DecodeBMP(&bytes[0], bytes.size(), texture);
+
+	return false;
+}
+
+bool TextureDecoder::DecodeFiles(const std::vector<std::wstring>& filenames, std::vector<DecodedTexture>& textures,
+	UINT numJobs)
+{
+	UINT numFiles = (UINT)filenames.size();
+
+	textures.assign(numFiles, DecodedTexture());
+	if( numFiles == 0 )
+		return true;
+
+	std::vector<BYTE> decoded(numFiles, 0);
+
+	DecodeJob job;
+	job.Files    = &filenames;
+	job.Textures = &textures;
+	job.Decoded  = &decoded;
+
+	if( numJobs == 1 )
+		DecodeFilesJob(&job, 0, numFiles);
+	else
+	{
+		// Files differ a lot in size, so by default each is its own job.
+		UINT grainSize = numJobs > 0 ? (numFiles + numJobs - 1)/numJobs : 1;
+
+		JobCounter counter;
+		JobSystem::ParallelFor(DecodeFilesJob, &job, numFiles, grainSize, &counter);
+		JobSystem::Wait(counter);
+	}
+
+	for(UINT i = 0; i < numFiles; ++i)
+	{
+		if( !decoded[i] )
+			return false;
+	}
+
+	return true;
+}
+
+bool TextureDecoder::EncodeDDS(const DecodedTexture& texture, std::vector<BYTE>& bytes)
+{
+	if( texture.Subresources.empty() )
+		return false;
+
+	DDSFile::Description desc;
+	desc.Width             = texture.Width;
+	desc.Height            = texture.Height;
+	desc.Depth             = 1;
+	desc.MipLevels         = texture.MipLevels;
+	desc.ArraySize         = texture.ArraySize;
+	desc.Format            = texture.Format;
+	desc.ResourceDimension = DDSFile::Dimension2D;
+
+	DDSFile::WriteHeader(desc, bytes);
+	bytes.insert(bytes.end(), texture.Data.begin(), texture.Data.end());
+
+	return true;
+}
+
+bool TextureDecoder::DecodeDDS(const BYTE* data, size_t size, DecodedTexture& texture)
+{
+	size_t offset = 0;
+	if( !DecodeDDSHeader(data, size, texture, offset) )
+		return false;
+
+	UINT64 dataSize = texture.Subresources.back().Offset + texture.Subresources.back().SlicePitch;
+	if( dataSize > size - offset )
+		return false;
+
+	texture.Data.assign(data + offset, data + offset + (size_t)dataSize);
+
+	return true;
+}
+
+bool TextureDecoder::DecodeDDSHeader(const BYTE* data, size_t size, DecodedTexture& texture, size_t& dataOffset)
+{
+	DDSFile::Description desc;
+	if( !DDSFile::ParseHeader(data, size, desc, dataOffset) )
+		return false;
+
+	// DecodedTexture holds 2D textures and arrays only; see CreateSRV(const DDSFile&)
+	// for the rest.
+	if( desc.ResourceDimension != DDSFile::Dimension2D || desc.IsCubemap )
+		return false;
+
+	texture.Width     = desc.Width;
+	texture.Height    = desc.Height;
+	texture.MipLevels = desc.MipLevels;
+	texture.ArraySize = desc.ArraySize;
+	texture.Format    = (DXGI_FORMAT)desc.Format;
+
+	return BuildSubresources(texture) != 0;
+}
+
+bool TextureDecoder::DecodeBMP(const BYTE* data, size_t size, DecodedTexture& texture)
+{
+	if( size < sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) )
+		return false;
+
+	const BITMAPFILEHEADER* fileHeader = (const BITMAPFILEHEADER*)data;
+	const BITMAPINFOHEADER* info = (const BITMAPINFOHEADER*)(data + sizeof(BITMAPFILEHEADER));
+
+	if( fileHeader->bfType != 0x4D42 || info->biCompression != BI_RGB ||
+		(info->biBitCount != 24 && info->biBitCount != 32) || info->biWidth <= 0 || info->biHeight == 0 )
+		return false;
+
+	UINT width  = (UINT)info->biWidth;
+	UINT height = (UINT)abs(info->biHeight);
+
+	// Positive heights are stored bottom-up.
+	bool bottomUp = info->biHeight > 0;
+
+	UINT bytesPerPixel = info->biBitCount / 8;
+	UINT srcPitch = ((width*info->biBitCount + 31) / 32) * 4;
+
+	if( fileHeader->bfOffBits + (UINT64)srcPitch*height > size )
+		return false;
+
+	texture.Width     = width;
+	texture.Height    = height;
+	texture.MipLevels = 1;
+	texture.ArraySize = 1;
+	texture.Format    = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	UINT64 dataSize = BuildSubresources(texture);
+	texture.Data.resize((size_t)dataSize);
+
+	const BYTE* pixels = data + fileHeader->bfOffBits;
+	for(UINT i = 0; i < height; ++i)
+	{
+		const BYTE* src = pixels + (bottomUp ? height-1-i : i)*srcPitch;
+		BYTE* dst = &texture.Data[i*width*4];
+
+		// BGR(X) to RGBA.  The fourth byte of 32 bit BI_RGB bitmaps is unused.
+		for(UINT j = 0; j < width; ++j)
+		{
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+			dst[3] = 0xff;
+
+			src += bytesPerPixel;
+			dst += 4;
+		}
+	}
+
+	return true;
+}
+
+bool TextureDecoder::GetSurfaceInfo(UINT width, UINT height, DXGI_FORMAT format, UINT& rowPitch, UINT& numRows)
+{
+	return DDSFile::GetSurfaceInfo(width, height, format, rowPitch, numRows);
+}
+
+bool TextureDecoder::IsBlockCompressed(DXGI_FORMAT format)
+{
+	return DDSFile::GetBlockBytes(format) > 0;
+}
+
+bool TextureDecoder::GenerateMips(DecodedTexture& texture, const MipGenerator::Options& options)
+{
+	bool srgb  = texture.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	bool bytes = texture.Format == DXGI_FORMAT_R8G8B8A8_UNORM || srgb;
+	bool floats = texture.Format == DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+	if( (!bytes && !floats) || texture.MipLevels != 1 )
+		return false;
+
+	MipGenerator::Options mipOptions = options;
+	if( srgb )
+		mipOptions.SRGB = true;
+
+	DecodedTexture mipped;
+	mipped.Width     = texture.Width;
+	mipped.Height    = texture.Height;
+	mipped.MipLevels = MipGenerator::GetLevelCount(texture.Width, texture.Height);
+	mipped.ArraySize = texture.ArraySize;
+	mipped.Format    = texture.Format;
+
+	if( options.MaxLevels > 0 )
+		mipped.MipLevels = MathHelper::Min(mipped.MipLevels, options.MaxLevels);
+
+	mipped.Data.resize((size_t)BuildSubresources(mipped));
+
+	std::vector<std::vector<uint8_t> > byteLevels;
+	std::vector<std::vector<float> > floatLevels;
+
+	for(UINT slice = 0; slice < texture.ArraySize; ++slice)
+	{
+		const DecodedTexture::Subresource& top = texture.Subresources[slice];
+		const BYTE* src = &texture.Data[(size_t)top.Offset];
+
+		if( bytes )
+			MipGenerator::Generate(src, texture.Width, texture.Height, top.RowPitch, mipOptions, byteLevels);
+		else
+			MipGenerator::Generate((const float*)src, texture.Width, texture.Height, top.RowPitch, mipOptions, floatLevels);
+
+		// The levels come back tightly packed, as BuildSubresources() lays them out.
+		for(UINT mip = 0; mip < mipped.MipLevels; ++mip)
+		{
+			BYTE* dst = &mipped.Data[(size_t)mipped.Subresources[slice*mipped.MipLevels + mip].Offset];
+
+			if( bytes )
+				std::copy(byteLevels[mip].begin(), byteLevels[mip].end(), dst);
+			else
+				std::copy((const BYTE*)&floatLevels[mip][0], (const BYTE*)(&floatLevels[mip][0] + floatLevels[mip].size()), dst);
+		}
+	}
+
+	texture = mipped;
+
+	return true;
+}
+
+bool TextureDecoder::Compress(DecodedTexture& texture, BCEncoder::Format format, BCEncoder::Quality quality)
+{
+	bool srgb = texture.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	if( texture.Format != DXGI_FORMAT_R8G8B8A8_UNORM && !srgb )
+		return false;
+
+	DXGI_FORMAT compressedFormat = DXGI_FORMAT_UNKNOWN;
+	switch( format )
+	{
+	case BCEncoder::FormatBC1: compressedFormat = srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM; break;
+	case BCEncoder::FormatBC3: compressedFormat = srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM; break;
+	case BCEncoder::FormatBC5: compressedFormat = DXGI_FORMAT_BC5_UNORM; break;
+	}
+
+	BCEncoder::Options options;
+	options.BlockFormat = format;
+	options.Preset = quality;
+
+	DecodedTexture compressed;
+	compressed.Width     = texture.Width;
+	compressed.Height    = texture.Height;
+	compressed.MipLevels = texture.MipLevels;
+	compressed.ArraySize = texture.ArraySize;
+	compressed.Format    = compressedFormat;
+	compressed.Data.resize((size_t)BuildSubresources(compressed));
+
+	std::vector<uint8_t> blocks;
+	for(size_t i = 0; i < texture.Subresources.size(); ++i)
+	{
+		UINT mip = (UINT)(i % texture.MipLevels);
+		UINT w = MathHelper::Max(texture.Width  >> mip, 1u);
+		UINT h = MathHelper::Max(texture.Height >> mip, 1u);
+
+		const DecodedTexture::Subresource& src = texture.Subresources[i];
+		BCEncoder::Encode(&texture.Data[(size_t)src.Offset], w, h, src.RowPitch, options, blocks);
+
+		std::copy(blocks.begin(), blocks.end(), compressed.Data.begin() + (size_t)compressed.Subresources[i].Offset);
+	}
+
+	texture = compressed;
+
+	return true;
+}
+
+UINT64 TextureDecoder::BuildSubresources(DecodedTexture& texture)
+{
+	texture.Subresources.clear();
+
+	UINT64 offset = 0;
+	for(UINT slice = 0; slice < texture.ArraySize; ++slice)
+	{
+		UINT w = texture.Width;
+		UINT h = texture.Height;
+
+		for(UINT mip = 0; mip < texture.MipLevels; ++mip)
+		{
+			UINT rowPitch, numRows;
+			if( !GetSurfaceInfo(w, h, texture.Format, rowPitch, numRows) )
+			{
+				texture.Subresources.clear();
+				return 0;
+			}
+
+			DecodedTexture::Subresource sub;
+			sub.Offset     = offset;
+			sub.RowPitch   = rowPitch;
+			sub.SlicePitch = rowPitch*numRows;
+			texture.Subresources.push_back(sub);
+
+			offset += sub.SlicePitch;
+
+			w = MathHelper::Max(1u, w/2);
+			h = MathHelper::Max(1u, h/2);
+		}
+	}
+
+	return offset;
+}
+
+void TextureDecoder::GetInitData(const DecodedTexture& texture, std::vector<D3D11_SUBRESOURCE_DATA>& initData,
+	const BYTE* data)
+{
+	if( data == 0 )
+		data = &texture.Data[0];
+
+	initData.resize(texture.Subresources.size());
+
+	for(size_t i = 0; i < texture.Subresources.size(); ++i)
+	{
+		initData[i].pSysMem          = data + (size_t)texture.Subresources[i].Offset;
+		initData[i].SysMemPitch      = texture.Subresources[i].RowPitch;
+		initData[i].SysMemSlicePitch = texture.Subresources[i].SlicePitch;
+	}
+}
+
+ID3D11ShaderResourceView* TextureDecoder::CreateSRV(ID3D11Device* device, const DecodedTexture& texture,
+	const BYTE* data)
+{
+	D3D11_TEXTURE2D_DESC texDesc;
+	texDesc.Width              = texture.Width;
+	texDesc.Height             = texture.Height;
+	texDesc.MipLevels          = texture.MipLevels;
+	texDesc.ArraySize          = texture.ArraySize;
+	texDesc.Format             = texture.Format;
+	texDesc.SampleDesc.Count   = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage              = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE;
+	texDesc.CPUAccessFlags     = 0;
+	texDesc.MiscFlags          = 0;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> initData;
+	GetInitData(texture, initData, data);
+
+	ID3D11Texture2D* tex = 0;
+	if( FAILED(device->CreateTexture2D(&texDesc, &initData[0], &tex)) )
+		return 0;
+
+	// A null description views every mip and slice of the texture.
+	ID3D11ShaderResourceView* srv = 0;
+	HRESULT hr = device->CreateShaderResourceView(tex, 0, &srv);
+
+	// The view holds its own reference to the texture.
+	ReleaseCOM(tex);
+
+	return SUCCEEDED(hr) ? srv : 0;
+}
+
+ID3D11ShaderResourceView* TextureDecoder::CreateSRV(ID3D11Device* device, const DDSFile& file)
+{
+	if( !file.IsOpen() )
+		return 0;
+
+	const DDSFile::Description& desc = file.GetDesc();
+	DXGI_FORMAT format = (DXGI_FORMAT)desc.Format;
+	UINT items = file.GetItemCount();
+
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(file.GetSubresourceCount());
+	for(UINT i = 0; i < file.GetSubresourceCount(); ++i)
+	{
+		const DDSFile::Subresource& sub = file.GetSubresource(i);
+		initData[i].pSysMem          = sub.Data;
+		initData[i].SysMemPitch      = sub.RowPitch;
+		initData[i].SysMemSlicePitch = sub.SlicePitch;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+	ZeroMemory(&viewDesc, sizeof(viewDesc));
+	viewDesc.Format = format;
+
+	ID3D11Resource* resource = 0;
+	HRESULT hr = E_FAIL;
+
+	switch( desc.ResourceDimension )
+	{
+	case DDSFile::Dimension1D:
+		{
+			D3D11_TEXTURE1D_DESC texDesc;
+			texDesc.Width          = desc.Width;
+			texDesc.MipLevels      = desc.MipLevels;
+			texDesc.ArraySize      = items;
+			texDesc.Format         = format;
+			texDesc.Usage          = D3D11_USAGE_IMMUTABLE;
+			texDesc.BindFlags      = D3D11_BIND_SHADER_RESOURCE;
+			texDesc.CPUAccessFlags = 0;
+			texDesc.MiscFlags      = 0;
+
+			hr = device->CreateTexture1D(&texDesc, &initData[0], (ID3D11Texture1D**)&resource);
+
+			if( items > 1 )
+			{
+				viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE1DARRAY;
+				viewDesc.Texture1DArray.MipLevels = desc.MipLevels;
+				viewDesc.Texture1DArray.ArraySize = items;
+			}
+			else
+			{
+				viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE1D;
+				viewDesc.Texture1D.MipLevels = desc.MipLevels;
+			}
+		}
+		break;
+
+	case DDSFile::Dimension2D:
+		{
+			D3D11_TEXTURE2D_DESC texDesc;
+			texDesc.Width              = desc.Width;
+			texDesc.Height             = desc.Height;
+			texDesc.MipLevels          = desc.MipLevels;
+			texDesc.ArraySize          = items;
+			texDesc.Format             = format;
+			texDesc.SampleDesc.Count   = 1;
+			texDesc.SampleDesc.Quality = 0;
+			texDesc.Usage              = D3D11_USAGE_IMMUTABLE;
+			texDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE;
+			texDesc.CPUAccessFlags     = 0;
+			texDesc.MiscFlags          = desc.IsCubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+			hr = device->CreateTexture2D(&texDesc, &initData[0], (ID3D11Texture2D**)&resource);
+
+			if( desc.IsCubemap && desc.ArraySize > 1 )
+			{
+				viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+				viewDesc.TextureCubeArray.MipLevels = desc.MipLevels;
+				viewDesc.TextureCubeArray.NumCubes  = desc.ArraySize;
+			}
+			else if( desc.IsCubemap )
+			{
+				viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+				viewDesc.TextureCube.MipLevels = desc.MipLevels;
+			}
+			else if( items > 1 )
+			{
+				viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+				viewDesc.Texture2DArray.MipLevels = desc.MipLevels;
+				viewDesc.Texture2DArray.ArraySize = items;
+			}
+			else
+			{
+				viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+				viewDesc.Texture2D.MipLevels = desc.MipLevels;
+			}
+		}
+		break;
+
+	case DDSFile::Dimension3D:
+		{
+			D3D11_TEXTURE3D_DESC texDesc;
+			texDesc.Width          = desc.Width;
+			texDesc.Height         = desc.Height;
+			texDesc.Depth          = desc.Depth;
+			texDesc.MipLevels      = desc.MipLevels;
+			texDesc.Format         = format;
+			texDesc.Usage          = D3D11_USAGE_IMMUTABLE;
+			texDesc.BindFlags      = D3D11_BIND_SHADER_RESOURCE;
+			texDesc.CPUAccessFlags = 0;
+			texDesc.MiscFlags      = 0;
+
+			hr = device->CreateTexture3D(&texDesc, &initData[0], (ID3D11Texture3D**)&resource);
+
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
+			viewDesc.Texture3D.MipLevels = desc.MipLevels;
+		}
+		break;
+	}
+
+	if( FAILED(hr) )
+		return 0;
+
+	ID3D11ShaderResourceView* srv = 0;
+	hr = device->CreateShaderResourceView(resource, &viewDesc, &srv);
+
+	// The view holds its own reference to the resource.
+	ReleaseCOM(resource);
+
+	return SUCCEEDED(hr) ? srv : 0;
+}
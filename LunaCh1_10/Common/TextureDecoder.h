@@ -0,0 +1,134 @@
+//***************************************************************************************
+// TextureDecoder.h
+//
+// Decodes DDS and BMP files into system memory texture data ready to be passed to
+// ID3D11Device::CreateTexture2D.  Nothing here needs a device, so decoding can run on
+// worker threads (see TextureMgr) or in tools.
+//
+// Supported:
+//   -DDS: 2D textures and texture arrays with mipmaps, legacy or DX10 header, BC1-BC7
+//    and the uncompressed formats with a fixed texel size (parsed by DDSFile).
+//    Volume textures and cube maps can't be decoded, but CreateSRV() creates them
+//    straight from a mapped DDSFile.
+//   -BMP: uncompressed 24 and 32 bit, decoded to DXGI_FORMAT_R8G8B8A8_UNORM.
+//***************************************************************************************
+
+#ifndef TEXTUREDECODER_H
+#define TEXTUREDECODER_H
+
+#include "d3dUtil.h"
+#include "BCEncoder.h"
+#include "DDSFile.h"
+#include "MipGenerator.h"
+
+///<summary>
+/// System memory texture.  Subresources are stored array slice major, then by mip
+/// level, matching D3D11CalcSubresource().
+///</summary>
+struct DecodedTexture
+{
+	struct Subresource
+	{
+		UINT64 Offset;
+		UINT RowPitch;
+		UINT SlicePitch;
+	};
+
+	DecodedTexture();
+
+	UINT Width;
+	UINT Height;
+	UINT MipLevels;
+	UINT ArraySize;
+	DXGI_FORMAT Format;
+
+	std::vector<BYTE> Data;
+	std::vector<Subresource> Subresources;
+};
+
+class TextureDecoder
+{
+public:
+	///<summary>
+	/// Reads the file and decodes it by its magic number.  Returns false if the file
+	/// can't be read or the format is not supported.
+	///</summary>
+	static bool DecodeFile(const std::wstring& filename, DecodedTexture& texture);
+
+	///<summary>
+	/// Decodes a batch of files as numJobs JobSystem jobs (0 makes each file a
+	/// job, 1 decodes on the calling thread).  Returns false if any of them fails.
+	///</summary>
+	static bool DecodeFiles(const std::vector<std::wstring>& filenames, std::vector<DecodedTexture>& textures,
+		UINT numJobs = 0);
+
+	static bool DecodeDDS(const BYTE* data, size_t size, DecodedTexture& texture);
+	static bool DecodeBMP(const BYTE* data, size_t size, DecodedTexture& texture);
+
+	///<summary>
+	/// Reads only the description and subresource layout of a DDS file, leaving
+	/// Data empty.  dataOffset receives the file offset that Subresource::Offset is
+	/// relative to, so single mips can be read from the file later.
+	///</summary>
+	static bool DecodeDDSHeader(const BYTE* data, size_t size, DecodedTexture& texture, size_t& dataOffset);
+
+	static bool ReadFileBytes(const std::wstring& filename, std::vector<BYTE>& bytes);
+
+	///<summary>
+	/// Writes the texture as a DDS file image with a DX10 header, which DecodeDDS()
+	/// reads back.
+	///</summary>
+	static bool EncodeDDS(const DecodedTexture& texture, std::vector<BYTE>& bytes);
+
+	///<summary>
+	/// Row pitch and number of rows (block rows for compressed formats) of a surface.
+	/// Returns false for formats the decoder does not know.
+	///</summary>
+	static bool GetSurfaceInfo(UINT width, UINT height, DXGI_FORMAT format, UINT& rowPitch, UINT& numRows);
+
+	static bool IsBlockCompressed(DXGI_FORMAT format);
+
+	///<summary>
+	/// Replaces the single mip of an R8G8B8A8 or R32G32B32A32_FLOAT texture with a
+	/// chain built by MipGenerator.  _SRGB formats are filtered in linear space
+	/// whatever options.SRGB says.  Returns false for other textures.
+	///</summary>
+	static bool GenerateMips(DecodedTexture& texture, const MipGenerator::Options& options = MipGenerator::Options());
+
+	///<summary>
+	/// Block compresses every subresource of an R8G8B8A8 texture in place.  Returns
+	/// false, leaving the texture alone, for any other format.
+	///</summary>
+	static bool Compress(DecodedTexture& texture, BCEncoder::Format format,
+		BCEncoder::Quality quality = BCEncoder::QualityNormal);
+
+	///<summary>
+	/// Fills the initial data array for CreateTexture2D.  The pointers refer into
+	/// texture.Data, so the texture must outlive the call that consumes them.  If
+	/// data is given, the subresource offsets are taken relative to it instead, so
+	/// a header-only texture can point straight into a mapped file.
+	///</summary>
+	static void GetInitData(const DecodedTexture& texture, std::vector<D3D11_SUBRESOURCE_DATA>& initData,
+		const BYTE* data = 0);
+
+	///<summary>
+	/// Creates an immutable texture and a view of all its mips and slices.  data
+	/// works as for GetInitData().
+	///</summary>
+	static ID3D11ShaderResourceView* CreateSRV(ID3D11Device* device, const DecodedTexture& texture,
+		const BYTE* data = 0);
+
+	///<summary>
+	/// Creates an immutable texture of any kind the file holds (1D, 2D, cube map or
+	/// volume, arrays included) and a view of all of it.  The initial data points
+	/// into the file's mapping, so nothing is copied on the CPU.
+	///</summary>
+	static ID3D11ShaderResourceView* CreateSRV(ID3D11Device* device, const DDSFile& file);
+
+private:
+	// Lays the subresources out tightly, slice major, and returns the total size.
+	// Returns 0 for unknown formats.
+	static UINT64 BuildSubresources(DecodedTexture& texture);
+};
+
+#endif // TEXTUREDECODER_H
@@ -1,22 +1,60 @@
 #include "TextureMgr.h"
 
-TextureMgr::TextureMgr() : md3dDevice(0)
+TextureMgr::TextureMgr()
+	: md3dDevice(0),
+	  mCreatedBytes(0),
+	  mPlaceholderSRV(0),
+	  mMemoryBudget(0),
+	  mFrame(0),
+	  mSecondsPerCount(0.0),
+	  mQuit(false)
 {
+	ZeroMemory(&mStats, sizeof(mStats));
+
+	__int64 countsPerSec;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+	mSecondsPerCount = 1.0 / (double)countsPerSec;
 }
 
 TextureMgr::~TextureMgr()
 {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeWorkers.notify_all();
+
+	for(size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+
+	for(size_t i = 0; i < mCompleted.size(); ++i)
+		delete mCompleted[i];
+
+	MemoryTracker::Free(MemoryTracker::Textures, (size_t)(mStats.ResidentBytes + mCreatedBytes));
+
 	for(auto it = mTextureSRV.begin(); it != mTextureSRV.end(); ++it)
     {
 		ReleaseCOM(it->second);
     }
 
 	mTextureSRV.clear();
+
+	for(size_t i = 0; i < mEntries.size(); ++i)
+		ReleaseCOM(mEntries[i].SRV);
+
+	ReleaseCOM(mPlaceholderSRV);
 }
 
-void TextureMgr::Init(ID3D11Device* device)
+void TextureMgr::Init(ID3D11Device* device, UINT64 memoryBudget, UINT numThreads)
 {
 	md3dDevice = device;
+	mMemoryBudget = memoryBudget;
+
+	if( md3dDevice )
+		CreatePlaceholder();
+
+	for(UINT i = 0; i < numThreads; ++i)
+		mWorkers.push_back(std::thread(&TextureMgr::WorkerMain, this));
 }
 
 ID3D11ShaderResourceView* TextureMgr::CreateTexture(std::wstring filename)
@@ -30,11 +68,298 @@ ID3D11ShaderResourceView* TextureMgr::CreateTexture(std::wstring filename)
 	}
 	else
 	{
-		HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice, filename.c_str(), 0, 0, &srv, 0 ));
+		// DDS files are created straight from the mapped file; D3DX loads the rest.
+		DDSFile file;
+		if( file.Open(filename) )
+			srv = TextureDecoder::CreateSRV(md3dDevice, file);
+
+		if( srv != 0 )
+		{
+			mCreatedBytes += file.GetDataSize();
+			MemoryTracker::Allocate(MemoryTracker::Textures, (size_t)file.GetDataSize());
+		}
+
+		if( srv == 0 )
+			HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice, filename.c_str(), 0, 0, &srv, 0 ));
 
 		mTextureSRV[filename] = srv;
 	}
 
 	return srv;
 }
- 
+
+TextureMgr::Handle TextureMgr::RequestTexture(const std::wstring& filename)
+{
+	++mStats.Requests;
+
+	auto it = mHandles.find(filename);
+	if( it != mHandles.end() )
+	{
+		if( mEntries[it->second].LoadState == StateUnloaded )
+			QueueLoad(it->second);
+
+		return it->second;
+	}
+
+	Entry entry;
+	entry.Filename      = filename;
+	entry.LoadState     = StateUnloaded;
+	entry.SRV           = 0;
+	entry.Bytes         = 0;
+	entry.LastUsedFrame = mFrame;
+	entry.QueuedTime    = 0;
+
+	Handle handle = (Handle)mEntries.size();
+	mEntries.push_back(entry);
+	mHandles[filename] = handle;
+
+	QueueLoad(handle);
+
+	return handle;
+}
+
+ID3D11ShaderResourceView* TextureMgr::GetSRV(Handle handle)
+{
+	assert(handle < mEntries.size());
+
+	Entry& entry = mEntries[handle];
+	entry.LastUsedFrame = mFrame;
+
+	if( entry.LoadState == StateReady )
+	{
+		++mStats.Hits;
+		return entry.SRV;
+	}
+
+	++mStats.Misses;
+
+	if( entry.LoadState == StateUnloaded )
+		QueueLoad(handle);
+
+	return mPlaceholderSRV;
+}
+
+bool TextureMgr::IsReady(Handle handle)const
+{
+	return handle < mEntries.size() && mEntries[handle].LoadState == StateReady;
+}
+
+void TextureMgr::Update()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		// Without workers the queue is loaded here, in request order.
+		if( mWorkers.empty() )
+		{
+			while( !mQueue.empty() )
+			{
+				mCompleted.push_back(LoadFile(mQueue.front().first, mQueue.front().second));
+				mQueue.pop_front();
+			}
+		}
+
+		// Swapped rather than copied, so both vectors keep their capacity.
+		mFinished.swap(mCompleted);
+	}
+
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+
+	for(size_t i = 0; i < mFinished.size(); ++i)
+	{
+		LoadResult* result = mFinished[i];
+		Entry& entry = mEntries[result->Id];
+
+		if( result->Succeeded && result->File.IsOpen() )
+		{
+			entry.Bytes = result->File.GetDataSize();
+
+			if( md3dDevice )
+				entry.SRV = TextureDecoder::CreateSRV(md3dDevice, result->File);
+		}
+		else if( result->Succeeded )
+		{
+			entry.Bytes = result->Texture.Data.size();
+
+			if( md3dDevice )
+				entry.SRV = TextureDecoder::CreateSRV(md3dDevice, result->Texture);
+		}
+		else if( md3dDevice )
+		{
+			// Formats the decoder does not handle (jpg, png, ...) go through D3DX
+			// on this thread.
+			if( SUCCEEDED(D3DX11CreateShaderResourceViewFromFile(md3dDevice, entry.Filename.c_str(), 0, 0, &entry.SRV, 0)) )
+			{
+				ID3D11Texture2D* tex = 0;
+				entry.SRV->GetResource((ID3D11Resource**)&tex);
+
+				D3D11_TEXTURE2D_DESC desc;
+				tex->GetDesc(&desc);
+				ReleaseCOM(tex);
+
+				// Estimate as 32 bits per texel plus a full mip chain.
+				entry.Bytes = (UINT64)desc.Width*desc.Height*desc.ArraySize*4*4/3;
+			}
+		}
+
+		if( result->Succeeded || entry.SRV )
+		{
+			entry.LoadState = StateReady;
+			mStats.ResidentBytes += entry.Bytes;
+			MemoryTracker::Allocate(MemoryTracker::Textures, (size_t)entry.Bytes);
+			++mStats.LoadsCompleted;
+
+			double loadTime = (now - entry.QueuedTime)*mSecondsPerCount;
+			mStats.TotalLoadTime += loadTime;
+			mStats.MaxLoadTime = MathHelper::Max(mStats.MaxLoadTime, loadTime);
+		}
+		else
+		{
+			// Keep failed textures on the placeholder instead of retrying every frame.
+			entry.LoadState = StateFailed;
+			++mStats.LoadsFailed;
+		}
+
+		delete result;
+	}
+	mFinished.clear();
+
+	Evict();
+
+	++mFrame;
+}
+
+const TextureMgr::Stats& TextureMgr::GetStats()const
+{
+	return mStats;
+}
+
+float TextureMgr::GetHitRate()const
+{
+	UINT lookups = mStats.Hits + mStats.Misses;
+	return lookups > 0 ? (float)mStats.Hits / lookups : 1.0f;
+}
+
+void TextureMgr::QueueLoad(Handle handle)
+{
+	Entry& entry = mEntries[handle];
+	entry.LoadState = StateQueued;
+	QueryPerformanceCounter((LARGE_INTEGER*)&entry.QueuedTime);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.push_back(std::make_pair(handle, entry.Filename));
+	}
+	mWakeWorkers.notify_one();
+}
+
+void TextureMgr::Evict()
+{
+	if( mStats.ResidentBytes <= mMemoryBudget )
+		return;
+
+	// Only grows when textures were added since the last eviction.
+	mEvictCandidates.clear();
+	mEvictCandidates.reserve(mEntries.size());
+
+	for(Handle i = 0; i < (Handle)mEntries.size(); ++i)
+	{
+		if( mEntries[i].LoadState == StateReady && mEntries[i].LastUsedFrame != mFrame )
+			mEvictCandidates.push_back(std::make_pair(mEntries[i].LastUsedFrame, i));
+	}
+
+	// Least recently used first.
+	std::sort(mEvictCandidates.begin(), mEvictCandidates.end());
+
+	for(size_t i = 0; i < mEvictCandidates.size() && mStats.ResidentBytes > mMemoryBudget; ++i)
+	{
+		Entry& entry = mEntries[mEvictCandidates[i].second];
+
+		ReleaseCOM(entry.SRV);
+		entry.LoadState = StateUnloaded;
+
+		mStats.ResidentBytes -= entry.Bytes;
+		MemoryTracker::Free(MemoryTracker::Textures, (size_t)entry.Bytes);
+		entry.Bytes = 0;
+
+		++mStats.Evictions;
+	}
+}
+
+void TextureMgr::WorkerMain()
+{
+	while(true)
+	{
+		std::pair<Handle, std::wstring> request;
+
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			while( !mQuit && mQueue.empty() )
+				mWakeWorkers.wait(lock);
+
+			if( mQuit )
+				return;
+
+			request = mQueue.front();
+			mQueue.pop_front();
+		}
+
+		LoadResult* result = LoadFile(request.first, request.second);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mCompleted.push_back(result);
+		}
+	}
+}
+
+TextureMgr::LoadResult* TextureMgr::LoadFile(Handle handle, const std::wstring& filename)
+{
+	LoadResult* result = new LoadResult();
+	result->Id = handle;
+
+	// DDS files are mapped and used in place.  Touching the pages here keeps the
+	// disk reads off the thread that creates the texture.
+	if( result->File.Open(filename) )
+	{
+		result->File.Prefetch();
+		result->Succeeded = true;
+	}
+	else
+	{
+		result->Succeeded = TextureDecoder::DecodeFile(filename, result->Texture);
+	}
+
+	return result;
+}
+
+void TextureMgr::CreatePlaceholder()
+{
+	// 1x1 mid gray, so untextured surfaces are still lit sensibly.
+	UINT texel = 0xff808080;
+
+	D3D11_SUBRESOURCE_DATA initData;
+	initData.pSysMem          = &texel;
+	initData.SysMemPitch      = sizeof(UINT);
+	initData.SysMemSlicePitch = 0;
+
+	D3D11_TEXTURE2D_DESC texDesc;
+	texDesc.Width              = 1;
+	texDesc.Height             = 1;
+	texDesc.MipLevels          = 1;
+	texDesc.ArraySize          = 1;
+	texDesc.Format             = DXGI_FORMAT_R8G8B8A8_UNORM;
+	texDesc.SampleDesc.Count   = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage              = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE;
+	texDesc.CPUAccessFlags     = 0;
+	texDesc.MiscFlags          = 0;
+
+	ID3D11Texture2D* tex = 0;
+	HR(md3dDevice->CreateTexture2D(&texDesc, &initData, &tex));
+	HR(md3dDevice->CreateShaderResourceView(tex, 0, &mPlaceholderSRV));
+
+	ReleaseCOM(tex);
+}
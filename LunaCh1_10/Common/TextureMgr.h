@@ -2,29 +2,151 @@
 #define TEXTUREMGR_H
 
 #include "d3dUtil.h"
+#include "TextureDecoder.h"
+#include "MemoryTracker.h"
 #include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 ///<summary>
 /// Simple texture manager to avoid loading duplicate textures from file.  That can
-/// happen, for example, if multiple meshes reference the same texture filename. 
+/// happen, for example, if multiple meshes reference the same texture filename.
+///
+/// Textures can also be loaded asynchronously: RequestTexture() returns a handle at
+/// once and a worker thread maps the file (DDS, see DDSFile) or decodes it (BMP,
+/// see TextureDecoder).  DDS textures are created straight from the mapping without
+/// a copy.  Until the texture is ready, GetSRV() returns a 1x1 placeholder.
+/// Update() creates the views of finished textures and, once the resident size is
+/// over budget, releases the least recently used ones; they are loaded again the
+/// next time they are used.
+///
+/// Initialized with a null device, the manager decodes and tracks residency the same
+/// way but creates no views, so the loading and caching logic can run headless.
+/// With no worker threads, queued files are loaded by Update() on the calling
+/// thread, which makes the order of loads deterministic.
 ///</summary>
 class TextureMgr
 {
+public:
+	typedef UINT Handle;
+	static const Handle InvalidHandle = 0xffffffff;
+
+	struct Stats
+	{
+		UINT Requests;
+		UINT Hits;
+		UINT Misses;
+		UINT LoadsCompleted;
+		UINT LoadsFailed;
+		UINT Evictions;
+
+		// Seconds from a load being queued to the texture being ready.
+		double TotalLoadTime;
+		double MaxLoadTime;
+
+		UINT64 ResidentBytes;
+	};
+
 public:
 	TextureMgr();
 	~TextureMgr();
 
-	void Init(ID3D11Device* device);
+	// 0 threads loads on the thread that calls Update().
+	void Init(ID3D11Device* device, UINT64 memoryBudget = 256*1024*1024, UINT numThreads = 2);
 
+	// Loads synchronously.  These textures are never evicted.
 	ID3D11ShaderResourceView* CreateTexture(std::wstring filename);
 
+	// Queues the texture for loading if it is not resident or already queued.
+	Handle RequestTexture(const std::wstring& filename);
+
+	// Returns the texture, or the placeholder while it is loading.  Marks the
+	// texture as used this frame and reloads it if it was evicted.
+	ID3D11ShaderResourceView* GetSRV(Handle handle);
+
+	bool IsReady(Handle handle)const;
+
+	// Finishes completed loads and evicts down to the budget.  Call once per
+	// frame after drawing; textures used this frame are never evicted.
+	void Update();
+
+	const Stats& GetStats()const;
+
+	// Fraction of GetSRV() calls that found the texture ready.
+	float GetHitRate()const;
+
+private:
+	enum State
+	{
+		StateUnloaded,
+		StateQueued,
+		StateReady,
+		StateFailed
+	};
+
+	struct Entry
+	{
+		std::wstring Filename;
+		State LoadState;
+		ID3D11ShaderResourceView* SRV;
+		UINT64 Bytes;
+		UINT LastUsedFrame;
+		__int64 QueuedTime;
+	};
+
+	struct LoadResult
+	{
+		Handle Id;
+		bool Succeeded;
+
+		// The mapped file for DDS, otherwise the decoded texture.
+		DDSFile File;
+		DecodedTexture Texture;
+	};
+
+	void QueueLoad(Handle handle);
+	void Evict();
+	void WorkerMain();
+	static LoadResult* LoadFile(Handle handle, const std::wstring& filename);
+	void CreatePlaceholder();
+
 private:
 	TextureMgr(const TextureMgr& rhs);
 	TextureMgr& operator=(const TextureMgr& rhs);
-	
+
 private:
 	ID3D11Device* md3dDevice;
 	std::map<std::wstring, ID3D11ShaderResourceView*> mTextureSRV;
+
+	// Of the DDS files CreateTexture() loaded.
+	UINT64 mCreatedBytes;
+
+	ID3D11ShaderResourceView* mPlaceholderSRV;
+
+	// Asynchronously loaded textures; a handle indexes mEntries.  Only touched
+	// by the calling thread.
+	std::vector<Entry> mEntries;
+	std::map<std::wstring, Handle> mHandles;
+
+	// Reused every Update() so a frame does not allocate.
+	std::vector<LoadResult*> mFinished;
+	std::vector<std::pair<UINT, Handle>> mEvictCandidates;
+
+	UINT64 mMemoryBudget;
+	UINT mFrame;
+	double mSecondsPerCount;
+	Stats mStats;
+
+	// Shared with the workers, guarded by mMutex.
+	std::deque<std::pair<Handle, std::wstring>> mQueue;
+	std::vector<LoadResult*> mCompleted;
+	bool mQuit;
+
+	std::mutex mMutex;
+	std::condition_variable mWakeWorkers;
+	std::vector<std::thread> mWorkers;
 };
 
-#endif // TEXTUREMGR_H
\ No newline at end of file
+#endif // TEXTUREMGR_H
@@ -0,0 +1,429 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+#include "MemoryTracker.h"
+
+TextureStreamer::TextureStreamer()
+	: md3dDevice(0),
+	  md3dImmediateContext(0),
+	  mMemoryBudget(0),
+	  mResidentBytes(0),
+	  mMinResidentSize(64),
+	  mEyePosW(0.0f, 0.0f, 0.0f),
+	  mNearZ(1.0f),
+	  mPixelSizeAtUnitDistance(1.0f),
+	  mPendingCount(0),
+	  mQuit(false)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	if( mWorker.joinable() )
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mWakeWorker.notify_all();
+		mWorker.join();
+	}
+
+	for(size_t i = 0; i < mCompleted.size(); ++i)
+		delete mCompleted[i];
+
+	MemoryTracker::Free(MemoryTracker::Textures, (size_t)mResidentBytes);
+
+	for(size_t i = 0; i < mTextures.size(); ++i)
+	{
+		ReleaseCOM(mTextures[i]->SRV);
+		ReleaseCOM(mTextures[i]->Tex);
+		delete mTextures[i];
+	}
+}
+
+void TextureStreamer::Init(ID3D11Device* device, ID3D11DeviceContext* dc, UINT64 memoryBudget, UINT minResidentSize)
+{
+	md3dDevice = device;
+	md3dImmediateContext = dc;
+	mMemoryBudget = memoryBudget;
+	mMinResidentSize = minResidentSize;
+
+	mWorker = std::thread(&TextureStreamer::WorkerMain, this);
+}
+
+TextureStreamer::Handle TextureStreamer::Register(const std::wstring& filename)
+{
+	Texture* tex = new Texture();
+	tex->Filename   = filename;
+	tex->DataOffset = 0;
+	tex->Streamed   = false;
+	tex->Tex        = 0;
+	tex->SRV        = 0;
+	tex->ResidentMip = 0;
+	tex->TailMip    = 0;
+	tex->WantedMip  = 0;
+	tex->Loading    = false;
+
+	Handle handle = (Handle)mTextures.size();
+	mTextures.push_back(tex);
+
+	//
+	// Read the DDS header; it is at most 148 bytes.
+	//
+
+	BYTE header[148];
+	std::ifstream fin(filename.c_str(), std::ios::binary);
+	fin.read((char*)header, sizeof(header));
+
+	if( fin.gcount() > 0 &&
+		TextureDecoder::DecodeDDSHeader(header, (size_t)fin.gcount(), tex->Layout, tex->DataOffset) )
+	{
+		const DecodedTexture& layout = tex->Layout;
+		bool blockCompressed = TextureDecoder::IsBlockCompressed(layout.Format);
+
+		// The tail starts at the first mip no larger than MinResidentSize.
+		// Block compressed textures must keep a level 0 that is a multiple of 4.
+		UINT tail = 0;
+		while( tail + 1 < layout.MipLevels &&
+			MathHelper::Max(layout.Width >> tail, layout.Height >> tail) > mMinResidentSize )
+		{
+			UINT w = layout.Width  >> (tail+1);
+			UINT h = layout.Height >> (tail+1);
+			if( blockCompressed && ((w & 3) != 0 || (h & 3) != 0) )
+				break;
+
+			++tail;
+		}
+
+		std::vector<BYTE> data;
+		if( ReadMips(*tex, tail, layout.MipLevels, data) )
+		{
+			tex->Streamed = true;
+			tex->TailMip = tail;
+			tex->WantedMip = tail;
+			tex->ResidentMip = layout.MipLevels;
+
+			Resize(*tex, tail, &data[0]);
+			return handle;
+		}
+	}
+
+	// Not streamable; load every mip up front.
+	HR(D3DX11CreateShaderResourceViewFromFile(md3dDevice, filename.c_str(), 0, 0, &tex->SRV, 0));
+
+	return handle;
+}
+
+ID3D11ShaderResourceView* TextureStreamer::GetSRV(Handle handle)const
+{
+	return mTextures[handle]->SRV;
+}
+
+UINT TextureStreamer::GetResidentMip(Handle handle)const
+{
+	return mTextures[handle]->ResidentMip;
+}
+
+void TextureStreamer::BeginFrame(const Camera& cam, UINT screenHeight)
+{
+	mEyePosW = cam.GetPosition();
+	mNearZ = cam.GetNearZ();
+
+	// World space height of a pixel at distance 1 from the eye.
+	mPixelSizeAtUnitDistance = 2.0f*tanf(0.5f*cam.GetFovY()) / (float)MathHelper::Max(screenHeight, 1u);
+
+	// Until something asks for them, textures only need their tail.
+	for(size_t i = 0; i < mTextures.size(); ++i)
+		mTextures[i]->WantedMip = mTextures[i]->TailMip;
+}
+
+void TextureStreamer::RequestCoverage(Handle handle, const XMFLOAT3& center, float radius, float uvRepeat)
+{
+	Texture& tex = *mTextures[handle];
+	if( !tex.Streamed )
+		return;
+
+	// Closest point of the bounds; inside the bounds, the near plane.
+	XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&mEyePosW));
+	float dist = XMVectorGetX(XMVector3Length(toCenter)) - radius;
+	dist = MathHelper::Max(dist, mNearZ);
+
+	// Mip 0 maps one texel to this much world space.
+	float texelSize = 2.0f*radius / (uvRepeat*tex.Layout.Width);
+	float pixelSize = dist*mPixelSizeAtUnitDistance;
+
+	// Each mip doubles the texel size; use the finest whose texels are not
+	// smaller than a pixel.
+	UINT mip = 0;
+	if( pixelSize > texelSize )
+		mip = (UINT)floorf(logf(pixelSize / texelSize) / logf(2.0f));
+
+	tex.WantedMip = MathHelper::Min(tex.WantedMip, MathHelper::Min(mip, tex.TailMip));
+}
+
+void TextureStreamer::EndFrame()
+{
+	//
+	// Fit the wanted mips into the budget: while over, drop the finest mip of the
+	// texture that costs the most.
+	//
+
+	UINT64 total = 0;
+	for(size_t i = 0; i < mTextures.size(); ++i)
+	{
+		if( mTextures[i]->Streamed )
+			total += GetBytes(*mTextures[i], mTextures[i]->WantedMip);
+	}
+
+	while( total > mMemoryBudget )
+	{
+		Texture* largest = 0;
+		UINT64 largestBytes = 0;
+
+		for(size_t i = 0; i < mTextures.size(); ++i)
+		{
+			Texture* tex = mTextures[i];
+			if( !tex->Streamed || tex->WantedMip >= tex->TailMip )
+				continue;
+
+			UINT64 bytes = GetBytes(*tex, tex->WantedMip);
+			if( bytes > largestBytes )
+			{
+				largest = tex;
+				largestBytes = bytes;
+			}
+		}
+
+		// Only tails left; they always stay.
+		if( largest == 0 )
+			break;
+
+		++largest->WantedMip;
+		total -= largestBytes - GetBytes(*largest, largest->WantedMip);
+	}
+
+	//
+	// Apply finished loads.
+	//
+
+	std::vector<LoadResult*> completed;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		completed.swap(mCompleted);
+	}
+
+	for(size_t i = 0; i < completed.size(); ++i)
+	{
+		ApplyLoad(*completed[i]);
+		delete completed[i];
+	}
+
+	//
+	// Start loads for textures that want finer mips and shrink the ones that
+	// want coarser mips.  Shrinking needs no file access.
+	//
+
+	for(size_t i = 0; i < mTextures.size(); ++i)
+	{
+		Texture& tex = *mTextures[i];
+		if( !tex.Streamed || tex.Loading )
+			continue;
+
+		if( tex.WantedMip > tex.ResidentMip )
+		{
+			Resize(tex, tex.WantedMip, 0);
+		}
+		else if( tex.WantedMip < tex.ResidentMip )
+		{
+			LoadRequest request;
+			request.Id       = (Handle)i;
+			request.Source   = &tex;
+			request.FirstMip = tex.WantedMip;
+			request.EndMip   = tex.ResidentMip;
+
+			tex.Loading = true;
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mQueue.push_back(request);
+				++mPendingCount;
+			}
+			mWakeWorker.notify_one();
+		}
+	}
+}
+
+UINT64 TextureStreamer::GetResidentBytes()const
+{
+	return mResidentBytes;
+}
+
+UINT64 TextureStreamer::GetMemoryBudget()const
+{
+	return mMemoryBudget;
+}
+
+UINT TextureStreamer::GetPendingCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mPendingCount;
+}
+
+void TextureStreamer::ApplyLoad(LoadResult& result)
+{
+	Texture& tex = *mTextures[result.Request.Id];
+	tex.Loading = false;
+
+	// The data only fits if nothing changed the residency since the request.
+	if( !result.Succeeded || tex.ResidentMip != result.Request.EndMip )
+		return;
+
+	// Loaded mips the budget no longer allows are still worth keeping for a
+	// frame; the next EndFrame() shrinks the texture if needed.
+	Resize(tex, result.Request.FirstMip, &result.Data[0]);
+}
+
+void TextureStreamer::Resize(Texture& tex, UINT firstMip, const BYTE* newMips)
+{
+	const DecodedTexture& layout = tex.Layout;
+
+	UINT oldFirst  = tex.ResidentMip;
+	UINT oldLevels = layout.MipLevels - MathHelper::Min(oldFirst, layout.MipLevels);
+	UINT newLevels = layout.MipLevels - firstMip;
+
+	D3D11_TEXTURE2D_DESC texDesc;
+	texDesc.Width              = MathHelper::Max(layout.Width  >> firstMip, 1u);
+	texDesc.Height             = MathHelper::Max(layout.Height >> firstMip, 1u);
+	texDesc.MipLevels          = newLevels;
+	texDesc.ArraySize          = layout.ArraySize;
+	texDesc.Format             = layout.Format;
+	texDesc.SampleDesc.Count   = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage              = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE;
+	texDesc.CPUAccessFlags     = 0;
+	texDesc.MiscFlags          = 0;
+
+	ID3D11Texture2D* newTex = 0;
+	HR(md3dDevice->CreateTexture2D(&texDesc, 0, &newTex));
+
+	//
+	// Mips already resident are copied on the GPU, mips in [firstMip, oldFirst)
+	// come from newMips.
+	//
+
+	const BYTE* src = newMips;
+	for(UINT slice = 0; slice < layout.ArraySize; ++slice)
+	{
+		for(UINT mip = firstMip; mip < layout.MipLevels; ++mip)
+		{
+			UINT dstSub = D3D11CalcSubresource(mip - firstMip, slice, newLevels);
+
+			if( mip >= oldFirst )
+			{
+				UINT srcSub = D3D11CalcSubresource(mip - oldFirst, slice, oldLevels);
+				md3dImmediateContext->CopySubresourceRegion(newTex, dstSub, 0, 0, 0, tex.Tex, srcSub, 0);
+			}
+			else
+			{
+				const DecodedTexture::Subresource& sub = layout.Subresources[slice*layout.MipLevels + mip];
+				md3dImmediateContext->UpdateSubresource(newTex, dstSub, 0, src, sub.RowPitch, sub.SlicePitch);
+				src += sub.SlicePitch;
+			}
+		}
+	}
+
+	ID3D11ShaderResourceView* newSRV = 0;
+	HR(md3dDevice->CreateShaderResourceView(newTex, 0, &newSRV));
+
+	ReleaseCOM(tex.SRV);
+	ReleaseCOM(tex.Tex);
+
+	if( oldFirst < layout.MipLevels )
+	{
+		mResidentBytes -= GetBytes(tex, oldFirst);
+		MemoryTracker::Free(MemoryTracker::Textures, (size_t)GetBytes(tex, oldFirst));
+	}
+	mResidentBytes += GetBytes(tex, firstMip);
+	MemoryTracker::Allocate(MemoryTracker::Textures, (size_t)GetBytes(tex, firstMip));
+
+	tex.Tex = newTex;
+	tex.SRV = newSRV;
+	tex.ResidentMip = firstMip;
+}
+
+bool TextureStreamer::ReadMips(const Texture& tex, UINT firstMip, UINT endMip, std::vector<BYTE>& data)const
+{
+	const DecodedTexture& layout = tex.Layout;
+
+	std::ifstream fin(tex.Filename.c_str(), std::ios::binary);
+	if( !fin )
+		return false;
+
+	data.clear();
+
+	// A slice's mips are contiguous in the file, so each slice is one read.
+	for(UINT slice = 0; slice < layout.ArraySize; ++slice)
+	{
+		const DecodedTexture::Subresource& first = layout.Subresources[slice*layout.MipLevels + firstMip];
+		const DecodedTexture::Subresource& last  = layout.Subresources[slice*layout.MipLevels + endMip-1];
+
+		UINT64 begin = first.Offset;
+		UINT64 end   = last.Offset + last.SlicePitch;
+
+		size_t dst = data.size();
+		data.resize(dst + (size_t)(end - begin));
+
+		fin.seekg((std::streamoff)(tex.DataOffset + begin), std::ios_base::beg);
+		fin.read((char*)&data[dst], (std::streamsize)(end - begin));
+
+		if( fin.fail() )
+			return false;
+	}
+
+	return true;
+}
+
+UINT64 TextureStreamer::GetBytes(const Texture& tex, UINT firstMip)const
+{
+	const DecodedTexture& layout = tex.Layout;
+
+	UINT64 bytes = 0;
+	for(UINT mip = firstMip; mip < layout.MipLevels; ++mip)
+		bytes += layout.Subresources[mip].SlicePitch;
+
+	return bytes*layout.ArraySize;
+}
+
+void TextureStreamer::WorkerMain()
+{
+	while(true)
+	{
+		LoadRequest request;
+
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			while( !mQuit && mQueue.empty() )
+				mWakeWorker.wait(lock);
+
+			if( mQuit )
+				return;
+
+			request = mQueue.front();
+			mQueue.pop_front();
+		}
+
+		LoadResult* result = new LoadResult();
+		result->Request = request;
+		result->Succeeded = ReadMips(*request.Source, request.FirstMip, request.EndMip, result->Data);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mCompleted.push_back(result);
+			--mPendingCount;
+		}
+	}
+}
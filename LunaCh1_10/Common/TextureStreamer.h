@@ -0,0 +1,145 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Streams the mip levels of DDS textures so a large texture set fits a fixed memory
+// budget.
+//   -Registering a texture loads only its small tail mips (no larger than
+//    MinResidentSize), so startup reads very little.
+//   -Each frame the caller reports where a texture is used (world bounds and how
+//    often the texture repeats across them).  From the camera, the bounds give the
+//    screen size of a texel at the closest point, which picks the finest mip that
+//    is worth having.
+//   -EndFrame() fits the wanted mips of all textures into the budget, dropping the
+//    finest level of the largest textures first, then starts loads for textures that
+//    need finer mips and shrinks the ones that need fewer.
+//
+// A texture's GPU resource only holds its resident mips: the finest resident mip is
+// the texture's level 0.  Texture coordinates are normalized, so shaders sample it
+// the same way.  New finer mips are read from the file on a worker thread; the mips
+// already resident are copied on the GPU.  Because the resource is replaced when the
+// residency changes, fetch the view with GetSRV() every frame.
+//***************************************************************************************
+
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include "d3dUtil.h"
+#include "Camera.h"
+#include "TextureDecoder.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+class TextureStreamer
+{
+public:
+	typedef UINT Handle;
+
+public:
+	TextureStreamer();
+	~TextureStreamer();
+
+	void Init(ID3D11Device* device, ID3D11DeviceContext* dc, UINT64 memoryBudget, UINT minResidentSize = 64);
+
+	// Loads the tail mips of the texture.  Files that are not DDS are loaded
+	// whole through D3DX and are not streamed.
+	Handle Register(const std::wstring& filename);
+
+	ID3D11ShaderResourceView* GetSRV(Handle handle)const;
+
+	// Most detailed mip (of the full texture) currently resident.
+	UINT GetResidentMip(Handle handle)const;
+
+	// Call before reporting usage for the frame.
+	void BeginFrame(const Camera& cam, UINT screenHeight);
+
+	// The texture covers a sphere of the given world space bounds and repeats
+	// uvRepeat times across its diameter (the scale of its texture transform).
+	void RequestCoverage(Handle handle, const XMFLOAT3& center, float radius, float uvRepeat);
+
+	// Picks resident mips under the budget and applies finished loads.
+	void EndFrame();
+
+	UINT64 GetResidentBytes()const;
+	UINT64 GetMemoryBudget()const;
+	UINT GetPendingCount()const;
+
+private:
+	struct Texture
+	{
+		std::wstring Filename;
+
+		// Description and file layout; no data.
+		DecodedTexture Layout;
+		size_t DataOffset;
+		bool Streamed;
+
+		ID3D11Texture2D* Tex;
+		ID3D11ShaderResourceView* SRV;
+
+		UINT ResidentMip;
+		UINT TailMip;
+		UINT WantedMip;
+		bool Loading;
+	};
+
+	struct LoadRequest
+	{
+		Handle Id;
+
+		// mTextures may grow while the worker reads, so it gets the texture itself.
+		const Texture* Source;
+
+		UINT FirstMip;
+		UINT EndMip;
+	};
+
+	struct LoadResult
+	{
+		LoadRequest Request;
+		bool Succeeded;
+
+		// Mips [FirstMip, EndMip) of each slice, slice major.
+		std::vector<BYTE> Data;
+	};
+
+	void ApplyLoad(LoadResult& result);
+	void Resize(Texture& tex, UINT firstMip, const BYTE* newMips);
+	bool ReadMips(const Texture& tex, UINT firstMip, UINT endMip, std::vector<BYTE>& data)const;
+	UINT64 GetBytes(const Texture& tex, UINT firstMip)const;
+	void WorkerMain();
+
+private:
+	TextureStreamer(const TextureStreamer& rhs);
+	TextureStreamer& operator=(const TextureStreamer& rhs);
+
+private:
+	ID3D11Device* md3dDevice;
+	ID3D11DeviceContext* md3dImmediateContext;
+
+	UINT64 mMemoryBudget;
+	UINT64 mResidentBytes;
+	UINT mMinResidentSize;
+
+	// Only touched by the calling thread.  The worker reads a texture's filename
+	// and layout, which do not change after Register().
+	std::vector<Texture*> mTextures;
+
+	// Camera state of the current frame.
+	XMFLOAT3 mEyePosW;
+	float mNearZ;
+	float mPixelSizeAtUnitDistance;
+
+	// Shared with the worker, guarded by mMutex.
+	std::deque<LoadRequest> mQueue;
+	std::vector<LoadResult*> mCompleted;
+	UINT mPendingCount;
+	bool mQuit;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mWakeWorker;
+	std::thread mWorker;
+};
+
+#endif // TEXTURESTREAMER_H
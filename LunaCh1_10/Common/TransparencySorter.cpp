@@ -0,0 +1,193 @@
+//***************************************************************************************
+// TransparencySorter.cpp
+//***************************************************************************************
+
+#include "TransparencySorter.h"
+#include "FrameArena.h"
+
+namespace
+{
+	const UINT RadixBits = 11;
+	const UINT RadixSize = 1 << RadixBits;
+
+	// Maps a float to an unsigned integer with the same ordering: positive floats
+	// get their sign bit set, negative floats are inverted.
+	UINT FloatToOrderedInt(float f)
+	{
+		UINT bits = *(const UINT*)&f;
+		UINT mask = (bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+
+		return bits ^ mask;
+	}
+}
+
+TransparencySorter::TransparencySorter()
+	: mIndexBuffer(0), mNumTriangles(0)
+{
+}
+
+TransparencySorter::~TransparencySorter()
+{
+	ReleaseCOM(mIndexBuffer);
+}
+
+void TransparencySorter::Init(ID3D11Device* device, const XMFLOAT3* positions, UINT stride, UINT numVertices,
+	const UINT* indices, UINT numIndices)
+{
+	ReleaseCOM(mIndexBuffer);
+
+	mNumTriangles = numIndices / 3;
+	mIndices.assign(indices, indices + mNumTriangles*3);
+
+	UINT paddedTriangles = (mNumTriangles + 3) & ~3u;
+
+	mCentroidX.assign(paddedTriangles, 0.0f);
+	mCentroidY.assign(paddedTriangles, 0.0f);
+	mCentroidZ.assign(paddedTriangles, 0.0f);
+
+	const BYTE* base = reinterpret_cast<const BYTE*>(positions);
+
+	for(UINT t = 0; t < mNumTriangles; ++t)
+	{
+		XMVECTOR sum = XMVectorZero();
+		for(UINT k = 0; k < 3; ++k)
+		{
+			UINT index = mIndices[t*3 + k];
+			assert(index < numVertices);
+
+			sum = XMVectorAdd(sum, XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + index*stride)));
+		}
+
+		XMFLOAT3 centroid;
+		XMStoreFloat3(&centroid, XMVectorScale(sum, 1.0f/3.0f));
+
+		mCentroidX[t] = centroid.x;
+		mCentroidY[t] = centroid.y;
+		mCentroidZ[t] = centroid.z;
+	}
+
+	mKeys.resize(paddedTriangles);
+	mOrder.resize(mNumTriangles);
+	mKeysTemp.resize(paddedTriangles);
+	mOrderTemp.resize(mNumTriangles);
+
+	if( mNumTriangles == 0 )
+		return;
+
+	D3D11_BUFFER_DESC ibd;
+	ibd.Usage = D3D11_USAGE_DYNAMIC;
+	ibd.ByteWidth = sizeof(UINT) * mNumTriangles*3;
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ibd.MiscFlags = 0;
+	ibd.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA iinitData;
+	iinitData.pSysMem = &mIndices[0];
+	HR(device->CreateBuffer(&ibd, &iinitData, &mIndexBuffer));
+}
+
+void TransparencySorter::Sort(ID3D11DeviceContext* dc, CXMMATRIX worldView)
+{
+	if( mNumTriangles == 0 )
+		return;
+
+	//
+	// View depth of each centroid: the z column of worldView, four triangles at a
+	// time.
+	//
+
+	XMFLOAT4X4 M;
+	XMStoreFloat4x4(&M, worldView);
+
+	XMVECTOR mx = XMVectorReplicate(M._13);
+	XMVECTOR my = XMVectorReplicate(M._23);
+	XMVECTOR mz = XMVectorReplicate(M._33);
+	XMVECTOR mw = XMVectorReplicate(M._43);
+
+	UINT paddedTriangles = (UINT)mCentroidX.size();
+	XMFLOAT4 depths;
+
+	for(UINT t = 0; t < paddedTriangles; t += 4)
+	{
+		XMVECTOR x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mCentroidX[t]));
+		XMVECTOR y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mCentroidY[t]));
+		XMVECTOR z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&mCentroidZ[t]));
+
+		XMVECTOR depth = XMVectorMultiplyAdd(x, mx, XMVectorMultiplyAdd(y, my, XMVectorMultiplyAdd(z, mz, mw)));
+		XMStoreFloat4(&depths, depth);
+
+		// Inverted so that an ascending sort puts the furthest triangles first.
+		mKeys[t+0] = ~FloatToOrderedInt(depths.x);
+		mKeys[t+1] = ~FloatToOrderedInt(depths.y);
+		mKeys[t+2] = ~FloatToOrderedInt(depths.z);
+		mKeys[t+3] = ~FloatToOrderedInt(depths.w);
+	}
+
+	RadixSort();
+
+	//
+	// Write the triangles in sorted order.
+	//
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(dc->Map(mIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+	UINT* dst = reinterpret_cast<UINT*>(mappedData.pData);
+	for(UINT i = 0; i < mNumTriangles; ++i)
+	{
+		const UINT* src = &mIndices[mOrder[i]*3];
+		dst[i*3+0] = src[0];
+		dst[i*3+1] = src[1];
+		dst[i*3+2] = src[2];
+	}
+
+	dc->Unmap(mIndexBuffer, 0);
+}
+
+void TransparencySorter::RadixSort()
+{
+	for(UINT i = 0; i < mNumTriangles; ++i)
+		mOrder[i] = i;
+
+	// Three passes of 11 bits cover the 32-bit keys.  Passes where every key has
+	// the same digit are skipped; they are common when the depths are close.
+	UINT* counts = FrameArena::ForThread().Allocate<UINT>(RadixSize);
+
+	for(UINT shift = 0; shift < 32; shift += RadixBits)
+	{
+		std::fill(counts, counts + RadixSize, 0);
+		for(UINT i = 0; i < mNumTriangles; ++i)
+			++counts[(mKeys[i] >> shift) & (RadixSize-1)];
+
+		if( counts[(mKeys[0] >> shift) & (RadixSize-1)] == mNumTriangles )
+			continue;
+
+		UINT sum = 0;
+		for(UINT b = 0; b < RadixSize; ++b)
+		{
+			UINT count = counts[b];
+			counts[b] = sum;
+			sum += count;
+		}
+
+		for(UINT i = 0; i < mNumTriangles; ++i)
+		{
+			UINT dst = counts[(mKeys[i] >> shift) & (RadixSize-1)]++;
+			mKeysTemp[dst]  = mKeys[i];
+			mOrderTemp[dst] = mOrder[i];
+		}
+
+		mKeys.swap(mKeysTemp);
+		mOrder.swap(mOrderTemp);
+	}
+}
+
+ID3D11Buffer* TransparencySorter::GetIndexBuffer()const
+{
+	return mIndexBuffer;
+}
+
+UINT TransparencySorter::GetIndexCount()const
+{
+	return mNumTriangles*3;
+}
@@ -0,0 +1,69 @@
+//***************************************************************************************
+// TransparencySorter.h
+//
+// Keeps the triangles of a blended mesh in back to front order for the camera, so
+// they blend correctly from every direction without hand-ordered draw calls.
+//   -Triangle centroids are computed once and stored as separate x, y and z arrays,
+//    so Sort() finds the view depth of four triangles per XMVECTOR operation.
+//   -The depths are turned into integer keys and radix sorted, 11 bits per pass.
+//   -The sorted triangles are written into a dynamic index buffer with one Map(),
+//    and the whole mesh is drawn with a single DrawIndexed().
+//
+// Sorting objects, rather than the triangles within one, is done by RenderQueue
+// (blended packets are ordered back to front).  Intersecting triangles are not
+// split; no order blends those correctly.
+//***************************************************************************************
+
+#ifndef TRANSPARENCYSORTER_H
+#define TRANSPARENCYSORTER_H
+
+#include "d3dUtil.h"
+
+class TransparencySorter
+{
+public:
+	TransparencySorter();
+	~TransparencySorter();
+
+	///<summary>
+	/// Copies the triangle list and creates the dynamic index buffer.  positions
+	/// points at the first vertex's position and stride is the vertex size.
+	///</summary>
+	void Init(ID3D11Device* device, const XMFLOAT3* positions, UINT stride, UINT numVertices,
+		const UINT* indices, UINT numIndices);
+
+	///<summary>
+	/// Orders the triangles back to front for the worldView transform and rewrites
+	/// the index buffer.
+	///</summary>
+	void Sort(ID3D11DeviceContext* dc, CXMMATRIX worldView);
+
+	ID3D11Buffer* GetIndexBuffer()const;
+	UINT GetIndexCount()const;
+
+private:
+	void RadixSort();
+
+private:
+	TransparencySorter(const TransparencySorter& rhs);
+	TransparencySorter& operator=(const TransparencySorter& rhs);
+
+private:
+	ID3D11Buffer* mIndexBuffer;
+
+	std::vector<UINT> mIndices;
+	UINT mNumTriangles;
+
+	// Centroids, padded to a multiple of four triangles.
+	std::vector<float> mCentroidX;
+	std::vector<float> mCentroidY;
+	std::vector<float> mCentroidZ;
+
+	// Sort keys and triangle numbers, with scratch space for the radix passes.
+	std::vector<UINT> mKeys;
+	std::vector<UINT> mOrder;
+	std::vector<UINT> mKeysTemp;
+	std::vector<UINT> mOrderTemp;
+};
+
+#endif // TRANSPARENCYSORTER_H
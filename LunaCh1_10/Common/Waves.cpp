@@ -7,6 +7,12 @@
 #include <vector>
 #include <cassert>
 
+namespace
+{
+	// Rows per job; a row of the 200x200 demo grid is a few microseconds of work.
+	const UINT RowsPerJob = 16;
+}
+
 Waves::Waves()
 : mNumRows(0), mNumCols(0), mVertexCount(0), mTriangleCount(0), 
   mK1(0.0f), mK2(0.0f), mK3(0.0f), mTimeStep(0.0f), mSpatialStep(0.0f),
@@ -16,6 +22,8 @@ Waves::Waves()
 
 Waves::~Waves()
 {
+	MemoryTracker::Free(MemoryTracker::Waves, 4*mVertexCount*sizeof(XMFLOAT3));
+
 	delete[] mPrevSolution;
 	delete[] mCurrSolution;
 	delete[] mNormals;
@@ -54,6 +62,9 @@ float Waves::Depth()const
 
 void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 {
+	// In case Init() called again.
+	MemoryTracker::Free(MemoryTracker::Waves, 4*mVertexCount*sizeof(XMFLOAT3));
+
 	mNumRows  = m;
 	mNumCols  = n;
 
@@ -80,6 +91,8 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 	mNormals      = new XMFLOAT3[m*n];
 	mTangentX     = new XMFLOAT3[m*n];
 
+	MemoryTracker::Allocate(MemoryTracker::Waves, 4*m*n*sizeof(XMFLOAT3));
+
 	// Generate grid vertices in system memory.
 
 	float halfWidth = (n-1)*dx*0.5f;
@@ -109,29 +122,11 @@ void Waves::Update(float dt)
 	// Only update the simulation at the specified time step.
 	if( t >= mTimeStep )
 	{
-		// Only update interior points; we use zero boundary conditions.
-		for(UINT i = 1; i < mNumRows-1; ++i)
-		{
-			for(UINT j = 1; j < mNumCols-1; ++j)
-			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
-			}
-		}
+		// Only update interior points; we use zero boundary conditions.  Each row
+		// only writes its own points, so the rows are split into jobs.
+		JobCounter counter;
+		JobSystem::ParallelFor(&Waves::SolveRowsJob, this, mNumRows-2, RowsPerJob, &counter);
+		JobSystem::Wait(counter);
 
 		// We just overwrote the previous buffer with the new data, so
 		// this data needs to become the current solution and the old
@@ -143,25 +138,68 @@ void Waves::Update(float dt)
 		//
 		// Compute normals using finite difference scheme.
 		//
-		for(UINT i = 1; i < mNumRows-1; ++i)
+		JobSystem::ParallelFor(&Waves::ComputeNormalRowsJob, this, mNumRows-2, RowsPerJob, &counter);
+		JobSystem::Wait(counter);
+	}
+}
+
+void Waves::SolveRowsJob(void* waves, UINT firstRow, UINT endRow)
+{
+	static_cast<Waves*>(waves)->SolveRows(firstRow, endRow);
+}
+
+void Waves::ComputeNormalRowsJob(void* waves, UINT firstRow, UINT endRow)
+{
+	static_cast<Waves*>(waves)->ComputeNormalRows(firstRow, endRow);
+}
+
+void Waves::SolveRows(UINT firstRow, UINT endRow)
+{
+	// Row i of the jobs' range is interior row i+1.
+	for(UINT i = firstRow+1; i < endRow+1; ++i)
+	{
+		for(UINT j = 1; j < mNumCols-1; ++j)
+		{
+			// After this update we will be discarding the old previous
+			// buffer, so overwrite that buffer with the new update.
+			// Note how we can do this inplace (read/write to same element) 
+			// because we won't need prev_ij again and the assignment happens last.
+
+			// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+			// Moreover, our +z axis goes "down"; this is just to 
+			// keep consistent with our row indices going down.
+
+			mPrevSolution[i*mNumCols+j].y = 
+				mK1*mPrevSolution[i*mNumCols+j].y +
+				mK2*mCurrSolution[i*mNumCols+j].y +
+				mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
+				     mCurrSolution[(i-1)*mNumCols+j].y + 
+				     mCurrSolution[i*mNumCols+j+1].y + 
+					 mCurrSolution[i*mNumCols+j-1].y);
+		}
+	}
+}
+
+void Waves::ComputeNormalRows(UINT firstRow, UINT endRow)
+{
+	for(UINT i = firstRow+1; i < endRow+1; ++i)
+	{
+		for(UINT j = 1; j < mNumCols-1; ++j)
 		{
-			for(UINT j = 1; j < mNumCols-1; ++j)
-			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
-			}
+			float l = mCurrSolution[i*mNumCols+j-1].y;
+			float r = mCurrSolution[i*mNumCols+j+1].y;
+			float t = mCurrSolution[(i-1)*mNumCols+j].y;
+			float b = mCurrSolution[(i+1)*mNumCols+j].y;
+			mNormals[i*mNumCols+j].x = -r+l;
+			mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
+			mNormals[i*mNumCols+j].z = b-t;
+
+			XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
+			XMStoreFloat3(&mNormals[i*mNumCols+j], n);
+
+			mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
+			XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
+			XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
 		}
 	}
 }
@@ -11,6 +11,8 @@
 
 #include <Windows.h>
 #include <xnamath.h>
+#include "JobSystem.h"
+#include "MemoryTracker.h"
 
 class Waves
 {
@@ -38,6 +40,14 @@ public:
 	void Update(float dt);
 	void Disturb(UINT i, UINT j, float magnitude);
 
+private:
+	// Update the interior rows [firstRow+1, endRow+1).
+	void SolveRows(UINT firstRow, UINT endRow);
+	void ComputeNormalRows(UINT firstRow, UINT endRow);
+
+	static void SolveRowsJob(void* waves, UINT firstRow, UINT endRow);
+	static void ComputeNormalRowsJob(void* waves, UINT firstRow, UINT endRow);
+
 private:
 	UINT mNumRows;
 	UINT mNumCols;
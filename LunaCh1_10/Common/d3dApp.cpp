@@ -12,6 +12,32 @@ namespace
 	// procedure to our member function window procedure because we cannot
 	// assign a member function to WNDCLASS::lpfnWndProc.
 	D3DApp* gd3dApp = 0;
+
+#if defined(DEBUG) | defined(_DEBUG)
+	// Allocations from the general heap made by a frame, counted by the debug CRT
+	// to check that steady-state frames make none.
+	std::atomic<long> gHeapAllocations(0);
+
+	// Set while this thread updates or draws a frame.  Loader and streaming
+	// threads allocate as they please and are not counted.
+	__declspec(thread) bool gCountHeapAllocations = false;
+
+	int __cdecl CountHeapAllocations(int allocType, void* userData, size_t size, int blockType,
+		long requestNumber, const unsigned char* filename, int lineNumber)
+	{
+		if( gCountHeapAllocations && (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC) )
+			++gHeapAllocations;
+
+		return TRUE;
+	}
+#endif
+
+	void CountFrameAllocations(bool count)
+	{
+#if defined(DEBUG) | defined(_DEBUG)
+		gCountHeapAllocations = count;
+#endif
+	}
 }
 
 LRESULT CALLBACK
@@ -41,9 +67,26 @@ D3DApp::D3DApp(HINSTANCE hInstance)
 	mSwapChain(0),
 	mDepthStencilBuffer(0),
 	mRenderTargetView(0),
-	mDepthStencilView(0)
+	mDepthStencilView(0),
+	mFrameLatency(0),
+	mFramesSubmitted(0),
+	mFramesDrawn(0),
+	mStopRendering(false),
+	mFrameDrawnEvent(0),
+	mWaitingForFrames(false),
+	mResizePending(false),
+	mBenchmarking(false),
+	mBenchmarkRestoreLatency(0),
+	mBenchmarkSeconds(0.0f),
+	mBenchmarkStart(0.0f),
+	mBenchmarkFrames(0),
+	mHeapAllocationsPerFrame(0)
 {
 	ZeroMemory(&mScreenViewport, sizeof(D3D11_VIEWPORT));
+	ZeroMemory(mBenchmarkFps, sizeof(mBenchmarkFps));
+
+	// Auto-reset: each wait consumes the frames drawn before it.
+	mFrameDrawnEvent = CreateEvent(0, FALSE, FALSE, 0);
 
 	// Get a pointer to the application object so we can forward 
 	// Windows messages to the object's window procedure through
@@ -53,6 +96,13 @@ D3DApp::D3DApp(HINSTANCE hInstance)
 
 D3DApp::~D3DApp()
 {
+	StopRenderThread();
+	JobSystem::Shutdown();
+	FrameArena::ReleaseAll();
+
+	if( mFrameDrawnEvent )
+		CloseHandle(mFrameDrawnEvent);
+
 	ReleaseCOM(mRenderTargetView);
 	ReleaseCOM(mDepthStencilView);
 	ReleaseCOM(mSwapChain);
@@ -103,8 +153,29 @@ int D3DApp::Run()
 			if( !mAppPaused )
 			{
 				CalculateFrameStats();
+
+				// Last frame's temporaries are done with; with a render thread it
+				// resets its own arena.
+				FrameArena::ForThread().Reset();
+
+				if( mResizePending )
+					OnResize();
+
+				CountFrameAllocations(true);
+
 				UpdateScene(mTimer.DeltaTime());	
-				DrawScene();
+
+				if( mFrameLatency == 0 )
+					DrawScene();
+				else
+					SubmitFrame();
+
+				CountFrameAllocations(false);
+
+				MemoryTracker::EndFrame();
+
+				if( mBenchmarking )
+					UpdateLatencyBenchmark();
 			}
 			else
 			{
@@ -113,11 +184,200 @@ int D3DApp::Run()
         }
     }
 
+	// The derived class's resources go away after this returns.
+	StopRenderThread();
+
 	return (int)msg.wParam;
 }
 
+void D3DApp::SetFrameLatency(UINT frames)
+{
+	assert(frames <= MaxFrameLatency);
+
+	if( frames == mFrameLatency )
+		return;
+
+	// Slots are numbered by the latency, so drain the frames in flight first.
+	StopRenderThread();
+	mFrameLatency = frames;
+}
+
+UINT D3DApp::GetFrameLatency()const
+{
+	return mFrameLatency;
+}
+
+void D3DApp::BenchmarkFrameLatency(float secondsEach)
+{
+	mBenchmarking = true;
+	mBenchmarkRestoreLatency = mFrameLatency;
+	mBenchmarkSeconds = secondsEach;
+	mBenchmarkFrames = 0;
+
+	SetFrameLatency(0);
+}
+
+void D3DApp::UpdateLatencyBenchmark()
+{
+	// Timed from the end of the first frame at each latency, which leaves out
+	// starting the render thread.
+	if( mBenchmarkFrames++ == 0 )
+	{
+		mBenchmarkStart = mTimer.TotalTime();
+		return;
+	}
+
+	float elapsed = mTimer.TotalTime() - mBenchmarkStart;
+	if( elapsed < mBenchmarkSeconds )
+		return;
+
+	// With a render thread, submitting is held back to the drawing rate, so the
+	// frames counted here are the frames drawn.
+	mBenchmarkFps[mFrameLatency] = (mBenchmarkFrames - 1) / elapsed;
+
+	if( mFrameLatency < MaxFrameLatency )
+	{
+		SetFrameLatency(mFrameLatency + 1);
+		mBenchmarkFrames = 0;
+		return;
+	}
+
+	mBenchmarking = false;
+	SetFrameLatency(mBenchmarkRestoreLatency);
+
+	std::ofstream fout("FrameLatency.txt");
+	fout << "Frame latency throughput, " << mBenchmarkSeconds << " s each" << std::endl;
+	for(UINT i = 0; i <= MaxFrameLatency; ++i)
+	{
+		fout << "  latency " << i << ": " << mBenchmarkFps[i] << " frames/s, "
+			<< 1000.0f / MathHelper::Max(mBenchmarkFps[i], 1e-6f) << " ms/frame";
+		if( i > 0 )
+			fout << " (" << mBenchmarkFps[i] / MathHelper::Max(mBenchmarkFps[0], 1e-6f) << "x latency 0)";
+		fout << std::endl;
+	}
+}
+
+UINT D3DApp::GetHeapAllocationsPerFrame()const
+{
+	return mHeapAllocationsPerFrame;
+}
+
+void D3DApp::WriteMemoryReport()
+{
+	std::ofstream fout("MemoryReport.txt");
+	MemoryTracker::WriteReport(fout);
+}
+
+void D3DApp::SubmitFrame()
+{
+	if( !mRenderThread.joinable() )
+		mRenderThread = std::thread(&D3DApp::RenderMain, this);
+
+	UINT64 frame = mFramesSubmitted;
+	UINT slot = (UINT)(frame % (mFrameLatency + 1));
+
+	// The slot was last used mFrameLatency+1 frames ago; wait until that frame
+	// has been drawn.
+	if( frame > mFrameLatency )
+		WaitForFramesDrawn(frame - mFrameLatency);
+
+	WriteSnapshot(slot);
+
+	{
+		std::lock_guard<std::mutex> lock(mFrameMutex);
+		++mFramesSubmitted;
+	}
+	mFrameSubmitted.notify_one();
+}
+
+void D3DApp::FlushFrames()
+{
+	WaitForFramesDrawn(mFramesSubmitted);
+}
+
+void D3DApp::WaitForFramesDrawn(UINT64 frames)
+{
+	mWaitingForFrames = true;
+
+	for(;;)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mFrameMutex);
+			if( mFramesDrawn >= frames )
+				break;
+		}
+
+		// Present() on the render thread can send the window a message (a full
+		// screen switch, losing focus) and block until it is handled.  Handle the
+		// sent messages here; posted ones stay queued for Run().
+		if( MsgWaitForMultipleObjectsEx(1, &mFrameDrawnEvent, INFINITE, QS_SENDMESSAGE, MWMO_INPUTAVAILABLE) == WAIT_OBJECT_0 + 1 )
+		{
+			MSG msg;
+			PeekMessage(&msg, 0, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+		}
+	}
+
+	mWaitingForFrames = false;
+}
+
+void D3DApp::StopRenderThread()
+{
+	if( !mRenderThread.joinable() )
+		return;
+
+	// Drain first, so join() does not block while the render thread is presenting.
+	FlushFrames();
+
+	{
+		std::lock_guard<std::mutex> lock(mFrameMutex);
+		mStopRendering = true;
+	}
+	mFrameSubmitted.notify_one();
+
+	// It draws what was submitted before it stops.
+	mRenderThread.join();
+	mStopRendering = false;
+}
+
+void D3DApp::RenderMain()
+{
+	for(;;)
+	{
+		UINT64 frame;
+		{
+			std::unique_lock<std::mutex> lock(mFrameMutex);
+			while( mFramesDrawn == mFramesSubmitted && !mStopRendering )
+				mFrameSubmitted.wait(lock);
+
+			if( mFramesDrawn == mFramesSubmitted )
+				return;
+
+			frame = mFramesDrawn;
+		}
+
+		FrameArena::ForThread().Reset();
+
+		CountFrameAllocations(true);
+		DrawSnapshot((UINT)(frame % (mFrameLatency + 1)));
+		CountFrameAllocations(false);
+
+		{
+			std::lock_guard<std::mutex> lock(mFrameMutex);
+			++mFramesDrawn;
+		}
+		SetEvent(mFrameDrawnEvent);
+	}
+}
+
 bool D3DApp::Init()
 {
+	// One worker per hardware thread besides this one, which helps while it waits.
+	JobSystem::Init();
+
+#if defined(DEBUG) | defined(_DEBUG)
+	_CrtSetAllocHook(&CountHeapAllocations);
+#endif
+
 	if(!InitMainWindow())
 		return false;
 
@@ -133,6 +393,18 @@ void D3DApp::OnResize()
 	assert(md3dDevice);
 	assert(mSwapChain);
 
+	// Resizing from a message handled while waiting for the render thread would
+	// wait for it again; the resize is done once that wait is over.
+	if( mWaitingForFrames )
+	{
+		mResizePending = true;
+		return;
+	}
+
+	// The render thread must be idle while the swap chain is resized.
+	FlushFrames();
+	mResizePending = false;
+
 	// Release the old views, as they hold references to the buffers we
 	// will be destroying.  Also release the old depth/stencil buffer.
 
@@ -321,6 +593,14 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	case WM_MOUSEMOVE:
 		OnMouseMove(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
+
+	case WM_KEYDOWN:
+		if( wParam == VK_F8 )
+		{
+			WriteMemoryReport();
+			return 0;
+		}
+		break;
 	}
 
 	return DefWindowProc(hwnd, msg, wParam, lParam);
@@ -485,12 +765,27 @@ void D3DApp::CalculateFrameStats()
 		float fps = (float)frameCnt; // fps = frameCnt / 1
 		float mspf = 1000.0f / fps;
 
-		std::wostringstream outs;   
-		outs.precision(6);
-		outs << mMainWndCaption << L"    "
-			 << L"FPS: " << fps << L"    " 
-			 << L"Frame Time: " << mspf << L" (ms)";
-		SetWindowText(mhMainWnd, outs.str().c_str());
+		// Formatted into fixed buffers; a string stream would allocate.
+		wchar_t latency[64] = L"";
+		if( mFrameLatency > 0 )
+			_snwprintf_s(latency, _TRUNCATE, L"    Pipelined: %u frame(s)", mFrameLatency);
+
+		wchar_t heap[64] = L"";
+#if defined(DEBUG) | defined(_DEBUG)
+		static long lastHeapAllocations = 0;
+		long heapAllocations = gHeapAllocations;
+
+		mHeapAllocationsPerFrame = (UINT)((heapAllocations - lastHeapAllocations) / frameCnt);
+		lastHeapAllocations = heapAllocations;
+
+		_snwprintf_s(heap, _TRUNCATE, L"    Heap allocs/frame: %u", mHeapAllocationsPerFrame);
+#endif
+
+		wchar_t caption[512];
+		_snwprintf_s(caption, _TRUNCATE, L"%s    FPS: %g    Frame Time: %g (ms)    Frame arena: %u KB%s%s",
+			mMainWndCaption.c_str(), fps, mspf, (UINT)(FrameArena::GetTotalHighWater()/1024), latency, heap);
+
+		SetWindowText(mhMainWnd, caption);
 		
 		// Reset for next average.
 		frameCnt = 0;
@@ -13,7 +13,13 @@
 
 #include "d3dUtil.h"
 #include "GameTimer.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "MemoryTracker.h"
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 class D3DApp
 {
@@ -36,17 +42,66 @@ public:
 	virtual void DrawScene()=0; 
 	virtual LRESULT MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
+	// Pipelined frames.  WriteSnapshot() copies everything drawing needs (camera,
+	// transforms, lights, dynamic vertices) into a snapshot slot after UpdateScene().
+	// DrawSnapshot() draws a slot on the render thread; while pipelined it is the
+	// only place the device context may be used.
+	virtual void WriteSnapshot(UINT slot) { }
+	virtual void DrawSnapshot(UINT slot) { }
+
 	// Convenience overrides for handling mouse input.
 	virtual void OnMouseDown(WPARAM btnState, int x, int y){ }
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)  { }
 	virtual void OnMouseMove(WPARAM btnState, int x, int y){ }
 
+	static const UINT MaxFrameLatency = 2;
+
+	///<summary>
+	/// Frames UpdateScene() may run ahead of the frame being drawn.  0, the default,
+	/// updates and draws each frame in turn.  1 or 2 draw on a render thread from
+	/// snapshots, so the derived class must implement WriteSnapshot() and
+	/// DrawSnapshot(), keeping MaxFrameLatency+1 slots.
+	///</summary>
+	void SetFrameLatency(UINT frames);
+	UINT GetFrameLatency()const;
+
+	///<summary>
+	/// Runs secondsEach seconds at each frame latency from 0 to MaxFrameLatency and
+	/// writes the frames per second of each to FrameLatency.txt, then goes back to
+	/// the current latency.  Only for classes that implement the snapshots.
+	///</summary>
+	void BenchmarkFrameLatency(float secondsEach);
+
+	// General heap allocations per frame over the last second, made by the main
+	// and render threads while updating and drawing.  Debug builds count them
+	// through the CRT; release builds report 0.
+	UINT GetHeapAllocationsPerFrame()const;
+
+	///<summary>
+	/// Writes MemoryTracker's counters to MemoryReport.txt.  Bound to F8.
+	///</summary>
+	void WriteMemoryReport();
+
 protected:
 	bool InitMainWindow();
 	bool InitDirect3D();
 
 	void CalculateFrameStats();
 
+	// Waits until every submitted frame has been drawn.
+	void FlushFrames();
+
+private:
+	void SubmitFrame();
+	void StopRenderThread();
+	void RenderMain();
+
+	// Waits until frames frames have been drawn, handling the messages sent to
+	// the window meanwhile.
+	void WaitForFramesDrawn(UINT64 frames);
+
+	void UpdateLatencyBenchmark();
+
 protected:
 
 	HINSTANCE mhAppInst;
@@ -73,6 +128,36 @@ protected:
 	int mClientWidth;
 	int mClientHeight;
 	bool mEnable4xMsaa;
+
+private:
+	UINT mFrameLatency;
+	std::thread mRenderThread;
+
+	// Frames handed to and finished by the render thread.
+	std::mutex mFrameMutex;
+	std::condition_variable mFrameSubmitted;
+	UINT64 mFramesSubmitted;
+	UINT64 mFramesDrawn;
+	bool mStopRendering;
+
+	// Set by the render thread after each frame.  The window thread waits on it
+	// with MsgWaitForMultipleObjects() rather than a condition variable.
+	HANDLE mFrameDrawnEvent;
+
+	// A resize sent while waiting for the render thread is done after the wait.
+	bool mWaitingForFrames;
+	bool mResizePending;
+
+	// BenchmarkFrameLatency() state; frames per second by latency.
+	bool mBenchmarking;
+	UINT mBenchmarkRestoreLatency;
+	float mBenchmarkSeconds;
+	float mBenchmarkStart;
+	UINT mBenchmarkFrames;
+	float mBenchmarkFps[MaxFrameLatency + 1];
+
+	// General heap allocations per frame over the last second, in debug builds.
+	UINT mHeapAllocationsPerFrame;
 };
 
 #endif // D3DAPP_H
\ No newline at end of file
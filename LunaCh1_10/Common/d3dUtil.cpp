@@ -224,4 +224,20 @@ void ExtractFrustumPlanes(XMFLOAT4 planes[6], CXMMATRIX M)
 		XMVECTOR v = XMPlaneNormalize(XMLoadFloat4(&planes[i]));
 		XMStoreFloat4(&planes[i], v);
 	}
+}
+
+bool SphereInFrustum(const XMVECTOR planes[6], FXMVECTOR sphere)
+{
+	XMVECTOR center = XMVectorSetW(sphere, 1.0f);
+	XMVECTOR negRadius = XMVectorNegate(XMVectorSplatW(sphere));
+
+	// The sphere is outside if its center is further behind any plane than its
+	// radius.
+	for(int i = 0; i < 6; ++i)
+	{
+		if( XMVector4Less(XMVector4Dot(planes[i], center), negRadius) )
+			return false;
+	}
+
+	return true;
 }
\ No newline at end of file
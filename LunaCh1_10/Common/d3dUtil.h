@@ -109,6 +109,10 @@ public:
 // Order: left, right, bottom, top, near, far.
 void ExtractFrustumPlanes(XMFLOAT4 planes[6], CXMMATRIX M);
 
+// Tests a bounding sphere (center in xyz, radius in w) against the planes from
+// ExtractFrustumPlanes, loaded once by the caller for a batch of tests.
+bool SphereInFrustum(const XMVECTOR planes[6], FXMVECTOR sphere);
+
 
 // #define XMGLOBALCONST extern CONST __declspec(selectany)
 //   1. extern so there is only one copy of the variable, and not a separate
@@ -0,0 +1,53 @@
+//***************************************************************************************
+// CommonTests.cpp
+//
+// Console checks and benchmarks for the parts of Common that run without a window.
+// With no arguments every test runs; otherwise only the ones named, e.g.
+//
+//		CommonTests texturemgr recordbench
+//
+// Run it from this directory, since the tests load the demos' assets by relative
+// path.  Returns 0 if every check passed.
+//***************************************************************************************
+
+#include "CommonTests.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	struct Test
+	{
+		const char* Name;
+		bool (*Run)();
+	};
+
+	const Test Tests[] =
+	{
+		{ "texturemgr",  &RunTextureMgrTest },
+		{ "recordbench", &RunRecordBenchmark }
+	};
+	const unsigned NumTests = sizeof(Tests)/sizeof(Tests[0]);
+}
+
+int main(int argc, char* argv[])
+{
+	bool passed = true;
+
+	for(unsigned i = 0; i < NumTests; ++i)
+	{
+		bool selected = argc < 2;
+		for(int arg = 1; arg < argc && !selected; ++arg)
+			selected = strcmp(argv[arg], Tests[i].Name) == 0;
+
+		if( !selected )
+			continue;
+
+		bool testPassed = Tests[i].Run();
+		printf("%-12s %s\n", Tests[i].Name, testPassed ? "passed" : "FAILED");
+
+		passed = passed && testPassed;
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+//***************************************************************************************
+// CommonTests.h
+//
+// The checks and benchmarks CommonTests runs.  Each writes its results to a text
+// file next to the executable and returns true if everything it checks passed.
+//***************************************************************************************
+
+#ifndef COMMONTESTS_H
+#define COMMONTESTS_H
+
+// Loads textures through TextureMgr with a null device; writes TextureMgrTest.txt.
+bool RunTextureMgrTest();
+
+// Times ParallelRecorder on one thread and on every job thread; writes RecordBench.txt.
+bool RunRecordBenchmark();
+
+#endif // COMMONTESTS_H
@@ -0,0 +1,145 @@
+//***************************************************************************************
+// RecordBenchmark.cpp
+//
+// Times recording a large scene of draws through ParallelRecorder on one thread and
+// on every job thread, with a null device, and checks that both record the same
+// draws in the same order.
+//***************************************************************************************
+
+#include "CommonTests.h"
+#include "ParallelRecorder.h"
+#include "MathHelper.h"
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+	// A grid of boxes in front of a camera.  Recording an item culls it against
+	// the view and records its state and draw, as a scene traversal would.
+	class BenchmarkScene : public ParallelRecorder::Job
+	{
+	public:
+		BenchmarkScene(UINT side)
+			: mSide(side)
+		{
+			XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, -10.0f, 1.0f),
+				XMVectorSet(0.0f, 0.0f, 0.5f*side, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+			XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 4.0f/3.0f, 1.0f, 1000.0f);
+			XMStoreFloat4x4(&mViewProj, view*proj);
+		}
+
+		void Record(UINT firstItem, UINT endItem, CommandBuffer& commands)
+		{
+			XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+
+			commands.SetShader(0);
+
+			for(UINT i = firstItem; i < endItem; ++i)
+			{
+				float x = (float)(i % mSide) - 0.5f*mSide;
+				float z = (float)(i / mSide);
+
+				XMMATRIX world = XMMatrixRotationY(0.01f*i)*XMMatrixTranslation(x, 0.0f, z);
+				XMVECTOR center = XMVector3TransformCoord(XMVectorZero(), world*viewProj);
+
+				// Keep the boxes whose center projects inside the view, with a
+				// margin for their size.
+				if( XMVectorGetZ(center) < 0.0f || XMVectorGetZ(center) > 1.0f ||
+					fabsf(XMVectorGetX(center)) > 1.1f || fabsf(XMVectorGetY(center)) > 1.1f )
+					continue;
+
+				commands.SetGeometry(0);
+				commands.SetMaterial(i % 4 == 0 ? ScreenMaterialId : BoxMaterialId);
+				commands.SetObject(i);
+				commands.DrawIndexed(36, 0, 0);
+			}
+		}
+
+	private:
+		enum { BoxMaterialId, ScreenMaterialId };
+
+		UINT mSide;
+		XMFLOAT4X4 mViewProj;
+	};
+
+	// Milliseconds per Record() of the scene, the best of a few runs.
+	double TimeRecording(ParallelRecorder& recorder, BenchmarkScene& scene, UINT numItems)
+	{
+		__int64 countsPerSec;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+
+		double best = 0.0;
+		for(UINT run = 0; run < 10; ++run)
+		{
+			__int64 start, end;
+			QueryPerformanceCounter((LARGE_INTEGER*)&start);
+			recorder.Record(scene, numItems);
+			QueryPerformanceCounter((LARGE_INTEGER*)&end);
+
+			double ms = 1000.0*(end - start)/countsPerSec;
+			if( run == 0 || ms < best )
+				best = ms;
+		}
+
+		return best;
+	}
+}
+
+bool RunRecordBenchmark()
+{
+	JobSystem::Init();
+
+	std::ofstream log("RecordBench.txt");
+	log << std::fixed << std::setprecision(3);
+
+	const UINT side = 512;
+	const UINT numItems = side*side;
+	BenchmarkScene scene(side);
+
+	// A null device records only.
+	ParallelRecorder single;
+	single.Init(0, 1);
+
+	ParallelRecorder parallel;
+	parallel.Init(0, 0);
+
+	double singleMs = TimeRecording(single, scene, numItems);
+	double parallelMs = TimeRecording(parallel, scene, numItems);
+
+	// Both must record the same commands in the same order.
+	CommandBuffer singleCommands, parallelCommands;
+	single.Merge(singleCommands);
+	parallel.Merge(parallelCommands);
+
+	bool same = false;
+	if( singleCommands.GetDrawCount() == parallelCommands.GetDrawCount() )
+	{
+		// The parallel buffers repeat the state each range starts with, so
+		// compare the draws and the objects they are drawn with.
+		std::vector<CommandBuffer::Command> a, b;
+		const CommandBuffer* buffers[2] = { &singleCommands, &parallelCommands };
+		std::vector<CommandBuffer::Command>* draws[2] = { &a, &b };
+
+		for(UINT k = 0; k < 2; ++k)
+		{
+			const CommandBuffer::Command* commands = buffers[k]->GetCommands();
+			for(UINT i = 0; i < buffers[k]->GetCommandCount(); ++i)
+			{
+				if( commands[i].Op == CommandBuffer::OpSetObject || commands[i].Op == CommandBuffer::OpDrawIndexed )
+					draws[k]->push_back(commands[i]);
+			}
+		}
+
+		same = a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size()*sizeof(a[0])) == 0);
+	}
+
+	log << numItems << " items, " << singleCommands.GetDrawCount() << " drawn" << std::endl;
+	log << "  1 thread:   " << singleMs << " ms" << std::endl;
+	log << "  " << parallel.GetActiveThreadCount() << " threads:  " << parallelMs << " ms ("
+		<< singleMs / MathHelper::Max(parallelMs, 1e-6) << "x)" << std::endl;
+	log << (same ? "Both recorded the same draws." : "The recordings differ.") << std::endl;
+
+	JobSystem::Shutdown();
+
+	return same;
+}
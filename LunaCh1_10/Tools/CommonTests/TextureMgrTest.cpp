@@ -0,0 +1,133 @@
+//***************************************************************************************
+// TextureMgrTest.cpp
+//
+// Checks TextureMgr with a null device: requests, loading with and without worker
+// threads, failures and eviction under a budget.  Uses Crate's textures.
+//***************************************************************************************
+
+#include "CommonTests.h"
+#include "TextureMgr.h"
+#include "MathHelper.h"
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+	// Logs one check and clears passed if it failed.
+	void Check(std::wofstream& log, bool& passed, bool condition, const wchar_t* what)
+	{
+		log << (condition ? L"pass  " : L"FAIL  ") << what << std::endl;
+		passed = passed && condition;
+	}
+
+	// A DXT5 and a DXT1 DDS, used in place, and a BMP that is decoded.
+	const wchar_t* Files[] =
+	{
+		L"../../Chapter 8 Texturing/Crate/Textures/WoodCrate01.dds",
+		L"../../Chapter 8 Texturing/Crate/Textures/darkbrickdxt1.dds",
+		L"../../Chapter 8 Texturing/Crate/Textures/darkbrick.bmp"
+	};
+	const UINT NumFiles = sizeof(Files)/sizeof(Files[0]);
+
+	// 24-bit RGB, which neither DDSFile nor TextureDecoder reads.
+	const wchar_t* UnsupportedFile = L"../../Chapter 8 Texturing/Crate/Textures/phone.dds";
+
+	const wchar_t* MissingFile = L"../../Chapter 8 Texturing/Crate/Textures/missing.dds";
+}
+
+bool RunTextureMgrTest()
+{
+	std::wofstream log(L"TextureMgrTest.txt");
+	bool passed = true;
+
+	const UINT64 noBudget = ~0ull;
+
+	// Without workers every load finishes in the next Update().
+	{
+		TextureMgr mgr;
+		mgr.Init(0, noBudget, 0);
+
+		TextureMgr::Handle handles[NumFiles];
+		for(UINT i = 0; i < NumFiles; ++i)
+			handles[i] = mgr.RequestTexture(Files[i]);
+
+		Check(log, passed, mgr.RequestTexture(Files[0]) == handles[0], L"a second request returns the same handle");
+		Check(log, passed, !mgr.IsReady(handles[0]), L"nothing is ready before Update()");
+
+		mgr.Update();
+
+		bool allReady = true;
+		for(UINT i = 0; i < NumFiles; ++i)
+			allReady = allReady && mgr.IsReady(handles[i]);
+
+		const TextureMgr::Stats& stats = mgr.GetStats();
+		Check(log, passed, allReady, L"every texture is ready after one Update()");
+		Check(log, passed, stats.LoadsCompleted == NumFiles, L"each file is loaded once");
+		Check(log, passed, stats.ResidentBytes > 0, L"resident bytes are counted");
+
+		TextureMgr::Handle missing = mgr.RequestTexture(MissingFile);
+		mgr.Update();
+		Check(log, passed, !mgr.IsReady(missing) && stats.LoadsFailed == 1, L"a missing file fails without retrying");
+
+		TextureMgr::Handle unsupported = mgr.RequestTexture(UnsupportedFile);
+		mgr.Update();
+		Check(log, passed, !mgr.IsReady(unsupported) && stats.LoadsFailed == 2, L"an unsupported format fails");
+	}
+
+	// With a budget that fits one texture, the ones not used this frame are
+	// evicted, and reloaded when they are used again.
+	{
+		TextureMgr mgr;
+		mgr.Init(0, 1, 0);
+
+		TextureMgr::Handle handles[NumFiles];
+		for(UINT i = 0; i < NumFiles; ++i)
+			handles[i] = mgr.RequestTexture(Files[i]);
+		mgr.Update();
+
+		mgr.GetSRV(handles[0]);
+		mgr.Update();
+
+		const TextureMgr::Stats& stats = mgr.GetStats();
+		Check(log, passed, mgr.IsReady(handles[0]), L"the texture used this frame stays resident");
+		Check(log, passed, !mgr.IsReady(handles[1]) && !mgr.IsReady(handles[2]), L"the others are evicted");
+		Check(log, passed, stats.Evictions == NumFiles - 1, L"evictions are counted");
+
+		mgr.GetSRV(handles[1]);
+		mgr.Update();
+		Check(log, passed, mgr.IsReady(handles[1]) && stats.LoadsCompleted == NumFiles + 1, L"an evicted texture reloads when used");
+		Check(log, passed, mgr.GetHitRate() < 1.0f, L"the reload counts as a miss");
+	}
+
+	// The same files through the worker threads.
+	{
+		TextureMgr mgr;
+		mgr.Init(0, noBudget, 2);
+
+		TextureMgr::Handle handles[NumFiles];
+		for(UINT i = 0; i < NumFiles; ++i)
+			handles[i] = mgr.RequestTexture(Files[i]);
+
+		bool allReady = false;
+		for(UINT tries = 0; tries < 1000 && !allReady; ++tries)
+		{
+			Sleep(5);
+			mgr.Update();
+
+			allReady = true;
+			for(UINT i = 0; i < NumFiles; ++i)
+				allReady = allReady && mgr.IsReady(handles[i]);
+		}
+
+		const TextureMgr::Stats& stats = mgr.GetStats();
+		Check(log, passed, allReady, L"the workers load every texture");
+
+		log << L"      average load " << std::fixed << std::setprecision(2)
+			<< 1000.0*stats.TotalLoadTime/MathHelper::Max(stats.LoadsCompleted, 1u)
+			<< L" ms, max " << 1000.0*stats.MaxLoadTime << L" ms" << std::endl;
+	}
+
+	log << (passed ? L"All checks passed." : L"Some checks failed.") << std::endl;
+
+	return passed;
+}